@@ -0,0 +1,556 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements executing methods of objects as messages.
+ *
+ * Each worker's mailbox is an intrusive stack of messages.  Senders push with a
+ * compare-and-swap and the worker takes the whole stack with one exchange,
+ * reversing it to run the batch in the order sent, so neither side ever blocks
+ * the other.  Only a worker with an empty mailbox takes its lock, to sleep: it
+ * flags itself sleeping before checking the mailbox a last time, and a sender
+ * checks the flag after pushing, so either the worker sees the message or the
+ * sender sees the flag and wakes it.  While running a batch the worker
+ * prefetches the object of the following message.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include "actor.h"
+
+/** The methods which may be sent */
+typedef enum actor_op_e_ {
+    /** Not a valid method */
+    ACTOR_OP_E_INVALID,
+    /** base1_increase_val3() */
+    ACTOR_OP_E_INCREASE_VAL3,
+    /** derived1_increase_val4() */
+    ACTOR_OP_E_INCREASE_VAL4,
+    /** base1_set_public_data() */
+    ACTOR_OP_E_SET_PUBLIC_DATA,
+    /** class_registry_get_field() */
+    ACTOR_OP_E_GET_FIELD,
+    /** base1_string() */
+    ACTOR_OP_E_STRING,
+    /** The number of methods */
+    ACTOR_OP_E_MAX,
+} actor_op_e;
+
+/** A method sent to an object */
+typedef struct actor_msg_st_ {
+    /** The message sent before this one, or after it once reversed */
+    struct actor_msg_st_ *next;
+    /** The object */
+    base1_handle obj;
+    /** The method */
+    actor_op_e op;
+    /** Field read by ACTOR_OP_E_GET_FIELD */
+    my_field_e field;
+    /** Public data set by ACTOR_OP_E_SET_PUBLIC_DATA */
+    base1_public_data_st public_data;
+    /** Future completed by the method, if any */
+    actor_future_st *future;
+} actor_msg_st;
+
+/** A worker and its mailbox */
+typedef struct actor_worker_st_ {
+    /** The mailbox, the most recently sent message first */
+    actor_msg_st *head __attribute__((aligned(MY_CACHE_LINE_SIZE)));
+    /** Whether the worker may be waiting for a message */
+    bool sleeping;
+    /** Lock for waiting, only taken when the mailbox is empty */
+    pthread_mutex_t lock __attribute__((aligned(MY_CACHE_LINE_SIZE)));
+    /** Signalled when a message is sent to a sleeping worker */
+    pthread_cond_t cond;
+    /** Whether to exit once the mailbox is empty */
+    bool stopping;
+    /** The thread */
+    pthread_t thread;
+} actor_worker_st;
+
+/**
+ * Private variables which cannot be directly accessed by any other class.
+ */
+typedef struct actor_executor_st_ {
+    /** Number of workers */
+    size_t num_workers;
+    /** The workers */
+    actor_worker_st *workers;
+} actor_executor_st;
+
+/**
+ * Run a method and complete its future.
+ *
+ * @param msg The message
+ */
+static void
+actor_run (actor_msg_st *msg)
+{
+    actor_future_st *future = msg->future;
+    char *string = NULL;
+    uint64_t value = 0;
+    size_t size;
+    my_rc_e rc;
+
+    switch (msg->op) {
+    case ACTOR_OP_E_INCREASE_VAL3:
+        rc = base1_increase_val3(msg->obj);
+        break;
+    case ACTOR_OP_E_INCREASE_VAL4:
+        rc = derived1_increase_val4(base1_try_cast_to_derived1(msg->obj));
+        break;
+    case ACTOR_OP_E_SET_PUBLIC_DATA:
+        rc = base1_set_public_data(msg->obj, &msg->public_data);
+        break;
+    case ACTOR_OP_E_GET_FIELD:
+        rc = class_registry_get_field(msg->obj, msg->field, &value);
+        break;
+    case ACTOR_OP_E_STRING:
+        rc = base1_string_size(msg->obj, &size);
+        if (my_rc_e_is_notok(rc)) {
+            break;
+        }
+        string = malloc(size);
+        if (NULL == string) {
+            rc = MY_RC_E_ENOMEM;
+            break;
+        }
+        rc = base1_string(msg->obj, string, size);
+        if (my_rc_e_is_notok(rc)) {
+            free(string);
+            string = NULL;
+        }
+        break;
+    default:
+        LOG_ERR("Invalid input, op(%u)", msg->op);
+        rc = MY_RC_E_EINVAL;
+        break;
+    }
+
+    if (NULL == future) {
+        free(string);
+        return;
+    }
+    future->rc = rc;
+    future->value = value;
+    future->string = string;
+    __atomic_store_n(&future->done, true, __ATOMIC_RELEASE);
+}
+
+/**
+ * Run the batches of messages sent to a worker until it is stopped and its
+ * mailbox is empty.
+ *
+ * @param arg The worker
+ * @return NULL
+ */
+static void *
+actor_worker_thread (void *arg)
+{
+    actor_worker_st *worker = arg;
+    actor_msg_st *batch, *msg, *next;
+    bool stopping = false;
+
+    while (true) {
+        batch = __atomic_exchange_n(&worker->head, NULL, __ATOMIC_ACQUIRE);
+        if (NULL == batch) {
+            if (stopping) {
+                break;
+            }
+            pthread_mutex_lock(&worker->lock);
+            __atomic_store_n(&worker->sleeping, true, __ATOMIC_SEQ_CST);
+            if ((NULL == __atomic_load_n(&worker->head, __ATOMIC_SEQ_CST)) &&
+                !worker->stopping) {
+                pthread_cond_wait(&worker->cond, &worker->lock);
+            }
+            __atomic_store_n(&worker->sleeping, false, __ATOMIC_RELAXED);
+            stopping = worker->stopping;
+            pthread_mutex_unlock(&worker->lock);
+            continue;
+        }
+
+        /* Reverse the stack into the order the messages were sent */
+        for (msg = NULL; NULL != batch; batch = next) {
+            next = batch->next;
+            batch->next = msg;
+            msg = batch;
+        }
+        for (; NULL != msg; msg = next) {
+            next = msg->next;
+            if (NULL != next) {
+                __builtin_prefetch(next->obj);
+            }
+            actor_run(msg);
+            free(msg);
+        }
+    }
+
+    return (NULL);
+}
+
+/**
+ * Stop workers once their mailboxes are empty and wait for them to exit.
+ *
+ * @param executor_h The executor
+ * @param num_workers Number of workers started
+ */
+static void
+actor_stop_workers (actor_executor_handle executor_h, size_t num_workers)
+{
+    actor_worker_st *worker;
+    size_t i;
+
+    for (i = 0; i < num_workers; i++) {
+        worker = &executor_h->workers[i];
+        pthread_mutex_lock(&worker->lock);
+        worker->stopping = true;
+        pthread_cond_signal(&worker->cond);
+        pthread_mutex_unlock(&worker->lock);
+    }
+    for (i = 0; i < num_workers; i++) {
+        pthread_join(executor_h->workers[i].thread, NULL);
+    }
+}
+
+/**
+ * Free an executor whose workers have exited.
+ *
+ * @param executor_h The executor
+ */
+static void
+actor_executor_free (actor_executor_handle executor_h)
+{
+    size_t i;
+
+    for (i = 0; i < executor_h->num_workers; i++) {
+        pthread_mutex_destroy(&executor_h->workers[i].lock);
+        pthread_cond_destroy(&executor_h->workers[i].cond);
+    }
+    free(executor_h->workers);
+    free(executor_h);
+}
+
+/**
+ * Create an executor and start its workers.
+ *
+ * @param num_workers Number of workers, and so of shards of the objects
+ * @return The executor, or NULL on failure
+ */
+actor_executor_handle
+actor_executor_new (size_t num_workers)
+{
+    actor_executor_handle executor_h;
+    actor_worker_st *worker;
+    size_t i;
+
+    if (0 == num_workers) {
+        LOG_ERR("Invalid input, num_workers(%zu)", num_workers);
+        return (NULL);
+    }
+
+    executor_h = calloc(1, sizeof(*executor_h));
+    if (NULL == executor_h) {
+        return (NULL);
+    }
+    executor_h->workers = aligned_alloc(MY_CACHE_LINE_SIZE,
+                                        num_workers *
+                                        sizeof(*executor_h->workers));
+    if (NULL == executor_h->workers) {
+        free(executor_h);
+        return (NULL);
+    }
+    memset(executor_h->workers, 0, num_workers * sizeof(*executor_h->workers));
+    executor_h->num_workers = num_workers;
+
+    for (i = 0; i < num_workers; i++) {
+        worker = &executor_h->workers[i];
+        pthread_mutex_init(&worker->lock, NULL);
+        pthread_cond_init(&worker->cond, NULL);
+    }
+    for (i = 0; i < num_workers; i++) {
+        worker = &executor_h->workers[i];
+        if (0 != pthread_create(&worker->thread, NULL, actor_worker_thread,
+                                worker)) {
+            actor_stop_workers(executor_h, i);
+            actor_executor_free(executor_h);
+            return (NULL);
+        }
+    }
+
+    return (executor_h);
+}
+
+/**
+ * Delete an executor once every method sent to it has run.  No method may be
+ * sent to it once this is called.
+ *
+ * @param executor_h The executor
+ */
+void
+actor_executor_delete (actor_executor_handle executor_h)
+{
+    if (NULL == executor_h) {
+        return;
+    }
+
+    actor_stop_workers(executor_h, executor_h->num_workers);
+    actor_executor_free(executor_h);
+}
+
+/**
+ * Create a message of a method for an object, resetting its future.
+ *
+ * @param executor_h The executor
+ * @param base1_h The object
+ * @param op The method
+ * @param future Future to complete, or NULL
+ * @param msg Outputs the message, to fill in and send
+ * @return Return code
+ */
+static my_rc_e
+actor_msg_new (actor_executor_handle executor_h, base1_handle base1_h,
+               actor_op_e op, actor_future_st *future, actor_msg_st **msg)
+{
+    if ((NULL == executor_h) || (NULL == base1_h)) {
+        LOG_ERR("Invalid input, executor_h(%p) base1_h(%p)", executor_h,
+                base1_h);
+        return (MY_RC_E_EINVAL);
+    }
+
+    *msg = malloc(sizeof(**msg));
+    if (NULL == *msg) {
+        return (MY_RC_E_ENOMEM);
+    }
+    (*msg)->obj = base1_h;
+    (*msg)->op = op;
+    (*msg)->future = future;
+    if (NULL != future) {
+        future->done = false;
+        future->string = NULL;
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Send a message to the mailbox of its object's worker, waking the worker if
+ * it is sleeping.
+ *
+ * @param executor_h The executor
+ * @param msg The message
+ */
+static void
+actor_msg_send (actor_executor_handle executor_h, actor_msg_st *msg)
+{
+    actor_worker_st *worker;
+
+    worker = &executor_h->workers[base1_get_object_id(msg->obj) %
+                                  executor_h->num_workers];
+    msg->next = __atomic_load_n(&worker->head, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&worker->head, &msg->next, msg, true,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+    }
+
+    if (__atomic_load_n(&worker->sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&worker->lock);
+        pthread_cond_signal(&worker->cond);
+        pthread_mutex_unlock(&worker->lock);
+    }
+}
+
+/**
+ * Send base1_increase_val3() to an object.
+ *
+ * @param executor_h The executor
+ * @param base1_h The object
+ * @param future Future completed with the return code, or NULL
+ * @return Return code of sending
+ */
+my_rc_e
+actor_increase_val3 (actor_executor_handle executor_h, base1_handle base1_h,
+                     actor_future_st *future)
+{
+    actor_msg_st *msg;
+    my_rc_e rc;
+
+    rc = actor_msg_new(executor_h, base1_h, ACTOR_OP_E_INCREASE_VAL3,
+                       future, &msg);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+    actor_msg_send(executor_h, msg);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Send derived1_increase_val4() to an object.
+ *
+ * @param executor_h The executor
+ * @param derived1_h The object
+ * @param future Future completed with the return code, or NULL
+ * @return Return code of sending
+ */
+my_rc_e
+actor_increase_val4 (actor_executor_handle executor_h,
+                     derived1_handle derived1_h, actor_future_st *future)
+{
+    actor_msg_st *msg;
+    my_rc_e rc;
+
+    rc = actor_msg_new(executor_h, derived1_cast_to_base1(derived1_h),
+                       ACTOR_OP_E_INCREASE_VAL4, future, &msg);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+    actor_msg_send(executor_h, msg);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Send base1_set_public_data() to an object.
+ *
+ * @param executor_h The executor
+ * @param base1_h The object
+ * @param public_data The public data, which is copied
+ * @param future Future completed with the return code, or NULL
+ * @return Return code of sending
+ */
+my_rc_e
+actor_set_public_data (actor_executor_handle executor_h, base1_handle base1_h,
+                       const base1_public_data_st *public_data,
+                       actor_future_st *future)
+{
+    actor_msg_st *msg;
+    my_rc_e rc;
+
+    if (NULL == public_data) {
+        LOG_ERR("Invalid input, public_data(%p)", public_data);
+        return (MY_RC_E_EINVAL);
+    }
+
+    rc = actor_msg_new(executor_h, base1_h, ACTOR_OP_E_SET_PUBLIC_DATA,
+                       future, &msg);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+    msg->public_data = *public_data;
+    actor_msg_send(executor_h, msg);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Send a read of a field to an object.
+ *
+ * @param executor_h The executor
+ * @param base1_h The object
+ * @param field The field
+ * @param future Future completed with the return code and the value
+ * @return Return code of sending
+ * @see class_registry_get_field()
+ */
+my_rc_e
+actor_get_field (actor_executor_handle executor_h, base1_handle base1_h,
+                 my_field_e field, actor_future_st *future)
+{
+    actor_msg_st *msg;
+    my_rc_e rc;
+
+    if (NULL == future) {
+        LOG_ERR("Invalid input, future(%p)", future);
+        return (MY_RC_E_EINVAL);
+    }
+
+    rc = actor_msg_new(executor_h, base1_h, ACTOR_OP_E_GET_FIELD, future,
+                       &msg);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+    msg->field = field;
+    actor_msg_send(executor_h, msg);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Send rendering an object's string to the object.
+ *
+ * @param executor_h The executor
+ * @param base1_h The object
+ * @param future Future completed with the return code and the string
+ * @return Return code of sending
+ * @see base1_string()
+ */
+my_rc_e
+actor_string (actor_executor_handle executor_h, base1_handle base1_h,
+              actor_future_st *future)
+{
+    actor_msg_st *msg;
+    my_rc_e rc;
+
+    if (NULL == future) {
+        LOG_ERR("Invalid input, future(%p)", future);
+        return (MY_RC_E_EINVAL);
+    }
+
+    rc = actor_msg_new(executor_h, base1_h, ACTOR_OP_E_STRING, future,
+                       &msg);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+    actor_msg_send(executor_h, msg);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Indicates whether the method of a future has completed.
+ *
+ * @param future The future
+ * @return true if the method completed, after which its results may be read
+ */
+bool
+actor_future_is_done (const actor_future_st *future)
+{
+    return (__atomic_load_n(&future->done, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * Wait for the method of a future to complete, yielding the CPU meanwhile
+ * since the worker may need it.
+ *
+ * @param future The future
+ * @return Return code of the method
+ */
+my_rc_e
+actor_future_wait (const actor_future_st *future)
+{
+    if (NULL == future) {
+        LOG_ERR("Invalid input, future(%p)", future);
+        return (MY_RC_E_EINVAL);
+    }
+
+    while (!actor_future_is_done(future)) {
+        sched_yield();
+    }
+
+    return (future->rc);
+}
@@ -0,0 +1,96 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for executing methods of objects as messages.
+ * An executor has worker threads, each owning a mailbox for a shard of the
+ * objects chosen by object ID.  Rather than calling a method, and locking an
+ * object shared between threads, a thread sends the method to the object's
+ * mailbox.  Its worker runs the methods in the order they were sent, so an
+ * object is only ever mutated by one thread and needs no lock.
+ *
+ * A mailbox is a lock-free stack any thread may push to, which the worker takes
+ * whole and runs as a batch.  A method with a result, such as the object's
+ * string, completes a future which the sender waits on.  An object must not be
+ * deleted while methods sent to it are pending, and should not be accessed
+ * directly by other threads while the executor may be running methods on it.
+ */
+#ifndef __ACTOR_H__
+#define __ACTOR_H__
+
+#include "common.h"
+#include "base1.h"
+#include "derived1.h"
+#include "class_registry.h"
+
+/** Opaque handle of an executor */
+typedef struct actor_executor_st_ *actor_executor_handle;
+
+/**
+ * The result of a method sent to an object.  The sender owns the future,
+ * which must remain valid until the method completes.
+ */
+typedef struct actor_future_st_ {
+    /** Whether the method completed, only set by the executor */
+    bool done;
+    /** Return code of the method */
+    my_rc_e rc;
+    /** Value of a field read by actor_get_field() */
+    uint64_t value;
+    /** String rendered by actor_string(), which the sender frees */
+    char *string;
+} actor_future_st;
+
+/* APIs below are documented in their implementation file */
+
+extern actor_executor_handle
+actor_executor_new(size_t num_workers);
+
+extern void
+actor_executor_delete(actor_executor_handle executor_h);
+
+extern my_rc_e
+actor_increase_val3(actor_executor_handle executor_h, base1_handle base1_h,
+                    actor_future_st *future);
+
+extern my_rc_e
+actor_increase_val4(actor_executor_handle executor_h,
+                    derived1_handle derived1_h, actor_future_st *future);
+
+extern my_rc_e
+actor_set_public_data(actor_executor_handle executor_h, base1_handle base1_h,
+                      const base1_public_data_st *public_data,
+                      actor_future_st *future);
+
+extern my_rc_e
+actor_get_field(actor_executor_handle executor_h, base1_handle base1_h,
+                my_field_e field, actor_future_st *future);
+
+extern my_rc_e
+actor_string(actor_executor_handle executor_h, base1_handle base1_h,
+             actor_future_st *future);
+
+extern bool
+actor_future_is_done(const actor_future_st *future);
+
+extern my_rc_e
+actor_future_wait(const actor_future_st *future);
+
+#endif
@@ -0,0 +1,377 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements the running aggregates.
+ *
+ * Each thread which updates an aggregate gets its own shard holding every
+ * aggregate, so updates are plain loads and stores to memory no other thread
+ * writes.  Readers merge the shards.  As with the journal's rings, shards are
+ * never freed: an exiting thread releases its shard for the next new thread to
+ * adopt, and since the shard holds sums of changes rather than anything of the
+ * thread's own, the adopter simply carries on.  The list of shards only grows,
+ * at its head, so readers walk it without a lock.
+ *
+ * Each start of aggregation is a new generation.  An object records the
+ * generation it was added in, so a later start does not count objects added
+ * before it, and a shard is cleared by its owner when it first updates in a new
+ * generation, so starting never writes to another thread's shard.
+ */
+#include <pthread.h>
+#include "aggregate.h"
+#include "base1_friend.h"
+
+/** A thread's part of every aggregate */
+typedef struct aggregate_shard_st_ {
+    /** Generation the results belong to, owned by the updating thread */
+    uint32_t gen __attribute__((aligned(MY_CACHE_LINE_SIZE)));
+    /** Results of each field of each class */
+    aggregate_result_st results[MY_CLASS_ID_E_MAX][MY_FIELD_E_MAX];
+    /** Whether a live thread updates the shard */
+    bool owned __attribute__((aligned(MY_CACHE_LINE_SIZE)));
+    /** The next shard on the list */
+    struct aggregate_shard_st_ *next;
+} aggregate_shard_st;
+
+bool aggregate_active = false;
+
+/** The current generation, zero before aggregation is first started */
+static uint32_t aggregate_gen = 0;
+
+/** The calling thread's shard, or NULL if it has not updated yet */
+static __thread aggregate_shard_st *aggregate_thread_shard;
+
+/** Key whose destructor releases an exiting thread's shard */
+static pthread_key_t aggregate_key;
+
+/** Ensures the key is created once */
+static pthread_once_t aggregate_key_once = PTHREAD_ONCE_INIT;
+
+/** Serializes adding and adopting shards */
+static pthread_mutex_t aggregate_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** List of all shards, most recent first */
+static aggregate_shard_st *aggregate_shards;
+
+/**
+ * Release an exiting thread's shard for adoption.  This is the destructor of
+ * the thread-specific key.
+ *
+ * @param arg The shard
+ */
+static void
+aggregate_shard_release (void *arg)
+{
+    aggregate_shard_st *shard = arg;
+
+    __atomic_store_n(&shard->owned, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * Create the key releasing the shards of exiting threads.
+ */
+static void
+aggregate_key_init (void)
+{
+    pthread_key_create(&aggregate_key, aggregate_shard_release);
+}
+
+/**
+ * Get the calling thread's shard for a generation, adopting a released
+ * shard or creating one on first use, and clearing it if it holds an
+ * earlier generation.
+ *
+ * @param gen The generation
+ * @return The shard or NULL if it could not be created
+ */
+static aggregate_shard_st *
+aggregate_shard_get (uint32_t gen)
+{
+    aggregate_shard_st *shard = aggregate_thread_shard;
+    size_t i, j;
+
+    if (NULL == shard) {
+        pthread_once(&aggregate_key_once, aggregate_key_init);
+
+        pthread_mutex_lock(&aggregate_lock);
+
+        for (shard = aggregate_shards; NULL != shard; shard = shard->next) {
+            if (!__atomic_load_n(&shard->owned, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+        }
+
+        if (NULL == shard) {
+            shard = aligned_alloc(MY_CACHE_LINE_SIZE, sizeof(*shard));
+            if (NULL != shard) {
+                memset(shard, 0, sizeof(*shard));
+                shard->next = aggregate_shards;
+                __atomic_store_n(&aggregate_shards, shard, __ATOMIC_RELEASE);
+            }
+        }
+
+        if ((NULL != shard) &&
+            (0 == pthread_setspecific(aggregate_key, shard))) {
+            shard->owned = true;
+            aggregate_thread_shard = shard;
+        } else {
+            shard = NULL;
+        }
+
+        pthread_mutex_unlock(&aggregate_lock);
+
+        if (NULL == shard) {
+            return (NULL);
+        }
+    }
+
+    if (gen != shard->gen) {
+        /* Readers skip the shard until its generation is stored */
+        for (i = 0; i < MY_CLASS_ID_E_MAX; i++) {
+            for (j = 0; j < MY_FIELD_E_MAX; j++) {
+                __atomic_store_n(&shard->results[i][j].count, 0,
+                                 __ATOMIC_RELAXED);
+                __atomic_store_n(&shard->results[i][j].sum, 0,
+                                 __ATOMIC_RELAXED);
+                __atomic_store_n(&shard->results[i][j].min, UINT64_MAX,
+                                 __ATOMIC_RELAXED);
+                __atomic_store_n(&shard->results[i][j].max, 0,
+                                 __ATOMIC_RELAXED);
+            }
+        }
+        __atomic_store_n(&shard->gen, gen, __ATOMIC_RELEASE);
+    }
+
+    return (shard);
+}
+
+/**
+ * Apply a change to a result in the calling thread's shard.  Only the owner
+ * writes the result, so this needs no atomic read-modify-write, only stores
+ * readers cannot see torn.
+ *
+ * @param result The result
+ * @param count Change in the number of objects
+ * @param sum Change in the sum
+ * @param value A value now held, which may extend the minimum and maximum
+ * @param held Whether value is held, else there is no new value
+ */
+static void
+aggregate_apply (aggregate_result_st *result, uint64_t count, uint64_t sum,
+                 uint64_t value, bool held)
+{
+    __atomic_store_n(&result->count, result->count + count, __ATOMIC_RELAXED);
+    __atomic_store_n(&result->sum, result->sum + sum, __ATOMIC_RELAXED);
+    if (!held) {
+        return;
+    }
+    if (value < result->min) {
+        __atomic_store_n(&result->min, value, __ATOMIC_RELAXED);
+    }
+    if (value > result->max) {
+        __atomic_store_n(&result->max, value, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Add or remove every field of an object in the calling thread's shard.
+ *
+ * @param base1_h The object
+ * @param gen The current generation
+ * @param add Whether to add the object, else remove it
+ */
+static void
+aggregate_apply_object (base1_handle base1_h, uint32_t gen, bool add)
+{
+    my_class_id_e class_id = base1_class_id(base1_h);
+    const class_field_st *fields;
+    aggregate_shard_st *shard;
+    size_t num_fields, i;
+    uint64_t value;
+
+    shard = aggregate_shard_get(gen);
+    if ((NULL == shard) || !my_class_id_e_is_valid(class_id)) {
+        return;
+    }
+
+    num_fields = class_registry_get_fields(class_id, &fields);
+    for (i = 0; i < num_fields; i++) {
+        if (my_rc_e_is_notok(class_registry_get_field(base1_h,
+                                                      fields[i].field,
+                                                      &value))) {
+            continue;
+        }
+        if (add) {
+            aggregate_apply(&shard->results[class_id][fields[i].field], 1,
+                            value, value, true);
+        } else {
+            aggregate_apply(&shard->results[class_id][fields[i].field], -1,
+                            -value, 0, false);
+        }
+    }
+}
+
+/**
+ * Start aggregation.  This begins a new generation: the aggregates restart
+ * from nothing, and objects constructed from then on are counted.
+ *
+ * @see aggregate_add()
+ */
+void
+aggregate_start (void)
+{
+    __atomic_add_fetch(&aggregate_gen, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&aggregate_active, true, __ATOMIC_RELEASE);
+}
+
+/**
+ * Stop aggregation.  The aggregates keep their last values for reading.
+ */
+void
+aggregate_stop (void)
+{
+    __atomic_store_n(&aggregate_active, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * Add an object to the aggregates.  Objects constructed while aggregation is
+ * started are added automatically; this adds ones constructed earlier.
+ * Adding an object twice has no effect.
+ *
+ * @param base1_h The object
+ */
+void
+aggregate_add (base1_handle base1_h)
+{
+    uint32_t gen = __atomic_load_n(&aggregate_gen, __ATOMIC_ACQUIRE);
+
+    if ((NULL == base1_h) || (0 == gen) ||
+        (gen == base1_get_aggregate_gen(base1_h))) {
+        return;
+    }
+
+    base1_set_aggregate_gen(base1_h, gen);
+    aggregate_apply_object(base1_h, gen, true);
+}
+
+/**
+ * Remove an object from the aggregates.
+ *
+ * @param base1_h The object
+ * @return Whether the object was counted
+ * @see AGGREGATE_REMOVE()
+ */
+bool
+aggregate_remove (base1_handle base1_h)
+{
+    uint32_t gen = __atomic_load_n(&aggregate_gen, __ATOMIC_ACQUIRE);
+
+    if ((NULL == base1_h) || (0 == gen) ||
+        (gen != base1_get_aggregate_gen(base1_h))) {
+        return (false);
+    }
+
+    aggregate_apply_object(base1_h, gen, false);
+    base1_set_aggregate_gen(base1_h, 0);
+
+    return (true);
+}
+
+/**
+ * Update the aggregates of a field of an object which changed.
+ *
+ * @param base1_h The object
+ * @param field The field
+ * @param old_value The value before the change
+ * @param new_value The value after the change
+ * @see AGGREGATE_UPDATE()
+ */
+void
+aggregate_update (base1_handle base1_h, my_field_e field, uint64_t old_value,
+                  uint64_t new_value)
+{
+    uint32_t gen = __atomic_load_n(&aggregate_gen, __ATOMIC_ACQUIRE);
+    my_class_id_e class_id;
+    aggregate_shard_st *shard;
+
+    if ((NULL == base1_h) || (0 == gen) ||
+        (gen != base1_get_aggregate_gen(base1_h))) {
+        return;
+    }
+
+    class_id = base1_class_id(base1_h);
+    shard = aggregate_shard_get(gen);
+    if ((NULL == shard) || !my_class_id_e_is_valid(class_id)) {
+        return;
+    }
+    aggregate_apply(&shard->results[class_id][field], 0,
+                    new_value - old_value, new_value, true);
+}
+
+/**
+ * Read an aggregate by merging every thread's part of it.
+ *
+ * @param class_id The class, or MY_CLASS_ID_E_INVALID for objects of every
+ * class.  Objects are counted under their own class, not their parents'.
+ * @param field The field
+ * @param result Outputs the aggregate
+ * @return Return code
+ */
+my_rc_e
+aggregate_get (my_class_id_e class_id, my_field_e field,
+               aggregate_result_st *result)
+{
+    uint32_t gen = __atomic_load_n(&aggregate_gen, __ATOMIC_ACQUIRE);
+    const aggregate_result_st *part;
+    const aggregate_shard_st *shard;
+    my_class_id_e id;
+    uint64_t value;
+
+    if ((class_id >= MY_CLASS_ID_E_MAX) || (field <= MY_FIELD_E_INVALID) ||
+        (field >= MY_FIELD_E_MAX) || (NULL == result)) {
+        LOG_ERR("Invalid input, class_id(%u) field(%u) result(%p)", class_id,
+                field, result);
+        return (MY_RC_E_EINVAL);
+    }
+
+    memset(result, 0, sizeof(*result));
+    result->min = UINT64_MAX;
+
+    for (shard = __atomic_load_n(&aggregate_shards, __ATOMIC_ACQUIRE);
+         NULL != shard; shard = shard->next) {
+        if (gen != __atomic_load_n(&shard->gen, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+        for (id = 0; id < MY_CLASS_ID_E_MAX; id++) {
+            if ((MY_CLASS_ID_E_INVALID != class_id) && (class_id != id)) {
+                continue;
+            }
+            part = &shard->results[id][field];
+            result->count += __atomic_load_n(&part->count, __ATOMIC_RELAXED);
+            result->sum += __atomic_load_n(&part->sum, __ATOMIC_RELAXED);
+            value = __atomic_load_n(&part->min, __ATOMIC_RELAXED);
+            result->min = (value < result->min) ? value : result->min;
+            value = __atomic_load_n(&part->max, __ATOMIC_RELAXED);
+            result->max = (value > result->max) ? value : result->max;
+        }
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
@@ -0,0 +1,126 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for running aggregates over live objects.  While
+ * aggregation is started, the count, sum, minimum and maximum of each field are
+ * kept for each class, updated as objects are constructed, mutated and deleted.
+ * Reading an aggregate costs a step per thread which has updated one rather
+ * than a step per object.
+ *
+ * Objects constructed before aggregation started can be added explicitly.  An
+ * object stops counting when it is deleted or put in a recycle bin or object
+ * pool.
+ *
+ * The minimum and maximum are the extremes of every value an aggregated object
+ * has held since aggregation started.  They are not lowered or raised again
+ * when the object holding an extreme changes or is deleted, which would need
+ * every value kept, so they bound the live values rather than equal them.
+ */
+#ifndef __AGGREGATE_H__
+#define __AGGREGATE_H__
+
+#include "common.h"
+#include "base1.h"
+#include "class_registry.h"
+
+/** An aggregate of a field */
+typedef struct aggregate_result_st_ {
+    /** Number of live objects with the field */
+    uint64_t count;
+    /** Sum of the field over them */
+    uint64_t sum;
+    /** Smallest value held, UINT64_MAX if none */
+    uint64_t min;
+    /** Largest value held, zero if none */
+    uint64_t max;
+} aggregate_result_st;
+
+/** Indicates whether aggregation is started.  Use aggregate_is_enabled(). */
+extern bool aggregate_active;
+
+/**
+ * Indicates whether aggregation is started.  This is inline since it is
+ * checked on every construction, mutation and deletion.
+ *
+ * @return true if aggregation is started.
+ */
+static inline bool
+aggregate_is_enabled (void)
+{
+    return (__atomic_load_n(&aggregate_active, __ATOMIC_RELAXED));
+}
+
+/**
+ * Add a new object to the aggregates if aggregation is started.  The
+ * argument is only evaluated when aggregation is enabled.
+ */
+#define AGGREGATE_ADD(base1_h) \
+do { \
+    if (aggregate_is_enabled()) { \
+        aggregate_add(base1_h); \
+    } \
+} while (0)
+
+/**
+ * Remove an object from the aggregates if aggregation is started.  The
+ * argument is only evaluated when aggregation is enabled.
+ */
+#define AGGREGATE_REMOVE(base1_h) \
+do { \
+    if (aggregate_is_enabled()) { \
+        (void) aggregate_remove(base1_h); \
+    } \
+} while (0)
+
+/**
+ * Update the aggregates of a mutated field if aggregation is started.  The
+ * arguments are only evaluated when aggregation is enabled.
+ */
+#define AGGREGATE_UPDATE(base1_h, field, old_value, new_value) \
+do { \
+    if (aggregate_is_enabled()) { \
+        aggregate_update((base1_h), (field), (old_value), (new_value)); \
+    } \
+} while (0)
+
+/* APIs below are documented in their implementation file */
+
+extern void
+aggregate_start(void);
+
+extern void
+aggregate_stop(void);
+
+extern void
+aggregate_add(base1_handle base1_h);
+
+extern bool
+aggregate_remove(base1_handle base1_h);
+
+extern void
+aggregate_update(base1_handle base1_h, my_field_e field, uint64_t old_value,
+                 uint64_t new_value);
+
+extern my_rc_e
+aggregate_get(my_class_id_e class_id, my_field_e field,
+              aggregate_result_st *result);
+
+#endif
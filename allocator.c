@@ -0,0 +1,481 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements the default allocator and the built-in alternatives.
+ *
+ * The bump allocator carves allocations sequentially out of large chunks and
+ * never reuses freed memory; it is not thread safe, so each thread should use
+ * its own.  The pool allocator keeps a free list per 16 byte size class and is
+ * thread safe, trading a lock for never returning memory to the heap until
+ * the pool is deleted.  Larger allocations come straight from the heap, on a
+ * list so that deleting the pool frees those still allocated as well.
+ */
+#include <pthread.h>
+#include "allocator.h"
+
+/** Alignment of every allocation from the built-in allocators */
+#define ALLOCATOR_ALIGN 16
+
+/** Largest allocation served by the pool free lists */
+#define ALLOCATOR_POOL_MAX_SIZE 512
+
+/** Number of pool size classes */
+#define ALLOCATOR_POOL_NUM_CLASSES (ALLOCATOR_POOL_MAX_SIZE / ALLOCATOR_ALIGN)
+
+/** Size of the slabs the pool carves blocks from */
+#define ALLOCATOR_POOL_SLAB_SIZE (64 * 1024)
+
+/** Round a size up to the allocation alignment */
+#define ALLOCATOR_ROUND(size) \
+    (((size) + ALLOCATOR_ALIGN - 1) & ~((size_t) ALLOCATOR_ALIGN - 1))
+
+/** A chunk of memory, linked to the previously allocated chunk */
+typedef struct allocator_chunk_st_ {
+    /** The previously allocated chunk */
+    struct allocator_chunk_st_ *next;
+    /** Padding so the memory following the header is aligned */
+    uint8_t pad[ALLOCATOR_ALIGN - sizeof(void *)];
+} allocator_chunk_st;
+
+/** State of a bump allocator */
+typedef struct allocator_bump_st_ {
+    /** The allocator, whose ctx points back at this state */
+    allocator_st allocator;
+    /** Chunks allocated so far, most recent first */
+    allocator_chunk_st *chunks;
+    /** Next free byte in the current chunk */
+    uint8_t *cur;
+    /** End of the current chunk */
+    uint8_t *end;
+    /** Usable size of each chunk */
+    size_t chunk_size;
+} allocator_bump_st;
+
+/** A free block in a pool size class */
+typedef struct allocator_pool_block_st_ {
+    /** The next free block */
+    struct allocator_pool_block_st_ *next;
+} allocator_pool_block_st;
+
+/** A pool allocation too large for the free lists, linked to the others */
+typedef struct allocator_pool_large_st_ {
+    /** The next large allocation */
+    struct allocator_pool_large_st_ *next;
+    /** The previous large allocation */
+    struct allocator_pool_large_st_ *prev;
+} allocator_pool_large_st;
+
+/** State of a pool allocator */
+typedef struct allocator_pool_st_ {
+    /** The allocator, whose ctx points back at this state */
+    allocator_st allocator;
+    /** Protects the free lists and slabs */
+    pthread_mutex_t lock;
+    /** Slabs allocated so far, most recent first */
+    allocator_chunk_st *slabs;
+    /** Large allocations not yet freed, most recent first */
+    allocator_pool_large_st *large;
+    /** Free list for each size class */
+    allocator_pool_block_st *free_lists[ALLOCATOR_POOL_NUM_CLASSES];
+} allocator_pool_st;
+
+/** @cond doxygen_suppress */
+CT_ASSERT(ALLOCATOR_ALIGN == sizeof(allocator_chunk_st));
+CT_ASSERT(0 == (sizeof(allocator_pool_large_st) % ALLOCATOR_ALIGN));
+/** @endcond */
+
+/**
+ * Allocate from the heap.
+ *
+ * @param ctx Unused
+ * @param size Number of bytes
+ * @return The memory or NULL
+ */
+static void *
+allocator_heap_alloc (void *ctx, size_t size)
+{
+    return (malloc(size));
+}
+
+/**
+ * Free to the heap.
+ *
+ * @param ctx Unused
+ * @param ptr The memory
+ * @param size Unused
+ */
+static void
+allocator_heap_free (void *ctx, void *ptr, size_t size)
+{
+    free(ptr);
+}
+
+const allocator_st allocator_heap = {
+    allocator_heap_alloc,
+    allocator_heap_free,
+    NULL
+};
+
+/** The allocator used when none is given at construction */
+static const allocator_st *allocator_default = &allocator_heap;
+
+/**
+ * Get the process-wide default allocator.
+ *
+ * @return The default allocator
+ */
+const allocator_st *
+allocator_get_default (void)
+{
+    return (__atomic_load_n(&allocator_default, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * Set the process-wide default allocator, used for objects constructed without
+ * an explicit allocator.  Objects already constructed keep freeing to the
+ * allocator that created them.
+ *
+ * @param allocator The allocator or NULL to restore the heap allocator.
+ */
+void
+allocator_set_default (const allocator_st *allocator)
+{
+    if (NULL == allocator) {
+        allocator = &allocator_heap;
+    }
+
+    __atomic_store_n(&allocator_default, allocator, __ATOMIC_RELEASE);
+}
+
+/**
+ * Allocate memory from an allocator.  The memory is not zeroed.  In poison
+ * builds it is filled with MY_POISON_BYTE, so that constructors can verify
+ * they initialized every field.
+ *
+ * @param allocator The allocator or NULL for the default allocator.
+ * @param size Number of bytes
+ * @return The memory or NULL if allocation failed
+ * @see POISON_CHECK_FIELD()
+ */
+void *
+allocator_alloc (const allocator_st *allocator, size_t size)
+{
+    void *ptr;
+
+    if (NULL == allocator) {
+        allocator = allocator_get_default();
+    }
+
+    ptr = allocator->alloc_fn(allocator->ctx, size);
+
+#ifdef MY_DEBUG_POISON
+    if (NULL != ptr) {
+        memset(ptr, MY_POISON_BYTE, size);
+    }
+#endif
+
+    return (ptr);
+}
+
+/**
+ * Free memory to the allocator it came from.
+ *
+ * @param allocator The allocator or NULL for the default allocator.
+ * @param ptr The memory.  If NULL, then this function is a no-op.
+ * @param size The size given when the memory was allocated
+ */
+void
+allocator_free (const allocator_st *allocator, void *ptr, size_t size)
+{
+    if (NULL == ptr) {
+        return;
+    }
+
+    if (NULL == allocator) {
+        allocator = allocator_get_default();
+    }
+
+    allocator->free_fn(allocator->ctx, ptr, size);
+}
+
+/**
+ * Allocate from a bump allocator.
+ *
+ * @param ctx The bump allocator state
+ * @param size Number of bytes
+ * @return The memory or NULL
+ */
+static void *
+allocator_bump_alloc (void *ctx, size_t size)
+{
+    allocator_bump_st *bump = ctx;
+    allocator_chunk_st *chunk;
+    size_t chunk_size;
+    void *ptr;
+
+    size = ALLOCATOR_ROUND(size);
+    if (size > (size_t) (bump->end - bump->cur)) {
+        chunk_size = (size > bump->chunk_size) ? size : bump->chunk_size;
+        chunk = malloc(sizeof(*chunk) + chunk_size);
+        if (NULL == chunk) {
+            return (NULL);
+        }
+
+        chunk->next = bump->chunks;
+        bump->chunks = chunk;
+        bump->cur = (uint8_t *) (chunk + 1);
+        bump->end = bump->cur + chunk_size;
+    }
+
+    ptr = bump->cur;
+    bump->cur += size;
+
+    return (ptr);
+}
+
+/**
+ * Free to a bump allocator, which is a no-op.  The memory is released when the
+ * allocator is deleted.
+ *
+ * @param ctx Unused
+ * @param ptr Unused
+ * @param size Unused
+ */
+static void
+allocator_bump_free (void *ctx, void *ptr, size_t size)
+{
+}
+
+/**
+ * Create a bump allocator.  It is not thread safe, so it should only be used
+ * by the thread that created it, and it never reuses freed memory, so it suits
+ * short lived batches of objects.
+ *
+ * @param chunk_size The number of bytes to allocate from the heap at a time,
+ * or zero for a default.
+ * @return The allocator or NULL if creation failed
+ */
+allocator_st *
+allocator_bump_new (size_t chunk_size)
+{
+    allocator_bump_st *bump;
+
+    bump = calloc(1, sizeof(*bump));
+    if (NULL == bump) {
+        return (NULL);
+    }
+
+    bump->allocator.alloc_fn = allocator_bump_alloc;
+    bump->allocator.free_fn = allocator_bump_free;
+    bump->allocator.ctx = bump;
+    bump->chunk_size = (0 == chunk_size) ? (1024 * 1024) :
+        ALLOCATOR_ROUND(chunk_size);
+
+    return (&bump->allocator);
+}
+
+/**
+ * Delete a bump allocator and all memory allocated from it.
+ *
+ * @param allocator The allocator.  If NULL, then this function is a no-op.
+ */
+void
+allocator_bump_delete (allocator_st *allocator)
+{
+    allocator_bump_st *bump;
+    allocator_chunk_st *chunk;
+
+    if (NULL == allocator) {
+        return;
+    }
+
+    bump = allocator->ctx;
+    while (NULL != bump->chunks) {
+        chunk = bump->chunks;
+        bump->chunks = chunk->next;
+        free(chunk);
+    }
+
+    free(bump);
+}
+
+/**
+ * Allocate from a pool allocator.
+ *
+ * @param ctx The pool allocator state
+ * @param size Number of bytes
+ * @return The memory or NULL
+ */
+static void *
+allocator_pool_alloc (void *ctx, size_t size)
+{
+    allocator_pool_st *pool = ctx;
+    allocator_pool_block_st *block;
+    allocator_pool_large_st *large;
+    allocator_chunk_st *slab;
+    size_t class, offset;
+
+    size = ALLOCATOR_ROUND((0 == size) ? 1 : size);
+    if (size > ALLOCATOR_POOL_MAX_SIZE) {
+        large = malloc(sizeof(*large) + size);
+        if (NULL == large) {
+            return (NULL);
+        }
+        pthread_mutex_lock(&pool->lock);
+        large->prev = NULL;
+        large->next = pool->large;
+        if (NULL != pool->large) {
+            pool->large->prev = large;
+        }
+        pool->large = large;
+        pthread_mutex_unlock(&pool->lock);
+        return (large + 1);
+    }
+    class = (size / ALLOCATOR_ALIGN) - 1;
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (NULL == pool->free_lists[class]) {
+        slab = malloc(sizeof(*slab) + ALLOCATOR_POOL_SLAB_SIZE);
+        if (NULL == slab) {
+            pthread_mutex_unlock(&pool->lock);
+            return (NULL);
+        }
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+
+        /* Thread the whole slab onto the free list for this class */
+        for (offset = 0; (offset + size) <= ALLOCATOR_POOL_SLAB_SIZE;
+             offset += size) {
+            block = (allocator_pool_block_st *) ((uint8_t *) (slab + 1) +
+                                                 offset);
+            block->next = pool->free_lists[class];
+            pool->free_lists[class] = block;
+        }
+    }
+
+    block = pool->free_lists[class];
+    pool->free_lists[class] = block->next;
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return (block);
+}
+
+/**
+ * Free to a pool allocator.
+ *
+ * @param ctx The pool allocator state
+ * @param ptr The memory
+ * @param size The size given at allocation
+ */
+static void
+allocator_pool_free (void *ctx, void *ptr, size_t size)
+{
+    allocator_pool_st *pool = ctx;
+    allocator_pool_block_st *block = ptr;
+    allocator_pool_large_st *large;
+    size_t class;
+
+    size = ALLOCATOR_ROUND((0 == size) ? 1 : size);
+    if (size > ALLOCATOR_POOL_MAX_SIZE) {
+        large = (allocator_pool_large_st *) ptr - 1;
+        pthread_mutex_lock(&pool->lock);
+        if (NULL != large->prev) {
+            large->prev->next = large->next;
+        } else {
+            pool->large = large->next;
+        }
+        if (NULL != large->next) {
+            large->next->prev = large->prev;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        free(large);
+        return;
+    }
+    class = (size / ALLOCATOR_ALIGN) - 1;
+
+    pthread_mutex_lock(&pool->lock);
+    block->next = pool->free_lists[class];
+    pool->free_lists[class] = block;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Create a pool allocator.  It is thread safe.  Freed memory is kept on a per
+ * size free list for reuse, and is only returned to the heap when the pool is
+ * deleted.
+ *
+ * @return The allocator or NULL if creation failed
+ */
+allocator_st *
+allocator_pool_new (void)
+{
+    allocator_pool_st *pool;
+
+    pool = calloc(1, sizeof(*pool));
+    if (NULL == pool) {
+        return (NULL);
+    }
+
+    if (0 != pthread_mutex_init(&pool->lock, NULL)) {
+        free(pool);
+        return (NULL);
+    }
+
+    pool->allocator.alloc_fn = allocator_pool_alloc;
+    pool->allocator.free_fn = allocator_pool_free;
+    pool->allocator.ctx = pool;
+
+    return (&pool->allocator);
+}
+
+/**
+ * Delete a pool allocator and all memory allocated from it.
+ *
+ * @param allocator The allocator.  If NULL, then this function is a no-op.
+ */
+void
+allocator_pool_delete (allocator_st *allocator)
+{
+    allocator_pool_st *pool;
+    allocator_pool_large_st *large;
+    allocator_chunk_st *slab;
+
+    if (NULL == allocator) {
+        return;
+    }
+
+    pool = allocator->ctx;
+    while (NULL != pool->slabs) {
+        slab = pool->slabs;
+        pool->slabs = slab->next;
+        free(slab);
+    }
+    while (NULL != pool->large) {
+        large = pool->large;
+        pool->large = large->next;
+        free(large);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
@@ -0,0 +1,91 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for pluggable memory allocators.  Every object
+ * and private block is allocated from an allocator, which can be set
+ * process-wide or given per construction, so that other allocators (e.g.,
+ * jemalloc, a per-thread bump allocator, or a NUMA-local pool) can be plugged
+ * in without changing the classes.
+ */
+#ifndef __ALLOCATOR_H__
+#define __ALLOCATOR_H__
+
+#include "common.h"
+
+/**
+ * Allocator function declaration.  Must return memory aligned for any type, or
+ * NULL on failure.  The memory need not be zeroed; constructors write every
+ * field of the objects they initialize.
+ */
+typedef void *
+(*allocator_alloc_fn)(void *ctx, size_t size);
+
+/**
+ * Allocator function declaration.  The size is that given when the memory was
+ * allocated.
+ */
+typedef void
+(*allocator_free_fn)(void *ctx, void *ptr, size_t size);
+
+/**
+ * An allocator.  Objects keep a reference to the allocator that created them
+ * and free themselves back to it, so an allocator must outlive every object
+ * allocated from it.
+ */
+typedef struct allocator_st_ {
+    /** Function to allocate memory */
+    allocator_alloc_fn alloc_fn;
+    /** Function to free memory */
+    allocator_free_fn free_fn;
+    /** Context passed to the functions */
+    void *ctx;
+} allocator_st;
+
+/** The allocator using the C library heap, which is the default */
+extern const allocator_st allocator_heap;
+
+/* APIs below are documented in their implementation file */
+
+extern const allocator_st *
+allocator_get_default(void);
+
+extern void
+allocator_set_default(const allocator_st *allocator);
+
+extern void *
+allocator_alloc(const allocator_st *allocator, size_t size);
+
+extern void
+allocator_free(const allocator_st *allocator, void *ptr, size_t size);
+
+extern allocator_st *
+allocator_bump_new(size_t chunk_size);
+
+extern void
+allocator_bump_delete(allocator_st *allocator);
+
+extern allocator_st *
+allocator_pool_new(void);
+
+extern void
+allocator_pool_delete(allocator_st *allocator);
+
+#endif
@@ -0,0 +1,791 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements arena allocators.
+ *
+ * The arena's region is split into slabs, each dedicated to one 16 byte size
+ * class at a time.  Slab metadata is kept outside the region, so that the pages
+ * of an empty slab can be discarded with madvise(MADV_DONTNEED) without losing
+ * track of the slab.  A slab whose last block is freed becomes idle and may be
+ * reused by any size class.  Allocations too large for the size classes go to
+ * the heap.
+ */
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "arena.h"
+#include "base1.h"
+#include "derived1.h"
+#include "derived2.h"
+#include "numa.h"
+
+/** Alignment and granularity of the size classes */
+#define ARENA_ALIGN 16
+
+/** Largest allocation served from slabs */
+#define ARENA_MAX_SIZE 512
+
+/** Number of size classes */
+#define ARENA_NUM_CLASSES (ARENA_MAX_SIZE / ARENA_ALIGN)
+
+/** Size of each slab */
+#define ARENA_SLAB_SIZE (64 * 1024)
+
+/** Size of each slab when using huge pages, which is the huge page size */
+#define ARENA_HUGE_SLAB_SIZE (2 * 1024 * 1024)
+
+/** Smallest page size, the stride for touching pages */
+#define ARENA_PAGE_SIZE 4096
+
+/** Default number of bytes reserved */
+#define ARENA_DEFAULT_CAPACITY ((size_t) 1024 * 1024 * 1024)
+
+/** Index plus one of no slab, terminating the slab lists */
+#define ARENA_SLAB_NONE 0
+
+/** Round a size up to the size class granularity */
+#define ARENA_ROUND(size) \
+    (((size) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+/** Metadata of a slab */
+typedef struct arena_slab_st_ {
+    /** Free blocks which were previously allocated */
+    void *free_blocks;
+    /** Index plus one of the next slab in the slab's list */
+    uint32_t next;
+    /** Index plus one of the previous slab in a partial list */
+    uint32_t prev;
+    /** Offset of the first block never allocated */
+    uint32_t bump;
+    /** Number of allocated blocks */
+    uint32_t live;
+    /** Size class plus one, zero if the slab is empty */
+    uint16_t class;
+    /** Whether the slab's pages were discarded */
+    bool trimmed;
+} arena_slab_st;
+
+/** State of an arena */
+typedef struct arena_st_ {
+    /** The allocator, whose ctx points back at this state */
+    allocator_st allocator;
+    /** Protects the slabs */
+    pthread_mutex_t lock;
+    /** The configuration */
+    arena_config_st config;
+    /** Start of the mapping */
+    void *map;
+    /** Size of the mapping */
+    size_t map_size;
+    /** Start of the first slab, aligned to the slab size */
+    uint8_t *base;
+    /** Size of each slab */
+    size_t slab_size;
+    /** Number of slabs in the region */
+    uint32_t num_slabs;
+    /** Number of slabs ever used */
+    uint32_t used_slabs;
+    /** Metadata for each slab */
+    arena_slab_st *slabs;
+    /** Slabs with free blocks for each size class */
+    uint32_t partial[ARENA_NUM_CLASSES];
+    /** Free blocks in the partial slabs of each size class */
+    size_t free_blocks[ARENA_NUM_CLASSES];
+    /** Empty resident slabs, most recently emptied first */
+    uint32_t idle;
+    /** Empty trimmed slabs */
+    uint32_t trimmed;
+    /** Number of idle slabs */
+    size_t num_idle;
+    /** Number of trimmed slabs */
+    size_t num_trimmed;
+    /** Number of slabs holding blocks */
+    size_t num_in_use;
+    /** Bytes of allocated blocks */
+    size_t bytes_in_use;
+    /** Number of times slabs were trimmed */
+    uint64_t trims;
+} arena_st;
+
+/** A block on a slab's free list */
+typedef struct arena_block_st_ {
+    /** The next free block */
+    struct arena_block_st_ *next;
+} arena_block_st;
+
+/**
+ * Get the slab with the given index plus one.
+ *
+ * @param arena The arena
+ * @param slab_ref The index plus one
+ * @return The slab
+ */
+static inline arena_slab_st *
+arena_slab (arena_st *arena, uint32_t slab_ref)
+{
+    return (&arena->slabs[slab_ref - 1]);
+}
+
+/**
+ * Get the memory of a slab.
+ *
+ * @param arena The arena
+ * @param slab_ref The index plus one of the slab
+ * @return The start of the slab
+ */
+static inline uint8_t *
+arena_slab_mem (arena_st *arena, uint32_t slab_ref)
+{
+    return (arena->base + ((size_t) (slab_ref - 1) * arena->slab_size));
+}
+
+/**
+ * Number of blocks of a size class which fit in a slab.
+ *
+ * @param arena The arena
+ * @param class The size class
+ * @return The number of blocks
+ */
+static inline size_t
+arena_class_blocks (arena_st *arena, size_t class)
+{
+    return (arena->slab_size / ((class + 1) * ARENA_ALIGN));
+}
+
+/**
+ * Prefault the pages of a range of the region.  The range is remapped with
+ * MAP_POPULATE, which faults every page in at once.
+ *
+ * @param arena The arena
+ * @param mem Start of the range
+ * @param len Length of the range
+ */
+static void
+arena_populate (arena_st *arena, void *mem, size_t len)
+{
+    size_t offset;
+    void *ptr;
+
+    if (arena->config.bind_node) {
+        /*
+         * A new mapping would lose the node binding, so fault each page in
+         * by touching it instead
+         */
+        for (offset = 0; offset < len; offset += ARENA_PAGE_SIZE) {
+            ((volatile uint8_t *) mem)[offset] = 0;
+        }
+        return;
+    }
+
+    ptr = mmap(mem, len, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_POPULATE |
+               MAP_NORESERVE, -1, 0);
+    if (MAP_FAILED == ptr) {
+        LOG_ERR("Populate failed, mem(%p) len(%zu)", mem, len);
+        return;
+    }
+
+    /* The new mapping does not inherit the advice of the old one */
+    if (arena->config.huge_pages) {
+        madvise(mem, len, MADV_HUGEPAGE);
+    }
+}
+
+/**
+ * Take an empty slab for a size class and put it on the class's partial list.
+ * The arena must be locked.
+ *
+ * @param arena The arena
+ * @param class The size class
+ * @return Index plus one of the slab or ARENA_SLAB_NONE if the arena is full.
+ */
+static uint32_t
+arena_slab_take (arena_st *arena, size_t class)
+{
+    arena_slab_st *slab;
+    uint32_t slab_ref;
+
+    if (ARENA_SLAB_NONE != arena->idle) {
+        slab_ref = arena->idle;
+        slab = arena_slab(arena, slab_ref);
+        arena->idle = slab->next;
+        arena->num_idle--;
+    } else if (ARENA_SLAB_NONE != arena->trimmed) {
+        slab_ref = arena->trimmed;
+        slab = arena_slab(arena, slab_ref);
+        arena->trimmed = slab->next;
+        arena->num_trimmed--;
+        if (arena->config.populate) {
+            arena_populate(arena, arena_slab_mem(arena, slab_ref),
+                           arena->slab_size);
+        }
+    } else if (arena->used_slabs < arena->num_slabs) {
+        slab_ref = ++arena->used_slabs;
+        slab = arena_slab(arena, slab_ref);
+        if (arena->config.populate) {
+            arena_populate(arena, arena_slab_mem(arena, slab_ref),
+                           arena->slab_size);
+        }
+    } else {
+        return (ARENA_SLAB_NONE);
+    }
+
+    slab->free_blocks = NULL;
+    slab->bump = 0;
+    slab->live = 0;
+    slab->class = class + 1;
+    slab->trimmed = false;
+    slab->prev = ARENA_SLAB_NONE;
+    slab->next = arena->partial[class];
+    if (ARENA_SLAB_NONE != slab->next) {
+        arena_slab(arena, slab->next)->prev = slab_ref;
+    }
+    arena->partial[class] = slab_ref;
+    arena->free_blocks[class] += arena_class_blocks(arena, class);
+    arena->num_in_use++;
+
+    return (slab_ref);
+}
+
+/**
+ * Remove a slab from the partial list of its size class.  The arena must be
+ * locked.
+ *
+ * @param arena The arena
+ * @param slab_ref Index plus one of the slab
+ */
+static void
+arena_partial_remove (arena_st *arena, uint32_t slab_ref)
+{
+    arena_slab_st *slab = arena_slab(arena, slab_ref);
+
+    if (ARENA_SLAB_NONE != slab->prev) {
+        arena_slab(arena, slab->prev)->next = slab->next;
+    } else {
+        arena->partial[slab->class - 1] = slab->next;
+    }
+    if (ARENA_SLAB_NONE != slab->next) {
+        arena_slab(arena, slab->next)->prev = slab->prev;
+    }
+    slab->next = ARENA_SLAB_NONE;
+    slab->prev = ARENA_SLAB_NONE;
+}
+
+/**
+ * Discard the pages of idle slabs until at most keep_bytes of idle slabs
+ * remain.  The arena must be locked.
+ *
+ * @param arena The arena
+ * @param keep_bytes Bytes of idle slabs to keep
+ * @return Number of bytes returned to the kernel
+ */
+static size_t
+arena_trim_locked (arena_st *arena, size_t keep_bytes)
+{
+    arena_slab_st *slab;
+    uint32_t slab_ref;
+    size_t trimmed = 0;
+
+    while ((ARENA_SLAB_NONE != arena->idle) &&
+           ((arena->num_idle * arena->slab_size) > keep_bytes)) {
+        slab_ref = arena->idle;
+        slab = arena_slab(arena, slab_ref);
+        arena->idle = slab->next;
+        arena->num_idle--;
+
+        madvise(arena_slab_mem(arena, slab_ref), arena->slab_size,
+                MADV_DONTNEED);
+        slab->trimmed = true;
+        slab->next = arena->trimmed;
+        arena->trimmed = slab_ref;
+        arena->num_trimmed++;
+        arena->trims++;
+        trimmed += arena->slab_size;
+    }
+
+    return (trimmed);
+}
+
+/**
+ * Allocate from an arena.
+ *
+ * @param ctx The arena state
+ * @param size Number of bytes
+ * @return The memory or NULL
+ */
+static void *
+arena_alloc (void *ctx, size_t size)
+{
+    arena_st *arena = ctx;
+    arena_slab_st *slab;
+    arena_block_st *block;
+    uint32_t slab_ref;
+    size_t class;
+    void *ptr;
+
+    size = ARENA_ROUND((0 == size) ? 1 : size);
+    if (size > ARENA_MAX_SIZE) {
+        return (malloc(size));
+    }
+    class = (size / ARENA_ALIGN) - 1;
+
+    pthread_mutex_lock(&arena->lock);
+
+    slab_ref = arena->partial[class];
+    if (ARENA_SLAB_NONE == slab_ref) {
+        slab_ref = arena_slab_take(arena, class);
+        if (ARENA_SLAB_NONE == slab_ref) {
+            pthread_mutex_unlock(&arena->lock);
+            return (NULL);
+        }
+    }
+    slab = arena_slab(arena, slab_ref);
+
+    if (NULL != slab->free_blocks) {
+        block = slab->free_blocks;
+        slab->free_blocks = block->next;
+        ptr = block;
+    } else {
+        ptr = arena_slab_mem(arena, slab_ref) + slab->bump;
+        slab->bump += size;
+    }
+
+    slab->live++;
+    arena->free_blocks[class]--;
+    arena->bytes_in_use += size;
+    if (slab->live == arena_class_blocks(arena, class)) {
+        arena_partial_remove(arena, slab_ref);
+    }
+
+    pthread_mutex_unlock(&arena->lock);
+
+    return (ptr);
+}
+
+/**
+ * Free to an arena.
+ *
+ * @param ctx The arena state
+ * @param ptr The memory
+ * @param size The size given at allocation
+ */
+static void
+arena_free (void *ctx, void *ptr, size_t size)
+{
+    arena_st *arena = ctx;
+    arena_slab_st *slab;
+    arena_block_st *block = ptr;
+    uint32_t slab_ref;
+    size_t class, num_blocks;
+
+    size = ARENA_ROUND((0 == size) ? 1 : size);
+    if (size > ARENA_MAX_SIZE) {
+        free(ptr);
+        return;
+    }
+    class = (size / ARENA_ALIGN) - 1;
+    num_blocks = arena_class_blocks(arena, class);
+    slab_ref = (((uint8_t *) ptr - arena->base) / arena->slab_size) + 1;
+
+    pthread_mutex_lock(&arena->lock);
+
+    slab = arena_slab(arena, slab_ref);
+    if (slab->live == num_blocks) {
+        /* The slab was full, so it goes back on the partial list */
+        slab->prev = ARENA_SLAB_NONE;
+        slab->next = arena->partial[class];
+        if (ARENA_SLAB_NONE != slab->next) {
+            arena_slab(arena, slab->next)->prev = slab_ref;
+        }
+        arena->partial[class] = slab_ref;
+    }
+
+    block->next = slab->free_blocks;
+    slab->free_blocks = block;
+    slab->live--;
+    arena->free_blocks[class]++;
+    arena->bytes_in_use -= size;
+
+    if (0 == slab->live) {
+        arena_partial_remove(arena, slab_ref);
+        arena->free_blocks[class] -= num_blocks;
+        arena->num_in_use--;
+        slab->class = 0;
+        slab->next = arena->idle;
+        arena->idle = slab_ref;
+        arena->num_idle++;
+        arena_trim_locked(arena, arena->config.idle_limit);
+    }
+
+    pthread_mutex_unlock(&arena->lock);
+}
+
+/**
+ * Create an arena allocator.  It is thread safe.  The arena's virtual memory
+ * is reserved up front but, unless prefaulted, only takes physical memory as
+ * slabs are used.
+ *
+ * @param config The configuration or NULL for the defaults (1GB capacity, no
+ * huge pages, no prefaulting and no automatic trimming).
+ * @return The allocator or NULL if creation failed
+ */
+allocator_st *
+arena_new (const arena_config_st *config)
+{
+    arena_st *arena;
+    size_t capacity;
+
+    arena = calloc(1, sizeof(*arena));
+    if (NULL == arena) {
+        return (NULL);
+    }
+
+    if (NULL != config) {
+        arena->config = *config;
+    } else {
+        arena->config.idle_limit = SIZE_MAX;
+    }
+
+    arena->slab_size = arena->config.huge_pages ? ARENA_HUGE_SLAB_SIZE :
+        ARENA_SLAB_SIZE;
+    capacity = (0 == arena->config.capacity) ? ARENA_DEFAULT_CAPACITY :
+        arena->config.capacity;
+    capacity = (capacity + arena->slab_size - 1) & ~(arena->slab_size - 1);
+    if ((capacity / arena->slab_size) > UINT32_MAX) {
+        LOG_ERR("Invalid input, capacity(%zu)", capacity);
+        goto err_exit;
+    }
+    arena->config.capacity = capacity;
+    arena->num_slabs = capacity / arena->slab_size;
+
+    arena->slabs = calloc(arena->num_slabs, sizeof(*arena->slabs));
+    if (NULL == arena->slabs) {
+        goto err_exit;
+    }
+
+    /* Map an extra slab so the slabs can be aligned to the slab size */
+    arena->map_size = capacity + arena->slab_size;
+    arena->map = mmap(NULL, arena->map_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (MAP_FAILED == arena->map) {
+        LOG_ERR("Reserving failed, capacity(%zu)", capacity);
+        goto err_exit;
+    }
+    arena->base = (uint8_t *)
+        (((uintptr_t) arena->map + arena->slab_size - 1) &
+         ~((uintptr_t) arena->slab_size - 1));
+
+    if (arena->config.huge_pages &&
+        (0 != madvise(arena->base, capacity, MADV_HUGEPAGE))) {
+        /* Not fatal, e.g. the kernel may not support transparent huge pages */
+        LOG_ERR("Huge pages unavailable, base(%p)", arena->base);
+    }
+
+    if (arena->config.bind_node &&
+        my_rc_e_is_notok(numa_bind_memory(arena->base, capacity,
+                                          arena->config.node))) {
+        munmap(arena->map, arena->map_size);
+        goto err_exit;
+    }
+
+    if (0 != pthread_mutex_init(&arena->lock, NULL)) {
+        munmap(arena->map, arena->map_size);
+        goto err_exit;
+    }
+
+    arena->allocator.alloc_fn = arena_alloc;
+    arena->allocator.free_fn = arena_free;
+    arena->allocator.ctx = arena;
+
+    return (&arena->allocator);
+
+err_exit:
+
+    free(arena->slabs);
+    free(arena);
+
+    return (NULL);
+}
+
+/**
+ * Check whether memory was allocated from an arena's region.  Allocations
+ * too large for the arena come from the heap and are not owned by it.
+ *
+ * @param allocator The allocator
+ * @param ptr The memory
+ * @return Whether allocator is an arena and ptr is within its region.
+ */
+bool
+arena_owns (const allocator_st *allocator, const void *ptr)
+{
+    arena_st *arena;
+
+    if ((NULL == allocator) || (arena_alloc != allocator->alloc_fn)) {
+        return (false);
+    }
+
+    arena = allocator->ctx;
+
+    return (((const uint8_t *) ptr >= arena->base) &&
+            ((const uint8_t *) ptr <
+             (arena->base + arena->config.capacity)));
+}
+
+/**
+ * Delete an arena allocator and all memory allocated from it.
+ *
+ * @param allocator The allocator.  If NULL, then this function is a no-op.
+ */
+void
+arena_delete (allocator_st *allocator)
+{
+    arena_st *arena;
+
+    if (NULL == allocator) {
+        return;
+    }
+
+    arena = allocator->ctx;
+    munmap(arena->map, arena->map_size);
+    pthread_mutex_destroy(&arena->lock);
+    free(arena->slabs);
+    free(arena);
+}
+
+/**
+ * Make room in the arena for count allocations of size bytes, so that they
+ * neither take the slow path of the allocator nor, if the arena prefaults,
+ * fault on first touch.
+ *
+ * @param allocator The arena
+ * @param size Size of the allocations
+ * @param count Number of allocations
+ * @return Return code, MY_RC_E_ENOMEM if the arena is too small.
+ */
+my_rc_e
+arena_reserve (allocator_st *allocator, size_t size, size_t count)
+{
+    arena_st *arena;
+    size_t class;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if ((NULL == allocator) || (allocator->alloc_fn != arena_alloc)) {
+        LOG_ERR("Invalid input, allocator(%p)", allocator);
+        return (MY_RC_E_EINVAL);
+    }
+    arena = allocator->ctx;
+
+    size = ARENA_ROUND((0 == size) ? 1 : size);
+    if (size > ARENA_MAX_SIZE) {
+        return (MY_RC_E_SUCCESS);
+    }
+    class = (size / ARENA_ALIGN) - 1;
+
+    pthread_mutex_lock(&arena->lock);
+    while (arena->free_blocks[class] < count) {
+        if (ARENA_SLAB_NONE == arena_slab_take(arena, class)) {
+            rc = MY_RC_E_ENOMEM;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&arena->lock);
+
+    return (rc);
+}
+
+/** Most allocations made to construct an object of any class */
+#define ARENA_PROBE_MAX_ALLOCS 16
+
+/** Records the allocations made while constructing an object */
+typedef struct arena_probe_st_ {
+    /** Number of allocations */
+    size_t num_allocs;
+    /** Size of each allocation */
+    size_t sizes[ARENA_PROBE_MAX_ALLOCS];
+} arena_probe_st;
+
+/**
+ * Allocate from the heap, recording the size.
+ *
+ * @param ctx The probe
+ * @param size Number of bytes
+ * @return The memory or NULL
+ */
+static void *
+arena_probe_alloc (void *ctx, size_t size)
+{
+    arena_probe_st *probe = ctx;
+
+    if (probe->num_allocs < ARENA_PROBE_MAX_ALLOCS) {
+        probe->sizes[probe->num_allocs++] = size;
+    }
+
+    return (malloc(size));
+}
+
+/**
+ * Free to the heap.
+ *
+ * @param ctx Unused
+ * @param ptr The memory
+ * @param size Unused
+ */
+static void
+arena_probe_free (void *ctx, void *ptr, size_t size)
+{
+    free(ptr);
+}
+
+/**
+ * Make room in the arena for count objects of a class, including their
+ * private data.
+ *
+ * @param allocator The arena
+ * @param class_id The class, which must have a *_new_with_allocator()
+ * constructor
+ * @param count Number of objects
+ * @return Return code
+ * @see arena_reserve()
+ */
+my_rc_e
+arena_reserve_objects (allocator_st *allocator, my_class_id_e class_id,
+                       size_t count)
+{
+    arena_probe_st probe = { 0 };
+    allocator_st probe_allocator = {
+        arena_probe_alloc,
+        arena_probe_free,
+        &probe
+    };
+    base1_handle base1_h = NULL;
+    size_t i;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    /* Construct an object to find the allocations its class makes */
+    switch (class_id) {
+    case MY_CLASS_ID_E_BASE1:
+        base1_h = base1_new_with_allocator(&probe_allocator);
+        break;
+    case MY_CLASS_ID_E_DERIVED1:
+        base1_h = derived1_cast_to_base1(
+            derived1_new_with_allocator(&probe_allocator));
+        break;
+    case MY_CLASS_ID_E_DERIVED2:
+        base1_h = derived1_cast_to_base1(derived2_cast_to_derived1(
+            derived2_new_with_allocator(&probe_allocator)));
+        break;
+    default:
+        break;
+    }
+
+    if (NULL == base1_h) {
+        LOG_ERR("Invalid input, class_id(%s)",
+                my_class_id_e_get_string(class_id));
+        return (MY_RC_E_EINVAL);
+    }
+    base1_delete(base1_h);
+
+    for (i = 0; (i < probe.num_allocs) && my_rc_e_is_ok(rc); i++) {
+        rc = arena_reserve(allocator, probe.sizes[i], count);
+    }
+
+    return (rc);
+}
+
+/**
+ * Return idle slabs to the kernel, e.g. after a drop in object counts.
+ *
+ * @param allocator The arena
+ * @param keep_bytes Bytes of idle slabs to keep resident for reuse
+ * @return Number of bytes returned to the kernel
+ */
+size_t
+arena_trim (allocator_st *allocator, size_t keep_bytes)
+{
+    arena_st *arena;
+    size_t trimmed;
+
+    if ((NULL == allocator) || (allocator->alloc_fn != arena_alloc)) {
+        LOG_ERR("Invalid input, allocator(%p)", allocator);
+        return (0);
+    }
+    arena = allocator->ctx;
+
+    pthread_mutex_lock(&arena->lock);
+    trimmed = arena_trim_locked(arena, keep_bytes);
+    pthread_mutex_unlock(&arena->lock);
+
+    return (trimmed);
+}
+
+/**
+ * Get the statistics of an arena, along with the resident set size and page
+ * faults of the process.
+ *
+ * @param allocator The arena or NULL for only the process statistics
+ * @param stats Outputs the statistics
+ * @return Return code
+ */
+my_rc_e
+arena_get_stats (allocator_st *allocator, arena_stats_st *stats)
+{
+    arena_st *arena;
+    struct rusage usage;
+    unsigned long pages;
+    FILE *statm;
+
+    if ((NULL == stats) ||
+        ((NULL != allocator) && (allocator->alloc_fn != arena_alloc))) {
+        LOG_ERR("Invalid input, allocator(%p) stats(%p)", allocator, stats);
+        return (MY_RC_E_EINVAL);
+    }
+
+    memset(stats, 0, sizeof(*stats));
+
+    if (NULL != allocator) {
+        arena = allocator->ctx;
+        pthread_mutex_lock(&arena->lock);
+        stats->capacity = arena->config.capacity;
+        stats->slab_size = arena->slab_size;
+        stats->slabs_in_use = arena->num_in_use;
+        stats->slabs_idle = arena->num_idle;
+        stats->slabs_trimmed = arena->num_trimmed;
+        stats->bytes_in_use = arena->bytes_in_use;
+        stats->trims = arena->trims;
+        pthread_mutex_unlock(&arena->lock);
+    }
+
+    statm = fopen("/proc/self/statm", "r");
+    if (NULL != statm) {
+        if (1 == fscanf(statm, "%*u %lu", &pages)) {
+            stats->rss_bytes = pages * sysconf(_SC_PAGESIZE);
+        }
+        fclose(statm);
+    }
+
+    if (0 == getrusage(RUSAGE_SELF, &usage)) {
+        stats->minor_faults = usage.ru_minflt;
+        stats->major_faults = usage.ru_majflt;
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for arena allocators.  An arena reserves one
+ * large region of virtual memory up front with mmap() and serves object sized
+ * allocations from slabs within it.  Slabs can be prefaulted ahead of time
+ * (e.g., at startup, to keep page faults out of the first use of new objects),
+ * backed by transparent huge pages, and returned to the kernel when object
+ * counts drop.
+ */
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include "common.h"
+#include "allocator.h"
+
+/** Configuration of an arena */
+typedef struct arena_config_st_ {
+    /** Bytes of virtual memory to reserve, which bounds the arena's size.  If
+     *  zero, a default is used. */
+    size_t capacity;
+    /** Whether to ask for transparent huge pages, which also makes slabs
+     *  huge page sized */
+    bool huge_pages;
+    /** Whether to prefault slabs when they are first used, rather than
+     *  faulting each page on first touch */
+    bool populate;
+    /** Bytes of empty slabs to keep resident when objects are freed; beyond
+     *  this, empty slabs are returned to the kernel.  SIZE_MAX to never
+     *  trim automatically. */
+    size_t idle_limit;
+    /** Whether to place the arena's memory on a NUMA node */
+    bool bind_node;
+    /** The NUMA node, if bind_node is set */
+    unsigned int node;
+} arena_config_st;
+
+/** Statistics of an arena and of the process */
+typedef struct arena_stats_st_ {
+    /** Bytes of virtual memory reserved */
+    size_t capacity;
+    /** Size of each slab */
+    size_t slab_size;
+    /** Slabs holding objects */
+    size_t slabs_in_use;
+    /** Empty slabs which are resident */
+    size_t slabs_idle;
+    /** Empty slabs which were returned to the kernel */
+    size_t slabs_trimmed;
+    /** Bytes of live allocations, after rounding to size classes */
+    size_t bytes_in_use;
+    /** Number of times slabs were returned to the kernel */
+    uint64_t trims;
+    /** Resident set size of the process */
+    size_t rss_bytes;
+    /** Minor page faults of the process so far */
+    uint64_t minor_faults;
+    /** Major page faults of the process so far */
+    uint64_t major_faults;
+} arena_stats_st;
+
+/* APIs below are documented in their implementation file */
+
+extern allocator_st *
+arena_new(const arena_config_st *config);
+
+extern bool
+arena_owns(const allocator_st *allocator, const void *ptr);
+
+extern void
+arena_delete(allocator_st *allocator);
+
+extern my_rc_e
+arena_reserve(allocator_st *allocator, size_t size, size_t count);
+
+extern my_rc_e
+arena_reserve_objects(allocator_st *allocator, my_class_id_e class_id,
+                      size_t count);
+
+extern size_t
+arena_trim(allocator_st *allocator, size_t keep_bytes);
+
+extern my_rc_e
+arena_get_stats(allocator_st *allocator, arena_stats_st *stats);
+
+#endif
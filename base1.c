@@ -22,6 +22,14 @@
  * This is the implements a base class from which children class may inherit.
  */
 #include "base1_friend.h"
+#include "trace.h"
+#include "class_registry.h"
+#include "recycle.h"
+#include "journal.h"
+#include "wal.h"
+#include "checkpoint.h"
+#include "field_index.h"
+#include "aggregate.h"
 
 /** Size for this object to use for base1_string_size_fn */
 #define BASE1_STR_SIZE 128
@@ -33,6 +41,22 @@
 typedef struct base1_private_st_ {
     /** Virtual function table */
     const base1_vtable_st *vtable;
+    /** Unique ID of the object */
+    uint64_t object_id;
+    /** Allocator the object and this block were allocated from */
+    const allocator_st *allocator;
+    /** Slot plus one the object is tracked in for checkpoints, zero if
+     *  untracked */
+    uint32_t checkpoint_slot;
+    /** Generation of aggregation the object is counted in, zero if none */
+    uint32_t aggregate_gen;
+    /** Version word for transactions, odd while a commit holds the object */
+    uint64_t txn_version;
+    /** Number of field indexes holding the object */
+    uint32_t field_index_refs;
+    /** Whether the mutators refuse to modify the object, e.g. because it is
+     *  shared */
+    bool read_only;
 } base1_private_st;
 
 /**
@@ -84,16 +108,48 @@ base1_get_public_data (base1_handle base1_h, base1_public_data_st *public_data)
 my_rc_e
 base1_set_public_data (base1_handle base1_h, base1_public_data_st *public_data)
 {
+    base1_public_data_st old_data;
+    my_rc_e rc;
 
     if ((NULL == base1_h) || (NULL == public_data)) {
         LOG_ERR("Invalid input, base1_h(%p) public_data(%p)", base1_h,
                 public_data);
         return (MY_RC_E_EINVAL);
     }
+    if (base1_is_read_only(base1_h)) {
+        LOG_ERR("Object is read-only, base1_h(%p)", base1_h);
+        return (MY_RC_E_EINVAL);
+    }
 
-    memcpy(&(base1_h->public_data), public_data, sizeof(base1_h->public_data));
+    /* Stored atomically, as txn_read() may load the fields meanwhile */
+    old_data = base1_h->public_data;
+    __atomic_store_n(&base1_h->public_data.val1, public_data->val1,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&base1_h->public_data.val2, public_data->val2,
+                     __ATOMIC_RELAXED);
+
+    TRACE_RECORD(TRACE_OP_E_BASE1_SET_PUBLIC_DATA, base1_get_object_id(base1_h),
+                 public_data->val1, public_data->val2);
+    JOURNAL_RECORD(base1_get_object_id(base1_h), base1_class_id(base1_h),
+                   MY_FIELD_E_BASE1_VAL1, public_data->val1);
+    JOURNAL_RECORD(base1_get_object_id(base1_h), base1_class_id(base1_h),
+                   MY_FIELD_E_BASE1_VAL2, public_data->val2);
+    rc = WAL_LOG_FIELDS(base1_get_object_id(base1_h), 2,
+                        ((my_field_e []) { MY_FIELD_E_BASE1_VAL1,
+                                           MY_FIELD_E_BASE1_VAL2 }),
+                        ((uint64_t []) { public_data->val1,
+                                         public_data->val2 }));
+    CHECKPOINT_MARK_DIRTY(base1_h);
+    FIELD_INDEX_UPDATE(base1_h, MY_FIELD_E_BASE1_VAL1, old_data.val1,
+                       public_data->val1);
+    FIELD_INDEX_UPDATE(base1_h, MY_FIELD_E_BASE1_VAL2, old_data.val2,
+                       public_data->val2);
+    AGGREGATE_UPDATE(base1_h, MY_FIELD_E_BASE1_VAL1, old_data.val1,
+                     public_data->val1);
+    AGGREGATE_UPDATE(base1_h, MY_FIELD_E_BASE1_VAL2, old_data.val2,
+                     public_data->val2);
 
-    return (MY_RC_E_SUCCESS);
+    return (rc);
 }
 
 /**
@@ -173,6 +229,54 @@ base1_type_string (base1_handle base1_h)
     return (base1_h->private_h->vtable->type_string_fn(base1_h));
 }
 
+/**
+ * The internal function for getting the class ID for objects of type base1.
+ *
+ * @param base1_h The object
+ * @return The class ID
+ * @see base1_class_id()
+ */
+static my_class_id_e
+base1_class_id_internal (base1_handle base1_h)
+{
+    return (MY_CLASS_ID_E_BASE1);
+}
+
+/**
+ * Get the ID of the object's class.  This is a virtual function, so it gives
+ * the most derived class of the object.
+ *
+ * @param base1_h The object
+ * @return The class ID or MY_CLASS_ID_E_INVALID if the object is invalid.
+ */
+my_class_id_e
+base1_class_id (base1_handle base1_h)
+{
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    VALIDATE_VTABLE_FN(base1_h, private_h, vtable, class_id_fn, rc);
+    if (my_rc_e_is_notok(rc)) {
+        return (MY_CLASS_ID_E_INVALID);
+    }
+
+    return (base1_h->private_h->vtable->class_id_fn(base1_h));
+}
+
+/**
+ * Indicates whether the object is of the given class or one of its
+ * descendants.  This is O(1) and should be used rather than comparing
+ * base1_type_string() results.
+ *
+ * @param base1_h The object
+ * @param class_id The class to check for
+ * @return true if the object is a class_id.
+ */
+bool
+base1_is_a (base1_handle base1_h, my_class_id_e class_id)
+{
+    return (my_class_id_e_is_a(base1_class_id(base1_h), class_id));
+}
+
 /**
  * Get a string representation of the object.  This is a virtual function.
  *
@@ -192,6 +296,8 @@ base1_string (base1_handle base1_h, char *buffer, size_t buffer_size)
         return (rc);
     }
 
+    TRACE_RECORD(TRACE_OP_E_BASE1_STRING, base1_h->private_h->object_id, 0, 0);
+
     return (base1_h->private_h->vtable->string_fn(base1_h, buffer,
                                                   buffer_size));
 }
@@ -253,17 +359,26 @@ base1_string_internal (base1_handle base1_h, char *buffer, size_t buffer_size)
 static void
 base1_delete_internal (base1_handle base1_h, bool free_base1_h)
 {
+    const allocator_st *allocator = NULL;
+
     if (NULL == base1_h) {
         return;
     }
 
+    FIELD_INDEX_FORGET(base1_h);
+    AGGREGATE_REMOVE(base1_h);
     if (NULL != base1_h->private_h) {
-        free(base1_h->private_h);
+        if (0 != base1_h->private_h->checkpoint_slot) {
+            checkpoint_untrack(base1_h);
+        }
+        allocator = base1_h->private_h->allocator;
+        allocator_free(allocator, base1_h->private_h,
+                       sizeof(*base1_h->private_h));
         base1_h->private_h = NULL;
     }
 
     if (free_base1_h) {
-        free(base1_h);
+        allocator_free(allocator, base1_h, sizeof(*base1_h));
     }
 }
 
@@ -313,6 +428,9 @@ base1_delete (base1_handle base1_h)
         return;
     }
 
+    TRACE_RECORD(TRACE_OP_E_BASE1_DELETE, base1_h->private_h->object_id, 0, 0);
+    WAL_LOG_DELETE(base1_h->private_h->object_id);
+
     return (base1_h->private_h->vtable->delete_fn(base1_h));
 }
 
@@ -332,7 +450,7 @@ base1_increase_val3_internal (base1_handle base1_h)
         return (MY_RC_E_EINVAL);
     }
 
-    base1_h->val3 *= 2;
+    __atomic_store_n(&base1_h->val3, base1_h->val3 * 2, __ATOMIC_RELAXED);
 
     return (MY_RC_E_SUCCESS);
 }
@@ -347,13 +465,227 @@ my_rc_e
 base1_increase_val3 (base1_handle base1_h)
 {
     my_rc_e rc = MY_RC_E_SUCCESS;
+    uint32_t old_val3;
 
     VALIDATE_VTABLE_FN(base1_h, private_h, vtable, increase_val3_fn, rc);
     if (my_rc_e_is_notok(rc)) {
         return (rc);
     }
+    if (base1_is_read_only(base1_h)) {
+        LOG_ERR("Object is read-only, base1_h(%p)", base1_h);
+        return (MY_RC_E_EINVAL);
+    }
+    old_val3 = base1_h->val3;
+
+    TRACE_RECORD(TRACE_OP_E_BASE1_INCREASE_VAL3, base1_h->private_h->object_id,
+                 0, 0);
+
+    rc = base1_h->private_h->vtable->increase_val3_fn(base1_h);
+    if (my_rc_e_is_ok(rc)) {
+        JOURNAL_RECORD(base1_h->private_h->object_id, base1_class_id(base1_h),
+                       MY_FIELD_E_BASE1_VAL3, base1_h->val3);
+        rc = WAL_LOG_FIELD(base1_h->private_h->object_id,
+                           MY_FIELD_E_BASE1_VAL3, base1_h->val3);
+        CHECKPOINT_MARK_DIRTY(base1_h);
+        FIELD_INDEX_UPDATE(base1_h, MY_FIELD_E_BASE1_VAL3, old_val3,
+                           base1_h->val3);
+        AGGREGATE_UPDATE(base1_h, MY_FIELD_E_BASE1_VAL3, old_val3,
+                         base1_h->val3);
+    }
+
+    return (rc);
+}
+
+/**
+ * The internal function for copying objects of type base1.
+ *
+ * @param base1_h The object
+ * @return The copy or NULL on failure
+ * @see base1_clone()
+ */
+static base1_handle
+base1_clone_internal (base1_handle base1_h)
+{
+    const allocator_st *allocator = base1_h->private_h->allocator;
+    base1_st *base1;
+
+    base1 = allocator_alloc(allocator, sizeof(*base1));
+    if (NULL == base1) {
+        return (NULL);
+    }
+
+    memcpy(base1, base1_h, sizeof(*base1));
+    if (my_rc_e_is_notok(base1_clone_init(base1, base1_h))) {
+        allocator_free(allocator, base1, sizeof(*base1));
+        return (NULL);
+    }
+
+    return (base1);
+}
+
+/**
+ * Create a copy of the object, including its current state.  This is a
+ * virtual function, so the copy is of the object's most derived class.  The
+ * copy has its own object ID and is allocated from the same allocator as the
+ * original.
+ *
+ * Copying a fully constructed object (i.e., a prototype) is a fast way to
+ * create many objects with the same state, since it skips the init and vtable
+ * setup of each class.
+ *
+ * @param base1_h The object
+ * @return The copy or NULL on failure
+ */
+base1_handle
+base1_clone (base1_handle base1_h)
+{
+    base1_handle clone_h;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    VALIDATE_VTABLE_FN(base1_h, private_h, vtable, clone_fn, rc);
+    if (my_rc_e_is_notok(rc)) {
+        return (NULL);
+    }
+
+    clone_h = base1_h->private_h->vtable->clone_fn(base1_h);
+    if (NULL != clone_h) {
+        WAL_LOG_OBJECT(clone_h);
+        CHECKPOINT_TRACK(clone_h);
+        AGGREGATE_ADD(clone_h);
+    }
+
+    return (clone_h);
+}
+
+/**
+ * Allow a friend class to restore the default state of the base1 object.  This
+ * does not call the virtual function table version of reset, but rather the
+ * reset specifically for type base1.
+ *
+ * @param base1_h The object
+ * @see base1_reset()
+ */
+void
+base1_friend_reset (base1_handle base1_h)
+{
+    base1_h->public_data.val1 = 1;
+    base1_h->public_data.val2 = 2;
+    base1_h->val3 = 42;
+}
+
+/**
+ * The internal function for resetting objects of type base1.
+ *
+ * @param base1_h The object
+ * @return Return code
+ * @see base1_reset()
+ */
+static my_rc_e
+base1_reset_internal (base1_handle base1_h)
+{
+    base1_friend_reset(base1_h);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Restore the object to the state it had when constructed by *_new1(),
+ * without releasing its memory.  This is a virtual function.  The object keeps
+ * its object ID.
+ *
+ * @param base1_h The object
+ * @return Return code
+ * @see recycle_put()
+ */
+my_rc_e
+base1_reset (base1_handle base1_h)
+{
+    base1_public_data_st old_data;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+    uint32_t old_val3;
+    bool aggregated;
+
+    VALIDATE_VTABLE_FN(base1_h, private_h, vtable, reset_fn, rc);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+    if (base1_is_read_only(base1_h)) {
+        LOG_ERR("Object is read-only, base1_h(%p)", base1_h);
+        return (MY_RC_E_EINVAL);
+    }
+    old_data = base1_h->public_data;
+    old_val3 = base1_h->val3;
+    /* Every field may change, so count the object again afterwards */
+    aggregated = aggregate_is_enabled() && aggregate_remove(base1_h);
+
+    TRACE_RECORD(TRACE_OP_E_BASE1_RESET, base1_h->private_h->object_id, 0, 0);
+
+    rc = base1_h->private_h->vtable->reset_fn(base1_h);
+    if (my_rc_e_is_ok(rc)) {
+        rc = WAL_LOG_OBJECT(base1_h);
+        CHECKPOINT_MARK_DIRTY(base1_h);
+        FIELD_INDEX_UPDATE(base1_h, MY_FIELD_E_BASE1_VAL1, old_data.val1,
+                           base1_h->public_data.val1);
+        FIELD_INDEX_UPDATE(base1_h, MY_FIELD_E_BASE1_VAL2, old_data.val2,
+                           base1_h->public_data.val2);
+        FIELD_INDEX_UPDATE(base1_h, MY_FIELD_E_BASE1_VAL3, old_val3,
+                           base1_h->val3);
+    }
+    if (aggregated) {
+        aggregate_add(base1_h);
+    }
+
+    return (rc);
+}
+
+/**
+ * Allow a friend class to restore the default state of an object which has
+ * been logged as deleted, without tracing, logging or indexing the change.
+ * This calls the virtual function table version of reset.
+ *
+ * @param base1_h The object
+ * @return Return code
+ * @see base1_reset()
+ */
+my_rc_e
+base1_reset_unlogged (base1_handle base1_h)
+{
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    VALIDATE_VTABLE_FN(base1_h, private_h, vtable, reset_fn, rc);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+    if (base1_is_read_only(base1_h)) {
+        LOG_ERR("Object is read-only, base1_h(%p)", base1_h);
+        return (MY_RC_E_EINVAL);
+    }
 
-    return (base1_h->private_h->vtable->increase_val3_fn(base1_h));
+    return (base1_h->private_h->vtable->reset_fn(base1_h));
+}
+
+/**
+ * Allow a friend class to delete an object which has already been logged as
+ * deleted, without tracing or logging the deletion again.  This calls the
+ * virtual function table version of delete.
+ *
+ * @param base1_h The object.  If NULL, then this function is a no-op.
+ * @see base1_delete()
+ */
+void
+base1_delete_unlogged (base1_handle base1_h)
+{
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if (NULL == base1_h) {
+        return;
+    }
+    VALIDATE_VTABLE_FN(base1_h, private_h, vtable, delete_fn, rc);
+    if (my_rc_e_is_notok(rc)) {
+        return;
+    }
+
+    return (base1_h->private_h->vtable->delete_fn(base1_h));
 }
 
 /**
@@ -366,7 +698,10 @@ static const base1_vtable_st base1_vtable = {
     base1_type_string_internal,
     base1_string_internal,
     base1_string_size_internal,
-    base1_increase_val3_internal
+    base1_increase_val3_internal,
+    base1_class_id_internal,
+    base1_clone_internal,
+    base1_reset_internal
 };
 
 /**
@@ -386,7 +721,7 @@ base1_inherit_vtable (const base1_vtable_st *parent_vtable,
     my_rc_e rc = MY_RC_E_SUCCESS;
 
     /* Always add a new check here if functions are added. */
-    CT_ASSERT(5 == (sizeof(base1_vtable_st)/sizeof(void*)));
+    CT_ASSERT(8 == (sizeof(base1_vtable_st)/sizeof(void*)));
 
     if ((NULL == parent_vtable) || (NULL == child_vtable)) {
         LOG_ERR("Invalid input, parent_vtable(%p) "
@@ -404,6 +739,12 @@ base1_inherit_vtable (const base1_vtable_st *parent_vtable,
                       do_null_check, rc);
     INHERIT_VTABLE_FN(parent_vtable, child_vtable, increase_val3_fn,
                       do_null_check, rc);
+    INHERIT_VTABLE_FN(parent_vtable, child_vtable, class_id_fn,
+                      do_null_check, rc);
+    INHERIT_VTABLE_FN(parent_vtable, child_vtable, clone_fn, do_null_check,
+                      rc);
+    INHERIT_VTABLE_FN(parent_vtable, child_vtable, reset_fn, do_null_check,
+                      rc);
 
     return (MY_RC_E_SUCCESS);
 
@@ -450,15 +791,19 @@ base1_set_vtable (base1_handle base1_h, base1_vtable_st *vtable)
 /**
  * Allows a friend class to initialize their inner base1 object.  Must be called
  * before the base1 object is used.  If an error is returned, any clean-up was
- * handled internally and there is no need to call a delete function.
+ * handled internally and there is no need to call a delete function.  The
+ * object's memory need not be zeroed beforehand, since every field is written
+ * here.
  *
  * @param base1_h The object
+ * @param allocator The allocator the object was allocated from, which is also
+ * used for the private data.  If NULL, the default allocator is used.
  * @return Return code
  * @see base1_delete()
  * @see base1_friend_delete()
  */
 my_rc_e
-base1_init (base1_handle base1_h)
+base1_init (base1_handle base1_h, const allocator_st *allocator)
 {
     my_rc_e rc = MY_RC_E_SUCCESS;
 
@@ -467,23 +812,47 @@ base1_init (base1_handle base1_h)
         return (MY_RC_E_EINVAL);
     }
 
-    base1_h->private_h = calloc(1, sizeof(*base1_h->private_h));
+    if (NULL == allocator) {
+        allocator = allocator_get_default();
+    }
+
+    base1_h->private_h = allocator_alloc(allocator,
+                                         sizeof(*base1_h->private_h));
     if (NULL == base1_h->private_h) {
         rc = MY_RC_E_ENOMEM;
         goto err_exit;
     }
 
     base1_h->private_h->vtable = &base1_vtable;
-    base1_h->public_data.val1 = 1;
-    base1_h->public_data.val2 = 2;
-    base1_h->val3 = 42;
+    base1_h->private_h->object_id = my_object_id_alloc();
+    base1_h->private_h->allocator = allocator;
+    base1_h->private_h->checkpoint_slot = 0;
+    base1_h->private_h->aggregate_gen = 0;
+    base1_h->private_h->txn_version = 0;
+    base1_h->private_h->field_index_refs = 0;
+    base1_h->private_h->read_only = false;
+    base1_friend_reset(base1_h);
+
+    POISON_CHECK_FIELD(base1_h, private_h);
+    POISON_CHECK_FIELD(base1_h, public_data.val1);
+    POISON_CHECK_FIELD(base1_h, public_data.val2);
+    POISON_CHECK_FIELD(base1_h, val3);
+    POISON_CHECK_FIELD(base1_h->private_h, vtable);
+    POISON_CHECK_FIELD(base1_h->private_h, object_id);
+    POISON_CHECK_FIELD(base1_h->private_h, allocator);
+    POISON_CHECK_FIELD(base1_h->private_h, checkpoint_slot);
+    POISON_CHECK_FIELD(base1_h->private_h, aggregate_gen);
+    POISON_CHECK_FIELD(base1_h->private_h, txn_version);
+    POISON_CHECK_FIELD(base1_h->private_h, field_index_refs);
+    POISON_CHECK_FIELD(base1_h->private_h, read_only);
 
     return (MY_RC_E_SUCCESS);
 
 err_exit:
 
     if (NULL != base1_h->private_h) {
-        free(base1_h->private_h);
+        allocator_free(allocator, base1_h->private_h,
+                       sizeof(*base1_h->private_h));
         base1_h->private_h = NULL;
     }
 
@@ -491,19 +860,25 @@ err_exit:
 }
 
 /**
- * Create a new base1 object.
+ * Allocate and initialize a new base1 object without recording it in the
+ * trace, so that each public constructor records exactly one operation.
  *
+ * @param allocator The allocator or NULL for the default allocator.
  * @return The object or NULL if creation failed
  */
-base1_handle
-base1_new1 (void)
+static base1_handle
+base1_new_internal (const allocator_st *allocator)
 {
     base1_st *base1 = NULL;
     my_rc_e rc;
 
-    base1 = calloc(1, sizeof(*base1));
+    if (NULL == allocator) {
+        allocator = allocator_get_default();
+    }
+
+    base1 = allocator_alloc(allocator, sizeof(*base1));
     if (NULL != base1) {
-        rc = base1_init(base1);
+        rc = base1_init(base1, allocator);
         if (my_rc_e_is_notok(rc)) {
             LOG_ERR("Init failed, rc(%s)", my_rc_e_get_string(rc));
             goto err_exit;
@@ -514,11 +889,62 @@ base1_new1 (void)
 
 err_exit:
 
-    base1_private_delete(base1);
+    allocator_free(allocator, base1, sizeof(*base1));
 
     return (NULL);
 }
 
+/**
+ * Create a new base1 object.  A base1 object in the recycle bin, already reset
+ * to the defaults, is reused with a new object ID if there is one; otherwise
+ * one is allocated from the default allocator.
+ *
+ * @return The object or NULL if creation failed
+ * @see recycle_put()
+ */
+base1_handle
+base1_new1 (void)
+{
+    base1_handle base1_h;
+    uint64_t object_id;
+
+    base1_h = recycle_get(MY_CLASS_ID_E_BASE1);
+    if (NULL == base1_h) {
+        return (base1_new_with_allocator(NULL));
+    }
+
+    object_id = base1_renew_object_id(base1_h);
+    TRACE_RECORD(TRACE_OP_E_BASE1_NEW1, object_id, 0, 0);
+    WAL_LOG_OBJECT(base1_h);
+    CHECKPOINT_TRACK(base1_h);
+    AGGREGATE_ADD(base1_h);
+
+    return (base1_h);
+}
+
+/**
+ * Create a new base1 object from the given allocator.  The object is freed
+ * back to the same allocator when deleted.
+ *
+ * @param allocator The allocator or NULL for the default allocator.
+ * @return The object or NULL if creation failed
+ */
+base1_handle
+base1_new_with_allocator (const allocator_st *allocator)
+{
+    base1_st *base1 = NULL;
+
+    base1 = base1_new_internal(allocator);
+    if (NULL != base1) {
+        TRACE_RECORD(TRACE_OP_E_BASE1_NEW1, base1_get_object_id(base1), 0, 0);
+        WAL_LOG_OBJECT(base1);
+        CHECKPOINT_TRACK(base1);
+        AGGREGATE_ADD(base1);
+    }
+
+    return (base1);
+}
+
 /**
  * Create a new base1 object.
  *
@@ -535,9 +961,14 @@ base1_new2 (base1_public_data_st *public_data)
         return (NULL);
     }
 
-    base1 = base1_new1();
+    base1 = base1_new_internal(NULL);
     if (NULL != base1) {
         memcpy(&(base1->public_data), public_data, sizeof(base1->public_data));
+        TRACE_RECORD(TRACE_OP_E_BASE1_NEW2, base1_get_object_id(base1),
+                     public_data->val1, public_data->val2);
+        WAL_LOG_OBJECT(base1);
+        CHECKPOINT_TRACK(base1);
+        AGGREGATE_ADD(base1);
      }
 
     return (base1);
@@ -555,11 +986,281 @@ base1_new3 (uint8_t val1, uint32_t val3)
 {
     base1_st *base1 = NULL;
 
-    base1 = base1_new1();
+    base1 = base1_new_internal(NULL);
     if (NULL != base1) {
         base1->public_data.val1 = val1;
         base1->val3 = val3;
+        TRACE_RECORD(TRACE_OP_E_BASE1_NEW3, base1_get_object_id(base1), val1,
+                     val3);
+        WAL_LOG_OBJECT(base1);
+        CHECKPOINT_TRACK(base1);
+        AGGREGATE_ADD(base1);
      }
 
     return (base1);
 }
+
+/**
+ * Get the unique ID of the object.  The ID is assigned at construction and is
+ * shared by every view of the object (e.g., the base1 and base2 views of a
+ * derived1 object), so it can be used to identify the object in traces and
+ * logs.
+ *
+ * @param base1_h The object
+ * @return The object ID or zero if the object is invalid
+ */
+uint64_t
+base1_get_object_id (base1_handle base1_h)
+{
+    if ((NULL == base1_h) || (NULL == base1_h->private_h)) {
+        LOG_ERR("Invalid input, base1_h(%p)", base1_h);
+        return (0);
+    }
+
+    return (base1_h->private_h->object_id);
+}
+
+/**
+ * Indicates whether the object is read-only.  The mutators refuse to modify a
+ * read-only object, such as the instance shared by flyweights.
+ *
+ * @param base1_h The object
+ * @return true if the object is read-only
+ * @see flyweight_get()
+ */
+bool
+base1_is_read_only (base1_handle base1_h)
+{
+    return ((NULL != base1_h) && (NULL != base1_h->private_h) &&
+            base1_h->private_h->read_only);
+}
+
+/**
+ * Allows a friend class to get the allocator the object was allocated from.
+ *
+ * @param base1_h The object
+ * @return The allocator or NULL if the object is invalid
+ */
+const allocator_st *
+base1_get_allocator (base1_handle base1_h)
+{
+    if ((NULL == base1_h) || (NULL == base1_h->private_h)) {
+        LOG_ERR("Invalid input, base1_h(%p)", base1_h);
+        return (NULL);
+    }
+
+    return (base1_h->private_h->allocator);
+}
+
+/**
+ * Allows a friend class to finish copying their inner base1 object.  The object
+ * must already be a byte copy of the source object; this gives it its own
+ * private data and object ID.  If an error is returned, the object's private
+ * data is NULL and there is no need to call a delete function.
+ *
+ * @param base1_h The object, a byte copy of src_base1_h
+ * @param src_base1_h The object that was copied
+ * @return Return code
+ * @see base1_clone()
+ */
+my_rc_e
+base1_clone_init (base1_handle base1_h, base1_handle src_base1_h)
+{
+    const allocator_st *allocator;
+
+    if ((NULL == base1_h) || (NULL == src_base1_h) ||
+        (NULL == src_base1_h->private_h)) {
+        LOG_ERR("Invalid input, base1_h(%p) src_base1_h(%p)", base1_h,
+                src_base1_h);
+        return (MY_RC_E_EINVAL);
+    }
+    allocator = src_base1_h->private_h->allocator;
+
+    base1_h->private_h = allocator_alloc(allocator,
+                                         sizeof(*base1_h->private_h));
+    if (NULL == base1_h->private_h) {
+        return (MY_RC_E_ENOMEM);
+    }
+
+    *base1_h->private_h = *src_base1_h->private_h;
+    base1_h->private_h->object_id = my_object_id_alloc();
+    base1_h->private_h->checkpoint_slot = 0;
+    base1_h->private_h->aggregate_gen = 0;
+    base1_h->private_h->txn_version = 0;
+    base1_h->private_h->field_index_refs = 0;
+    base1_h->private_h->read_only = false;
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Allows a friend class to give an object reused from a recycle bin a new
+ * identity.
+ *
+ * @param base1_h The object
+ * @return The new object ID
+ * @see recycle_get()
+ */
+uint64_t
+base1_renew_object_id (base1_handle base1_h)
+{
+    base1_h->private_h->object_id = my_object_id_alloc();
+
+    return (base1_h->private_h->object_id);
+}
+
+/**
+ * Allows a friend class to give an object the identity it had when it was
+ * saved, e.g. during recovery.
+ *
+ * @param base1_h The object
+ * @param object_id The saved object ID
+ * @see my_object_id_reserve()
+ */
+void
+base1_restore_object_id (base1_handle base1_h, uint64_t object_id)
+{
+    base1_h->private_h->object_id = object_id;
+}
+
+/**
+ * Allows a friend class to get the slot the object is tracked in for
+ * checkpoints.
+ *
+ * @param base1_h The object
+ * @return The slot plus one, or zero if the object is not tracked
+ * @see checkpoint_track()
+ */
+uint32_t
+base1_get_checkpoint_slot (base1_handle base1_h)
+{
+    return (base1_h->private_h->checkpoint_slot);
+}
+
+/**
+ * Allows a friend class to set the slot the object is tracked in for
+ * checkpoints.
+ *
+ * @param base1_h The object
+ * @param slot The slot plus one, or zero if the object is not tracked
+ * @see checkpoint_track()
+ */
+void
+base1_set_checkpoint_slot (base1_handle base1_h, uint32_t slot)
+{
+    base1_h->private_h->checkpoint_slot = slot;
+}
+
+/**
+ * Allows a friend class to get the generation of aggregation the object is
+ * counted in.
+ *
+ * @param base1_h The object
+ * @return The generation, or zero if the object is not counted
+ * @see aggregate_add()
+ */
+uint32_t
+base1_get_aggregate_gen (base1_handle base1_h)
+{
+    return (base1_h->private_h->aggregate_gen);
+}
+
+/**
+ * Allows a friend class to set the generation of aggregation the object is
+ * counted in.
+ *
+ * @param base1_h The object
+ * @param gen The generation, or zero if the object is not counted
+ * @see aggregate_add()
+ */
+void
+base1_set_aggregate_gen (base1_handle base1_h, uint32_t gen)
+{
+    base1_h->private_h->aggregate_gen = gen;
+}
+
+/**
+ * Allows a friend class to get the object's version word for transactions,
+ * which it accesses atomically.
+ *
+ * @param base1_h The object
+ * @return The version word
+ * @see txn_commit()
+ */
+uint64_t *
+base1_get_txn_version (base1_handle base1_h)
+{
+    return (&base1_h->private_h->txn_version);
+}
+
+/**
+ * Allows a friend class to get the number of field indexes holding the object,
+ * which it accesses atomically.
+ *
+ * @param base1_h The object
+ * @return The number of indexes
+ * @see field_index_insert()
+ */
+uint32_t *
+base1_get_field_index_refs (base1_handle base1_h)
+{
+    return (&base1_h->private_h->field_index_refs);
+}
+
+/**
+ * Allows a friend class to make the object read-only, e.g. while it is
+ * shared.  A copy made with base1_clone() is never read-only.
+ *
+ * @param base1_h The object
+ * @param read_only Whether the object is read-only
+ * @see base1_is_read_only()
+ */
+void
+base1_set_read_only (base1_handle base1_h, bool read_only)
+{
+    base1_h->private_h->read_only = read_only;
+}
+
+/**
+ * Register the metadata of this class.  This is called by the class registry
+ * when it is first used.
+ *
+ * @return Return code
+ * @see class_registry_register()
+ */
+my_rc_e
+base1_register_class (void)
+{
+    static const class_field_st fields[] = {
+        CLASS_FIELD(MY_FIELD_E_BASE1_VAL1, "val1", MY_CLASS_ID_E_BASE1,
+                    base1_st, public_data.val1),
+        CLASS_FIELD(MY_FIELD_E_BASE1_VAL2, "val2", MY_CLASS_ID_E_BASE1,
+                    base1_st, public_data.val2),
+        CLASS_FIELD(MY_FIELD_E_BASE1_VAL3, "val3", MY_CLASS_ID_E_BASE1,
+                    base1_st, val3),
+    };
+    static const class_method_st methods[] = {
+        CLASS_METHOD("delete", base1_vtable_st, delete_fn),
+        CLASS_METHOD("type_string", base1_vtable_st, type_string_fn),
+        CLASS_METHOD("string", base1_vtable_st, string_fn),
+        CLASS_METHOD("string_size", base1_vtable_st, string_size_fn),
+        CLASS_METHOD("increase_val3", base1_vtable_st, increase_val3_fn),
+        CLASS_METHOD("class_id", base1_vtable_st, class_id_fn),
+        CLASS_METHOD("clone", base1_vtable_st, clone_fn),
+        CLASS_METHOD("reset", base1_vtable_st, reset_fn),
+    };
+    static const class_desc_st base1_class_desc = {
+        .class_id = MY_CLASS_ID_E_BASE1,
+        .name = "base1",
+        .num_parents = 0,
+        .size = sizeof(base1_st),
+        .vtable_size = sizeof(base1_vtable_st),
+        .num_fields = NELEMS(fields),
+        .fields = fields,
+        .num_methods = NELEMS(methods),
+        .methods = methods,
+        .new_fn = base1_new_with_allocator,
+    };
+
+    return (class_registry_register(&base1_class_desc));
+}
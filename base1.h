@@ -25,6 +25,7 @@
 #define __BASE1_H__
 
 #include "common.h"
+#include "allocator.h"
 
 /** Opaque pointer to reference instances of this class */
 typedef struct base1_st_ *base1_handle;
@@ -60,16 +61,37 @@ base1_new2(base1_public_data_st *public_data);
 extern base1_handle
 base1_new3(uint8_t val1, uint32_t val3);
 
+extern base1_handle
+base1_new_with_allocator(const allocator_st *allocator);
+
 extern void
 base1_delete(base1_handle base1_h);
 
 extern const char *
 base1_type_string(base1_handle base1_h);
 
+extern my_class_id_e
+base1_class_id(base1_handle base1_h);
+
+extern bool
+base1_is_a(base1_handle base1_h, my_class_id_e class_id);
+
 extern my_rc_e
 base1_string(base1_handle base1_h, char *buffer, size_t buffer_size);
 
 extern my_rc_e
 base1_string_size(base1_handle base1_h, size_t *buffer_size);
 
+extern uint64_t
+base1_get_object_id(base1_handle base1_h);
+
+extern bool
+base1_is_read_only(base1_handle base1_h);
+
+extern base1_handle
+base1_clone(base1_handle base1_h);
+
+extern my_rc_e
+base1_reset(base1_handle base1_h);
+
 #endif
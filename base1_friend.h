@@ -70,6 +70,24 @@ typedef my_rc_e
 typedef my_rc_e
 (*base1_increase_val3_fn)(base1_handle base1_h);
 
+/**
+ * Virtual function declaration.
+ */
+typedef my_class_id_e
+(*base1_class_id_fn)(base1_handle base1_h);
+
+/**
+ * Virtual function declaration.
+ */
+typedef base1_handle
+(*base1_clone_fn)(base1_handle base1_h);
+
+/**
+ * Virtual function declaration.
+ */
+typedef my_rc_e
+(*base1_reset_fn)(base1_handle base1_h);
+
 /**
  * The virtual table to be specified by friend classes.
  *
@@ -86,6 +104,12 @@ typedef struct base1_vtable_st_ {
     base1_string_size_fn string_size_fn;
     /** Function to increase val3 */
     base1_increase_val3_fn increase_val3_fn;
+    /** Function to give the class ID of the object */
+    base1_class_id_fn class_id_fn;
+    /** Function to copy the object */
+    base1_clone_fn clone_fn;
+    /** Function to restore the object's default state */
+    base1_reset_fn reset_fn;
 } base1_vtable_st;
 
 /* APIs below are documented in their implementation file */
@@ -102,6 +126,51 @@ extern void
 base1_friend_delete(base1_handle base1_h);
 
 extern my_rc_e
-base1_init(base1_handle base1_h);
+base1_init(base1_handle base1_h, const allocator_st *allocator);
+
+extern const allocator_st *
+base1_get_allocator(base1_handle base1_h);
+
+extern my_rc_e
+base1_clone_init(base1_handle base1_h, base1_handle src_base1_h);
+
+extern void
+base1_friend_reset(base1_handle base1_h);
+
+extern my_rc_e
+base1_reset_unlogged(base1_handle base1_h);
+
+extern void
+base1_delete_unlogged(base1_handle base1_h);
+
+extern uint64_t
+base1_renew_object_id(base1_handle base1_h);
+
+extern void
+base1_restore_object_id(base1_handle base1_h, uint64_t object_id);
+
+extern uint32_t
+base1_get_checkpoint_slot(base1_handle base1_h);
+
+extern void
+base1_set_checkpoint_slot(base1_handle base1_h, uint32_t slot);
+
+extern uint32_t
+base1_get_aggregate_gen(base1_handle base1_h);
+
+extern void
+base1_set_aggregate_gen(base1_handle base1_h, uint32_t gen);
+
+extern uint64_t *
+base1_get_txn_version(base1_handle base1_h);
+
+extern uint32_t *
+base1_get_field_index_refs(base1_handle base1_h);
+
+extern void
+base1_set_read_only(base1_handle base1_h, bool read_only);
+
+extern my_rc_e
+base1_register_class(void);
 
 #endif
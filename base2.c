@@ -24,6 +24,12 @@
  * constructor.
  */
 #include "base2_friend.h"
+#include "trace.h"
+#include "class_registry.h"
+#include "journal.h"
+#include "wal.h"
+#include "checkpoint.h"
+#include "aggregate.h"
 
 /** Size for this object to use for base2_string_size_fn */
 #define BASE2_STR_SIZE 64
@@ -35,8 +41,28 @@
 typedef struct base2_private_st_ {
     /** Virtual function table */
     const base2_vtable_st *vtable;
+    /** Unique ID of the object */
+    uint64_t object_id;
+    /** Allocator the object and this block were allocated from */
+    const allocator_st *allocator;
+    /** View of the object as a base1, set by the derived class, or NULL */
+    base1_handle base1_view;
 } base2_private_st;
 
+/**
+ * Get the base1 view of the object, through which checkpoints and aggregates
+ * track it and which says whether it is read-only.
+ *
+ * @param base2_h The object
+ * @return The base1 view or NULL if the object has none.
+ * @see base2_set_base1_view()
+ */
+static base1_handle
+base2_base1_view (base2_handle base2_h)
+{
+    return (base2_h->private_h->base1_view);
+}
+
 /**
  * Get the minimum size of a string buffer that should be used to get a string
  * representation of the object.  This is a virtual function.
@@ -114,6 +140,54 @@ base2_type_string (base2_handle base2_h)
     return (base2_h->private_h->vtable->type_string_fn(base2_h));
 }
 
+/**
+ * The internal function for getting the class ID for objects of type base2.
+ *
+ * @param base2_h The object
+ * @return The class ID
+ * @see base2_class_id()
+ */
+static my_class_id_e
+base2_class_id_internal (base2_handle base2_h)
+{
+    return (MY_CLASS_ID_E_BASE2);
+}
+
+/**
+ * Get the ID of the object's class.  This is a virtual function, so it gives
+ * the most derived class of the object.
+ *
+ * @param base2_h The object
+ * @return The class ID or MY_CLASS_ID_E_INVALID if the object is invalid.
+ */
+my_class_id_e
+base2_class_id (base2_handle base2_h)
+{
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    VALIDATE_VTABLE_FN(base2_h, private_h, vtable, class_id_fn, rc);
+    if (my_rc_e_is_notok(rc)) {
+        return (MY_CLASS_ID_E_INVALID);
+    }
+
+    return (base2_h->private_h->vtable->class_id_fn(base2_h));
+}
+
+/**
+ * Indicates whether the object is of the given class or one of its
+ * descendants.  This is O(1) and should be used rather than comparing
+ * base2_type_string() results.
+ *
+ * @param base2_h The object
+ * @param class_id The class to check for
+ * @return true if the object is a class_id.
+ */
+bool
+base2_is_a (base2_handle base2_h, my_class_id_e class_id)
+{
+    return (my_class_id_e_is_a(base2_class_id(base2_h), class_id));
+}
+
 /**
  * Get a string representation of the object.  This is a virtual function.
  *
@@ -133,6 +207,8 @@ base2_string (base2_handle base2_h, char *buffer, size_t buffer_size)
         return (rc);
     }
 
+    TRACE_RECORD(TRACE_OP_E_BASE2_STRING, base2_h->private_h->object_id, 0, 0);
+
     return (base2_h->private_h->vtable->string_fn(base2_h, buffer,
                                                   buffer_size));
 }
@@ -192,17 +268,21 @@ base2_string_internal (base2_handle base2_h, char *buffer, size_t buffer_size)
 static void
 base2_delete_internal (base2_handle base2_h, bool free_base2_h)
 {
+    const allocator_st *allocator = NULL;
+
     if (NULL == base2_h) {
         return;
     }
 
     if (NULL != base2_h->private_h) {
-        free(base2_h->private_h);
+        allocator = base2_h->private_h->allocator;
+        allocator_free(allocator, base2_h->private_h,
+                       sizeof(*base2_h->private_h));
         base2_h->private_h = NULL;
     }
 
     if (free_base2_h) {
-        free(base2_h);
+        allocator_free(allocator, base2_h, sizeof(*base2_h));
     }
 }
 
@@ -252,6 +332,9 @@ base2_delete (base2_handle base2_h)
         return;
     }
 
+    TRACE_RECORD(TRACE_OP_E_BASE2_DELETE, base2_h->private_h->object_id, 0, 0);
+    WAL_LOG_DELETE(base2_h->private_h->object_id);
+
     return (base2_h->private_h->vtable->delete_fn(base2_h));
 }
 
@@ -265,13 +348,37 @@ my_rc_e
 base2_increase_val1 (base2_handle base2_h)
 {
     my_rc_e rc = MY_RC_E_SUCCESS;
+    base1_handle base1_h;
+    uint32_t old_val1;
 
     VALIDATE_VTABLE_FN(base2_h, private_h, vtable, increase_val1_fn, rc);
     if (my_rc_e_is_notok(rc)) {
         return (rc);
     }
+    base1_h = base2_base1_view(base2_h);
+    if (base1_is_read_only(base1_h)) {
+        LOG_ERR("Object is read-only, base2_h(%p)", base2_h);
+        return (MY_RC_E_EINVAL);
+    }
 
-    return (base2_h->private_h->vtable->increase_val1_fn(base2_h));
+    TRACE_RECORD(TRACE_OP_E_BASE2_INCREASE_VAL1, base2_h->private_h->object_id,
+                 0, 0);
+
+    old_val1 = base2_h->val1;
+    rc = base2_h->private_h->vtable->increase_val1_fn(base2_h);
+    if (my_rc_e_is_ok(rc)) {
+        JOURNAL_RECORD(base2_h->private_h->object_id, base2_class_id(base2_h),
+                       MY_FIELD_E_BASE2_VAL1, base2_h->val1);
+        rc = WAL_LOG_FIELD(base2_h->private_h->object_id,
+                           MY_FIELD_E_BASE2_VAL1, base2_h->val1);
+        if (NULL != base1_h) {
+            CHECKPOINT_MARK_DIRTY(base1_h);
+            AGGREGATE_UPDATE(base1_h, MY_FIELD_E_BASE2_VAL1, old_val1,
+                             base2_h->val1);
+        }
+    }
+
+    return (rc);
 }
 
 /**
@@ -294,6 +401,73 @@ base2_get_val1 (base2_handle base2_h, uint32_t *val1)
     return (MY_RC_E_SUCCESS);
 }
 
+/**
+ * Get the unique ID of the object.  The ID is shared by every view of the
+ * object.
+ *
+ * @param base2_h The object
+ * @return The object ID or zero if the object is invalid
+ * @see base1_get_object_id()
+ */
+uint64_t
+base2_get_object_id (base2_handle base2_h)
+{
+    if ((NULL == base2_h) || (NULL == base2_h->private_h)) {
+        LOG_ERR("Invalid input, base2_h(%p)", base2_h);
+        return (0);
+    }
+
+    return (base2_h->private_h->object_id);
+}
+
+/**
+ * Allows a friend class to set the ID of its inner base2 object.  This is used
+ * when the friend class has other parents, so that all views of the object
+ * share a single ID.
+ *
+ * @param base2_h The object
+ * @param object_id The object ID
+ * @return Return code
+ * @see base2_get_object_id()
+ */
+my_rc_e
+base2_set_object_id (base2_handle base2_h, uint64_t object_id)
+{
+    if ((NULL == base2_h) || (NULL == base2_h->private_h) ||
+        (0 == object_id)) {
+        LOG_ERR("Invalid input, base2_h(%p) object_id(%" PRIu64 ")", base2_h,
+                object_id);
+        return (MY_RC_E_EINVAL);
+    }
+
+    base2_h->private_h->object_id = object_id;
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Allows a friend class which is also derived from base1 to give the object
+ * its base1 view, so that base2 can keep the base1 view's checkpoint and
+ * aggregate state current and respect it being read-only.
+ *
+ * @param base2_h The object
+ * @param base1_h The base1 view of the same object
+ * @return Return code
+ */
+my_rc_e
+base2_set_base1_view (base2_handle base2_h, base1_handle base1_h)
+{
+    if ((NULL == base2_h) || (NULL == base2_h->private_h) ||
+        (NULL == base1_h)) {
+        LOG_ERR("Invalid input, base2_h(%p) base1_h(%p)", base2_h, base1_h);
+        return (MY_RC_E_EINVAL);
+    }
+
+    base2_h->private_h->base1_view = base1_h;
+
+    return (MY_RC_E_SUCCESS);
+}
+
 /**
  * The virtual function table used for objects of type base2.  A NULL indicates
  * a pure virtual function in the base class for the function or that the parent
@@ -304,7 +478,8 @@ static const base2_vtable_st base2_vtable = {
     base2_type_string_internal,
     base2_string_internal,
     base2_string_size_internal,
-    NULL
+    NULL,
+    base2_class_id_internal
 };
 
 /**
@@ -324,7 +499,7 @@ base2_inherit_vtable (const base2_vtable_st *parent_vtable,
     my_rc_e rc = MY_RC_E_SUCCESS;
 
     /* Always add a new check here if functions are added. */
-    CT_ASSERT(5 == (sizeof(base2_vtable_st)/sizeof(void*)));
+    CT_ASSERT(6 == (sizeof(base2_vtable_st)/sizeof(void*)));
 
     if ((NULL == parent_vtable) || (NULL == child_vtable)) {
         LOG_ERR("Invalid input, parent_vtable(%p) "
@@ -342,6 +517,8 @@ base2_inherit_vtable (const base2_vtable_st *parent_vtable,
                       do_null_check, rc);
     INHERIT_VTABLE_FN(parent_vtable, child_vtable, increase_val1_fn,
                       do_null_check, rc);
+    INHERIT_VTABLE_FN(parent_vtable, child_vtable, class_id_fn,
+                      do_null_check, rc);
 
     return (MY_RC_E_SUCCESS);
 
@@ -388,15 +565,19 @@ base2_set_vtable (base2_handle base2_h, base2_vtable_st *vtable)
 /**
  * Allows a friend class to initialize their inner base2 object.  Must be called
  * before the base2 object is used.  If an error is returned, any clean-up was
- * handled internally and there is no need to call a delete function.
+ * handled internally and there is no need to call a delete function.  The
+ * object's memory need not be zeroed beforehand, since every field is written
+ * here.
  *
  * @param base2_h The object
+ * @param allocator The allocator the object was allocated from, which is also
+ * used for the private data.  If NULL, the default allocator is used.
  * @return Return code
  * @see base2_delete()
  * @see base2_friend_delete()
  */
 my_rc_e
-base2_init (base2_handle base2_h)
+base2_init (base2_handle base2_h, const allocator_st *allocator)
 {
     my_rc_e rc = MY_RC_E_SUCCESS;
 
@@ -405,23 +586,123 @@ base2_init (base2_handle base2_h)
         return (MY_RC_E_EINVAL);
     }
 
-    base2_h->private_h = calloc(1, sizeof(*base2_h->private_h));
+    if (NULL == allocator) {
+        allocator = allocator_get_default();
+    }
+
+    base2_h->private_h = allocator_alloc(allocator,
+                                         sizeof(*base2_h->private_h));
     if (NULL == base2_h->private_h) {
         rc = MY_RC_E_ENOMEM;
         goto err_exit;
     }
 
     base2_h->private_h->vtable = &base2_vtable;
-    base2_h->val1 = 7;
+    base2_h->private_h->object_id = my_object_id_alloc();
+    base2_h->private_h->allocator = allocator;
+    base2_h->private_h->base1_view = NULL;
+    base2_friend_reset(base2_h);
+
+    POISON_CHECK_FIELD(base2_h, private_h);
+    POISON_CHECK_FIELD(base2_h, val1);
+    POISON_CHECK_FIELD(base2_h->private_h, vtable);
+    POISON_CHECK_FIELD(base2_h->private_h, object_id);
+    POISON_CHECK_FIELD(base2_h->private_h, allocator);
+    POISON_CHECK_FIELD(base2_h->private_h, base1_view);
 
     return (MY_RC_E_SUCCESS);
 
 err_exit:
 
     if (NULL != base2_h->private_h) {
-        free(base2_h->private_h);
+        allocator_free(allocator, base2_h->private_h,
+                       sizeof(*base2_h->private_h));
         base2_h->private_h = NULL;
     }
 
     return (rc);
 }
+
+/**
+ * Allows a friend class to finish copying their inner base2 object.  The object
+ * must already be a byte copy of the source object; this gives it its own
+ * private data and object ID.  If an error is returned, the object's private
+ * data is NULL and there is no need to call a delete function.
+ *
+ * @param base2_h The object, a byte copy of src_base2_h
+ * @param src_base2_h The object that was copied
+ * @return Return code
+ */
+my_rc_e
+base2_clone_init (base2_handle base2_h, base2_handle src_base2_h)
+{
+    const allocator_st *allocator;
+
+    if ((NULL == base2_h) || (NULL == src_base2_h) ||
+        (NULL == src_base2_h->private_h)) {
+        LOG_ERR("Invalid input, base2_h(%p) src_base2_h(%p)", base2_h,
+                src_base2_h);
+        return (MY_RC_E_EINVAL);
+    }
+    allocator = src_base2_h->private_h->allocator;
+
+    base2_h->private_h = allocator_alloc(allocator,
+                                         sizeof(*base2_h->private_h));
+    if (NULL == base2_h->private_h) {
+        return (MY_RC_E_ENOMEM);
+    }
+
+    *base2_h->private_h = *src_base2_h->private_h;
+    base2_h->private_h->object_id = my_object_id_alloc();
+    base2_h->private_h->base1_view = NULL;
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Allow a friend class to restore the default state of the base2 object.
+ *
+ * @param base2_h The object
+ */
+void
+base2_friend_reset (base2_handle base2_h)
+{
+    base2_h->val1 = 7;
+}
+
+/**
+ * Register the metadata of this class.  This is called by the class registry
+ * when it is first used.
+ *
+ * @return Return code
+ * @see class_registry_register()
+ */
+my_rc_e
+base2_register_class (void)
+{
+    static const class_field_st fields[] = {
+        CLASS_FIELD(MY_FIELD_E_BASE2_VAL1, "val1", MY_CLASS_ID_E_BASE2,
+                    base2_st, val1),
+    };
+    static const class_method_st methods[] = {
+        CLASS_METHOD("delete", base2_vtable_st, delete_fn),
+        CLASS_METHOD("type_string", base2_vtable_st, type_string_fn),
+        CLASS_METHOD("string", base2_vtable_st, string_fn),
+        CLASS_METHOD("string_size", base2_vtable_st, string_size_fn),
+        CLASS_METHOD("increase_val1", base2_vtable_st, increase_val1_fn),
+        CLASS_METHOD("class_id", base2_vtable_st, class_id_fn),
+    };
+    static const class_desc_st base2_class_desc = {
+        .class_id = MY_CLASS_ID_E_BASE2,
+        .name = "base2",
+        .num_parents = 0,
+        .size = sizeof(base2_st),
+        .vtable_size = sizeof(base2_vtable_st),
+        .num_fields = NELEMS(fields),
+        .fields = fields,
+        .num_methods = NELEMS(methods),
+        .methods = methods,
+    };
+
+    return (class_registry_register(&base2_class_desc));
+}
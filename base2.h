@@ -25,6 +25,7 @@
 #define __BASE2_H__
 
 #include "common.h"
+#include "allocator.h"
 
 /** Opaque pointer to reference instances of this class */
 typedef struct base2_st_ *base2_handle;
@@ -43,10 +44,19 @@ base2_delete(base2_handle base2_h);
 extern const char *
 base2_type_string(base2_handle base2_h);
 
+extern my_class_id_e
+base2_class_id(base2_handle base2_h);
+
+extern bool
+base2_is_a(base2_handle base2_h, my_class_id_e class_id);
+
 extern my_rc_e
 base2_string(base2_handle base2_h, char *buffer, size_t buffer_size);
 
 extern my_rc_e
 base2_string_size(base2_handle base2_h, size_t *buffer_size);
 
+extern uint64_t
+base2_get_object_id(base2_handle base2_h);
+
 #endif
@@ -26,6 +26,7 @@
 #define __BASE2_FRIEND_H__
 
 #include "base2.h"
+#include "base1.h"
 
 /** Opaque pointer to reference private data for the class */
 typedef struct base2_private_st_ *base2_private_handle;
@@ -68,6 +69,12 @@ typedef my_rc_e
 typedef my_rc_e
 (*base2_string_size_fn)(base2_handle base2_h, size_t *buffer_size);
 
+/**
+ * Virtual function declaration.
+ */
+typedef my_class_id_e
+(*base2_class_id_fn)(base2_handle base2_h);
+
 /**
  * The virtual table to be specified by friend classes.
  *
@@ -84,6 +91,8 @@ typedef struct base2_vtable_st_ {
     base2_string_size_fn string_size_fn;
     /** Function to increase val1 */
     base2_increase_val1_fn increase_val1_fn;
+    /** Function to give the class ID of the object */
+    base2_class_id_fn class_id_fn;
 } base2_vtable_st;
 
 /* APIs below are documented in their implementation file */
@@ -100,6 +109,21 @@ extern void
 base2_friend_delete(base2_handle base2_h);
 
 extern my_rc_e
-base2_init(base2_handle base2_h);
+base2_init(base2_handle base2_h, const allocator_st *allocator);
+
+extern my_rc_e
+base2_set_object_id(base2_handle base2_h, uint64_t object_id);
+
+extern my_rc_e
+base2_set_base1_view(base2_handle base2_h, base1_handle base1_h);
+
+extern my_rc_e
+base2_clone_init(base2_handle base2_h, base2_handle src_base2_h);
+
+extern void
+base2_friend_reset(base2_handle base2_h);
+
+extern my_rc_e
+base2_register_class(void);
 
 #endif
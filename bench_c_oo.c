@@ -0,0 +1,2235 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * Benchmark program for the object-oriented C code.  Each benchmark is a
+ * sub-command, run as <tt>bench_c_oo NAME [ARGS]</tt>.  Running it without
+ * arguments lists the benchmarks.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include "base1.h"
+#include "base2.h"
+#include "derived1.h"
+#include "derived2.h"
+#include "trace.h"
+#include "recycle.h"
+#include "arena.h"
+#include "numa.h"
+#include "magazine.h"
+#include "objpool.h"
+#include "journal.h"
+#include "wal.h"
+#include "checkpoint.h"
+#include "snapshot.h"
+#include "query.h"
+#include "field_index.h"
+#include "handle_sort.h"
+#include "aggregate.h"
+#include "txn.h"
+#include "actor.h"
+#include "parallel.h"
+#include "dump.h"
+
+/**
+ * Function to run a benchmark.
+ *
+ * @param argc Number of arguments following the benchmark name
+ * @param argv Arguments following the benchmark name
+ * @return Exit code for the program
+ */
+typedef int
+(*bench_fn)(int argc, char *argv[]);
+
+/** Description of a benchmark */
+typedef struct bench_st_ {
+    /** Name used to select the benchmark */
+    const char *name;
+    /** Arguments taken by the benchmark */
+    const char *usage;
+    /** Function to run the benchmark */
+    bench_fn fn;
+} bench_st;
+
+/**
+ * Get the current time from a monotonic clock.
+ *
+ * @return The time in nanoseconds
+ */
+static uint64_t
+bench_now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec);
+}
+
+/**
+ * Parse an unsigned number from the arguments.
+ *
+ * @param argc Number of arguments
+ * @param argv Arguments
+ * @param index Index of the argument to parse
+ * @param default_value Value to use if the argument is not given
+ * @return The value
+ */
+static unsigned long
+bench_arg (int argc, char *argv[], int index, unsigned long default_value)
+{
+    if (index >= argc) {
+        return (default_value);
+    }
+
+    return (strtoul(argv[index], NULL, 0));
+}
+
+/**
+ * Run a synthetic mix of construction, mutation, string and delete calls while
+ * recording a trace.  Real workloads should instead call trace_start() and
+ * trace_stop() around the code of interest.
+ *
+ * @param argc Number of arguments
+ * @param argv The trace file and the number of objects
+ * @return Exit code for the program
+ */
+static int
+bench_record (int argc, char *argv[])
+{
+    unsigned long i, num_objects = bench_arg(argc, argv, 1, 100000);
+    base1_public_data_st public_data = { 3, 4 };
+    derived1_handle derived1_h;
+    base1_handle base1_h;
+    char str[256];
+    my_rc_e rc;
+
+    if (argc < 1) {
+        return (1);
+    }
+
+    rc = trace_start(argv[0]);
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    for (i = 0; i < num_objects; i++) {
+        switch (i % 3) {
+        case 0:
+            base1_h = base1_new1();
+            break;
+        case 1:
+            derived1_h = derived1_new1();
+            base2_increase_val1(derived1_cast_to_base2(derived1_h));
+            derived1_increase_val4(derived1_h);
+            base1_h = derived1_cast_to_base1(derived1_h);
+            break;
+        default:
+            base1_h = derived1_cast_to_base1(
+                derived2_cast_to_derived1(derived2_new1()));
+            break;
+        }
+
+        public_data.val2 = i;
+        base1_set_public_data(base1_h, &public_data);
+        base1_increase_val3(base1_h);
+        if (0 == (i % 4)) {
+            base1_string(base1_h, str, sizeof(str));
+        }
+        base1_delete(base1_h);
+    }
+
+    rc = trace_stop();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    printf("recorded %lu objects to %s\n", num_objects, argv[0]);
+
+    return (0);
+}
+
+/**
+ * Replay a recorded trace.
+ *
+ * @param argc Number of arguments
+ * @param argv The trace file and the number of threads
+ * @return Exit code for the program
+ */
+static int
+bench_replay (int argc, char *argv[])
+{
+    trace_replay_stats_st stats;
+    my_rc_e rc;
+
+    if (argc < 1) {
+        return (1);
+    }
+
+    rc = trace_replay(argv[0], bench_arg(argc, argv, 1, 1), &stats);
+    if (my_rc_e_is_notok(rc)) {
+        LOG_ERR("Replay failed, rc(%s)", my_rc_e_get_string(rc));
+        return (1);
+    }
+
+    printf("ops(%" PRIu64 ") skipped(%" PRIu64 ") objects(%" PRIu64 ") "
+           "leaked(%" PRIu64 ") elapsed(%.3f ms) rate(%.1f Mops/s)\n",
+           stats.ops, stats.skipped, stats.objects, stats.leaked,
+           stats.elapsed_ns / 1e6,
+           (stats.elapsed_ns > 0) ? (stats.ops * 1e3 / stats.elapsed_ns) : 0);
+
+    return (0);
+}
+
+/**
+ * Construct a batch of objects of each class from an allocator, then delete
+ * them, and report the time per object.
+ *
+ * @param name Name of the allocator to report
+ * @param allocator The allocator
+ * @param handles Array to hold the batch
+ * @param num_objects Number of objects in the batch
+ * @param num_rounds Number of times to construct and delete the batch
+ * @return Return code
+ */
+static my_rc_e
+bench_alloc_run (const char *name, const allocator_st *allocator,
+                 base1_handle *handles, unsigned long num_objects,
+                 unsigned long num_rounds)
+{
+    unsigned long i, round;
+    uint64_t start_ns, elapsed_ns;
+
+    start_ns = bench_now_ns();
+
+    for (round = 0; round < num_rounds; round++) {
+        for (i = 0; i < num_objects; i++) {
+            switch (i % 3) {
+            case 0:
+                handles[i] = base1_new_with_allocator(allocator);
+                break;
+            case 1:
+                handles[i] = derived1_cast_to_base1(
+                    derived1_new_with_allocator(allocator));
+                break;
+            default:
+                handles[i] = derived1_cast_to_base1(derived2_cast_to_derived1(
+                    derived2_new_with_allocator(allocator)));
+                break;
+            }
+
+            if (NULL == handles[i]) {
+                return (MY_RC_E_ENOMEM);
+            }
+        }
+
+        for (i = 0; i < num_objects; i++) {
+            base1_delete(handles[i]);
+        }
+    }
+
+    elapsed_ns = bench_now_ns() - start_ns;
+    printf("%-6s %8.1f ns/object\n", name,
+           (double) elapsed_ns / (num_objects * num_rounds));
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Compare the built-in allocators on construct/delete batches of objects.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of objects per batch and the number of batches
+ * @return Exit code for the program
+ */
+static int
+bench_alloc (int argc, char *argv[])
+{
+    unsigned long num_objects = bench_arg(argc, argv, 0, 100000);
+    unsigned long num_rounds = bench_arg(argc, argv, 1, 10);
+    allocator_st *pool = NULL, *bump = NULL;
+    base1_handle *handles;
+    my_rc_e rc;
+
+    handles = calloc(num_objects, sizeof(*handles));
+    pool = allocator_pool_new();
+    /* The bump allocator never reuses memory, so size it for every round */
+    bump = allocator_bump_new(0);
+    if ((NULL == handles) || (NULL == pool) || (NULL == bump)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    rc = bench_alloc_run("heap", &allocator_heap, handles, num_objects,
+                         num_rounds);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    rc = bench_alloc_run("pool", pool, handles, num_objects, num_rounds);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    rc = bench_alloc_run("bump", bump, handles, num_objects, num_rounds);
+
+exit:
+
+    allocator_bump_delete(bump);
+    allocator_pool_delete(pool);
+    free(handles);
+
+    return (my_rc_e_is_ok(rc) ? 0 : 1);
+}
+
+/**
+ * Compare constructing derived2 objects and setting their state against
+ * cloning a prototype with the same state.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of objects per batch and the number of batches
+ * @return Exit code for the program
+ */
+static int
+bench_clone (int argc, char *argv[])
+{
+    unsigned long num_objects = bench_arg(argc, argv, 0, 100000);
+    unsigned long num_rounds = bench_arg(argc, argv, 1, 10);
+    base1_public_data_st public_data = { .val1 = 3, .val2 = 4 };
+    base1_handle *handles, prototype;
+    unsigned long i, round;
+    uint64_t start_ns, construct_ns, clone_ns;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    handles = calloc(num_objects, sizeof(*handles));
+    prototype = derived1_cast_to_base1(derived2_cast_to_derived1(
+        derived2_new1()));
+    if ((NULL == handles) || (NULL == prototype)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+    base1_set_public_data(prototype, &public_data);
+
+    start_ns = bench_now_ns();
+    for (round = 0; (round < num_rounds) && my_rc_e_is_ok(rc); round++) {
+        for (i = 0; i < num_objects; i++) {
+            handles[i] = derived1_cast_to_base1(derived2_cast_to_derived1(
+                derived2_new1()));
+            if (NULL == handles[i]) {
+                rc = MY_RC_E_ENOMEM;
+                break;
+            }
+            base1_set_public_data(handles[i], &public_data);
+        }
+        while (i > 0) {
+            base1_delete(handles[--i]);
+        }
+    }
+    construct_ns = bench_now_ns() - start_ns;
+
+    start_ns = bench_now_ns();
+    for (round = 0; (round < num_rounds) && my_rc_e_is_ok(rc); round++) {
+        for (i = 0; i < num_objects; i++) {
+            handles[i] = base1_clone(prototype);
+            if (NULL == handles[i]) {
+                rc = MY_RC_E_ENOMEM;
+                break;
+            }
+        }
+        while (i > 0) {
+            base1_delete(handles[--i]);
+        }
+    }
+    clone_ns = bench_now_ns() - start_ns;
+
+    if (my_rc_e_is_ok(rc)) {
+        printf("construct %8.1f ns/object\n",
+               (double) construct_ns / (num_objects * num_rounds));
+        printf("clone     %8.1f ns/object\n",
+               (double) clone_ns / (num_objects * num_rounds));
+    }
+
+exit:
+
+    base1_delete(prototype);
+    free(handles);
+
+    return (my_rc_e_is_ok(rc) ? 0 : 1);
+}
+
+/**
+ * Compare deleting and constructing derived1 objects against putting them in
+ * the recycle bin and constructing them from it.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of objects per batch and the number of batches
+ * @return Exit code for the program
+ */
+static int
+bench_recycle (int argc, char *argv[])
+{
+    unsigned long num_objects = bench_arg(argc, argv, 0, 64);
+    unsigned long num_rounds = bench_arg(argc, argv, 1, 100000);
+    derived1_handle *handles;
+    unsigned long i, round;
+    uint64_t start_ns, delete_ns, recycle_ns;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    handles = calloc(num_objects, sizeof(*handles));
+    if ((NULL == handles) ||
+        my_rc_e_is_notok(recycle_set_capacity(MY_CLASS_ID_E_DERIVED1,
+                                              num_objects))) {
+        free(handles);
+        return (1);
+    }
+
+    start_ns = bench_now_ns();
+    for (round = 0; (round < num_rounds) && my_rc_e_is_ok(rc); round++) {
+        for (i = 0; i < num_objects; i++) {
+            handles[i] = derived1_new_with_allocator(NULL);
+            if (NULL == handles[i]) {
+                rc = MY_RC_E_ENOMEM;
+                break;
+            }
+        }
+        while (i > 0) {
+            base1_delete(derived1_cast_to_base1(handles[--i]));
+        }
+    }
+    delete_ns = bench_now_ns() - start_ns;
+
+    start_ns = bench_now_ns();
+    for (round = 0; (round < num_rounds) && my_rc_e_is_ok(rc); round++) {
+        for (i = 0; i < num_objects; i++) {
+            handles[i] = derived1_new1();
+            if (NULL == handles[i]) {
+                rc = MY_RC_E_ENOMEM;
+                break;
+            }
+        }
+        while (i > 0) {
+            recycle_put(derived1_cast_to_base1(handles[--i]));
+        }
+    }
+    recycle_ns = bench_now_ns() - start_ns;
+    recycle_drain(MY_CLASS_ID_E_DERIVED1);
+
+    if (my_rc_e_is_ok(rc)) {
+        printf("delete+new  %8.1f ns/object\n",
+               (double) delete_ns / (num_objects * num_rounds));
+        printf("recycle+new %8.1f ns/object\n",
+               (double) recycle_ns / (num_objects * num_rounds));
+    }
+
+    free(handles);
+
+    return (my_rc_e_is_ok(rc) ? 0 : 1);
+}
+
+/**
+ * Measure constructing derived1 objects for the first time, when their memory
+ * has never been touched, from the heap and from a prefaulted arena.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of objects and whether to use huge pages (0 or 1)
+ * @return Exit code for the program
+ */
+static int
+bench_arena (int argc, char *argv[])
+{
+    unsigned long num_objects = bench_arg(argc, argv, 0, 1000000);
+    arena_config_st config = {
+        .capacity = 0,
+        .huge_pages = (0 != bench_arg(argc, argv, 1, 0)),
+        .populate = true,
+        .idle_limit = SIZE_MAX,
+    };
+    derived1_handle *handles;
+    allocator_st *arena = NULL;
+    arena_stats_st before, after;
+    unsigned long i, pass;
+    uint64_t start_ns, elapsed_ns;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    handles = calloc(num_objects, sizeof(*handles));
+    arena = arena_new(&config);
+    if ((NULL == handles) || (NULL == arena)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    start_ns = bench_now_ns();
+    rc = arena_reserve_objects(arena, MY_CLASS_ID_E_DERIVED1, num_objects);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    printf("%-6s %8.1f ms warm-up\n", "arena",
+           (double) (bench_now_ns() - start_ns) / 1000000);
+
+    for (pass = 0; (pass < 2) && my_rc_e_is_ok(rc); pass++) {
+        arena_get_stats(arena, &before);
+        start_ns = bench_now_ns();
+        for (i = 0; i < num_objects; i++) {
+            handles[i] = derived1_new_with_allocator((0 == pass) ?
+                                                     &allocator_heap : arena);
+            if (NULL == handles[i]) {
+                rc = MY_RC_E_ENOMEM;
+                break;
+            }
+        }
+        elapsed_ns = bench_now_ns() - start_ns;
+        arena_get_stats(arena, &after);
+
+        printf("%-6s %8.1f ns/object %8.3f faults/object rss(%zuMB)\n",
+               (0 == pass) ? "heap" : "arena",
+               (double) elapsed_ns / num_objects,
+               (double) (after.minor_faults - before.minor_faults) /
+               num_objects, after.rss_bytes >> 20);
+
+        while (i > 0) {
+            base1_delete(derived1_cast_to_base1(handles[--i]));
+        }
+    }
+
+    arena_get_stats(arena, &before);
+    arena_trim(arena, 0);
+    arena_get_stats(arena, &after);
+    printf("trim   rss(%zuMB) -> rss(%zuMB)\n", before.rss_bytes >> 20,
+           after.rss_bytes >> 20);
+
+exit:
+
+    arena_delete(arena);
+    free(handles);
+
+    return (my_rc_e_is_ok(rc) ? 0 : 1);
+}
+
+/** Work for a thread mutating objects from a NUMA node */
+typedef struct bench_numa_arg_st_ {
+    /** Node the thread runs on */
+    unsigned int node;
+    /** The objects */
+    derived1_handle *handles;
+    /** Number of objects */
+    unsigned long num_objects;
+    /** Number of passes over the objects */
+    unsigned long num_rounds;
+    /** Set to the time taken */
+    uint64_t elapsed_ns;
+    /** Set to the result */
+    my_rc_e rc;
+} bench_numa_arg_st;
+
+/**
+ * Bind to a node and mutate every object for a number of rounds.
+ *
+ * @param arg The work
+ * @return NULL
+ */
+static void *
+bench_numa_thread (void *arg)
+{
+    bench_numa_arg_st *work = arg;
+    unsigned long i, round;
+    uint64_t start_ns;
+
+    work->rc = numa_bind_thread(work->node);
+    if (my_rc_e_is_notok(work->rc)) {
+        return (NULL);
+    }
+
+    start_ns = bench_now_ns();
+    for (round = 0; round < work->num_rounds; round++) {
+        for (i = 0; i < work->num_objects; i++) {
+            base1_increase_val3(derived1_cast_to_base1(work->handles[i]));
+            derived1_increase_val4(work->handles[i]);
+        }
+    }
+    work->elapsed_ns = bench_now_ns() - start_ns;
+
+    return (NULL);
+}
+
+/**
+ * Construct derived1 objects on node 0, then compare mutating them from a
+ * thread on node 0 against a thread on the last node.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of objects and the number of passes over them
+ * @return Exit code for the program
+ */
+static int
+bench_numa (int argc, char *argv[])
+{
+    unsigned long num_objects = bench_arg(argc, argv, 0, 1000000);
+    unsigned long num_rounds = bench_arg(argc, argv, 1, 10);
+    unsigned int nodes[2] = { 0, numa_num_nodes() - 1 };
+    const allocator_st *allocator;
+    bench_numa_arg_st work;
+    derived1_handle *handles;
+    unsigned long i, pass;
+    pthread_t thread;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if (1 == numa_num_nodes()) {
+        printf("single node, local and remote are the same node\n");
+    }
+
+    handles = calloc(num_objects, sizeof(*handles));
+    allocator = numa_node_allocator(0);
+    if ((NULL == handles) || (NULL == allocator)) {
+        free(handles);
+        return (1);
+    }
+
+    for (i = 0; i < num_objects; i++) {
+        handles[i] = derived1_new_with_allocator(allocator);
+        if (NULL == handles[i]) {
+            rc = MY_RC_E_ENOMEM;
+            goto exit;
+        }
+    }
+
+    for (pass = 0; (pass < NELEMS(nodes)) && my_rc_e_is_ok(rc); pass++) {
+        work = (bench_numa_arg_st) {
+            .node = nodes[pass],
+            .handles = handles,
+            .num_objects = num_objects,
+            .num_rounds = num_rounds,
+        };
+        if (0 != pthread_create(&thread, NULL, bench_numa_thread, &work)) {
+            rc = MY_RC_E_ENOMEM;
+            break;
+        }
+        pthread_join(thread, NULL);
+        rc = work.rc;
+
+        if (my_rc_e_is_ok(rc)) {
+            printf("%-6s node(%u) %8.1f Mops/s\n",
+                   (0 == pass) ? "local" : "remote", work.node,
+                   (work.elapsed_ns > 0) ?
+                   (2e3 * num_objects * num_rounds / work.elapsed_ns) : 0);
+        }
+    }
+
+exit:
+
+    while (i > 0) {
+        base1_delete(derived1_cast_to_base1(handles[--i]));
+    }
+    free(handles);
+
+    return (my_rc_e_is_ok(rc) ? 0 : 1);
+}
+
+/** Work for a thread constructing and deleting objects */
+typedef struct bench_magazine_arg_st_ {
+    /** The allocator */
+    const allocator_st *allocator;
+    /** Index of the thread */
+    unsigned long thread;
+    /** Number of threads */
+    unsigned long num_threads;
+    /** Batch of objects for each thread */
+    derived1_handle **batches;
+    /** Number of objects per batch */
+    unsigned long num_objects;
+    /** Number of batches */
+    unsigned long num_rounds;
+    /** Synchronizes the threads between halves of each round */
+    pthread_barrier_t *barrier;
+} bench_magazine_arg_st;
+
+/**
+ * Construct a batch of objects each round, then delete the batch made by the
+ * next thread, so every free is a cross-thread free once there are two or
+ * more threads.
+ *
+ * @param arg The work
+ * @return NULL
+ */
+static void *
+bench_magazine_thread (void *arg)
+{
+    bench_magazine_arg_st *work = arg;
+    derived1_handle *mine, *theirs;
+    unsigned long i, round;
+
+    mine = work->batches[work->thread];
+    theirs = work->batches[(work->thread + 1) % work->num_threads];
+
+    for (round = 0; round < work->num_rounds; round++) {
+        for (i = 0; i < work->num_objects; i++) {
+            mine[i] = derived1_new_with_allocator(work->allocator);
+        }
+        pthread_barrier_wait(work->barrier);
+
+        for (i = 0; i < work->num_objects; i++) {
+            if (NULL != theirs[i]) {
+                base1_delete(derived1_cast_to_base1(theirs[i]));
+            }
+        }
+        pthread_barrier_wait(work->barrier);
+    }
+
+    return (NULL);
+}
+
+/**
+ * Run the cross-thread construct/delete workload on a number of threads.
+ *
+ * @param allocator The allocator
+ * @param num_threads Number of threads
+ * @param num_objects Number of objects per batch
+ * @param num_rounds Number of batches per thread
+ * @return Objects constructed and deleted per second, or zero on failure
+ */
+static double
+bench_magazine_run (const allocator_st *allocator, unsigned long num_threads,
+                    unsigned long num_objects, unsigned long num_rounds)
+{
+    bench_magazine_arg_st *work;
+    derived1_handle **batches;
+    pthread_barrier_t barrier;
+    pthread_t *threads;
+    unsigned long i, started = 0;
+    uint64_t start_ns, elapsed_ns = 0;
+
+    work = calloc(num_threads, sizeof(*work));
+    batches = calloc(num_threads, sizeof(*batches));
+    threads = calloc(num_threads, sizeof(*threads));
+    for (i = 0; (NULL != batches) && (i < num_threads); i++) {
+        batches[i] = calloc(num_objects, sizeof(*batches[i]));
+        if (NULL == batches[i]) {
+            goto exit;
+        }
+    }
+    if ((NULL == work) || (NULL == batches) || (NULL == threads) ||
+        (0 != pthread_barrier_init(&barrier, NULL, num_threads))) {
+        goto exit;
+    }
+
+    start_ns = bench_now_ns();
+    for (started = 0; started < num_threads; started++) {
+        work[started] = (bench_magazine_arg_st) {
+            .allocator = allocator,
+            .thread = started,
+            .num_threads = num_threads,
+            .batches = batches,
+            .num_objects = num_objects,
+            .num_rounds = num_rounds,
+            .barrier = &barrier,
+        };
+        if (0 != pthread_create(&threads[started], NULL,
+                                bench_magazine_thread, &work[started])) {
+            /* The barrier cannot be satisfied with fewer threads */
+            abort();
+        }
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    elapsed_ns = bench_now_ns() - start_ns;
+    pthread_barrier_destroy(&barrier);
+
+exit:
+
+    for (i = 0; (NULL != batches) && (i < num_threads); i++) {
+        free(batches[i]);
+    }
+    free(batches);
+    free(threads);
+    free(work);
+
+    return ((0 != elapsed_ns) ?
+            (1e9 * num_threads * num_objects * num_rounds / elapsed_ns) : 0);
+}
+
+/**
+ * Compare the heap, the pool allocator and a magazine allocator as the number
+ * of threads constructing and deleting objects grows.
+ *
+ * @param argc Number of arguments
+ * @param argv The most threads, the number of objects per batch and the
+ * number of batches per thread
+ * @return Exit code for the program
+ */
+static int
+bench_magazine (int argc, char *argv[])
+{
+    unsigned long max_threads = bench_arg(argc, argv, 0, 64);
+    unsigned long num_objects = bench_arg(argc, argv, 1, 1000);
+    unsigned long num_rounds = bench_arg(argc, argv, 2, 100);
+    const allocator_st *allocators[3];
+    const char *names[3] = { "heap", "pool", "magazine" };
+    allocator_st *pool, *mags;
+    unsigned long num_threads, i;
+    double rate;
+
+    pool = allocator_pool_new();
+    mags = magazine_allocator_new(NULL);
+    if ((NULL == pool) || (NULL == mags)) {
+        allocator_pool_delete(pool);
+        magazine_allocator_delete(mags);
+        return (1);
+    }
+    allocators[0] = &allocator_heap;
+    allocators[1] = pool;
+    allocators[2] = mags;
+
+    printf("threads");
+    for (i = 0; i < NELEMS(names); i++) {
+        printf(" %10s", names[i]);
+    }
+    printf("  (Mobjects/s)\n");
+
+    for (num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        printf("%7lu", num_threads);
+        for (i = 0; i < NELEMS(allocators); i++) {
+            rate = bench_magazine_run(allocators[i], num_threads, num_objects,
+                                      num_rounds);
+            printf(" %10.2f", rate / 1e6);
+        }
+        printf("\n");
+    }
+
+    magazine_allocator_delete(mags);
+    allocator_pool_delete(pool);
+
+    return (0);
+}
+
+/** Ways for the objpool benchmark to get and dispose of objects */
+typedef enum bench_objpool_mode_e_ {
+    /** Construct and delete */
+    BENCH_OBJPOOL_MODE_E_NEW,
+    /** Construct from and put in the recycle bin, which takes a lock */
+    BENCH_OBJPOOL_MODE_E_RECYCLE,
+    /** Acquire from and release to the lock-free pool */
+    BENCH_OBJPOOL_MODE_E_POOL,
+    /** Number of modes */
+    BENCH_OBJPOOL_MODE_E_MAX,
+} bench_objpool_mode_e;
+
+/** Work for a thread cycling objects */
+typedef struct bench_objpool_arg_st_ {
+    /** How to get and dispose of objects */
+    bench_objpool_mode_e mode;
+    /** Number of objects to cycle */
+    unsigned long num_objects;
+} bench_objpool_arg_st;
+
+/**
+ * Get, mutate and dispose of derived1 objects one at a time.
+ *
+ * @param arg The work
+ * @return NULL
+ */
+static void *
+bench_objpool_thread (void *arg)
+{
+    bench_objpool_arg_st *work = arg;
+    derived1_handle derived1_h;
+    base1_handle base1_h;
+    unsigned long i;
+
+    for (i = 0; i < work->num_objects; i++) {
+        switch (work->mode) {
+        case BENCH_OBJPOOL_MODE_E_NEW:
+            derived1_h = derived1_new_with_allocator(NULL);
+            break;
+        case BENCH_OBJPOOL_MODE_E_RECYCLE:
+            derived1_h = derived1_new1();
+            break;
+        default:
+            derived1_h = base1_try_cast_to_derived1(
+                objpool_acquire(MY_CLASS_ID_E_DERIVED1));
+            break;
+        }
+        if (NULL == derived1_h) {
+            break;
+        }
+
+        derived1_increase_val4(derived1_h);
+        base1_h = derived1_cast_to_base1(derived1_h);
+
+        switch (work->mode) {
+        case BENCH_OBJPOOL_MODE_E_NEW:
+            base1_delete(base1_h);
+            break;
+        case BENCH_OBJPOOL_MODE_E_RECYCLE:
+            recycle_put(base1_h);
+            break;
+        default:
+            objpool_release(base1_h);
+            break;
+        }
+    }
+
+    return (NULL);
+}
+
+/**
+ * Compare cycling derived1 objects through construct/delete, the recycle bin
+ * and the lock-free pool as the number of threads grows.
+ *
+ * @param argc Number of arguments
+ * @param argv The most threads and the number of objects per thread
+ * @return Exit code for the program
+ */
+static int
+bench_objpool (int argc, char *argv[])
+{
+    unsigned long max_threads = bench_arg(argc, argv, 0, 16);
+    unsigned long num_objects = bench_arg(argc, argv, 1, 200000);
+    const char *names[BENCH_OBJPOOL_MODE_E_MAX] = {
+        "new", "recycle", "objpool"
+    };
+    bench_objpool_arg_st work;
+    unsigned long num_threads, i, mode;
+    uint64_t start_ns, elapsed_ns;
+    objpool_stats_st stats;
+    pthread_t *threads;
+    my_rc_e rc;
+
+    threads = calloc(max_threads, sizeof(*threads));
+    rc = objpool_create(MY_CLASS_ID_E_DERIVED1, 1024, 1024);
+    if ((NULL == threads) || my_rc_e_is_notok(rc)) {
+        free(threads);
+        return (1);
+    }
+
+    printf("threads");
+    for (mode = 0; mode < BENCH_OBJPOOL_MODE_E_MAX; mode++) {
+        printf(" %10s", names[mode]);
+    }
+    printf("  (Mobjects/s)\n");
+
+    for (num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        printf("%7lu", num_threads);
+        for (mode = 0; mode < BENCH_OBJPOOL_MODE_E_MAX; mode++) {
+            work.mode = mode;
+            work.num_objects = num_objects;
+
+            start_ns = bench_now_ns();
+            for (i = 0; i < num_threads; i++) {
+                if (0 != pthread_create(&threads[i], NULL,
+                                        bench_objpool_thread, &work)) {
+                    break;
+                }
+            }
+            num_threads = i;
+            for (i = 0; i < num_threads; i++) {
+                pthread_join(threads[i], NULL);
+            }
+            elapsed_ns = bench_now_ns() - start_ns;
+
+            printf(" %10.2f",
+                   (1e3 * num_threads * num_objects) / elapsed_ns);
+        }
+        printf("\n");
+    }
+
+    objpool_get_stats(MY_CLASS_ID_E_DERIVED1, &stats);
+    printf("objpool hits(%" PRIu64 ") misses(%" PRIu64 ") "
+           "overflows(%" PRIu64 ")\n", stats.hits, stats.misses,
+           stats.overflows);
+
+    objpool_destroy(MY_CLASS_ID_E_DERIVED1);
+    recycle_drain(MY_CLASS_ID_E_DERIVED1);
+    free(threads);
+
+    return (0);
+}
+
+/** Set to stop the journal benchmark's consumer */
+static bool bench_journal_done;
+
+/**
+ * Drain the journal until told to stop.
+ *
+ * @param arg Outputs the number of records drained
+ * @return NULL
+ */
+static void *
+bench_journal_consumer (void *arg)
+{
+    journal_record_st records[1024];
+    uint64_t *drained = arg;
+    size_t count;
+
+    while (!__atomic_load_n(&bench_journal_done, __ATOMIC_ACQUIRE)) {
+        count = journal_drain(records, NELEMS(records));
+        *drained += count;
+        if (0 == count) {
+            sched_yield();
+        }
+    }
+    *drained += journal_drain(records, NELEMS(records));
+
+    return (NULL);
+}
+
+/**
+ * Measure the cost the journal adds to mutations, with a consumer thread
+ * draining it concurrently.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of mutations
+ * @return Exit code for the program
+ */
+static int
+bench_journal (int argc, char *argv[])
+{
+    unsigned long num_ops = bench_arg(argc, argv, 0, 10000000);
+    journal_stats_st stats;
+    derived1_handle derived1_h;
+    uint64_t start_ns, elapsed_ns, drained = 0;
+    unsigned long i, pass;
+    pthread_t consumer;
+
+    derived1_h = derived1_new1();
+    if (NULL == derived1_h) {
+        return (1);
+    }
+
+    for (pass = 0; pass < 2; pass++) {
+        if (1 == pass) {
+            journal_start(0);
+            if (0 != pthread_create(&consumer, NULL, bench_journal_consumer,
+                                    &drained)) {
+                break;
+            }
+        }
+
+        start_ns = bench_now_ns();
+        for (i = 0; i < num_ops; i++) {
+            derived1_increase_val4(derived1_h);
+        }
+        elapsed_ns = bench_now_ns() - start_ns;
+
+        printf("%-3s %8.1f ns/mutation\n", (0 == pass) ? "off" : "on",
+               (double) elapsed_ns / num_ops);
+    }
+
+    if (journal_is_enabled()) {
+        journal_stop();
+        __atomic_store_n(&bench_journal_done, true, __ATOMIC_RELEASE);
+        pthread_join(consumer, NULL);
+        journal_get_stats(&stats);
+        printf("drained(%" PRIu64 ") dropped(%" PRIu64 ")\n", drained,
+               stats.dropped);
+    }
+
+    base1_delete(derived1_cast_to_base1(derived1_h));
+
+    return (0);
+}
+
+/**
+ * Mutate an object repeatedly with the log open.
+ *
+ * @param arg The number of mutations, as a pointer to unsigned long
+ * @return NULL
+ */
+static void *
+bench_wal_thread (void *arg)
+{
+    unsigned long num_ops = *(unsigned long *) arg, i;
+    derived1_handle derived1_h;
+
+    derived1_h = derived1_new1();
+    if (NULL == derived1_h) {
+        return (NULL);
+    }
+
+    for (i = 0; i < num_ops; i++) {
+        derived1_increase_val4(derived1_h);
+    }
+
+    base1_delete(derived1_cast_to_base1(derived1_h));
+
+    return (NULL);
+}
+
+/**
+ * Measure synchronous write-ahead logging as the number of threads grows,
+ * showing how group commit spreads each fdatasync() over more mutations.
+ * The log is written to a temporary directory which is removed afterwards.
+ *
+ * @param argc Number of arguments
+ * @param argv The most threads and the number of mutations per thread
+ * @return Exit code for the program
+ */
+static int
+bench_wal (int argc, char *argv[])
+{
+    unsigned long max_threads = bench_arg(argc, argv, 0, 16);
+    unsigned long num_ops = bench_arg(argc, argv, 1, 1000);
+    char dir[] = "/tmp/bench_c_oo_wal.XXXXXX";
+    char path[sizeof(dir) + 32];
+    unsigned long num_threads, i, started;
+    uint64_t start_ns, elapsed_ns;
+    wal_stats_st stats;
+    pthread_t *threads;
+    int rc = 0;
+
+    threads = calloc(max_threads, sizeof(*threads));
+    if ((NULL == threads) || (NULL == mkdtemp(dir))) {
+        free(threads);
+        return (1);
+    }
+
+    printf("threads   mutations/s       syncs  records/sync\n");
+    for (num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        if (my_rc_e_is_notok(wal_open(dir, NULL))) {
+            rc = 1;
+            break;
+        }
+
+        start_ns = bench_now_ns();
+        for (started = 0; started < num_threads; started++) {
+            if (0 != pthread_create(&threads[started], NULL,
+                                    bench_wal_thread, &num_ops)) {
+                break;
+            }
+        }
+        for (i = 0; i < started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        elapsed_ns = bench_now_ns() - start_ns;
+
+        wal_get_stats(&stats);
+        wal_close();
+        snprintf(path, sizeof(path), "%s/wal.%" PRIu64, dir,
+                 stats.generation);
+        unlink(path);
+
+        printf("%7lu %13.0f %11" PRIu64 " %13.1f\n", started,
+               1e9 * stats.records / elapsed_ns, stats.syncs,
+               (double) stats.records / ((0 == stats.syncs) ? 1 : stats.syncs));
+    }
+
+    rmdir(dir);
+    free(threads);
+
+    return (rc);
+}
+
+/**
+ * Measure how the cost of a checkpoint follows the number of objects
+ * mutated since the previous one rather than the number tracked.  The
+ * checkpoint is written to a temporary file which is removed afterwards.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of objects
+ * @return Exit code for the program
+ */
+static int
+bench_checkpoint (int argc, char *argv[])
+{
+    static const unsigned long dirty_per_million[] = {
+        1000000, 100000, 10000, 1000, 0
+    };
+    unsigned long num_objects = bench_arg(argc, argv, 0, 1000000);
+    char path[] = "/tmp/bench_c_oo_checkpoint.XXXXXX";
+    checkpoint_write_stats_st stats;
+    base1_handle *objs;
+    uint64_t start_ns, elapsed_ns;
+    unsigned long i, j, stride;
+    int fd, rc = 0;
+
+    objs = calloc(num_objects, sizeof(*objs));
+    fd = mkstemp(path);
+    if ((NULL == objs) || (fd < 0)) {
+        free(objs);
+        return (1);
+    }
+    close(fd);
+
+    checkpoint_start();
+    for (i = 0; i < num_objects; i++) {
+        objs[i] = base1_new1();
+    }
+    if (my_rc_e_is_notok(checkpoint_write(path, NULL))) {
+        rc = 1;
+        goto exit;
+    }
+
+    printf("   dirty     objects  dirty_pages        MB          ms\n");
+    for (i = 0; i < NELEMS(dirty_per_million); i++) {
+        stride = (0 == dirty_per_million[i]) ? 0 :
+            (1000000 / dirty_per_million[i]);
+        for (j = 0; (0 != stride) && (j < num_objects); j += stride) {
+            base1_increase_val3(objs[j]);
+        }
+
+        start_ns = bench_now_ns();
+        if (my_rc_e_is_notok(checkpoint_write(path, &stats))) {
+            rc = 1;
+            break;
+        }
+        elapsed_ns = bench_now_ns() - start_ns;
+
+        printf("%7.1f%% %11zu %12zu %9.2f %11.2f\n",
+               dirty_per_million[i] / 1e4, stats.objects, stats.dirty_pages,
+               stats.bytes / 1e6, elapsed_ns / 1e6);
+    }
+
+exit:
+
+    checkpoint_stop();
+    for (i = 0; i < num_objects; i++) {
+        base1_delete(objs[i]);
+    }
+    free(objs);
+    unlink(path);
+
+    return (rc);
+}
+
+/**
+ * Measure saving and loading a snapshot as the number of threads grows.  The
+ * snapshot is written to a temporary file which is removed afterwards.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of objects and the most threads
+ * @return Exit code for the program
+ */
+static int
+bench_snapshot (int argc, char *argv[])
+{
+    unsigned long num_objects = bench_arg(argc, argv, 0, 1000000);
+    unsigned long max_threads = bench_arg(argc, argv, 1, 32);
+    char path[] = "/tmp/bench_c_oo_snapshot.XXXXXX";
+    snapshot_config_st config = { .num_threads = 1 };
+    snapshot_stats_st stats;
+    base1_handle *objs, *loaded;
+    uint64_t start_ns, save_ns, load_ns;
+    size_t count, i;
+    int fd, rc = 0;
+
+    objs = calloc(num_objects, sizeof(*objs));
+    fd = mkstemp(path);
+    if ((NULL == objs) || (fd < 0)) {
+        free(objs);
+        return (1);
+    }
+    close(fd);
+
+    for (i = 0; i < num_objects; i++) {
+        objs[i] = (0 == (i % 2)) ? base1_new1() :
+            derived1_cast_to_base1(derived1_new1());
+    }
+
+    printf("threads  save(ms)  load(ms)  blocks        MB\n");
+    for (; config.num_threads <= max_threads; config.num_threads *= 2) {
+        start_ns = bench_now_ns();
+        if (my_rc_e_is_notok(snapshot_save(path, objs, num_objects, &config,
+                                           &stats))) {
+            rc = 1;
+            break;
+        }
+        save_ns = bench_now_ns() - start_ns;
+
+        start_ns = bench_now_ns();
+        if (my_rc_e_is_notok(snapshot_load(path, &config, &loaded, &count,
+                                           NULL))) {
+            rc = 1;
+            break;
+        }
+        load_ns = bench_now_ns() - start_ns;
+
+        printf("%7zu %9.1f %9.1f %7zu %9.2f\n", stats.threads, save_ns / 1e6,
+               load_ns / 1e6, stats.blocks, stats.bytes / 1e6);
+
+        for (i = 0; i < count; i++) {
+            base1_delete(loaded[i]);
+        }
+        free(loaded);
+    }
+
+    for (i = 0; i < num_objects; i++) {
+        base1_delete(objs[i]);
+    }
+    free(objs);
+    unlink(path);
+
+    return (rc);
+}
+
+/**
+ * Benchmark a filtered sum over base1 objects, computed by a loop over the
+ * public accessors, by a query gathering from the objects, and by a query
+ * over columns, with increasing numbers of threads.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of objects and the most threads
+ * @return Exit code for the program
+ */
+static int
+bench_query (int argc, char *argv[])
+{
+    unsigned long num_objects = bench_arg(argc, argv, 0, 4000000);
+    unsigned long max_threads = bench_arg(argc, argv, 1, 8);
+    query_st query = { .num_preds = 1, .field = MY_FIELD_E_BASE1_VAL2,
+                       .preds = { { MY_FIELD_E_BASE1_VAL1, QUERY_OP_E_LT,
+                                    128 } } };
+    query_columns_st columns = { .count = num_objects };
+    base1_public_data_st public_data;
+    query_result_st result;
+    base1_handle *objs;
+    uint64_t *val1, *val2, start_ns, sum = 0;
+    size_t i;
+    int rc = 0;
+
+    objs = calloc(num_objects, sizeof(*objs));
+    val1 = calloc(num_objects, sizeof(*val1));
+    val2 = calloc(num_objects, sizeof(*val2));
+    if ((NULL == objs) || (NULL == val1) || (NULL == val2)) {
+        free(objs);
+        free(val1);
+        free(val2);
+        return (1);
+    }
+
+    for (i = 0; i < num_objects; i++) {
+        objs[i] = base1_new3(i, i);
+    }
+
+    start_ns = bench_now_ns();
+    for (i = 0; i < num_objects; i++) {
+        base1_get_public_data(objs[i], &public_data);
+        if (public_data.val1 < 128) {
+            sum += public_data.val2;
+        }
+    }
+    printf("accessors:        %8.2f ns/object sum(%" PRIu64 ")\n",
+           (double) (bench_now_ns() - start_ns) / num_objects, sum);
+
+    class_registry_extract_column(MY_FIELD_E_BASE1_VAL1, objs, num_objects,
+                                  val1);
+    class_registry_extract_column(MY_FIELD_E_BASE1_VAL2, objs, num_objects,
+                                  val2);
+    columns.columns[MY_FIELD_E_BASE1_VAL1] = val1;
+    columns.columns[MY_FIELD_E_BASE1_VAL2] = val2;
+
+    for (query.num_threads = 1; query.num_threads <= max_threads;
+         query.num_threads *= 2) {
+        start_ns = bench_now_ns();
+        if (my_rc_e_is_notok(query_run_objects(&query, objs, num_objects,
+                                               &result))) {
+            rc = 1;
+            break;
+        }
+        printf("objects  %zu thread: %8.2f ns/object sum(%" PRIu64 ")\n",
+               query.num_threads,
+               (double) (bench_now_ns() - start_ns) / num_objects,
+               result.sum);
+
+        start_ns = bench_now_ns();
+        if (my_rc_e_is_notok(query_run_columns(&query, &columns, &result))) {
+            rc = 1;
+            break;
+        }
+        printf("columns  %zu thread: %8.2f ns/object sum(%" PRIu64 ")\n",
+               query.num_threads,
+               (double) (bench_now_ns() - start_ns) / num_objects,
+               result.sum);
+    }
+
+    for (i = 0; i < num_objects; i++) {
+        base1_delete(objs[i]);
+    }
+    free(objs);
+    free(val1);
+    free(val2);
+
+    return (rc);
+}
+
+/**
+ * Compare finding objects by val2 with a scan against hash and ordered
+ * indexes, and measure the cost indexes add to mutations.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of objects and the number of lookups
+ * @return Exit code for the program
+ */
+static int
+bench_field_index (int argc, char *argv[])
+{
+    unsigned long num_objects = bench_arg(argc, argv, 0, 1000000);
+    unsigned long num_lookups = bench_arg(argc, argv, 1, 100);
+    field_index_handle hash_h, ordered_h;
+    base1_public_data_st public_data;
+    base1_handle *objs, found[16];
+    uint64_t start_ns, value, hits = 0;
+    size_t count, i, j;
+
+    objs = calloc(num_objects, sizeof(*objs));
+    hash_h = field_index_new(FIELD_INDEX_KIND_E_HASH, MY_FIELD_E_BASE1_VAL2);
+    ordered_h = field_index_new(FIELD_INDEX_KIND_E_ORDERED,
+                                MY_FIELD_E_BASE1_VAL2);
+    if ((NULL == objs) || (NULL == hash_h) || (NULL == ordered_h)) {
+        free(objs);
+        field_index_delete(hash_h);
+        field_index_delete(ordered_h);
+        return (1);
+    }
+
+    for (i = 0; i < num_objects; i++) {
+        objs[i] = base1_new1();
+        public_data.val1 = i;
+        public_data.val2 = (i * 2654435761u) % num_objects;
+        base1_set_public_data(objs[i], &public_data);
+    }
+
+    start_ns = bench_now_ns();
+    for (i = 0; i < num_lookups; i++) {
+        value = (i * 7919) % num_objects;
+        for (j = 0; j < num_objects; j++) {
+            base1_get_public_data(objs[j], &public_data);
+            hits += (value == public_data.val2);
+        }
+    }
+    printf("scan lookup:     %10.1f ns hits(%" PRIu64 ")\n",
+           (double) (bench_now_ns() - start_ns) / num_lookups, hits);
+
+    start_ns = bench_now_ns();
+    for (i = 0; i < num_objects; i++) {
+        field_index_insert(hash_h, objs[i]);
+    }
+    printf("hash insert:     %10.1f ns\n",
+           (double) (bench_now_ns() - start_ns) / num_objects);
+    start_ns = bench_now_ns();
+    for (i = 0; i < num_objects; i++) {
+        field_index_insert(ordered_h, objs[i]);
+    }
+    printf("ordered insert:  %10.1f ns\n",
+           (double) (bench_now_ns() - start_ns) / num_objects);
+
+    hits = 0;
+    start_ns = bench_now_ns();
+    for (i = 0; i < num_objects; i++) {
+        field_index_lookup(hash_h, (i * 7919) % num_objects, found,
+                           NELEMS(found), &count);
+        hits += count;
+    }
+    printf("hash lookup:     %10.1f ns hits(%" PRIu64 ")\n",
+           (double) (bench_now_ns() - start_ns) / num_objects, hits);
+
+    hits = 0;
+    start_ns = bench_now_ns();
+    for (i = 0; i < num_objects; i++) {
+        field_index_lookup(ordered_h, (i * 7919) % num_objects, found,
+                           NELEMS(found), &count);
+        hits += count;
+    }
+    printf("ordered lookup:  %10.1f ns hits(%" PRIu64 ")\n",
+           (double) (bench_now_ns() - start_ns) / num_objects, hits);
+
+    hits = 0;
+    start_ns = bench_now_ns();
+    for (i = 0; i < num_objects; i++) {
+        value = (i * 7919) % num_objects;
+        field_index_range(ordered_h, value, value + 15, found, NELEMS(found),
+                          &count);
+        hits += count;
+    }
+    printf("ordered range16: %10.1f ns hits(%" PRIu64 ")\n",
+           (double) (bench_now_ns() - start_ns) / num_objects, hits);
+
+    start_ns = bench_now_ns();
+    for (i = 0; i < num_objects; i++) {
+        public_data.val1 = i;
+        public_data.val2 = ((i + 1) * 2654435761u) % num_objects;
+        base1_set_public_data(objs[i], &public_data);
+    }
+    printf("indexed set:     %10.1f ns\n",
+           (double) (bench_now_ns() - start_ns) / num_objects);
+
+    field_index_delete(hash_h);
+    field_index_delete(ordered_h);
+    start_ns = bench_now_ns();
+    for (i = 0; i < num_objects; i++) {
+        public_data.val1 = i;
+        public_data.val2 = i;
+        base1_set_public_data(objs[i], &public_data);
+    }
+    printf("unindexed set:   %10.1f ns\n",
+           (double) (bench_now_ns() - start_ns) / num_objects);
+
+    for (i = 0; i < num_objects; i++) {
+        base1_delete(objs[i]);
+    }
+    free(objs);
+
+    return (0);
+}
+
+/**
+ * Compare handles by the class of their objects, for qsort().
+ *
+ * @param a The first handle
+ * @param b The second handle
+ * @return Negative, zero or positive as the first orders before, the same
+ * as or after the second.
+ */
+static int
+bench_class_cmp (const void *a, const void *b)
+{
+    my_class_id_e class_a = base1_class_id(*(const base1_handle *) a);
+    my_class_id_e class_b = base1_class_id(*(const base1_handle *) b);
+
+    return ((class_a > class_b) - (class_a < class_b));
+}
+
+/**
+ * Compare handles by val3 of their objects, for qsort().
+ *
+ * @param a The first handle
+ * @param b The second handle
+ * @return Negative, zero or positive as the first orders before, the same
+ * as or after the second.
+ */
+static int
+bench_val3_cmp (const void *a, const void *b)
+{
+    uint64_t val_a = 0, val_b = 0;
+
+    class_registry_get_field(*(const base1_handle *) a, MY_FIELD_E_BASE1_VAL3,
+                             &val_a);
+    class_registry_get_field(*(const base1_handle *) b, MY_FIELD_E_BASE1_VAL3,
+                             &val_b);
+
+    return ((val_a > val_b) - (val_a < val_b));
+}
+
+/**
+ * Compare sorting mixed handles by class and by val3 with qsort() and a
+ * comparison callback against the radix sorts, with increasing numbers of
+ * threads.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of objects and the most threads
+ * @return Exit code for the program
+ */
+static int
+bench_handle_sort (int argc, char *argv[])
+{
+    unsigned long num_objects = bench_arg(argc, argv, 0, 1000000);
+    unsigned long max_threads = bench_arg(argc, argv, 1, 8);
+    base1_handle *objs, *sorted;
+    uint64_t start_ns, seed = 1;
+    size_t threads, i;
+    int rc = 0;
+
+    objs = calloc(num_objects, sizeof(*objs));
+    sorted = calloc(num_objects, sizeof(*sorted));
+    if ((NULL == objs) || (NULL == sorted)) {
+        free(objs);
+        free(sorted);
+        return (1);
+    }
+
+    for (i = 0; i < num_objects; i++) {
+        seed = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+        switch ((seed >> 33) % 3) {
+        case 0:
+            objs[i] = base1_new3(i, seed >> 40);
+            break;
+        case 1:
+            objs[i] = derived1_cast_to_base1(derived1_new1());
+            break;
+        default:
+            objs[i] = derived1_cast_to_base1(derived2_cast_to_derived1(
+                derived2_new1()));
+            break;
+        }
+    }
+
+    memcpy(sorted, objs, num_objects * sizeof(*sorted));
+    start_ns = bench_now_ns();
+    qsort(sorted, num_objects, sizeof(*sorted), bench_class_cmp);
+    printf("qsort class:        %8.2f ns/object\n",
+           (double) (bench_now_ns() - start_ns) / num_objects);
+
+    memcpy(sorted, objs, num_objects * sizeof(*sorted));
+    start_ns = bench_now_ns();
+    qsort(sorted, num_objects, sizeof(*sorted), bench_val3_cmp);
+    printf("qsort val3:         %8.2f ns/object\n",
+           (double) (bench_now_ns() - start_ns) / num_objects);
+
+    for (threads = 1; threads <= max_threads; threads *= 2) {
+        memcpy(sorted, objs, num_objects * sizeof(*sorted));
+        start_ns = bench_now_ns();
+        if (my_rc_e_is_notok(handle_sort_by_class(sorted, num_objects,
+                                                  threads, NULL))) {
+            rc = 1;
+            break;
+        }
+        printf("radix class %2zu thr: %8.2f ns/object\n", threads,
+               (double) (bench_now_ns() - start_ns) / num_objects);
+
+        memcpy(sorted, objs, num_objects * sizeof(*sorted));
+        start_ns = bench_now_ns();
+        if (my_rc_e_is_notok(handle_sort_by_field(sorted, num_objects,
+                                                  MY_FIELD_E_BASE1_VAL3,
+                                                  threads, NULL))) {
+            rc = 1;
+            break;
+        }
+        printf("radix val3  %2zu thr: %8.2f ns/object\n", threads,
+               (double) (bench_now_ns() - start_ns) / num_objects);
+    }
+
+    for (i = 0; i < num_objects; i++) {
+        base1_delete(objs[i]);
+    }
+    free(objs);
+    free(sorted);
+
+    return (rc);
+}
+
+/**
+ * Compare summing val3 over every object with reading the running aggregate,
+ * and measure the cost aggregation adds to mutations.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of objects and the number of reads
+ * @return Exit code for the program
+ */
+static int
+bench_aggregate (int argc, char *argv[])
+{
+    unsigned long num_objects = bench_arg(argc, argv, 0, 1000000);
+    unsigned long num_reads = bench_arg(argc, argv, 1, 10);
+    aggregate_result_st result;
+    base1_handle *objs;
+    uint64_t start_ns, value, sum = 0;
+    size_t i, j;
+
+    objs = calloc(num_objects, sizeof(*objs));
+    if (NULL == objs) {
+        return (1);
+    }
+
+    aggregate_start();
+    for (i = 0; i < num_objects; i++) {
+        objs[i] = base1_new3(i, i);
+    }
+
+    start_ns = bench_now_ns();
+    for (j = 0; j < num_reads; j++) {
+        for (i = 0; i < num_objects; i++) {
+            class_registry_get_field(objs[i], MY_FIELD_E_BASE1_VAL3, &value);
+            sum += value;
+        }
+    }
+    printf("scan sum:        %12.1f ns/read sum(%" PRIu64 ")\n",
+           (double) (bench_now_ns() - start_ns) / num_reads, sum / num_reads);
+
+    start_ns = bench_now_ns();
+    for (j = 0; j < num_reads; j++) {
+        aggregate_get(MY_CLASS_ID_E_BASE1, MY_FIELD_E_BASE1_VAL3, &result);
+    }
+    printf("aggregate read:  %12.1f ns/read sum(%" PRIu64 ")\n",
+           (double) (bench_now_ns() - start_ns) / num_reads, result.sum);
+
+    start_ns = bench_now_ns();
+    for (i = 0; i < num_objects; i++) {
+        base1_increase_val3(objs[i]);
+    }
+    printf("aggregated mutation:   %6.1f ns\n",
+           (double) (bench_now_ns() - start_ns) / num_objects);
+
+    aggregate_stop();
+    start_ns = bench_now_ns();
+    for (i = 0; i < num_objects; i++) {
+        base1_increase_val3(objs[i]);
+    }
+    printf("unaggregated mutation: %6.1f ns\n",
+           (double) (bench_now_ns() - start_ns) / num_objects);
+
+    for (i = 0; i < num_objects; i++) {
+        base1_delete(objs[i]);
+    }
+    free(objs);
+
+    return (0);
+}
+
+/** Arguments of a thread of the transaction benchmark */
+typedef struct bench_txn_arg_st_ {
+    /** Number of operations */
+    unsigned long num_ops;
+    /** Whether to use transactions */
+    bool txn;
+    /** Objects shared by every thread, NULL for objects of its own */
+    base1_handle *shared;
+    /** Outputs the number of commits which failed validation */
+    unsigned long aborts;
+} bench_txn_arg_st;
+
+/**
+ * Read val3 of one object and increase val3 of it and another, either
+ * directly or in a transaction retried until it commits.
+ *
+ * @param arg The arguments, as bench_txn_arg_st
+ * @return NULL
+ */
+static void *
+bench_txn_thread (void *arg)
+{
+    bench_txn_arg_st *txn_arg = arg;
+    base1_handle own[2], *objs = txn_arg->shared;
+    unsigned long i;
+    uint64_t value;
+    txn_st txn;
+
+    own[0] = base1_new3(1, 1);
+    own[1] = base1_new3(2, 2);
+    if (NULL == objs) {
+        objs = own;
+    }
+    txn_arg->aborts = 0;
+
+    for (i = 0; (NULL != own[0]) && (NULL != own[1]) &&
+         (i < txn_arg->num_ops); i++) {
+        if (!txn_arg->txn) {
+            class_registry_get_field(objs[0], MY_FIELD_E_BASE1_VAL3, &value);
+            base1_increase_val3(objs[0]);
+            base1_increase_val3(objs[1]);
+            continue;
+        }
+        while (true) {
+            txn_begin(&txn);
+            txn_read(&txn, objs[0], MY_FIELD_E_BASE1_VAL3, &value);
+            txn_increase_val3(&txn, objs[0]);
+            txn_increase_val3(&txn, objs[1]);
+            if (MY_RC_E_EAGAIN != txn_commit(&txn)) {
+                break;
+            }
+            txn_arg->aborts++;
+        }
+    }
+
+    for (i = 0; i < NELEMS(own); i++) {
+        if (NULL != own[i]) {
+            base1_delete(own[i]);
+        }
+    }
+
+    return (NULL);
+}
+
+/**
+ * Run the transaction benchmark on a number of threads.
+ *
+ * @param num_threads Number of threads
+ * @param args Arguments of each thread, whose fields but aborts are set
+ * @param threads The threads
+ * @param aborts Outputs the total of failed commits
+ * @return Operations per second
+ */
+static double
+bench_txn_run (unsigned long num_threads, bench_txn_arg_st *args,
+               pthread_t *threads, unsigned long *aborts)
+{
+    unsigned long started, i, num_ops = 0;
+    uint64_t start_ns;
+
+    start_ns = bench_now_ns();
+    for (started = 0; started < num_threads; started++) {
+        if (0 != pthread_create(&threads[started], NULL, bench_txn_thread,
+                                &args[started])) {
+            break;
+        }
+    }
+    *aborts = 0;
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+        num_ops += args[i].num_ops;
+        *aborts += args[i].aborts;
+    }
+
+    return (1e9 * num_ops / (bench_now_ns() - start_ns));
+}
+
+/**
+ * Compare operations on two objects made directly with the same operations
+ * made in transactions, with each thread on objects of its own and with
+ * every thread on the same objects.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of operations per thread and the most threads
+ * @return Exit code for the program
+ */
+static int
+bench_txn (int argc, char *argv[])
+{
+    unsigned long num_ops = bench_arg(argc, argv, 0, 1000000);
+    unsigned long max_threads = bench_arg(argc, argv, 1, 8);
+    base1_handle shared[2];
+    bench_txn_arg_st *args;
+    pthread_t *threads;
+    unsigned long num_threads, i, aborts;
+    double plain, own, contended;
+
+    shared[0] = base1_new3(1, 1);
+    shared[1] = base1_new3(2, 2);
+    args = calloc(max_threads, sizeof(*args));
+    threads = calloc(max_threads, sizeof(*threads));
+    if ((NULL == shared[0]) || (NULL == shared[1]) || (NULL == args) ||
+        (NULL == threads)) {
+        return (1);
+    }
+
+    printf("threads     direct/s  txn(own)/s  txn(shared)/s  aborts\n");
+    for (num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        for (i = 0; i < num_threads; i++) {
+            args[i].num_ops = num_ops;
+            args[i].txn = false;
+            args[i].shared = NULL;
+        }
+        plain = bench_txn_run(num_threads, args, threads, &aborts);
+        for (i = 0; i < num_threads; i++) {
+            args[i].txn = true;
+        }
+        own = bench_txn_run(num_threads, args, threads, &aborts);
+        for (i = 0; i < num_threads; i++) {
+            args[i].shared = shared;
+        }
+        contended = bench_txn_run(num_threads, args, threads, &aborts);
+        printf("%7lu %12.0f %11.0f %14.0f %7lu\n", num_threads, plain, own,
+               contended, aborts);
+    }
+
+    base1_delete(shared[0]);
+    base1_delete(shared[1]);
+    free(args);
+    free(threads);
+
+    return (0);
+}
+
+/** Arguments of a thread of the actor benchmark */
+typedef struct bench_actor_arg_st_ {
+    /** Number of operations */
+    unsigned long num_ops;
+    /** The shared objects */
+    base1_handle *objs;
+    /** Lock of each object, or NULL to send to the executor */
+    pthread_mutex_t *locks;
+    /** Number of objects */
+    unsigned long num_objects;
+    /** The executor */
+    actor_executor_handle executor_h;
+} bench_actor_arg_st;
+
+/**
+ * Increase val3 of the shared objects in turn, either under each object's
+ * lock or by sending the method to the executor.
+ *
+ * @param arg The arguments, as bench_actor_arg_st
+ * @return NULL
+ */
+static void *
+bench_actor_thread (void *arg)
+{
+    bench_actor_arg_st *actor_arg = arg;
+    unsigned long i, j;
+
+    for (i = 0; i < actor_arg->num_ops; i++) {
+        j = i % actor_arg->num_objects;
+        if (NULL == actor_arg->locks) {
+            actor_increase_val3(actor_arg->executor_h, actor_arg->objs[j],
+                                NULL);
+            continue;
+        }
+        pthread_mutex_lock(&actor_arg->locks[j]);
+        base1_increase_val3(actor_arg->objs[j]);
+        pthread_mutex_unlock(&actor_arg->locks[j]);
+    }
+
+    return (NULL);
+}
+
+/**
+ * Run the actor benchmark on a number of threads, including for the
+ * executor the time until every method sent has run.
+ *
+ * @param num_threads Number of threads
+ * @param arg Arguments of every thread
+ * @param threads The threads
+ * @return Operations per second
+ */
+static double
+bench_actor_run (unsigned long num_threads, bench_actor_arg_st *arg,
+                 pthread_t *threads)
+{
+    actor_future_st future;
+    unsigned long started, i;
+    uint64_t start_ns;
+
+    start_ns = bench_now_ns();
+    for (started = 0; started < num_threads; started++) {
+        if (0 != pthread_create(&threads[started], NULL, bench_actor_thread,
+                                arg)) {
+            break;
+        }
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    if (NULL == arg->locks) {
+        for (i = 0; i < arg->num_objects; i++) {
+            actor_get_field(arg->executor_h, arg->objs[i],
+                            MY_FIELD_E_BASE1_VAL3, &future);
+            actor_future_wait(&future);
+        }
+    }
+
+    return (1e9 * started * arg->num_ops / (bench_now_ns() - start_ns));
+}
+
+/**
+ * Compare threads mutating shared objects under a lock per object with
+ * threads sending the mutations to the objects' mailboxes.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of operations per thread, the most threads, the
+ * number of objects and the number of workers
+ * @return Exit code for the program
+ */
+static int
+bench_actor (int argc, char *argv[])
+{
+    unsigned long num_ops = bench_arg(argc, argv, 0, 1000000);
+    unsigned long max_threads = bench_arg(argc, argv, 1, 8);
+    unsigned long num_objects = bench_arg(argc, argv, 2, 16);
+    unsigned long num_workers = bench_arg(argc, argv, 3, 2);
+    pthread_mutex_t *locks;
+    bench_actor_arg_st arg;
+    pthread_t *threads;
+    unsigned long num_threads, i;
+    double locked, sent;
+    int rc = 0;
+
+    memset(&arg, 0, sizeof(arg));
+    arg.num_ops = num_ops;
+    arg.num_objects = num_objects;
+    arg.objs = calloc(num_objects, sizeof(*arg.objs));
+    locks = calloc(num_objects, sizeof(*locks));
+    threads = calloc(max_threads, sizeof(*threads));
+    arg.executor_h = actor_executor_new(num_workers);
+    if ((NULL == arg.objs) || (NULL == locks) || (NULL == threads) ||
+        (NULL == arg.executor_h)) {
+        rc = 1;
+        goto exit;
+    }
+    for (i = 0; i < num_objects; i++) {
+        pthread_mutex_init(&locks[i], NULL);
+        arg.objs[i] = base1_new3(1, 1);
+        if (NULL == arg.objs[i]) {
+            rc = 1;
+            goto exit;
+        }
+    }
+
+    printf("threads     locked/s       sent/s\n");
+    for (num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        arg.locks = locks;
+        locked = bench_actor_run(num_threads, &arg, threads);
+        arg.locks = NULL;
+        sent = bench_actor_run(num_threads, &arg, threads);
+        printf("%7lu %12.0f %12.0f\n", num_threads, locked, sent);
+    }
+
+exit:
+
+    actor_executor_delete(arg.executor_h);
+    for (i = 0; (NULL != arg.objs) && (i < num_objects); i++) {
+        if (NULL != arg.objs[i]) {
+            base1_delete(arg.objs[i]);
+        }
+    }
+    free(arg.objs);
+    free(locks);
+    free(threads);
+
+    return (rc);
+}
+
+/**
+ * Increase val3 of an object.
+ *
+ * @param worker_h The worker
+ * @param base1_h The object
+ * @param index Index of the object
+ * @param arg Unused
+ * @return Return code
+ */
+static my_rc_e
+bench_parallel_increase (parallel_worker_handle worker_h,
+                         base1_handle base1_h, size_t index, void *arg)
+{
+    return (base1_increase_val3(base1_h));
+}
+
+/**
+ * Render an object's string into the worker's scratch buffer.
+ *
+ * @param worker_h The worker
+ * @param base1_h The object
+ * @param arg Unused
+ * @param value Outputs the length of the string
+ * @return Return code
+ */
+static my_rc_e
+bench_parallel_string (parallel_worker_handle worker_h, base1_handle base1_h,
+                       void *arg, uint64_t *value)
+{
+    size_t size;
+    char *buffer;
+    my_rc_e rc;
+
+    rc = base1_string_size(base1_h, &size);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+    buffer = parallel_scratch(worker_h, size);
+    if (NULL == buffer) {
+        return (MY_RC_E_ENOMEM);
+    }
+    rc = base1_string(base1_h, buffer, size);
+    *value = strlen(buffer);
+
+    return (rc);
+}
+
+/**
+ * Add values.
+ *
+ * @param result The result so far
+ * @param value The next value
+ * @return The combined result
+ */
+static uint64_t
+bench_parallel_sum (uint64_t result, uint64_t value)
+{
+    return (result + value);
+}
+
+/**
+ * Measure increasing val3 and rendering the string of every object of a
+ * collection as the number of threads in the pool grows.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of objects, the most threads and the grain
+ * @return Exit code for the program
+ */
+static int
+bench_parallel (int argc, char *argv[])
+{
+    unsigned long num_objects = bench_arg(argc, argv, 0, 1000000);
+    unsigned long max_threads = bench_arg(argc, argv, 1, 8);
+    unsigned long grain = bench_arg(argc, argv, 2, 0);
+    parallel_pool_handle pool_h;
+    uint64_t start_ns, increase_ns, string_ns, length;
+    base1_handle *objs;
+    unsigned long num_threads, i;
+    int rc = 0;
+
+    objs = calloc(num_objects, sizeof(*objs));
+    if (NULL == objs) {
+        return (1);
+    }
+    for (i = 0; i < num_objects; i++) {
+        objs[i] = (0 == (i % 2)) ? base1_new3(i, i) :
+            derived1_cast_to_base1(derived1_new1());
+        if (NULL == objs[i]) {
+            rc = 1;
+            goto exit;
+        }
+    }
+
+    printf("threads  increase ns/obj  string ns/obj\n");
+    for (num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        pool_h = parallel_pool_new(num_threads);
+        if (NULL == pool_h) {
+            rc = 1;
+            break;
+        }
+
+        start_ns = bench_now_ns();
+        parallel_for_each_object(pool_h, objs, num_objects,
+                                 bench_parallel_increase, NULL, grain);
+        increase_ns = bench_now_ns() - start_ns;
+
+        start_ns = bench_now_ns();
+        parallel_reduce_objects(pool_h, objs, num_objects,
+                                bench_parallel_string, NULL,
+                                bench_parallel_sum, 0, grain, &length);
+        string_ns = bench_now_ns() - start_ns;
+
+        parallel_pool_delete(pool_h);
+        printf("%7lu %16.1f %14.1f\n", num_threads,
+               (double) increase_ns / num_objects,
+               (double) string_ns / num_objects);
+    }
+
+exit:
+
+    for (i = 0; i < num_objects; i++) {
+        if (NULL != objs[i]) {
+            base1_delete(objs[i]);
+        }
+    }
+    free(objs);
+
+    return (rc);
+}
+
+/**
+ * Compare dumping objects serially with the parallel dump as the number of
+ * rendering threads grows.  The dumps are written to a temporary file which
+ * is removed afterwards.
+ *
+ * @param argc Number of arguments
+ * @param argv The number of objects and the most threads
+ * @return Exit code for the program
+ */
+static int
+bench_dump (int argc, char *argv[])
+{
+    unsigned long num_objects = bench_arg(argc, argv, 0, 1000000);
+    unsigned long max_threads = bench_arg(argc, argv, 1, 8);
+    char path[] = "/tmp/bench_c_oo_dump.XXXXXX";
+    dump_config_st config = { 0 };
+    base1_handle *objs;
+    uint64_t start_ns, elapsed_ns;
+    dump_stats_st stats;
+    unsigned long i;
+    my_rc_e rc;
+    int fd;
+
+    objs = calloc(num_objects, sizeof(*objs));
+    fd = mkstemp(path);
+    if ((NULL == objs) || (fd < 0)) {
+        free(objs);
+        return (1);
+    }
+    for (i = 0; i < num_objects; i++) {
+        objs[i] = (0 == (i % 2)) ? base1_new3(i, i) :
+            derived1_cast_to_base1(derived1_new1());
+    }
+
+    printf("threads       MB/s   writes\n");
+    for (config.num_threads = 0; config.num_threads <= max_threads;
+         config.num_threads = (0 == config.num_threads) ? 1 :
+         (config.num_threads * 2)) {
+        if ((0 != ftruncate(fd, 0)) || (0 != lseek(fd, 0, SEEK_SET))) {
+            break;
+        }
+        start_ns = bench_now_ns();
+        if (0 == config.num_threads) {
+            rc = dump_objects_serial(fd, objs, num_objects, &stats);
+        } else {
+            rc = dump_objects(fd, objs, num_objects, &config, &stats);
+        }
+        elapsed_ns = bench_now_ns() - start_ns;
+        if (my_rc_e_is_notok(rc)) {
+            break;
+        }
+        if (0 == config.num_threads) {
+            printf(" serial");
+        } else {
+            printf("%7zu", config.num_threads);
+        }
+        printf(" %10.1f %8zu\n", 1e3 * stats.bytes / elapsed_ns,
+               stats.writes);
+    }
+
+    close(fd);
+    unlink(path);
+    for (i = 0; i < num_objects; i++) {
+        if (NULL != objs[i]) {
+            base1_delete(objs[i]);
+        }
+    }
+    free(objs);
+
+    return (0);
+}
+
+/** The benchmarks */
+static const bench_st benches[] = {
+    { "record", "FILE [NUM_OBJECTS]", bench_record },
+    { "replay", "FILE [NUM_THREADS]", bench_replay },
+    { "alloc", "[NUM_OBJECTS] [NUM_ROUNDS]", bench_alloc },
+    { "clone", "[NUM_OBJECTS] [NUM_ROUNDS]", bench_clone },
+    { "recycle", "[NUM_OBJECTS] [NUM_ROUNDS]", bench_recycle },
+    { "arena", "[NUM_OBJECTS] [HUGE_PAGES]", bench_arena },
+    { "numa", "[NUM_OBJECTS] [NUM_ROUNDS]", bench_numa },
+    { "magazine", "[MAX_THREADS] [NUM_OBJECTS] [NUM_ROUNDS]",
+      bench_magazine },
+    { "objpool", "[MAX_THREADS] [NUM_OBJECTS]", bench_objpool },
+    { "journal", "[NUM_MUTATIONS]", bench_journal },
+    { "wal", "[MAX_THREADS] [NUM_MUTATIONS]", bench_wal },
+    { "checkpoint", "[NUM_OBJECTS]", bench_checkpoint },
+    { "snapshot", "[NUM_OBJECTS] [MAX_THREADS]", bench_snapshot },
+    { "query", "[NUM_OBJECTS] [MAX_THREADS]", bench_query },
+    { "field_index", "[NUM_OBJECTS] [NUM_LOOKUPS]", bench_field_index },
+    { "handle_sort", "[NUM_OBJECTS] [MAX_THREADS]", bench_handle_sort },
+    { "aggregate", "[NUM_OBJECTS] [NUM_READS]", bench_aggregate },
+    { "txn", "[NUM_OPS] [MAX_THREADS]", bench_txn },
+    { "actor", "[NUM_OPS] [MAX_THREADS] [NUM_OBJECTS] [NUM_WORKERS]",
+      bench_actor },
+    { "parallel", "[NUM_OBJECTS] [MAX_THREADS] [GRAIN]", bench_parallel },
+    { "dump", "[NUM_OBJECTS] [MAX_THREADS]", bench_dump },
+};
+
+/**
+ * Main function to run benchmarks.
+ */
+int
+main (int argc, char *argv[])
+{
+    size_t i;
+
+    for (i = 0; (argc > 1) && (i < NELEMS(benches)); i++) {
+        if (0 == strcmp(argv[1], benches[i].name)) {
+            return (benches[i].fn(argc - 2, argv + 2));
+        }
+    }
+
+    printf("usage: %s BENCHMARK [ARGS]\n", argv[0]);
+    for (i = 0; i < NELEMS(benches); i++) {
+        printf("    %s %s\n", benches[i].name, benches[i].usage);
+    }
+
+    return (1);
+}
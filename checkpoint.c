@@ -0,0 +1,821 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements incremental checkpoints.
+ *
+ * Tracked objects are held in a table of slots, allocated in fixed size pages
+ * which are never freed, and each object keeps its slot number so marking it
+ * dirty takes no lock and no lookup.  Each page has a bitmap with a bit per
+ * slot, and the table has a bitmap with a bit per page, so a checkpoint visits
+ * only the pages with a dirty object and, within them, skips clean words 64
+ * slots at a time.
+ *
+ * A mutation sets the object's bit before testing the page's bit, and a
+ * checkpoint clears a page's bit before clearing the page's bits, so a mutation
+ * racing with a checkpoint is either written by it or left dirty for the next
+ * one.  The bits are cleared with atomic exchanges, which synchronize with the
+ * marking, so the checkpoint sees the mutated state.
+ *
+ * A checkpoint file holds a header and then records, each an object ID and the
+ * length of the object's exported state, both little-endian, followed by the
+ * state.  Deletions have a length of zero.  Files are written to a temporary
+ * name, synced and renamed, so a checkpoint is either complete or absent.
+ */
+#include <pthread.h>
+#include <unistd.h>
+#include "checkpoint.h"
+#include "base1_friend.h"
+#include "class_registry.h"
+#include "id_map.h"
+
+/** Magic at the start of each checkpoint file */
+#define CHECKPOINT_MAGIC "OOCP"
+
+/** Version of the file format */
+#define CHECKPOINT_VERSION 1
+
+/** Size of the file header: magic and version */
+#define CHECKPOINT_HEADER_SIZE 8
+
+/** Size of a record header: object ID and length */
+#define CHECKPOINT_RECORD_HEADER_SIZE 12
+
+/** Largest exported state of an object */
+#define CHECKPOINT_MAX_STATE_SIZE 256
+
+/** Number of slots in each page of the table */
+#define CHECKPOINT_PAGE_SLOTS 4096
+
+/** Number of pages in a full table */
+#define CHECKPOINT_MAX_PAGES (CHECKPOINT_MAX_OBJECTS / CHECKPOINT_PAGE_SLOTS)
+
+/** Number of bits in a bitmap word */
+#define CHECKPOINT_WORD_BITS 64
+
+/** A page of slots */
+typedef struct checkpoint_page_st_ {
+    /** The objects, NULL for a free slot */
+    base1_handle objs[CHECKPOINT_PAGE_SLOTS];
+    /** Index plus one of the next free slot, zero for none */
+    uint32_t next_free[CHECKPOINT_PAGE_SLOTS];
+    /** A bit per slot, set when the slot's object is dirty */
+    uint64_t dirty[CHECKPOINT_PAGE_SLOTS / CHECKPOINT_WORD_BITS];
+} checkpoint_page_st;
+
+/** The table of tracked objects */
+typedef struct checkpoint_table_st_ {
+    /** Protects changes to the table and writing checkpoints */
+    pthread_mutex_t lock;
+    /** Pages of slots, allocated as needed */
+    checkpoint_page_st *pages[CHECKPOINT_MAX_PAGES];
+    /** A bit per page, set when the page has a dirty object */
+    uint64_t dirty_pages[CHECKPOINT_MAX_PAGES / CHECKPOINT_WORD_BITS];
+    /** Number of slots ever used */
+    uint32_t num_slots;
+    /** Index plus one of the first free slot, zero for none */
+    uint32_t free_head;
+    /** Number of tracked objects */
+    size_t count;
+    /** IDs of objects deleted since the last checkpoint */
+    uint64_t *deletions;
+    /** Number of deletions */
+    size_t num_deletions;
+    /** Capacity of deletions */
+    size_t deletions_capacity;
+} checkpoint_table_st;
+
+/** A state held during compaction */
+typedef struct checkpoint_state_st_ {
+    /** Length of the state */
+    size_t len;
+    /** The state */
+    uint8_t data[];
+} checkpoint_state_st;
+
+/** Context for compaction */
+typedef struct checkpoint_compact_st_ {
+    /** The merged states, by object ID */
+    id_map_handle states;
+    /** The file being written */
+    FILE *file;
+    /** First failure */
+    my_rc_e rc;
+} checkpoint_compact_st;
+
+bool checkpoint_active = false;
+
+/** The table */
+static checkpoint_table_st checkpoint_table = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/**
+ * Start tracking new objects and mutations.
+ */
+void
+checkpoint_start (void)
+{
+    __atomic_store_n(&checkpoint_active, true, __ATOMIC_RELEASE);
+}
+
+/**
+ * Stop tracking and forget every tracked object and pending deletion.  Other
+ * threads must not be constructing, mutating or deleting tracked objects
+ * meanwhile.
+ */
+void
+checkpoint_stop (void)
+{
+    checkpoint_table_st *table = &checkpoint_table;
+    checkpoint_page_st *page;
+    size_t i;
+
+    __atomic_store_n(&checkpoint_active, false, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&table->lock);
+    for (i = 0; i < table->num_slots; i++) {
+        page = table->pages[i / CHECKPOINT_PAGE_SLOTS];
+        if (NULL != page->objs[i % CHECKPOINT_PAGE_SLOTS]) {
+            base1_set_checkpoint_slot(page->objs[i % CHECKPOINT_PAGE_SLOTS],
+                                      0);
+            page->objs[i % CHECKPOINT_PAGE_SLOTS] = NULL;
+        }
+    }
+    for (i = 0; i < CHECKPOINT_MAX_PAGES; i++) {
+        if (NULL != table->pages[i]) {
+            memset(table->pages[i]->dirty, 0, sizeof(table->pages[i]->dirty));
+        }
+    }
+    memset(table->dirty_pages, 0, sizeof(table->dirty_pages));
+    table->num_slots = 0;
+    table->free_head = 0;
+    table->count = 0;
+    table->num_deletions = 0;
+    pthread_mutex_unlock(&table->lock);
+}
+
+/**
+ * Mark the object in a slot dirty.
+ *
+ * @param index The slot
+ */
+static void
+checkpoint_mark_slot (uint32_t index)
+{
+    checkpoint_table_st *table = &checkpoint_table;
+    uint32_t page_index = index / CHECKPOINT_PAGE_SLOTS;
+    uint32_t slot = index % CHECKPOINT_PAGE_SLOTS;
+    checkpoint_page_st *page;
+    uint64_t page_bit;
+
+    page = __atomic_load_n(&table->pages[page_index], __ATOMIC_ACQUIRE);
+    __atomic_fetch_or(&page->dirty[slot / CHECKPOINT_WORD_BITS],
+                      1ull << (slot % CHECKPOINT_WORD_BITS), __ATOMIC_SEQ_CST);
+
+    /* Testing first keeps repeated marks from writing the shared word */
+    page_bit = 1ull << (page_index % CHECKPOINT_WORD_BITS);
+    if (0 == (__atomic_load_n(&table->dirty_pages[page_index /
+                                                  CHECKPOINT_WORD_BITS],
+                              __ATOMIC_SEQ_CST) & page_bit)) {
+        __atomic_fetch_or(&table->dirty_pages[page_index /
+                                              CHECKPOINT_WORD_BITS],
+                          page_bit, __ATOMIC_SEQ_CST);
+    }
+}
+
+/**
+ * Mark a tracked object dirty so the next checkpoint writes it.  Callers
+ * should normally use CHECKPOINT_MARK_DIRTY() after the mutation.
+ *
+ * @param base1_h The object.  If it is not tracked, this is a no-op.
+ */
+void
+checkpoint_mark_dirty (base1_handle base1_h)
+{
+    uint32_t slot = base1_get_checkpoint_slot(base1_h);
+
+    if (0 != slot) {
+        checkpoint_mark_slot(slot - 1);
+    }
+}
+
+/**
+ * Track an object, which is dirty until the next checkpoint.  New objects are
+ * tracked automatically while tracking is started, so this is for objects
+ * constructed before.
+ *
+ * @param base1_h The object
+ * @return Return code, MY_RC_E_ENOMEM if too many objects are tracked.
+ */
+my_rc_e
+checkpoint_track (base1_handle base1_h)
+{
+    checkpoint_table_st *table = &checkpoint_table;
+    checkpoint_page_st *page;
+    uint32_t index;
+
+    if (NULL == base1_h) {
+        LOG_ERR("Invalid input, base1_h(%p)", base1_h);
+        return (MY_RC_E_EINVAL);
+    }
+
+    pthread_mutex_lock(&table->lock);
+
+    if (0 != base1_get_checkpoint_slot(base1_h)) {
+        pthread_mutex_unlock(&table->lock);
+        return (MY_RC_E_SUCCESS);
+    }
+
+    if (0 != table->free_head) {
+        index = table->free_head - 1;
+        page = table->pages[index / CHECKPOINT_PAGE_SLOTS];
+        table->free_head = page->next_free[index % CHECKPOINT_PAGE_SLOTS];
+    } else {
+        if (table->num_slots >= CHECKPOINT_MAX_OBJECTS) {
+            pthread_mutex_unlock(&table->lock);
+            LOG_ERR("Too many objects tracked, count(%zu)", table->count);
+            return (MY_RC_E_ENOMEM);
+        }
+        index = table->num_slots;
+        page = table->pages[index / CHECKPOINT_PAGE_SLOTS];
+        if (NULL == page) {
+            page = calloc(1, sizeof(*page));
+            if (NULL == page) {
+                pthread_mutex_unlock(&table->lock);
+                return (MY_RC_E_ENOMEM);
+            }
+            __atomic_store_n(&table->pages[index / CHECKPOINT_PAGE_SLOTS],
+                             page, __ATOMIC_RELEASE);
+        }
+        table->num_slots++;
+    }
+
+    page->objs[index % CHECKPOINT_PAGE_SLOTS] = base1_h;
+    base1_set_checkpoint_slot(base1_h, index + 1);
+    table->count++;
+    checkpoint_mark_slot(index);
+
+    pthread_mutex_unlock(&table->lock);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Stop tracking an object, recording its deletion for the next checkpoint.
+ * This is done automatically when a tracked object is deleted, recycled or
+ * released to an object pool.
+ *
+ * @param base1_h The object.  If it is not tracked, this is a no-op.
+ */
+void
+checkpoint_untrack (base1_handle base1_h)
+{
+    checkpoint_table_st *table = &checkpoint_table;
+    checkpoint_page_st *page;
+    uint64_t *deletions;
+    uint32_t index, slot;
+    size_t capacity;
+
+    if ((NULL == base1_h) || (0 == base1_get_checkpoint_slot(base1_h))) {
+        return;
+    }
+
+    pthread_mutex_lock(&table->lock);
+
+    index = base1_get_checkpoint_slot(base1_h) - 1;
+    if (index >= table->num_slots) {
+        /* Tracking was stopped meanwhile */
+        pthread_mutex_unlock(&table->lock);
+        return;
+    }
+    page = table->pages[index / CHECKPOINT_PAGE_SLOTS];
+    slot = index % CHECKPOINT_PAGE_SLOTS;
+
+    page->objs[slot] = NULL;
+    __atomic_fetch_and(&page->dirty[slot / CHECKPOINT_WORD_BITS],
+                       ~(1ull << (slot % CHECKPOINT_WORD_BITS)),
+                       __ATOMIC_RELAXED);
+    page->next_free[slot] = table->free_head;
+    table->free_head = index + 1;
+    table->count--;
+    base1_set_checkpoint_slot(base1_h, 0);
+
+    if (table->num_deletions == table->deletions_capacity) {
+        capacity = (0 == table->deletions_capacity) ? 1024 :
+            (table->deletions_capacity * 2);
+        deletions = realloc(table->deletions,
+                            capacity * sizeof(*deletions));
+        if (NULL == deletions) {
+            pthread_mutex_unlock(&table->lock);
+            LOG_ERR("Deletion lost, object_id(%" PRIu64 ")",
+                    base1_get_object_id(base1_h));
+            return;
+        }
+        table->deletions = deletions;
+        table->deletions_capacity = capacity;
+    }
+    table->deletions[table->num_deletions++] = base1_get_object_id(base1_h);
+
+    pthread_mutex_unlock(&table->lock);
+}
+
+/**
+ * Get the number of tracked objects.
+ *
+ * @return The number of objects
+ */
+size_t
+checkpoint_count (void)
+{
+    size_t count;
+
+    pthread_mutex_lock(&checkpoint_table.lock);
+    count = checkpoint_table.count;
+    pthread_mutex_unlock(&checkpoint_table.lock);
+
+    return (count);
+}
+
+/**
+ * Write a record to a checkpoint file.
+ *
+ * @param file The file
+ * @param object_id The object ID
+ * @param data The object's state, NULL for a deletion
+ * @param len Length of the state
+ * @return Return code
+ */
+static my_rc_e
+checkpoint_write_record (FILE *file, uint64_t object_id, const uint8_t *data,
+                         size_t len)
+{
+    uint8_t header[CHECKPOINT_RECORD_HEADER_SIZE];
+    size_t i;
+
+    for (i = 0; i < 8; i++) {
+        header[i] = object_id >> (8 * i);
+    }
+    for (i = 0; i < 4; i++) {
+        header[8 + i] = len >> (8 * i);
+    }
+
+    if ((1 != fwrite(header, sizeof(header), 1, file)) ||
+        ((0 != len) && (1 != fwrite(data, len, 1, file)))) {
+        return (MY_RC_E_EIO);
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Create a checkpoint file under a temporary name and write its header.
+ *
+ * @param path The final path of the file
+ * @param tmp_path Outputs the temporary path, which has room for path plus
+ * five bytes
+ * @return The file or NULL on failure
+ */
+static FILE *
+checkpoint_create (const char *path, char *tmp_path)
+{
+    uint8_t header[CHECKPOINT_HEADER_SIZE] = CHECKPOINT_MAGIC;
+    FILE *file;
+
+    sprintf(tmp_path, "%s.tmp", path);
+    header[4] = CHECKPOINT_VERSION;
+
+    file = fopen(tmp_path, "wb");
+    if (NULL == file) {
+        LOG_ERR("Failed to create, path(%s)", tmp_path);
+        return (NULL);
+    }
+
+    if (1 != fwrite(header, sizeof(header), 1, file)) {
+        fclose(file);
+        unlink(tmp_path);
+        return (NULL);
+    }
+
+    return (file);
+}
+
+/**
+ * Make a checkpoint file durable under its final name, or remove it.
+ *
+ * @param file The file, which is closed
+ * @param tmp_path The temporary path it was written to
+ * @param path The final path
+ * @param rc Result of writing the file
+ * @return Return code
+ */
+static my_rc_e
+checkpoint_finish (FILE *file, const char *tmp_path, const char *path,
+                   my_rc_e rc)
+{
+    if (my_rc_e_is_ok(rc) &&
+        ((0 != fflush(file)) || (0 != fsync(fileno(file))))) {
+        rc = MY_RC_E_EIO;
+    }
+    if ((0 != fclose(file)) && my_rc_e_is_ok(rc)) {
+        rc = MY_RC_E_EIO;
+    }
+    if (my_rc_e_is_ok(rc) && (0 != rename(tmp_path, path))) {
+        LOG_ERR("Failed to rename, path(%s)", path);
+        rc = MY_RC_E_EIO;
+    }
+    if (my_rc_e_is_notok(rc)) {
+        unlink(tmp_path);
+    }
+
+    return (rc);
+}
+
+/**
+ * Take the dirty slots of the table, clearing their bits.  The lock must be
+ * held.  On failure every slot is left dirty.
+ *
+ * @param slots Outputs an array of the slot indexes, which the caller frees
+ * @param stats Updated with the number of dirty pages
+ * @return Number of dirty slots or SIZE_MAX on failure
+ */
+static size_t
+checkpoint_take_dirty (uint32_t **slots, checkpoint_write_stats_st *stats)
+{
+    checkpoint_table_st *table = &checkpoint_table;
+    checkpoint_page_st *page;
+    uint64_t pages_word, slots_word;
+    uint32_t *grown, page_index, index;
+    size_t count = 0, capacity = 0, i, j, k;
+
+    *slots = NULL;
+
+    for (i = 0; i < NELEMS(table->dirty_pages); i++) {
+        if (0 == __atomic_load_n(&table->dirty_pages[i], __ATOMIC_RELAXED)) {
+            continue;
+        }
+        pages_word = __atomic_exchange_n(&table->dirty_pages[i], 0,
+                                         __ATOMIC_SEQ_CST);
+        while (0 != pages_word) {
+            page_index = (i * CHECKPOINT_WORD_BITS) +
+                __builtin_ctzll(pages_word);
+            pages_word &= pages_word - 1;
+            page = table->pages[page_index];
+            stats->dirty_pages++;
+
+            for (j = 0; j < NELEMS(page->dirty); j++) {
+                if (0 == __atomic_load_n(&page->dirty[j], __ATOMIC_RELAXED)) {
+                    continue;
+                }
+                slots_word = __atomic_exchange_n(&page->dirty[j], 0,
+                                                 __ATOMIC_SEQ_CST);
+                while (0 != slots_word) {
+                    index = (page_index * CHECKPOINT_PAGE_SLOTS) +
+                        (j * CHECKPOINT_WORD_BITS) +
+                        __builtin_ctzll(slots_word);
+                    slots_word &= slots_word - 1;
+
+                    if (count == capacity) {
+                        capacity = (0 == capacity) ? 1024 : (capacity * 2);
+                        grown = realloc(*slots, capacity * sizeof(**slots));
+                        if (NULL == grown) {
+                            /* Put back the bits taken but not yet listed */
+                            __atomic_fetch_or(&page->dirty[j], slots_word |
+                                (1ull << (index % CHECKPOINT_WORD_BITS)),
+                                __ATOMIC_SEQ_CST);
+                            __atomic_fetch_or(&table->dirty_pages[i],
+                                pages_word | (1ull << (page_index %
+                                                       CHECKPOINT_WORD_BITS)),
+                                __ATOMIC_SEQ_CST);
+                            for (k = 0; k < count; k++) {
+                                checkpoint_mark_slot((*slots)[k]);
+                            }
+                            free(*slots);
+                            *slots = NULL;
+                            return (SIZE_MAX);
+                        }
+                        *slots = grown;
+                    }
+                    (*slots)[count++] = index;
+                }
+            }
+        }
+    }
+
+    return (count);
+}
+
+/**
+ * Write a checkpoint of the objects dirtied and deleted since the previous
+ * checkpoint, or since tracking started for the first.  Objects may be
+ * mutated by other threads meanwhile, and those mutations are in this
+ * checkpoint or the next; constructing and deleting tracked objects waits
+ * for the checkpoint.  If writing fails, the objects stay dirty.
+ *
+ * @param path The file to write
+ * @param stats Outputs statistics of the checkpoint, or NULL
+ * @return Return code
+ */
+my_rc_e
+checkpoint_write (const char *path, checkpoint_write_stats_st *stats)
+{
+    checkpoint_table_st *table = &checkpoint_table;
+    uint8_t state[CHECKPOINT_MAX_STATE_SIZE];
+    checkpoint_write_stats_st local_stats;
+    char *tmp_path = NULL;
+    uint32_t *slots = NULL, index;
+    base1_handle base1_h;
+    size_t count, i, len;
+    FILE *file = NULL;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if (NULL == path) {
+        LOG_ERR("Invalid input, path(%p)", path);
+        return (MY_RC_E_EINVAL);
+    }
+    if (NULL == stats) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    tmp_path = malloc(strlen(path) + 5);
+    if (NULL == tmp_path) {
+        return (MY_RC_E_ENOMEM);
+    }
+
+    pthread_mutex_lock(&table->lock);
+
+    file = checkpoint_create(path, tmp_path);
+    if (NULL == file) {
+        rc = MY_RC_E_EIO;
+        goto exit;
+    }
+
+    /* Deletions first, so the state of a re-tracked object wins */
+    stats->bytes = CHECKPOINT_HEADER_SIZE;
+    for (i = 0; (i < table->num_deletions) && my_rc_e_is_ok(rc); i++) {
+        rc = checkpoint_write_record(file, table->deletions[i], NULL, 0);
+        stats->bytes += CHECKPOINT_RECORD_HEADER_SIZE;
+    }
+    stats->deletions = table->num_deletions;
+
+    count = checkpoint_take_dirty(&slots, stats);
+    if (SIZE_MAX == count) {
+        count = 0;
+        if (my_rc_e_is_ok(rc)) {
+            rc = MY_RC_E_ENOMEM;
+        }
+    }
+    for (i = 0; (i < count) && my_rc_e_is_ok(rc); i++) {
+        index = slots[i];
+        base1_h = table->pages[index / CHECKPOINT_PAGE_SLOTS]->
+            objs[index % CHECKPOINT_PAGE_SLOTS];
+        if (NULL == base1_h) {
+            continue;
+        }
+
+        rc = class_registry_export(&base1_h, 1, state, sizeof(state), &len);
+        if (my_rc_e_is_ok(rc)) {
+            rc = checkpoint_write_record(file, base1_get_object_id(base1_h),
+                                         state, len);
+            stats->objects++;
+            stats->bytes += CHECKPOINT_RECORD_HEADER_SIZE + len;
+        }
+    }
+
+    rc = checkpoint_finish(file, tmp_path, path, rc);
+    if (my_rc_e_is_ok(rc)) {
+        table->num_deletions = 0;
+    } else {
+        for (i = 0; i < count; i++) {
+            checkpoint_mark_slot(slots[i]);
+        }
+    }
+
+exit:
+
+    pthread_mutex_unlock(&table->lock);
+    free(slots);
+    free(tmp_path);
+
+    return (rc);
+}
+
+/**
+ * Call a function for each record of a checkpoint file, in the order written.
+ *
+ * @param path The file
+ * @param fn The function
+ * @param ctx Context passed to the function
+ * @return Return code, MY_RC_E_EIO if the file is missing, invalid or
+ * truncated.
+ */
+my_rc_e
+checkpoint_foreach (const char *path, checkpoint_foreach_fn fn, void *ctx)
+{
+    uint8_t header[CHECKPOINT_RECORD_HEADER_SIZE];
+    uint8_t state[CHECKPOINT_MAX_STATE_SIZE];
+    uint64_t object_id;
+    size_t len, read, i;
+    FILE *file;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if ((NULL == path) || (NULL == fn)) {
+        LOG_ERR("Invalid input, path(%p) fn(%p)", path, fn);
+        return (MY_RC_E_EINVAL);
+    }
+
+    file = fopen(path, "rb");
+    if (NULL == file) {
+        return (MY_RC_E_EIO);
+    }
+
+    if ((1 != fread(header, CHECKPOINT_HEADER_SIZE, 1, file)) ||
+        (0 != memcmp(header, CHECKPOINT_MAGIC, 4)) ||
+        (CHECKPOINT_VERSION != header[4])) {
+        LOG_ERR("Invalid header, path(%s)", path);
+        fclose(file);
+        return (MY_RC_E_EIO);
+    }
+
+    while (0 != (read = fread(header, 1, sizeof(header), file))) {
+        if (sizeof(header) != read) {
+            rc = MY_RC_E_EIO;
+            break;
+        }
+        object_id = 0;
+        for (i = 0; i < 8; i++) {
+            object_id |= (uint64_t) header[i] << (8 * i);
+        }
+        len = 0;
+        for (i = 0; i < 4; i++) {
+            len |= (size_t) header[8 + i] << (8 * i);
+        }
+
+        if ((len > sizeof(state)) ||
+            ((0 != len) && (1 != fread(state, len, 1, file)))) {
+            rc = MY_RC_E_EIO;
+            break;
+        }
+        fn(object_id, (0 == len) ? NULL : state, len, ctx);
+    }
+    fclose(file);
+
+    return (rc);
+}
+
+/**
+ * Merge a record into the states being compacted.
+ *
+ * @param object_id The object ID
+ * @param data The object's state, NULL for a deletion
+ * @param len Length of the state
+ * @param ctx The compaction
+ */
+static void
+checkpoint_compact_record (uint64_t object_id, const uint8_t *data,
+                           size_t len, void *ctx)
+{
+    checkpoint_compact_st *compact = ctx;
+    checkpoint_state_st *state = NULL;
+    uintptr_t old;
+
+    if (id_map_remove(compact->states, object_id, &old)) {
+        free((void *) old);
+    }
+    if (0 == len) {
+        return;
+    }
+
+    state = malloc(sizeof(*state) + len);
+    if (NULL == state) {
+        compact->rc = MY_RC_E_ENOMEM;
+        return;
+    }
+    state->len = len;
+    memcpy(state->data, data, len);
+
+    if (my_rc_e_is_notok(id_map_insert(compact->states, object_id,
+                                       (uintptr_t) state))) {
+        free(state);
+        compact->rc = MY_RC_E_ENOMEM;
+    }
+}
+
+/**
+ * Write a merged state to the compacted file.
+ *
+ * @param object_id The object ID
+ * @param value The state
+ * @param ctx The compaction
+ */
+static void
+checkpoint_compact_write (uint64_t object_id, uintptr_t value, void *ctx)
+{
+    checkpoint_compact_st *compact = ctx;
+    checkpoint_state_st *state = (checkpoint_state_st *) value;
+
+    if (my_rc_e_is_ok(compact->rc)) {
+        compact->rc = checkpoint_write_record(compact->file, object_id,
+                                              state->data, state->len);
+    }
+}
+
+/**
+ * Free a merged state.
+ *
+ * @param object_id The object ID
+ * @param value The state
+ * @param ctx Unused
+ */
+static void
+checkpoint_compact_free (uint64_t object_id, uintptr_t value, void *ctx)
+{
+    free((void *) value);
+}
+
+/**
+ * Merge a base checkpoint and the deltas written after it, in order, into a
+ * new base holding the last state of each object not deleted.  The output
+ * may replace the base, after which the deltas are no longer needed.
+ *
+ * @param base_path The base checkpoint or NULL to start from nothing, e.g.
+ * when the first delta was written when tracking started.
+ * @param delta_paths The deltas, oldest first
+ * @param num_deltas Number of deltas
+ * @param path The file to write
+ * @return Return code
+ */
+my_rc_e
+checkpoint_compact (const char *base_path, const char *const *delta_paths,
+                    size_t num_deltas, const char *path)
+{
+    checkpoint_compact_st compact = { .rc = MY_RC_E_SUCCESS };
+    char *tmp_path = NULL;
+    size_t i;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if ((NULL == path) || ((NULL == delta_paths) && (0 != num_deltas))) {
+        LOG_ERR("Invalid input, path(%p) delta_paths(%p)", path,
+                delta_paths);
+        return (MY_RC_E_EINVAL);
+    }
+
+    compact.states = id_map_new(0);
+    tmp_path = malloc(strlen(path) + 5);
+    if ((NULL == compact.states) || (NULL == tmp_path)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    if (NULL != base_path) {
+        rc = checkpoint_foreach(base_path, checkpoint_compact_record,
+                                &compact);
+    }
+    for (i = 0; (i < num_deltas) && my_rc_e_is_ok(rc) &&
+         my_rc_e_is_ok(compact.rc); i++) {
+        rc = checkpoint_foreach(delta_paths[i], checkpoint_compact_record,
+                                &compact);
+    }
+    if (my_rc_e_is_ok(rc)) {
+        rc = compact.rc;
+    }
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    compact.file = checkpoint_create(path, tmp_path);
+    if (NULL == compact.file) {
+        rc = MY_RC_E_EIO;
+        goto exit;
+    }
+    id_map_foreach(compact.states, checkpoint_compact_write, &compact);
+    rc = checkpoint_finish(compact.file, tmp_path, path, compact.rc);
+
+exit:
+
+    if (NULL != compact.states) {
+        id_map_foreach(compact.states, checkpoint_compact_free, NULL);
+        id_map_delete(compact.states);
+    }
+    free(tmp_path);
+
+    return (rc);
+}
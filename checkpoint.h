@@ -0,0 +1,130 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for incremental checkpoints.  While tracking is
+ * started, objects as they are constructed are tracked, and every public
+ * mutation marks the object dirty.  A checkpoint writes only the objects
+ * dirtied and the objects deleted since the previous checkpoint, so its cost
+ * follows the write rate rather than the number of objects.  Checkpoints are
+ * deltas which can be merged into a base checkpoint by compaction.
+ *
+ * Objects constructed before tracking started can be tracked explicitly.  A
+ * tracked object stops being tracked when it is deleted or put in a recycle bin
+ * or object pool, which the next checkpoint records as a deletion.
+ */
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include "common.h"
+#include "base1.h"
+
+/** Most objects which may be tracked at once */
+#define CHECKPOINT_MAX_OBJECTS (1u << 22)
+
+/** Statistics of a checkpoint */
+typedef struct checkpoint_write_stats_st_ {
+    /** Objects written because they were dirty */
+    size_t objects;
+    /** Deletions written */
+    size_t deletions;
+    /** Pages of tracked objects with a dirty object, the only ones scanned */
+    size_t dirty_pages;
+    /** Bytes written */
+    size_t bytes;
+} checkpoint_write_stats_st;
+
+/**
+ * Function called for each record of a checkpoint.  The data is the object's
+ * state in the format of class_registry_export(), or NULL with a length of
+ * zero for a deletion.
+ */
+typedef void
+(*checkpoint_foreach_fn)(uint64_t object_id, const uint8_t *data, size_t len,
+                         void *ctx);
+
+/** Indicates whether tracking is started.  Use checkpoint_is_enabled(). */
+extern bool checkpoint_active;
+
+/**
+ * Indicates whether new objects should be tracked.  This is inline since it
+ * is checked on every construction and mutation.
+ *
+ * @return true if tracking is started.
+ */
+static inline bool
+checkpoint_is_enabled (void)
+{
+    return (__atomic_load_n(&checkpoint_active, __ATOMIC_RELAXED));
+}
+
+/**
+ * Track a new object if tracking is started.  The argument is only evaluated
+ * when tracking is enabled.
+ */
+#define CHECKPOINT_TRACK(base1_h) \
+do { \
+    if (checkpoint_is_enabled()) { \
+        (void) checkpoint_track(base1_h); \
+    } \
+} while (0)
+
+/**
+ * Mark a mutated object dirty if tracking is started.  The argument is only
+ * evaluated when tracking is enabled.
+ */
+#define CHECKPOINT_MARK_DIRTY(base1_h) \
+do { \
+    if (checkpoint_is_enabled()) { \
+        checkpoint_mark_dirty(base1_h); \
+    } \
+} while (0)
+
+/* APIs below are documented in their implementation file */
+
+extern void
+checkpoint_start(void);
+
+extern void
+checkpoint_stop(void);
+
+extern my_rc_e
+checkpoint_track(base1_handle base1_h);
+
+extern void
+checkpoint_untrack(base1_handle base1_h);
+
+extern void
+checkpoint_mark_dirty(base1_handle base1_h);
+
+extern size_t
+checkpoint_count(void);
+
+extern my_rc_e
+checkpoint_write(const char *path, checkpoint_write_stats_st *stats);
+
+extern my_rc_e
+checkpoint_compact(const char *base_path, const char *const *delta_paths,
+                   size_t num_deltas, const char *path);
+
+extern my_rc_e
+checkpoint_foreach(const char *path, checkpoint_foreach_fn fn, void *ctx);
+
+#endif
@@ -0,0 +1,781 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements the class metadata registry.
+ *
+ * Classes register on first use of the registry.  When a class registers, the
+ * fields of its parents are flattened into its own field table with their
+ * offsets adjusted, so generic code sees every field of a class in one table.
+ * Since a class's state is embedded whole in its descendants, a field is at a
+ * fixed offset from the base1 view of every object declaring it, which lets
+ * column extraction of base1 fields run as a plain strided loop without any
+ * virtual calls.
+ */
+#include <pthread.h>
+#include "class_registry.h"
+#include "base1_friend.h"
+#include "base2_friend.h"
+#include "derived1_friend.h"
+#include "derived2.h"
+#include "aggregate.h"
+
+/** Registered state of a class */
+typedef struct class_registry_entry_st_ {
+    /** The description registered by the class */
+    const class_desc_st *desc;
+    /** Number of fields, including inherited fields */
+    size_t num_fields;
+    /** All fields, with offsets from the start of an object of the class */
+    class_field_st fields[CLASS_MAX_FIELDS];
+} class_registry_entry_st;
+
+/**
+ * String representations of the fields.
+ *
+ * @see my_field_e
+ */
+static const char * const my_field_e_string[] = {
+    "Invalid field",
+    "base1.val1",
+    "base1.val2",
+    "base1.val3",
+    "base2.val1",
+    "derived1.val4",
+    "Max field"
+};
+
+/** @cond doxygen_suppress */
+/* Ensure there is a string for each field declared */
+CT_ASSERT(NELEMS(my_field_e_string) == (MY_FIELD_E_MAX + 1));
+/** @endcond */
+
+/** The registered classes, indexed by class ID */
+static class_registry_entry_st class_registry[MY_CLASS_ID_E_MAX];
+
+/** Ensures classes are registered exactly once */
+static pthread_once_t class_registry_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Get a string representation of the field.
+ *
+ * @param field The field
+ * @return A string representation of the field or "__Invalid__" if an invalid
+ * field is input.
+ */
+const char *
+my_field_e_get_string (my_field_e field)
+{
+    const char *retval = "__Invalid__";
+
+    if ((field >= MY_FIELD_E_INVALID) && (field <= MY_FIELD_E_MAX)) {
+        retval = my_field_e_string[field];
+    }
+
+    return (retval);
+}
+
+/**
+ * Register all classes, parents before children.
+ */
+static void
+class_registry_init (void)
+{
+    my_rc_e rc;
+
+    rc = base1_register_class();
+    if (my_rc_e_is_ok(rc)) {
+        rc = base2_register_class();
+    }
+    if (my_rc_e_is_ok(rc)) {
+        rc = derived1_register_class();
+    }
+    if (my_rc_e_is_ok(rc)) {
+        rc = derived2_register_class();
+    }
+
+    if (my_rc_e_is_notok(rc)) {
+        LOG_ERR("Class registration failed, rc(%s)", my_rc_e_get_string(rc));
+    }
+}
+
+/**
+ * Get the registered state of a class.
+ *
+ * @param class_id The class
+ * @return The state or NULL if the class is not registered.
+ */
+static const class_registry_entry_st *
+class_registry_entry (my_class_id_e class_id)
+{
+    pthread_once(&class_registry_once, class_registry_init);
+
+    if (!my_class_id_e_is_valid(class_id) ||
+        (NULL == class_registry[class_id].desc)) {
+        return (NULL);
+    }
+
+    return (&class_registry[class_id]);
+}
+
+/**
+ * Register a class.  This is called by each class's register function when
+ * the registry is first used; parents must be registered before children.
+ *
+ * @param desc The description of the class, which must remain valid for the
+ * life of the process.
+ * @return Return code
+ */
+my_rc_e
+class_registry_register (const class_desc_st *desc)
+{
+    class_registry_entry_st *entry, *parent;
+    size_t i, j;
+
+    if ((NULL == desc) || !my_class_id_e_is_valid(desc->class_id) ||
+        (desc->num_parents > CLASS_MAX_PARENTS)) {
+        LOG_ERR("Invalid input, desc(%p)", desc);
+        return (MY_RC_E_EINVAL);
+    }
+
+    entry = &class_registry[desc->class_id];
+    if (NULL != entry->desc) {
+        LOG_ERR("Class already registered, class(%s)",
+                my_class_id_e_get_string(desc->class_id));
+        return (MY_RC_E_EINVAL);
+    }
+    entry->num_fields = 0;
+
+    for (i = 0; i < desc->num_parents; i++) {
+        if (!my_class_id_e_is_valid(desc->parents[i]) ||
+            (NULL == class_registry[desc->parents[i]].desc)) {
+            LOG_ERR("Parent not registered, class(%s) parent(%s)",
+                    my_class_id_e_get_string(desc->class_id),
+                    my_class_id_e_get_string(desc->parents[i]));
+            return (MY_RC_E_EINVAL);
+        }
+
+        parent = &class_registry[desc->parents[i]];
+        for (j = 0; j < parent->num_fields; j++) {
+            if (entry->num_fields >= CLASS_MAX_FIELDS) {
+                return (MY_RC_E_ENOMEM);
+            }
+            entry->fields[entry->num_fields] = parent->fields[j];
+            entry->fields[entry->num_fields].offset += desc->parent_offsets[i];
+            entry->num_fields++;
+        }
+    }
+
+    for (i = 0; i < desc->num_fields; i++) {
+        if (entry->num_fields >= CLASS_MAX_FIELDS) {
+            return (MY_RC_E_ENOMEM);
+        }
+        entry->fields[entry->num_fields++] = desc->fields[i];
+    }
+
+    entry->desc = desc;
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Get the description of a class.
+ *
+ * @param class_id The class
+ * @return The description or NULL if the class is not registered.
+ */
+const class_desc_st *
+class_registry_get (my_class_id_e class_id)
+{
+    const class_registry_entry_st *entry = class_registry_entry(class_id);
+
+    return ((NULL == entry) ? NULL : entry->desc);
+}
+
+/**
+ * Get all fields of a class, including inherited fields.
+ *
+ * @param class_id The class
+ * @param fields Outputs the fields, with offsets from the start of an object of
+ * the class.
+ * @return The number of fields, zero if the class is not registered.
+ */
+size_t
+class_registry_get_fields (my_class_id_e class_id,
+                           const class_field_st **fields)
+{
+    const class_registry_entry_st *entry = class_registry_entry(class_id);
+
+    if ((NULL == entry) || (NULL == fields)) {
+        return (0);
+    }
+
+    *fields = entry->fields;
+
+    return (entry->num_fields);
+}
+
+/**
+ * Find a field of a class by name.  Inherited fields are searched too.
+ *
+ * @param class_id The class
+ * @param name Name of the field
+ * @return The field or NULL if not found.
+ */
+const class_field_st *
+class_registry_find_field (my_class_id_e class_id, const char *name)
+{
+    const class_registry_entry_st *entry = class_registry_entry(class_id);
+    size_t i;
+
+    if ((NULL == entry) || (NULL == name)) {
+        return (NULL);
+    }
+
+    for (i = 0; i < entry->num_fields; i++) {
+        if (0 == strcmp(entry->fields[i].name, name)) {
+            return (&entry->fields[i]);
+        }
+    }
+
+    return (NULL);
+}
+
+/**
+ * Get the offset of an ancestor's state (i.e., the view of the object through
+ * the ancestor's handle) within an object of a class.
+ *
+ * @param class_id The class of the object
+ * @param view_id The ancestor class, which may be the class itself
+ * @param offset Outputs the offset
+ * @return Return code, MY_RC_E_EINVAL if view_id is not an ancestor.
+ */
+my_rc_e
+class_registry_view_offset (my_class_id_e class_id, my_class_id_e view_id,
+                            size_t *offset)
+{
+    const class_registry_entry_st *entry = class_registry_entry(class_id);
+    size_t i;
+
+    if ((NULL == entry) || (NULL == offset)) {
+        return (MY_RC_E_EINVAL);
+    }
+
+    if (class_id == view_id) {
+        *offset = 0;
+        return (MY_RC_E_SUCCESS);
+    }
+
+    for (i = 0; i < entry->desc->num_parents; i++) {
+        if (my_rc_e_is_ok(class_registry_view_offset(entry->desc->parents[i],
+                                                     view_id, offset))) {
+            *offset += entry->desc->parent_offsets[i];
+            return (MY_RC_E_SUCCESS);
+        }
+    }
+
+    return (MY_RC_E_EINVAL);
+}
+
+/**
+ * Find the offset and width of a field relative to the base1 view of an object
+ * of a class.  Code reading a field from many objects looks this up once per
+ * class rather than once per object.
+ *
+ * @param class_id The class of the object
+ * @param field The field
+ * @param offset Outputs the offset from the base1 view, which may be negative
+ * @param width Outputs the width of the field
+ * @return Return code, MY_RC_E_EINVAL if the class does not have the field.
+ */
+my_rc_e
+class_registry_base1_field_offset (my_class_id_e class_id, my_field_e field,
+                                   ptrdiff_t *offset, size_t *width)
+{
+    const class_registry_entry_st *entry = class_registry_entry(class_id);
+    size_t i, base1_offset;
+    my_rc_e rc;
+
+    if (NULL == entry) {
+        return (MY_RC_E_EINVAL);
+    }
+
+    rc = class_registry_view_offset(class_id, MY_CLASS_ID_E_BASE1,
+                                    &base1_offset);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+
+    for (i = 0; i < entry->num_fields; i++) {
+        if (field == entry->fields[i].field) {
+            *offset = (ptrdiff_t) entry->fields[i].offset -
+                (ptrdiff_t) base1_offset;
+            *width = entry->fields[i].width;
+            return (MY_RC_E_SUCCESS);
+        }
+    }
+
+    return (MY_RC_E_EINVAL);
+}
+
+/**
+ * Load an unsigned field of the given width.
+ *
+ * @param ptr The field
+ * @param width The width of the field
+ * @return The value
+ */
+static uint64_t
+class_registry_load (const uint8_t *ptr, size_t width)
+{
+    uint16_t val16;
+    uint32_t val32;
+    uint64_t val64;
+
+    switch (width) {
+    case 1:
+        return (*ptr);
+    case 2:
+        memcpy(&val16, ptr, sizeof(val16));
+        return (val16);
+    case 4:
+        memcpy(&val32, ptr, sizeof(val32));
+        return (val32);
+    default:
+        memcpy(&val64, ptr, sizeof(val64));
+        return (val64);
+    }
+}
+
+/**
+ * Get the value of a field of any object by its field ID.
+ *
+ * @param base1_h The object
+ * @param field The field
+ * @param value Outputs the value
+ * @return Return code, MY_RC_E_EINVAL if the object does not have the field.
+ */
+my_rc_e
+class_registry_get_field (base1_handle base1_h, my_field_e field,
+                          uint64_t *value)
+{
+    ptrdiff_t offset;
+    size_t width;
+    my_rc_e rc;
+
+    if ((NULL == base1_h) || (NULL == value)) {
+        LOG_ERR("Invalid input, base1_h(%p) value(%p)", base1_h, value);
+        return (MY_RC_E_EINVAL);
+    }
+
+    rc = class_registry_base1_field_offset(base1_class_id(base1_h), field,
+                                           &offset, &width);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+
+    *value = class_registry_load((const uint8_t *) base1_h + offset, width);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Store an unsigned field of the given width.
+ *
+ * @param ptr The field
+ * @param width The width of the field
+ * @param value The value, truncated to the width
+ */
+static void
+class_registry_store (uint8_t *ptr, size_t width, uint64_t value)
+{
+    uint16_t val16 = value;
+    uint32_t val32 = value;
+
+    switch (width) {
+    case 1:
+        *ptr = value;
+        break;
+    case 2:
+        memcpy(ptr, &val16, sizeof(val16));
+        break;
+    case 4:
+        memcpy(ptr, &val32, sizeof(val32));
+        break;
+    default:
+        memcpy(ptr, &value, sizeof(value));
+        break;
+    }
+}
+
+/**
+ * Set the value of a field of any object by its field ID.  This bypasses the
+ * object's methods, so it is meant for restoring saved state (e.g., during
+ * recovery), not for normal mutation.
+ *
+ * @param base1_h The object
+ * @param field The field
+ * @param value The value, truncated to the width of the field
+ * @return Return code, MY_RC_E_EINVAL if the object does not have the field.
+ * @see class_registry_get_field()
+ */
+my_rc_e
+class_registry_set_field (base1_handle base1_h, my_field_e field,
+                          uint64_t value)
+{
+    uint64_t old_value;
+    ptrdiff_t offset;
+    size_t width;
+    my_rc_e rc;
+
+    if (NULL == base1_h) {
+        LOG_ERR("Invalid input, base1_h(%p)", base1_h);
+        return (MY_RC_E_EINVAL);
+    }
+    if (base1_is_read_only(base1_h)) {
+        LOG_ERR("Object is read-only, base1_h(%p)", base1_h);
+        return (MY_RC_E_EINVAL);
+    }
+
+    rc = class_registry_base1_field_offset(base1_class_id(base1_h), field,
+                                           &offset, &width);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+
+    old_value = class_registry_load((uint8_t *) base1_h + offset, width);
+    class_registry_store((uint8_t *) base1_h + offset, width, value);
+    AGGREGATE_UPDATE(base1_h, field, old_value,
+                     class_registry_load((uint8_t *) base1_h + offset, width));
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Strided loop loading a field of the given type from every object.
+ */
+#define CLASS_REGISTRY_COLUMN_LOOP(type, handles, count, offset, values) \
+do { \
+    size_t i_; \
+    type val_; \
+\
+    for (i_ = 0; i_ < (count); i_++) { \
+        memcpy(&val_, (const uint8_t *) (handles)[i_] + (offset), \
+               sizeof(val_)); \
+        (values)[i_] = val_; \
+    } \
+} while (0)
+
+/**
+ * Extract the values of a field from an array of objects into a column.  For
+ * fields of base1, which are at a fixed offset from the base1 view of every
+ * object, this is a single strided loop with no virtual calls.  For fields of
+ * other classes, the class of each object must be checked, but the offset is
+ * still looked up once per class rather than once per object.
+ *
+ * @param field The field
+ * @param handles The objects
+ * @param count Number of objects
+ * @param values Outputs the value for each object
+ * @return Return code, MY_RC_E_EINVAL if any object does not have the field.
+ */
+my_rc_e
+class_registry_extract_column (my_field_e field, const base1_handle *handles,
+                               size_t count, uint64_t *values)
+{
+    ptrdiff_t offsets[MY_CLASS_ID_E_MAX];
+    size_t widths[MY_CLASS_ID_E_MAX];
+    bool has_field[MY_CLASS_ID_E_MAX];
+    my_class_id_e class_id;
+    size_t i;
+
+    if ((NULL == handles) || (NULL == values) ||
+        (field <= MY_FIELD_E_INVALID) || (field >= MY_FIELD_E_MAX)) {
+        LOG_ERR("Invalid input, field(%u) handles(%p) values(%p)", field,
+                handles, values);
+        return (MY_RC_E_EINVAL);
+    }
+
+    for (class_id = 0; class_id < MY_CLASS_ID_E_MAX; class_id++) {
+        has_field[class_id] = my_rc_e_is_ok(class_registry_base1_field_offset(
+            class_id, field, &offsets[class_id], &widths[class_id]));
+    }
+
+    if (has_field[MY_CLASS_ID_E_BASE1]) {
+        switch (widths[MY_CLASS_ID_E_BASE1]) {
+        case 1:
+            CLASS_REGISTRY_COLUMN_LOOP(uint8_t, handles, count,
+                                       offsets[MY_CLASS_ID_E_BASE1], values);
+            break;
+        case 2:
+            CLASS_REGISTRY_COLUMN_LOOP(uint16_t, handles, count,
+                                       offsets[MY_CLASS_ID_E_BASE1], values);
+            break;
+        case 4:
+            CLASS_REGISTRY_COLUMN_LOOP(uint32_t, handles, count,
+                                       offsets[MY_CLASS_ID_E_BASE1], values);
+            break;
+        default:
+            CLASS_REGISTRY_COLUMN_LOOP(uint64_t, handles, count,
+                                       offsets[MY_CLASS_ID_E_BASE1], values);
+            break;
+        }
+
+        return (MY_RC_E_SUCCESS);
+    }
+
+    for (i = 0; i < count; i++) {
+        class_id = base1_class_id(handles[i]);
+        if (!my_class_id_e_is_valid(class_id) || !has_field[class_id]) {
+            LOG_ERR("Object does not have field, handle(%p) field(%s)",
+                    handles[i], my_field_e_get_string(field));
+            return (MY_RC_E_EINVAL);
+        }
+
+        values[i] = class_registry_load((const uint8_t *) handles[i] +
+                                        offsets[class_id], widths[class_id]);
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Construct an object of any class in its default state, e.g. to load saved
+ * objects.  Saved object IDs should be reserved afterwards.
+ *
+ * @param class_id The class
+ * @param allocator The allocator or NULL for the default allocator.
+ * @param object_id The object's saved ID, or zero to give it a new ID
+ * @return The object or NULL if the class is abstract or creation failed
+ * @see my_object_id_reserve()
+ */
+base1_handle
+class_registry_new (my_class_id_e class_id, const allocator_st *allocator,
+                    uint64_t object_id)
+{
+    const class_registry_entry_st *entry;
+    derived1_handle derived1_h;
+    base1_handle base1_h;
+
+    entry = class_registry_entry(class_id);
+    if ((NULL == entry) || (NULL == entry->desc->new_fn)) {
+        LOG_ERR("Class cannot be constructed, class_id(%u)", class_id);
+        return (NULL);
+    }
+
+    base1_h = entry->desc->new_fn(allocator);
+    if ((NULL == base1_h) || (0 == object_id)) {
+        return (base1_h);
+    }
+
+    /* Every view of the object shares its ID */
+    derived1_h = base1_try_cast_to_derived1(base1_h);
+    if (NULL != derived1_h) {
+        derived1_restore_object_id(derived1_h, object_id);
+    } else {
+        base1_restore_object_id(base1_h, object_id);
+    }
+
+    return (base1_h);
+}
+
+/**
+ * Import the state of an object from one object exported by
+ * class_registry_export().  This bypasses the object's methods, so it is
+ * meant for restoring saved state.
+ *
+ * @param base1_h The object, which must be of the exported object's class
+ * @param buffer The exported object
+ * @param buffer_size Size of the buffer, which may hold more objects
+ * @param used Outputs the number of bytes read
+ * @return Return code, MY_RC_E_EINVAL if the class does not match or the
+ * buffer is too small.
+ * @see class_registry_export()
+ */
+my_rc_e
+class_registry_import (base1_handle base1_h, const uint8_t *buffer,
+                       size_t buffer_size, size_t *used)
+{
+    const class_registry_entry_st *entry;
+    size_t i, k, base1_offset, len = 1;
+    my_class_id_e class_id;
+    bool aggregated;
+    uint8_t *obj;
+    uint64_t value;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if ((NULL == base1_h) || (NULL == buffer) || (NULL == used) ||
+        (0 == buffer_size)) {
+        LOG_ERR("Invalid input, base1_h(%p) buffer(%p) used(%p)", base1_h,
+                buffer, used);
+        return (MY_RC_E_EINVAL);
+    }
+
+    class_id = base1_class_id(base1_h);
+    entry = class_registry_entry(class_id);
+    if ((NULL == entry) || (buffer[0] != class_id) ||
+        my_rc_e_is_notok(class_registry_view_offset(class_id,
+                                                    MY_CLASS_ID_E_BASE1,
+                                                    &base1_offset))) {
+        return (MY_RC_E_EINVAL);
+    }
+    obj = (uint8_t *) base1_h - base1_offset;
+
+    /* Every field may change, so count the object again afterwards */
+    aggregated = aggregate_is_enabled() && aggregate_remove(base1_h);
+    for (i = 0; i < entry->num_fields; i++) {
+        if ((len + entry->fields[i].width) > buffer_size) {
+            rc = MY_RC_E_EINVAL;
+            break;
+        }
+        value = 0;
+        for (k = 0; k < entry->fields[i].width; k++, len++) {
+            value |= (uint64_t) buffer[len] << (8 * k);
+        }
+        class_registry_store(obj + entry->fields[i].offset,
+                             entry->fields[i].width, value);
+    }
+    if (aggregated) {
+        aggregate_add(base1_h);
+    }
+    if (my_rc_e_is_ok(rc)) {
+        *used = len;
+    }
+
+    return (rc);
+}
+
+/**
+ * Export objects of any class into a compact binary buffer.  Each object is
+ * written as its class ID byte followed by each of its fields, in the order
+ * given by class_registry_get_fields(), as little endian values of the field's
+ * width.
+ *
+ * @param handles The objects
+ * @param count Number of objects
+ * @param buffer The buffer to export into
+ * @param buffer_size Size of the buffer
+ * @param used Outputs the number of bytes written, or the number of bytes
+ * needed if the buffer is too small.
+ * @return Return code, MY_RC_E_ENOMEM if the buffer is too small.
+ */
+my_rc_e
+class_registry_export (const base1_handle *handles, size_t count,
+                       uint8_t *buffer, size_t buffer_size, size_t *used)
+{
+    const class_registry_entry_st *entry;
+    const uint8_t *obj;
+    size_t i, j, k, base1_offset, len = 0;
+    uint64_t value;
+    my_class_id_e class_id;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if ((NULL == handles) || (NULL == used) ||
+        ((NULL == buffer) && (0 != buffer_size))) {
+        LOG_ERR("Invalid input, handles(%p) buffer(%p) used(%p)", handles,
+                buffer, used);
+        return (MY_RC_E_EINVAL);
+    }
+
+    for (i = 0; i < count; i++) {
+        class_id = base1_class_id(handles[i]);
+        entry = class_registry_entry(class_id);
+        if ((NULL == entry) ||
+            my_rc_e_is_notok(class_registry_view_offset(class_id,
+                                                        MY_CLASS_ID_E_BASE1,
+                                                        &base1_offset))) {
+            return (MY_RC_E_EINVAL);
+        }
+        obj = (const uint8_t *) handles[i] - base1_offset;
+
+        if (len < buffer_size) {
+            buffer[len] = class_id;
+        }
+        len++;
+
+        for (j = 0; j < entry->num_fields; j++) {
+            value = class_registry_load(obj + entry->fields[j].offset,
+                                        entry->fields[j].width);
+            for (k = 0; k < entry->fields[j].width; k++, len++) {
+                if (len < buffer_size) {
+                    buffer[len] = (value >> (8 * k)) & 0xff;
+                }
+            }
+        }
+    }
+
+    if (len > buffer_size) {
+        rc = MY_RC_E_ENOMEM;
+    }
+    *used = len;
+
+    return (rc);
+}
+
+/**
+ * Get a generic string representation of any object, listing each field by
+ * name.
+ *
+ * @param base1_h The object
+ * @param buffer The buffer in which to put the string.
+ * @param buffer_size The size of the buffer.
+ * @return Return code
+ */
+my_rc_e
+class_registry_dump (base1_handle base1_h, char *buffer, size_t buffer_size)
+{
+    const class_registry_entry_st *entry;
+    const uint8_t *obj;
+    size_t i, base1_offset;
+    int len;
+    my_class_id_e class_id;
+
+    if ((NULL == base1_h) || (NULL == buffer) || (0 == buffer_size)) {
+        LOG_ERR("Invalid input, base1_h(%p) buffer(%p) buffer_size(%zu)",
+                base1_h, buffer, buffer_size);
+        return (MY_RC_E_EINVAL);
+    }
+
+    class_id = base1_class_id(base1_h);
+    entry = class_registry_entry(class_id);
+    if ((NULL == entry) ||
+        my_rc_e_is_notok(class_registry_view_offset(class_id,
+                                                    MY_CLASS_ID_E_BASE1,
+                                                    &base1_offset))) {
+        return (MY_RC_E_EINVAL);
+    }
+    obj = (const uint8_t *) base1_h - base1_offset;
+
+    len = snprintf(buffer, buffer_size, "%s:", entry->desc->name);
+    for (i = 0; (i < entry->num_fields) && (len >= 0) &&
+         ((size_t) len < buffer_size); i++) {
+        len += snprintf(buffer + len, buffer_size - len, " %s(%" PRIu64 ")",
+                        my_field_e_get_string(entry->fields[i].field),
+                        class_registry_load(obj + entry->fields[i].offset,
+                                            entry->fields[i].width));
+    }
+
+    if ((len < 0) || ((size_t) len >= buffer_size)) {
+        LOG_ERR("Invalid input, buffer_size(%zu)", buffer_size);
+        return (MY_RC_E_EINVAL);
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
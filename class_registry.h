@@ -0,0 +1,186 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for the class metadata registry.  Each class
+ * describes its name, parents, size, fields and virtual methods once, and
+ * generic code (e.g., serializers, dumps and column extraction) works from
+ * these descriptions instead of hand written per-class code.
+ */
+#ifndef __CLASS_REGISTRY_H__
+#define __CLASS_REGISTRY_H__
+
+#include "common.h"
+#include "base1.h"
+
+/** Most parents a class may have */
+#define CLASS_MAX_PARENTS 2
+
+/** Most fields a class may have, including inherited fields */
+#define CLASS_MAX_FIELDS 16
+
+/**
+ * IDs of the data fields of all classes.  Inherited fields keep the ID of the
+ * class that declares them.
+ */
+typedef enum my_field_e_ {
+    /** Invalid field, should never be used */
+    MY_FIELD_E_INVALID,
+    /** base1 public_data.val1 */
+    MY_FIELD_E_BASE1_VAL1,
+    /** base1 public_data.val2 */
+    MY_FIELD_E_BASE1_VAL2,
+    /** base1 val3 */
+    MY_FIELD_E_BASE1_VAL3,
+    /** base2 val1 */
+    MY_FIELD_E_BASE2_VAL1,
+    /** derived1 val4 */
+    MY_FIELD_E_DERIVED1_VAL4,
+    /** Max field for bounds testing */
+    MY_FIELD_E_MAX,
+} my_field_e;
+
+/**
+ * Initializer for a class_field_st describing a member of the struct type.
+ */
+#define CLASS_FIELD(field_id, name, owner, type, member) \
+    { field_id, name, owner, offsetof(type, member), \
+      sizeof(((type *) 0)->member) }
+
+/**
+ * Initializer for a class_method_st describing a member of the vtable type.
+ */
+#define CLASS_METHOD(name, vtable_type, member) \
+    { name, offsetof(vtable_type, member) }
+
+/**
+ * Constructor of an object of a class in its default state.  The allocator is
+ * NULL for the default allocator.
+ */
+typedef base1_handle
+(*class_new_fn)(const allocator_st *allocator);
+
+/** Description of a data field */
+typedef struct class_field_st_ {
+    /** ID of the field */
+    my_field_e field;
+    /** Name of the field */
+    const char *name;
+    /** Class declaring the field */
+    my_class_id_e owner;
+    /** Offset of the field from the start of an object of the class being
+     *  described */
+    size_t offset;
+    /** Size of the field in bytes, which is 1, 2, 4 or 8 */
+    size_t width;
+} class_field_st;
+
+/** Description of a virtual method */
+typedef struct class_method_st_ {
+    /** Name of the method */
+    const char *name;
+    /** Offset of the function pointer within the class's vtable */
+    size_t vtable_offset;
+} class_method_st;
+
+/** Description of a class */
+typedef struct class_desc_st_ {
+    /** ID of the class */
+    my_class_id_e class_id;
+    /** Name of the class */
+    const char *name;
+    /** Number of parents */
+    size_t num_parents;
+    /** The parent classes */
+    my_class_id_e parents[CLASS_MAX_PARENTS];
+    /** Offset of each parent's state within an object of the class */
+    size_t parent_offsets[CLASS_MAX_PARENTS];
+    /** Size of an object of the class */
+    size_t size;
+    /** Size of the class's vtable, or zero if it only overrides its parents'
+     *  vtables */
+    size_t vtable_size;
+    /** Number of fields declared by the class itself */
+    size_t num_fields;
+    /** Fields declared by the class itself, offsets are from the start of an
+     *  object of the class */
+    const class_field_st *fields;
+    /** Number of virtual methods declared by the class itself */
+    size_t num_methods;
+    /** Virtual methods declared by the class itself */
+    const class_method_st *methods;
+    /** Constructor, or NULL if the class is abstract */
+    class_new_fn new_fn;
+} class_desc_st;
+
+/* APIs below are documented in their implementation file */
+
+extern const char *
+my_field_e_get_string(my_field_e field);
+
+extern my_rc_e
+class_registry_register(const class_desc_st *desc);
+
+extern const class_desc_st *
+class_registry_get(my_class_id_e class_id);
+
+extern size_t
+class_registry_get_fields(my_class_id_e class_id,
+                          const class_field_st **fields);
+
+extern const class_field_st *
+class_registry_find_field(my_class_id_e class_id, const char *name);
+
+extern my_rc_e
+class_registry_view_offset(my_class_id_e class_id, my_class_id_e view_id,
+                           size_t *offset);
+
+extern my_rc_e
+class_registry_base1_field_offset(my_class_id_e class_id, my_field_e field,
+                                  ptrdiff_t *offset, size_t *width);
+
+extern my_rc_e
+class_registry_get_field(base1_handle base1_h, my_field_e field,
+                         uint64_t *value);
+
+extern my_rc_e
+class_registry_set_field(base1_handle base1_h, my_field_e field,
+                         uint64_t value);
+
+extern my_rc_e
+class_registry_extract_column(my_field_e field, const base1_handle *handles,
+                              size_t count, uint64_t *values);
+
+extern base1_handle
+class_registry_new(my_class_id_e class_id, const allocator_st *allocator,
+                   uint64_t object_id);
+
+extern my_rc_e
+class_registry_import(base1_handle base1_h, const uint8_t *buffer,
+                      size_t buffer_size, size_t *used);
+
+extern my_rc_e
+class_registry_export(const base1_handle *handles, size_t count,
+                      uint8_t *buffer, size_t buffer_size, size_t *used);
+
+extern my_rc_e
+class_registry_dump(base1_handle base1_h, char *buffer, size_t buffer_size);
+
+#endif
@@ -23,6 +23,21 @@
  */
 #include "common.h"
 
+/**
+ * Number of object IDs a thread reserves from the global counter at a time, so
+ * constructors running on many threads do not all contend on one cache line.
+ */
+#define MY_OBJECT_ID_BLOCK 256
+
+/** The first object ID of the next block to hand out.  Zero is never used. */
+static uint64_t my_object_id_next_block = 1;
+
+/** The next object ID to hand out from this thread's reserved block */
+static __thread uint64_t my_object_id_cur;
+
+/** One past the last object ID in this thread's reserved block */
+static __thread uint64_t my_object_id_end;
+
 /**
  * String representations of the return codes.
  *
@@ -33,6 +48,8 @@ static const char * const my_rc_e_string[] = {
     "Success",
     "Invalid input",
     "No memory",
+    "I/O error",
+    "Try again",
     "Max RC"
 };
 
@@ -41,6 +58,51 @@ static const char * const my_rc_e_string[] = {
 CT_ASSERT(NELEMS(my_rc_e_string) == (MY_RC_E_MAX + 1));
 /** @endcond */
 
+/**
+ * String representations of the class IDs.
+ *
+ * @see my_class_id_e
+ */
+static const char * const my_class_id_e_string[] = {
+    "Invalid class",
+    "base1",
+    "base2",
+    "derived1",
+    "derived2",
+    "Max class"
+};
+
+/** Bit for a class ID in a mask of classes */
+#define MY_CLASS_ID_BIT(class_id) (1U << (class_id))
+
+/**
+ * For each class, a mask with the bits set for the class itself and all of its
+ * ancestors, so checking whether an object is a given class is a single load.
+ * This must be updated when a class is added.
+ *
+ * @see my_class_id_e_is_a()
+ */
+static const uint32_t my_class_id_e_ancestors[] = {
+    0,
+    MY_CLASS_ID_BIT(MY_CLASS_ID_E_BASE1),
+    MY_CLASS_ID_BIT(MY_CLASS_ID_E_BASE2),
+    MY_CLASS_ID_BIT(MY_CLASS_ID_E_DERIVED1) |
+        MY_CLASS_ID_BIT(MY_CLASS_ID_E_BASE1) |
+        MY_CLASS_ID_BIT(MY_CLASS_ID_E_BASE2),
+    MY_CLASS_ID_BIT(MY_CLASS_ID_E_DERIVED2) |
+        MY_CLASS_ID_BIT(MY_CLASS_ID_E_DERIVED1) |
+        MY_CLASS_ID_BIT(MY_CLASS_ID_E_BASE1) |
+        MY_CLASS_ID_BIT(MY_CLASS_ID_E_BASE2),
+    0
+};
+
+/** @cond doxygen_suppress */
+/* Ensure there is a string and ancestor mask for each class declared */
+CT_ASSERT(NELEMS(my_class_id_e_string) == (MY_CLASS_ID_E_MAX + 1));
+CT_ASSERT(NELEMS(my_class_id_e_ancestors) == (MY_CLASS_ID_E_MAX + 1));
+CT_ASSERT(MY_CLASS_ID_E_MAX <= 32);
+/** @endcond */
+
 /**
  * Indicates whether the return code is not in error.
  *
@@ -95,3 +157,125 @@ my_rc_e_get_string (my_rc_e rc)
 
     return (retval);
 }
+
+/**
+ * Indicates whether the class ID is valid.
+ *
+ * @param class_id The class ID to check
+ * @return true if the class ID is valid.
+ */
+bool
+my_class_id_e_is_valid (my_class_id_e class_id)
+{
+    return ((class_id > MY_CLASS_ID_E_INVALID) &&
+            (class_id < MY_CLASS_ID_E_MAX));
+}
+
+/**
+ * Get a string representation of the class ID.
+ *
+ * @param class_id The class ID
+ * @return The name of the class or "__Invalid__" if an invalid class ID is
+ * input.
+ */
+const char *
+my_class_id_e_get_string (my_class_id_e class_id)
+{
+    const char* retval = "__Invalid__";
+
+    if ((class_id >= MY_CLASS_ID_E_INVALID) &&
+        (class_id <= MY_CLASS_ID_E_MAX)) {
+        retval = my_class_id_e_string[class_id];
+    }
+
+    return (retval);
+}
+
+/**
+ * Indicates whether a class is the same as or inherits from another class.
+ * This is O(1) regardless of the depth of the hierarchy.
+ *
+ * @param class_id The class to check
+ * @param ancestor_id The possible ancestor class
+ * @return true if class_id is ancestor_id or one of its descendants.
+ */
+bool
+my_class_id_e_is_a (my_class_id_e class_id, my_class_id_e ancestor_id)
+{
+    if (!my_class_id_e_is_valid(class_id) ||
+        !my_class_id_e_is_valid(ancestor_id)) {
+        return (false);
+    }
+
+    return (0 != (my_class_id_e_ancestors[class_id] &
+                  MY_CLASS_ID_BIT(ancestor_id)));
+}
+
+/**
+ * Allocate an object ID which is unique for the life of the process.  IDs are
+ * handed out in per-thread blocks, so they are not dense nor ordered across
+ * threads.  Zero is never returned and can be used as an invalid ID.
+ *
+ * @return The object ID
+ */
+uint64_t
+my_object_id_alloc (void)
+{
+    if (my_object_id_cur == my_object_id_end) {
+        my_object_id_cur = __atomic_fetch_add(&my_object_id_next_block,
+                                              MY_OBJECT_ID_BLOCK,
+                                              __ATOMIC_RELAXED);
+        my_object_id_end = my_object_id_cur + MY_OBJECT_ID_BLOCK;
+    }
+
+    return (my_object_id_cur++);
+}
+
+/**
+ * Ensure object IDs allocated from now on are above an ID, e.g., one restored
+ * from saved state.  Blocks already handed to other threads are unaffected, so
+ * this should be called before other threads construct objects.
+ *
+ * @param object_id The ID
+ */
+void
+my_object_id_reserve (uint64_t object_id)
+{
+    uint64_t next_block;
+
+    next_block = __atomic_load_n(&my_object_id_next_block, __ATOMIC_RELAXED);
+    while ((next_block <= object_id) &&
+           !__atomic_compare_exchange_n(&my_object_id_next_block, &next_block,
+                                        object_id + 1, true, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+    }
+
+    /* Drop the calling thread's block if it could hand out the ID */
+    if (my_object_id_cur <= object_id) {
+        my_object_id_cur = my_object_id_end;
+    }
+}
+
+/**
+ * Indicates whether memory holds only the poison pattern written over new
+ * allocations in poison builds.
+ *
+ * @param ptr The memory
+ * @param size Number of bytes
+ * @return true if every byte is MY_POISON_BYTE.
+ * @see POISON_CHECK_FIELD()
+ */
+bool
+my_poison_is_set (const void *ptr, size_t size)
+{
+    const uint8_t *bytes = ptr;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        if (MY_POISON_BYTE != bytes[i]) {
+            return (false);
+        }
+    }
+
+    return (true);
+}
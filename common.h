@@ -26,6 +26,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -42,6 +43,12 @@
  */
 #define NELEMS(x) (sizeof(x) / sizeof(x[0]))
 
+/**
+ * Size of a cache line, used to keep data written by different threads from
+ * sharing one.
+ */
+#define MY_CACHE_LINE_SIZE 64
+
 /**
  * Display an error message.
  */
@@ -106,6 +113,29 @@ do { \
     } \
 } while (0)
 
+/** Byte pattern written over newly allocated memory in poison builds */
+#define MY_POISON_BYTE 0xa5
+
+/**
+ * In poison builds (i.e., with MY_DEBUG_POISON defined), all memory handed out
+ * by allocators is filled with MY_POISON_BYTE, and constructors use this to
+ * verify that they did not leave a field uninitialized.  A field still holding
+ * only the poison pattern is reported and the program aborted.  In other
+ * builds this is a no-op.
+ */
+#ifdef MY_DEBUG_POISON
+#define POISON_CHECK_FIELD(obj_h, field) \
+do { \
+    if (my_poison_is_set(&((obj_h)->field), sizeof((obj_h)->field))) { \
+        LOG_ERR("Uninitialized field, " #obj_h "(%p) " #field, obj_h); \
+        fflush(stdout); \
+        abort(); \
+    } \
+} while (0)
+#else
+#define POISON_CHECK_FIELD(obj_h, field) do { } while (0)
+#endif
+
 /**
  * Return codes used to indicate whether a function call was successful.
  */
@@ -118,10 +148,32 @@ typedef enum my_rc_e_ {
     MY_RC_E_EINVAL,
     /** Function failed to allocate memory */
     MY_RC_E_ENOMEM,
+    /** Function failed to read or write a file */
+    MY_RC_E_EIO,
+    /** Function lost a race with another thread and may be retried */
+    MY_RC_E_EAGAIN,
     /** Max return code for bounds testing */
     MY_RC_E_MAX,
 } my_rc_e;
 
+/**
+ * Numeric IDs for each class, used for O(1) runtime type checks.
+ */
+typedef enum my_class_id_e_ {
+    /** Invalid class ID, should never be used */
+    MY_CLASS_ID_E_INVALID,
+    /** Class base1 */
+    MY_CLASS_ID_E_BASE1,
+    /** Class base2 */
+    MY_CLASS_ID_E_BASE2,
+    /** Class derived1 */
+    MY_CLASS_ID_E_DERIVED1,
+    /** Class derived2 */
+    MY_CLASS_ID_E_DERIVED2,
+    /** Max class ID for bounds testing */
+    MY_CLASS_ID_E_MAX,
+} my_class_id_e;
+
 /* APIs below are documented in their implementation file */
 
 extern bool
@@ -136,4 +188,22 @@ my_rc_e_is_valid(my_rc_e rc);
 extern const char *
 my_rc_e_get_string(my_rc_e rc);
 
+extern bool
+my_class_id_e_is_valid(my_class_id_e class_id);
+
+extern const char *
+my_class_id_e_get_string(my_class_id_e class_id);
+
+extern bool
+my_class_id_e_is_a(my_class_id_e class_id, my_class_id_e ancestor_id);
+
+extern uint64_t
+my_object_id_alloc(void);
+
+extern void
+my_object_id_reserve(uint64_t object_id);
+
+extern bool
+my_poison_is_set(const void *ptr, size_t size);
+
 #endif
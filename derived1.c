@@ -22,6 +22,13 @@
  * This is the implements a class that inherits from base1 and base2.
  */
 #include "derived1_friend.h"
+#include "trace.h"
+#include "class_registry.h"
+#include "recycle.h"
+#include "journal.h"
+#include "wal.h"
+#include "checkpoint.h"
+#include "aggregate.h"
 
 /** Size for this object to use for base1_string_size_fn */
 #define DERIVED1_STR_SIZE 256
@@ -33,6 +40,8 @@
 typedef struct derived1_private_st_ {
     /** Virtual function table */
     const derived1_vtable_st *vtable;
+    /** Allocator the object and this block were allocated from */
+    const allocator_st *allocator;
 } derived1_private_st;
 
 /*
@@ -93,7 +102,7 @@ derived1_base2_increase_val1 (base2_handle base2_h)
         return (MY_RC_E_EINVAL);
     }
 
-    base2_h->val1 += 5;
+    __atomic_store_n(&base2_h->val1, base2_h->val1 + 5, __ATOMIC_RELAXED);
 
     return (MY_RC_E_SUCCESS);
 }
@@ -187,6 +196,42 @@ derived1_base2_type_string (base2_handle base2_h)
     return (derived1_type_string_internal(base2_cast_to_derived1(base2_h)));
 }
 
+/**
+ * The internal function for getting the class ID for objects of type derived1.
+ *
+ * @param derived1_h The object
+ * @return The class ID
+ */
+static my_class_id_e
+derived1_class_id_internal (derived1_handle derived1_h)
+{
+    return (MY_CLASS_ID_E_DERIVED1);
+}
+
+/**
+ * Wrapper for to call common function.
+ *
+ * @param base1_h The object
+ * @return The class ID
+ */
+static my_class_id_e
+derived1_base1_class_id (base1_handle base1_h)
+{
+    return (derived1_class_id_internal(base1_cast_to_derived1(base1_h)));
+}
+
+/**
+ * Wrapper for to call common function.
+ *
+ * @param base2_h The object
+ * @return The class ID
+ */
+static my_class_id_e
+derived1_base2_class_id (base2_handle base2_h)
+{
+    return (derived1_class_id_internal(base2_cast_to_derived1(base2_h)));
+}
+
 /**
  * The internal function for getting the string representation for objects of
  * type derived1.
@@ -273,7 +318,8 @@ derived1_increase_val4_internal (derived1_handle derived1_h)
         return (MY_RC_E_EINVAL);
     }
 
-    derived1_h->val4 *= 3;
+    __atomic_store_n(&derived1_h->val4, derived1_h->val4 * 3,
+                     __ATOMIC_RELAXED);
 
     return (MY_RC_E_SUCCESS);
 }
@@ -288,13 +334,34 @@ my_rc_e
 derived1_increase_val4 (derived1_handle derived1_h)
 {
     my_rc_e rc = MY_RC_E_SUCCESS;
+    uint32_t old_val4;
 
     VALIDATE_VTABLE_FN(derived1_h, private_h, vtable, increase_val4_fn, rc);
     if (my_rc_e_is_notok(rc)) {
         return (rc);
     }
+    if (base1_is_read_only(&(derived1_h->base1))) {
+        LOG_ERR("Object is read-only, derived1_h(%p)", derived1_h);
+        return (MY_RC_E_EINVAL);
+    }
+    old_val4 = derived1_h->val4;
+
+    TRACE_RECORD(TRACE_OP_E_DERIVED1_INCREASE_VAL4,
+                 base1_get_object_id(&(derived1_h->base1)), 0, 0);
+
+    rc = derived1_h->private_h->vtable->increase_val4_fn(derived1_h);
+    if (my_rc_e_is_ok(rc)) {
+        JOURNAL_RECORD(base1_get_object_id(&(derived1_h->base1)),
+                       base1_class_id(&(derived1_h->base1)),
+                       MY_FIELD_E_DERIVED1_VAL4, derived1_h->val4);
+        rc = WAL_LOG_FIELD(base1_get_object_id(&(derived1_h->base1)),
+                           MY_FIELD_E_DERIVED1_VAL4, derived1_h->val4);
+        CHECKPOINT_MARK_DIRTY(&(derived1_h->base1));
+        AGGREGATE_UPDATE(&(derived1_h->base1), MY_FIELD_E_DERIVED1_VAL4,
+                         old_val4, derived1_h->val4);
+    }
 
-    return (derived1_h->private_h->vtable->increase_val4_fn(derived1_h));
+    return (rc);
 }
 
 /**
@@ -311,6 +378,8 @@ derived1_increase_val4 (derived1_handle derived1_h)
 static void
 derived1_delete_internal (derived1_handle derived1_h, bool free_derived1_h)
 {
+    const allocator_st *allocator = NULL;
+
     if (NULL == derived1_h) {
         return;
     }
@@ -319,12 +388,14 @@ derived1_delete_internal (derived1_handle derived1_h, bool free_derived1_h)
     base2_friend_delete(&(derived1_h->base2));
 
     if (NULL != derived1_h->private_h) {
-        free(derived1_h->private_h);
+        allocator = derived1_h->private_h->allocator;
+        allocator_free(allocator, derived1_h->private_h,
+                       sizeof(*derived1_h->private_h));
         derived1_h->private_h = NULL;
     }
 
     if (free_derived1_h) {
-        free(derived1_h);
+        allocator_free(allocator, derived1_h, sizeof(*derived1_h));
     }
 }
 
@@ -401,6 +472,49 @@ derived1_base2_delete (base2_handle base2_h)
     return (derived1_delete(base2_cast_to_derived1(base2_h)));
 }
 
+/**
+ * The internal function for copying objects of type derived1.
+ *
+ * @param base1_h The object
+ * @return The copy or NULL on failure
+ * @see base1_clone()
+ */
+static base1_handle
+derived1_base1_clone (base1_handle base1_h)
+{
+    derived1_handle derived1_h = base1_cast_to_derived1(base1_h);
+    const allocator_st *allocator = derived1_h->private_h->allocator;
+    derived1_st *derived1;
+
+    derived1 = allocator_alloc(allocator, sizeof(*derived1));
+    if (NULL == derived1) {
+        return (NULL);
+    }
+
+    memcpy(derived1, derived1_h, sizeof(*derived1));
+    if (my_rc_e_is_notok(derived1_clone_init(derived1, derived1_h))) {
+        allocator_free(allocator, derived1, sizeof(*derived1));
+        return (NULL);
+    }
+
+    return (&(derived1->base1));
+}
+
+/**
+ * The internal function for resetting objects of type derived1.
+ *
+ * @param base1_h The object
+ * @return Return code
+ * @see base1_reset()
+ */
+static my_rc_e
+derived1_base1_reset (base1_handle base1_h)
+{
+    derived1_friend_reset(base1_cast_to_derived1(base1_h));
+
+    return (MY_RC_E_SUCCESS);
+}
+
 /**
  * The virtual function table for base1.  A NULL indicates a pure virtual
  * function in the base class for the function or that the parent object's
@@ -411,7 +525,10 @@ static base1_vtable_st base1_vtable = {
     derived1_base1_type_string,
     derived1_base1_string,
     derived1_base1_string_size,
-    NULL
+    NULL,
+    derived1_base1_class_id,
+    derived1_base1_clone,
+    derived1_base1_reset
 };
 
 /**
@@ -424,7 +541,8 @@ static base2_vtable_st base2_vtable = {
     derived1_base2_type_string,
     derived1_base2_string,
     derived1_base2_string_size,
-    derived1_base2_increase_val1
+    derived1_base2_increase_val1,
+    derived1_base2_class_id
 };
 
 /**
@@ -475,6 +593,64 @@ derived1_cast_to_base2 (derived1_handle derived1_h)
     return (base2_h);
 }
 
+/**
+ * Checked cast of the base1 object to derived1.
+ *
+ * @param base1_h The base1 object
+ * @return The derived1 object or NULL if the object is not a derived1.
+ */
+derived1_handle
+base1_try_cast_to_derived1 (base1_handle base1_h)
+{
+    if ((NULL == base1_h) || !base1_is_a(base1_h, MY_CLASS_ID_E_DERIVED1)) {
+        return (NULL);
+    }
+
+    return (base1_cast_to_derived1(base1_h));
+}
+
+/**
+ * Checked cast of the base2 object to derived1.
+ *
+ * @param base2_h The base2 object
+ * @return The derived1 object or NULL if the object is not a derived1.
+ */
+derived1_handle
+base2_try_cast_to_derived1 (base2_handle base2_h)
+{
+    if ((NULL == base2_h) || !base2_is_a(base2_h, MY_CLASS_ID_E_DERIVED1)) {
+        return (NULL);
+    }
+
+    return (base2_cast_to_derived1(base2_h));
+}
+
+/**
+ * Get the ID of the object's most derived class.
+ *
+ * @param derived1_h The object
+ * @return The class ID or MY_CLASS_ID_E_INVALID if the object is invalid.
+ */
+my_class_id_e
+derived1_class_id (derived1_handle derived1_h)
+{
+    return (base1_class_id(derived1_cast_to_base1(derived1_h)));
+}
+
+/**
+ * Indicates whether the object is of the given class or one of its
+ * descendants.
+ *
+ * @param derived1_h The object
+ * @param class_id The class to check for
+ * @return true if the object is a class_id.
+ */
+bool
+derived1_is_a (derived1_handle derived1_h, my_class_id_e class_id)
+{
+    return (base1_is_a(derived1_cast_to_base1(derived1_h), class_id));
+}
+
 /**
  * Fill in the child vtable with values inherited from the parent_vtable for all
  * functions left NULL in the child vtable.
@@ -571,13 +747,17 @@ derived1_set_vtable (derived1_handle derived1_h, derived1_vtable_st *vtable)
  * Allows a friend class to initialize their inner derived1 object.  Must be
  * called before the derived1 object is used.  If an error is returned, any
  * clean-up was handled internally and there is no need to call a delete
- * function.
+ * function.  The object's memory need not be zeroed beforehand, since every
+ * field is written here or by the parent init functions.
  *
  * @param derived1_h The object
+ * @param allocator The allocator the object was allocated from, which is also
+ * used for the private data of the object and its parents.  If NULL, the
+ * default allocator is used.
  * @return Return code
  */
 my_rc_e
-derived1_init (derived1_handle derived1_h)
+derived1_init (derived1_handle derived1_h, const allocator_st *allocator)
 {
     bool did_base1_init = false;
     bool did_base2_init = false;
@@ -588,46 +768,63 @@ derived1_init (derived1_handle derived1_h)
         return (MY_RC_E_EINVAL);
     }
 
-    rc = base1_init(&(derived1_h->base1));
+    if (NULL == allocator) {
+        allocator = allocator_get_default();
+    }
+
+    rc = base1_init(&(derived1_h->base1), allocator);
     if (my_rc_e_is_notok(rc)) {
-        return (rc);
+        goto err_exit;
     }
     did_base1_init = true;
 
     rc = base1_set_vtable(&(derived1_h->base1), &base1_vtable);
     if (my_rc_e_is_notok(rc)) {
-        return (rc);
+        goto err_exit;
     }
 
-    rc = base2_init(&(derived1_h->base2));
+    rc = base2_init(&(derived1_h->base2), allocator);
     if (my_rc_e_is_notok(rc)) {
-        return (rc);
+        goto err_exit;
     }
     did_base2_init = true;
 
     rc = base2_set_vtable(&(derived1_h->base2), &base2_vtable);
     if (my_rc_e_is_notok(rc)) {
-        return (rc);
+        goto err_exit;
+    }
+
+    rc = base2_set_object_id(&(derived1_h->base2),
+                             base1_get_object_id(&(derived1_h->base1)));
+    if (my_rc_e_is_notok(rc)) {
+        goto err_exit;
     }
 
-    derived1_h->private_h = calloc(1, sizeof(*derived1_h->private_h));
+    rc = base2_set_base1_view(&(derived1_h->base2), &(derived1_h->base1));
+    if (my_rc_e_is_notok(rc)) {
+        goto err_exit;
+    }
+
+    derived1_h->private_h = allocator_alloc(allocator,
+                                            sizeof(*derived1_h->private_h));
     if (NULL == derived1_h->private_h) {
         rc = MY_RC_E_ENOMEM;
         goto err_exit;
     }
 
     derived1_h->private_h->vtable = &derived1_vtable;
+    derived1_h->private_h->allocator = allocator;
     derived1_h->val4 = 500;
 
+    POISON_CHECK_FIELD(derived1_h, private_h);
+    POISON_CHECK_FIELD(derived1_h, val4);
+    POISON_CHECK_FIELD(derived1_h->private_h, vtable);
+    POISON_CHECK_FIELD(derived1_h->private_h, allocator);
+
     return (MY_RC_E_SUCCESS);
 
 err_exit:
 
-    if (NULL != derived1_h->private_h) {
-        free(derived1_h->private_h);
-        derived1_h->private_h = NULL;
-    }
-
     if (did_base2_init) {
         base2_friend_delete(&(derived1_h->base2));
     }
@@ -640,30 +837,297 @@ err_exit:
 }
 
 /**
- * Create a new derived1 object.
+ * Create a new derived1 object.  A derived1 object in the recycle bin is reused
+ * if there is one, with its base1 and base2 views given the same new object
+ * ID; otherwise one is allocated from the default allocator.
  *
  * @return The object or NULL if creation failed
+ * @see recycle_put()
  */
 derived1_handle
 derived1_new1 (void)
+{
+    base1_handle base1_h;
+    uint64_t object_id;
+
+    base1_h = recycle_get(MY_CLASS_ID_E_DERIVED1);
+    if (NULL == base1_h) {
+        return (derived1_new_with_allocator(NULL));
+    }
+
+    object_id = derived1_renew_object_id(base1_cast_to_derived1(base1_h));
+    TRACE_RECORD(TRACE_OP_E_DERIVED1_NEW1, object_id, 0, 0);
+    WAL_LOG_OBJECT(base1_h);
+    CHECKPOINT_TRACK(base1_h);
+    AGGREGATE_ADD(base1_h);
+
+    return (base1_cast_to_derived1(base1_h));
+}
+
+/**
+ * Create a new derived1 object from the given allocator.  The object is freed
+ * back to the same allocator when deleted.
+ *
+ * @param allocator The allocator or NULL for the default allocator.
+ * @return The object or NULL if creation failed
+ */
+derived1_handle
+derived1_new_with_allocator (const allocator_st *allocator)
 {
     derived1_st *derived1 = NULL;
     my_rc_e rc;
 
-    derived1 = calloc(1, sizeof(*derived1));
+    if (NULL == allocator) {
+        allocator = allocator_get_default();
+    }
+
+    derived1 = allocator_alloc(allocator, sizeof(*derived1));
     if (NULL != derived1) {
-        rc = derived1_init(derived1);
+        rc = derived1_init(derived1, allocator);
         if (my_rc_e_is_notok(rc)) {
             LOG_ERR("Init failed, rc(%s)", my_rc_e_get_string(rc));
             goto err_exit;
         }
+
+        TRACE_RECORD(TRACE_OP_E_DERIVED1_NEW1,
+                     base1_get_object_id(&(derived1->base1)), 0, 0);
+        WAL_LOG_OBJECT(&(derived1->base1));
+        CHECKPOINT_TRACK(&(derived1->base1));
+        AGGREGATE_ADD(&(derived1->base1));
     }
 
     return (derived1);
 
 err_exit:
 
-    derived1_delete(derived1);
+    allocator_free(allocator, derived1, sizeof(*derived1));
 
     return (NULL);
 }
+
+/**
+ * Allows a friend class to get the allocator the object was allocated from.
+ *
+ * @param derived1_h The object
+ * @return The allocator or NULL if the object is invalid
+ */
+const allocator_st *
+derived1_get_allocator (derived1_handle derived1_h)
+{
+    if ((NULL == derived1_h) || (NULL == derived1_h->private_h)) {
+        LOG_ERR("Invalid input, derived1_h(%p)", derived1_h);
+        return (NULL);
+    }
+
+    return (derived1_h->private_h->allocator);
+}
+
+/**
+ * Create a copy of the object, including its current state.  The copy is of
+ * the object's most derived class.
+ *
+ * @param derived1_h The object
+ * @return The copy or NULL on failure
+ * @see base1_clone()
+ */
+derived1_handle
+derived1_clone (derived1_handle derived1_h)
+{
+    base1_handle base1_h;
+
+    base1_h = base1_clone(derived1_cast_to_base1(derived1_h));
+    if (NULL == base1_h) {
+        return (NULL);
+    }
+
+    return (base1_cast_to_derived1(base1_h));
+}
+
+/**
+ * Restore the object to the state it had when constructed, without releasing
+ * its memory.  The reset is of the object's most derived class.
+ *
+ * @param derived1_h The object
+ * @return Return code
+ * @see base1_reset()
+ */
+my_rc_e
+derived1_reset (derived1_handle derived1_h)
+{
+    return (base1_reset(derived1_cast_to_base1(derived1_h)));
+}
+
+/**
+ * Allow a friend class to restore the default state of the derived1 object and
+ * its parents.  This does not call the virtual function table version of
+ * reset, but rather the reset specifically for type derived1.
+ *
+ * @param derived1_h The object
+ * @see base1_reset()
+ */
+void
+derived1_friend_reset (derived1_handle derived1_h)
+{
+    base1_friend_reset(&(derived1_h->base1));
+    base2_friend_reset(&(derived1_h->base2));
+    derived1_h->val4 = 500;
+}
+
+/**
+ * Allows a friend class to give an object reused from a recycle bin a new
+ * identity, shared by all of its views.
+ *
+ * @param derived1_h The object
+ * @return The new object ID
+ * @see recycle_get()
+ */
+uint64_t
+derived1_renew_object_id (derived1_handle derived1_h)
+{
+    uint64_t object_id;
+
+    object_id = base1_renew_object_id(&(derived1_h->base1));
+    base2_set_object_id(&(derived1_h->base2), object_id);
+
+    return (object_id);
+}
+
+/**
+ * Allows a friend class to give an object the identity it had when it was
+ * saved, shared by all of its views.
+ *
+ * @param derived1_h The object
+ * @param object_id The saved object ID
+ * @see my_object_id_reserve()
+ */
+void
+derived1_restore_object_id (derived1_handle derived1_h, uint64_t object_id)
+{
+    base1_restore_object_id(&(derived1_h->base1), object_id);
+    base2_set_object_id(&(derived1_h->base2), object_id);
+}
+
+/**
+ * Allows a friend class to finish copying their inner derived1 object.  The
+ * object must already be a byte copy of the source object; this gives it and
+ * its parents their own private data and a new object ID.  If an error is
+ * returned, any clean-up was handled internally and there is no need to call a
+ * delete function.
+ *
+ * @param derived1_h The object, a byte copy of src_derived1_h
+ * @param src_derived1_h The object that was copied
+ * @return Return code
+ * @see base1_clone()
+ */
+my_rc_e
+derived1_clone_init (derived1_handle derived1_h,
+                     derived1_handle src_derived1_h)
+{
+    bool did_base1_init = false;
+    bool did_base2_init = false;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if ((NULL == derived1_h) || (NULL == src_derived1_h) ||
+        (NULL == src_derived1_h->private_h)) {
+        LOG_ERR("Invalid input, derived1_h(%p) src_derived1_h(%p)", derived1_h,
+                src_derived1_h);
+        return (MY_RC_E_EINVAL);
+    }
+
+    rc = base1_clone_init(&(derived1_h->base1), &(src_derived1_h->base1));
+    if (my_rc_e_is_notok(rc)) {
+        goto err_exit;
+    }
+    did_base1_init = true;
+
+    rc = base2_clone_init(&(derived1_h->base2), &(src_derived1_h->base2));
+    if (my_rc_e_is_notok(rc)) {
+        goto err_exit;
+    }
+    did_base2_init = true;
+
+    rc = base2_set_object_id(&(derived1_h->base2),
+                             base1_get_object_id(&(derived1_h->base1)));
+    if (my_rc_e_is_notok(rc)) {
+        goto err_exit;
+    }
+
+    rc = base2_set_base1_view(&(derived1_h->base2), &(derived1_h->base1));
+    if (my_rc_e_is_notok(rc)) {
+        goto err_exit;
+    }
+
+    derived1_h->private_h =
+        allocator_alloc(src_derived1_h->private_h->allocator,
+                        sizeof(*derived1_h->private_h));
+    if (NULL == derived1_h->private_h) {
+        rc = MY_RC_E_ENOMEM;
+        goto err_exit;
+    }
+
+    *derived1_h->private_h = *src_derived1_h->private_h;
+
+    return (MY_RC_E_SUCCESS);
+
+err_exit:
+
+    if (did_base2_init) {
+        base2_friend_delete(&(derived1_h->base2));
+    }
+
+    if (did_base1_init) {
+        base1_friend_delete(&(derived1_h->base1));
+    }
+
+    return (rc);
+}
+
+/**
+ * Construct a derived1 object for the class registry.
+ *
+ * @param allocator The allocator or NULL for the default allocator.
+ * @return The object's base1 view or NULL if creation failed
+ * @see class_registry_new()
+ */
+static base1_handle
+derived1_class_new (const allocator_st *allocator)
+{
+    return (derived1_cast_to_base1(derived1_new_with_allocator(allocator)));
+}
+
+/**
+ * Register the metadata of this class.  This is called by the class registry
+ * when it is first used.
+ *
+ * @return Return code
+ * @see class_registry_register()
+ */
+my_rc_e
+derived1_register_class (void)
+{
+    static const class_field_st fields[] = {
+        CLASS_FIELD(MY_FIELD_E_DERIVED1_VAL4, "val4", MY_CLASS_ID_E_DERIVED1,
+                    derived1_st, val4),
+    };
+    static const class_method_st methods[] = {
+        CLASS_METHOD("delete", derived1_vtable_st, delete_fn),
+        CLASS_METHOD("increase_val4", derived1_vtable_st, increase_val4_fn),
+    };
+    static const class_desc_st derived1_class_desc = {
+        .class_id = MY_CLASS_ID_E_DERIVED1,
+        .name = "derived1",
+        .num_parents = 2,
+        .parents = { MY_CLASS_ID_E_BASE1, MY_CLASS_ID_E_BASE2 },
+        .parent_offsets = { offsetof(derived1_st, base1),
+                            offsetof(derived1_st, base2) },
+        .size = sizeof(derived1_st),
+        .vtable_size = sizeof(derived1_vtable_st),
+        .num_fields = NELEMS(fields),
+        .fields = fields,
+        .num_methods = NELEMS(methods),
+        .methods = methods,
+        .new_fn = derived1_class_new,
+    };
+
+    return (class_registry_register(&derived1_class_desc));
+}
@@ -37,13 +37,34 @@ typedef struct derived1_st_ *derived1_handle;
 extern my_rc_e
 derived1_increase_val4(derived1_handle derived1_h);
 
+extern derived1_handle
+derived1_clone(derived1_handle derived1_h);
+
+extern my_rc_e
+derived1_reset(derived1_handle derived1_h);
+
 extern base1_handle
 derived1_cast_to_base1(derived1_handle derived1_h);
 
 extern base2_handle
 derived1_cast_to_base2(derived1_handle derived1_h);
 
+extern derived1_handle
+base1_try_cast_to_derived1(base1_handle base1_h);
+
+extern derived1_handle
+base2_try_cast_to_derived1(base2_handle base2_h);
+
+extern my_class_id_e
+derived1_class_id(derived1_handle derived1_h);
+
+extern bool
+derived1_is_a(derived1_handle derived1_h, my_class_id_e class_id);
+
 extern derived1_handle
 derived1_new1(void);
 
+extern derived1_handle
+derived1_new_with_allocator(const allocator_st *allocator);
+
 #endif
@@ -86,6 +86,25 @@ extern void
 derived1_friend_delete(derived1_handle derived1_h);
 
 extern my_rc_e
-derived1_init(derived1_handle derived1_h);
+derived1_init(derived1_handle derived1_h, const allocator_st *allocator);
+
+extern const allocator_st *
+derived1_get_allocator(derived1_handle derived1_h);
+
+extern my_rc_e
+derived1_clone_init(derived1_handle derived1_h,
+                    derived1_handle src_derived1_h);
+
+extern void
+derived1_friend_reset(derived1_handle derived1_h);
+
+extern uint64_t
+derived1_renew_object_id(derived1_handle derived1_h);
+
+extern void
+derived1_restore_object_id(derived1_handle derived1_h, uint64_t object_id);
+
+extern my_rc_e
+derived1_register_class(void);
 
 #endif
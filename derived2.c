@@ -23,6 +23,12 @@
  */
 #include "derived2.h"
 #include "derived1_friend.h"
+#include "trace.h"
+#include "class_registry.h"
+#include "recycle.h"
+#include "wal.h"
+#include "checkpoint.h"
+#include "aggregate.h"
 
 /** Size for this object to use for base1_string_size_fn */
 #define DERIVED2_STR_SIZE 256
@@ -107,7 +113,8 @@ derived2_derived1_increase_val4 (derived1_handle derived1_h)
         return (MY_RC_E_EINVAL);
     }
 
-    derived1_h->val4 += 20;
+    __atomic_store_n(&derived1_h->val4, derived1_h->val4 + 20,
+                     __ATOMIC_RELAXED);
 
     return (MY_RC_E_SUCCESS);
 }
@@ -149,6 +156,42 @@ derived2_base2_type_string (base2_handle base2_h)
     return (derived2_type_string_internal(base2_cast_to_derived2(base2_h)));
 }
 
+/**
+ * The internal function for getting the class ID for objects of type derived2.
+ *
+ * @param derived2_h The object
+ * @return The class ID
+ */
+static my_class_id_e
+derived2_class_id_internal (derived2_handle derived2_h)
+{
+    return (MY_CLASS_ID_E_DERIVED2);
+}
+
+/**
+ * Wrapper for to call common function.
+ *
+ * @param base1_h The object
+ * @return The class ID
+ */
+static my_class_id_e
+derived2_base1_class_id (base1_handle base1_h)
+{
+    return (derived2_class_id_internal(base1_cast_to_derived2(base1_h)));
+}
+
+/**
+ * Wrapper for to call common function.
+ *
+ * @param base2_h The object
+ * @return The class ID
+ */
+static my_class_id_e
+derived2_base2_class_id (base2_handle base2_h)
+{
+    return (derived2_class_id_internal(base2_cast_to_derived2(base2_h)));
+}
+
 /**
  * The internal function to delete a derived2 object.  Upon return, the object
  * is not longer valid.
@@ -158,13 +201,17 @@ derived2_base2_type_string (base2_handle base2_h)
 static void
 derived2_delete (derived2_handle derived2_h)
 {
+    const allocator_st *allocator;
+
     if (NULL == derived2_h) {
         return;
     }
 
+    allocator = derived1_get_allocator(&(derived2_h->derived1));
+
     derived1_friend_delete(&(derived2_h->derived1));
 
-    free(derived2_h);
+    allocator_free(allocator, derived2_h, sizeof(*derived2_h));
 }
 
 /**
@@ -203,6 +250,63 @@ derived2_derived1_delete (derived1_handle derived1_h)
     return (derived2_delete(derived1_cast_to_derived2(derived1_h)));
 }
 
+/**
+ * The internal function for copying objects of type derived2.
+ *
+ * @param base1_h The object
+ * @return The copy or NULL on failure
+ * @see base1_clone()
+ */
+static base1_handle
+derived2_base1_clone (base1_handle base1_h)
+{
+    derived2_handle derived2_h = base1_cast_to_derived2(base1_h);
+    const allocator_st *allocator;
+    derived2_st *derived2;
+
+    allocator = derived1_get_allocator(&(derived2_h->derived1));
+    derived2 = allocator_alloc(allocator, sizeof(*derived2));
+    if (NULL == derived2) {
+        return (NULL);
+    }
+
+    memcpy(derived2, derived2_h, sizeof(*derived2));
+    if (my_rc_e_is_notok(derived1_clone_init(&(derived2->derived1),
+                                             &(derived2_h->derived1)))) {
+        allocator_free(allocator, derived2, sizeof(*derived2));
+        return (NULL);
+    }
+
+    return (&(derived2->derived1.base1));
+}
+
+/**
+ * Restore the default state of the derived2 object and its parents.
+ *
+ * @param derived2_h The object
+ */
+static void
+derived2_reset_internal (derived2_handle derived2_h)
+{
+    derived1_friend_reset(&(derived2_h->derived1));
+    derived2_h->derived1.base2.val1 = 999;
+    derived2_h->derived1.val4 = 700;
+}
+
+/**
+ * The internal function for resetting objects of type derived2.
+ *
+ * @param base1_h The object
+ * @return Return code
+ * @see base1_reset()
+ */
+static my_rc_e
+derived2_base1_reset (base1_handle base1_h)
+{
+    derived2_reset_internal(base1_cast_to_derived2(base1_h));
+
+    return (MY_RC_E_SUCCESS);
+}
 
 /**
  * The virtual function table for base1.  A NULL indicates a pure virtual
@@ -214,7 +318,10 @@ static base1_vtable_st base1_vtable = {
     derived2_base1_type_string,
     NULL,
     NULL,
-    NULL
+    NULL,
+    derived2_base1_class_id,
+    derived2_base1_clone,
+    derived2_base1_reset
 };
 
 /**
@@ -227,7 +334,8 @@ static base2_vtable_st base2_vtable = {
     derived2_base2_type_string,
     NULL,
     NULL,
-    NULL
+    NULL,
+    derived2_base2_class_id
 };
 
 /**
@@ -261,13 +369,64 @@ derived2_cast_to_derived1 (derived2_handle derived2_h)
 }
 
 /**
- * Initialize the derived2 objects.
+ * Checked cast of the derived1 object to derived2.
+ *
+ * @param derived1_h The derived1 object
+ * @return The derived2 object or NULL if the object is not a derived2.
+ */
+derived2_handle
+derived1_try_cast_to_derived2 (derived1_handle derived1_h)
+{
+    if ((NULL == derived1_h) ||
+        !derived1_is_a(derived1_h, MY_CLASS_ID_E_DERIVED2)) {
+        return (NULL);
+    }
+
+    return (derived1_cast_to_derived2(derived1_h));
+}
+
+/**
+ * Checked cast of the base1 object to derived2.
+ *
+ * @param base1_h The base1 object
+ * @return The derived2 object or NULL if the object is not a derived2.
+ */
+derived2_handle
+base1_try_cast_to_derived2 (base1_handle base1_h)
+{
+    if ((NULL == base1_h) || !base1_is_a(base1_h, MY_CLASS_ID_E_DERIVED2)) {
+        return (NULL);
+    }
+
+    return (base1_cast_to_derived2(base1_h));
+}
+
+/**
+ * Checked cast of the base2 object to derived2.
+ *
+ * @param base2_h The base2 object
+ * @return The derived2 object or NULL if the object is not a derived2.
+ */
+derived2_handle
+base2_try_cast_to_derived2 (base2_handle base2_h)
+{
+    if ((NULL == base2_h) || !base2_is_a(base2_h, MY_CLASS_ID_E_DERIVED2)) {
+        return (NULL);
+    }
+
+    return (base2_cast_to_derived2(base2_h));
+}
+
+/**
+ * Initialize the derived2 objects.  If an error is returned, any clean-up was
+ * handled internally.
  *
  * @param derived2_h The object
+ * @param allocator The allocator the object was allocated from
  * @return Return code
  */
 static my_rc_e
-derived2_init (derived2_handle derived2_h)
+derived2_init (derived2_handle derived2_h, const allocator_st *allocator)
 {
     my_rc_e rc = MY_RC_E_SUCCESS;
 
@@ -276,48 +435,167 @@ derived2_init (derived2_handle derived2_h)
         return (MY_RC_E_EINVAL);
     }
 
-    rc = derived1_init(&(derived2_h->derived1));
+    rc = derived1_init(&(derived2_h->derived1), allocator);
     if (my_rc_e_is_notok(rc)) {
         return (rc);
     }
 
     rc = derived1_set_vtable(&(derived2_h->derived1), &derived1_vtable);
     if (my_rc_e_is_notok(rc)) {
+        derived1_friend_delete(&(derived2_h->derived1));
         return (rc);
     }
 
-    derived2_h->derived1.base2.val1 = 999;
-    derived2_h->derived1.val4 = 700;
+    derived2_reset_internal(derived2_h);
 
     return (MY_RC_E_SUCCESS);
 }
 
 
 /**
- * Create a new derived2 object.
+ * Create a new derived2 object.  A derived2 object in the recycle bin is reused
+ * if there is one, renewed through its derived1 part so that every view shares
+ * the new object ID; otherwise one is allocated from the default allocator.
  *
  * @return The object or NULL if creation failed
+ * @see recycle_put()
  */
 derived2_handle
 derived2_new1 (void)
+{
+    base1_handle base1_h;
+    uint64_t object_id;
+
+    base1_h = recycle_get(MY_CLASS_ID_E_DERIVED2);
+    if (NULL == base1_h) {
+        return (derived2_new_with_allocator(NULL));
+    }
+
+    object_id = derived1_renew_object_id(derived2_cast_to_derived1(
+        base1_cast_to_derived2(base1_h)));
+    TRACE_RECORD(TRACE_OP_E_DERIVED2_NEW1, object_id, 0, 0);
+    WAL_LOG_OBJECT(base1_h);
+    CHECKPOINT_TRACK(base1_h);
+    AGGREGATE_ADD(base1_h);
+
+    return (base1_cast_to_derived2(base1_h));
+}
+
+/**
+ * Create a new derived2 object from the given allocator.  The object is freed
+ * back to the same allocator when deleted.
+ *
+ * @param allocator The allocator or NULL for the default allocator.
+ * @return The object or NULL if creation failed
+ */
+derived2_handle
+derived2_new_with_allocator (const allocator_st *allocator)
 {
     derived2_st *derived2 = NULL;
     my_rc_e rc;
 
-    derived2 = calloc(1, sizeof(*derived2));
+    if (NULL == allocator) {
+        allocator = allocator_get_default();
+    }
+
+    derived2 = allocator_alloc(allocator, sizeof(*derived2));
     if (NULL != derived2) {
-        rc = derived2_init(derived2);
+        rc = derived2_init(derived2, allocator);
         if (my_rc_e_is_notok(rc)) {
             LOG_ERR("Init failed, rc(%s)", my_rc_e_get_string(rc));
             goto err_exit;
         }
+
+        TRACE_RECORD(TRACE_OP_E_DERIVED2_NEW1,
+                     base1_get_object_id(&(derived2->derived1.base1)), 0, 0);
+        WAL_LOG_OBJECT(&(derived2->derived1.base1));
+        CHECKPOINT_TRACK(&(derived2->derived1.base1));
+        AGGREGATE_ADD(&(derived2->derived1.base1));
     }
 
     return (derived2);
 
 err_exit:
 
-    derived2_delete(derived2);
+    allocator_free(allocator, derived2, sizeof(*derived2));
 
     return (NULL);
 }
+
+/**
+ * Create a copy of the object, including its current state.
+ *
+ * @param derived2_h The object
+ * @return The copy or NULL on failure
+ * @see base1_clone()
+ */
+derived2_handle
+derived2_clone (derived2_handle derived2_h)
+{
+    base1_handle base1_h;
+
+    base1_h = base1_clone(derived1_cast_to_base1(derived2_cast_to_derived1(
+        derived2_h)));
+    if (NULL == base1_h) {
+        return (NULL);
+    }
+
+    return (base1_cast_to_derived2(base1_h));
+}
+
+/**
+ * Restore the object to the state it had when constructed, without releasing
+ * its memory.
+ *
+ * @param derived2_h The object
+ * @return Return code
+ * @see base1_reset()
+ */
+my_rc_e
+derived2_reset (derived2_handle derived2_h)
+{
+    return (base1_reset(derived1_cast_to_base1(derived2_cast_to_derived1(
+        derived2_h))));
+}
+
+/**
+ * Construct a derived2 object for the class registry.
+ *
+ * @param allocator The allocator or NULL for the default allocator.
+ * @return The object's base1 view or NULL if creation failed
+ * @see class_registry_new()
+ */
+static base1_handle
+derived2_class_new (const allocator_st *allocator)
+{
+    return (derived1_cast_to_base1(
+        derived2_cast_to_derived1(derived2_new_with_allocator(allocator))));
+}
+
+/**
+ * Register the metadata of this class.  This is called by the class registry
+ * when it is first used.
+ *
+ * @return Return code
+ * @see class_registry_register()
+ */
+my_rc_e
+derived2_register_class (void)
+{
+    static const class_desc_st derived2_class_desc = {
+        .class_id = MY_CLASS_ID_E_DERIVED2,
+        .name = "derived2",
+        .num_parents = 1,
+        .parents = { MY_CLASS_ID_E_DERIVED1 },
+        .parent_offsets = { offsetof(derived2_st, derived1) },
+        .size = sizeof(derived2_st),
+        .vtable_size = 0,
+        .num_fields = 0,
+        .fields = NULL,
+        .num_methods = 0,
+        .methods = NULL,
+        .new_fn = derived2_class_new,
+    };
+
+    return (class_registry_register(&derived2_class_desc));
+}
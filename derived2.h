@@ -36,7 +36,28 @@ typedef struct derived2_st_ *derived2_handle;
 extern derived1_handle
 derived2_cast_to_derived1(derived2_handle derived2_h);
 
+extern derived2_handle
+derived1_try_cast_to_derived2(derived1_handle derived1_h);
+
+extern derived2_handle
+base1_try_cast_to_derived2(base1_handle base1_h);
+
+extern derived2_handle
+base2_try_cast_to_derived2(base2_handle base2_h);
+
 extern derived2_handle
 derived2_new1(void);
 
+extern derived2_handle
+derived2_new_with_allocator(const allocator_st *allocator);
+
+extern derived2_handle
+derived2_clone(derived2_handle derived2_h);
+
+extern my_rc_e
+derived2_reset(derived2_handle derived2_h);
+
+extern my_rc_e
+derived2_register_class(void);
+
 #endif
@@ -0,0 +1,423 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements dumping objects as text.
+ *
+ * The objects are split into chunks of consecutive objects, and chunk i is
+ * rendered into slot i modulo the number of slots.  Renderers claim chunks in
+ * order from a shared counter, but may only claim a chunk once the writer has
+ * written the chunk which last used its slot, which is the backpressure.  The
+ * writer waits for the next chunk in order, then takes it and every consecutive
+ * chunk already rendered and writes them with a single writev(), so a writer
+ * falling behind catches up with fewer, larger writes.  Slot buffers grow as
+ * needed and are reused, so a dump allocates little after its first chunks.
+ *
+ * The serial dump renders each chunk into one buffer and writes it, so both
+ * produce the same bytes.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "dump.h"
+
+/** Most chunks written by one writev(), well within Linux's IOV_MAX */
+#define DUMP_MAX_IOV 64
+
+/** A buffer rendering a chunk */
+typedef struct dump_slot_st_ {
+    /** The text */
+    char *buffer;
+    /** Size of the buffer */
+    size_t capacity;
+    /** Length of the text */
+    size_t len;
+    /** Whether the chunk is rendered and not yet written */
+    bool ready;
+} dump_slot_st;
+
+/** Work shared by the threads of a dump */
+typedef struct dump_work_st_ {
+    /** The objects */
+    const base1_handle *objs;
+    /** Number of objects */
+    size_t count;
+    /** Objects in each chunk */
+    size_t chunk_objects;
+    /** Number of chunks */
+    size_t num_chunks;
+    /** The slots */
+    dump_slot_st *slots;
+    /** Number of slots */
+    size_t num_slots;
+    /** Guards the fields below and the slots' ready flags */
+    pthread_mutex_t lock;
+    /** Signalled when the chunk the writer waits for is rendered */
+    pthread_cond_t rendered;
+    /** Signalled when chunks are written, freeing their slots */
+    pthread_cond_t written;
+    /** Index of the next chunk to claim */
+    size_t next_claim;
+    /** Index of the next chunk to write */
+    size_t next_write;
+    /** First failure */
+    my_rc_e rc;
+} dump_work_st;
+
+/**
+ * Render the objects of a chunk into a slot, each on a line of its own.
+ *
+ * @param work The work
+ * @param chunk The chunk
+ * @param slot The slot
+ * @return Return code
+ */
+static my_rc_e
+dump_render (const dump_work_st *work, size_t chunk, dump_slot_st *slot)
+{
+    size_t i, end, size, capacity;
+    char *buffer;
+    my_rc_e rc;
+
+    slot->len = 0;
+    end = (chunk + 1) * work->chunk_objects;
+    end = (end > work->count) ? work->count : end;
+    for (i = chunk * work->chunk_objects; i < end; i++) {
+        rc = base1_string_size(work->objs[i], &size);
+        if (my_rc_e_is_notok(rc)) {
+            return (rc);
+        }
+        if ((slot->len + size + 1) > slot->capacity) {
+            capacity = 2 * (slot->len + size + 1);
+            buffer = realloc(slot->buffer, capacity);
+            if (NULL == buffer) {
+                return (MY_RC_E_ENOMEM);
+            }
+            slot->buffer = buffer;
+            slot->capacity = capacity;
+        }
+        rc = base1_string(work->objs[i], slot->buffer + slot->len, size);
+        if (my_rc_e_is_notok(rc)) {
+            return (rc);
+        }
+        slot->len += strlen(slot->buffer + slot->len);
+        slot->buffer[slot->len++] = '\n';
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Write buffers whole, continuing after short writes.
+ *
+ * @param fd The file
+ * @param iov The buffers, which are consumed
+ * @param iovcnt Number of buffers
+ * @param stats Statistics, whose bytes and writes are updated
+ * @return Return code
+ */
+static my_rc_e
+dump_writev (int fd, struct iovec *iov, int iovcnt, dump_stats_st *stats)
+{
+    ssize_t written;
+
+    while (iovcnt > 0) {
+        written = writev(fd, iov, iovcnt);
+        if (written < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            LOG_ERR("Write failed, errno(%d)", errno);
+            return (MY_RC_E_EIO);
+        }
+        stats->bytes += written;
+        stats->writes++;
+        while ((iovcnt > 0) && ((size_t) written >= iov->iov_len)) {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Claim and render chunks until none are left or the dump fails.
+ *
+ * @param arg The work
+ * @return NULL
+ */
+static void *
+dump_render_thread (void *arg)
+{
+    dump_work_st *work = arg;
+    dump_slot_st *slot;
+    size_t chunk;
+    my_rc_e rc;
+
+    pthread_mutex_lock(&work->lock);
+    while (true) {
+        while (my_rc_e_is_ok(work->rc) &&
+               (work->next_claim < work->num_chunks) &&
+               (work->next_claim >= (work->next_write + work->num_slots))) {
+            pthread_cond_wait(&work->written, &work->lock);
+        }
+        if (my_rc_e_is_notok(work->rc) ||
+            (work->next_claim >= work->num_chunks)) {
+            break;
+        }
+        chunk = work->next_claim++;
+        slot = &work->slots[chunk % work->num_slots];
+        pthread_mutex_unlock(&work->lock);
+
+        rc = dump_render(work, chunk, slot);
+
+        pthread_mutex_lock(&work->lock);
+        if (my_rc_e_is_notok(rc)) {
+            if (my_rc_e_is_ok(work->rc)) {
+                work->rc = rc;
+            }
+            pthread_cond_broadcast(&work->written);
+        } else {
+            slot->ready = true;
+        }
+        if ((chunk == work->next_write) || my_rc_e_is_notok(rc)) {
+            pthread_cond_signal(&work->rendered);
+        }
+    }
+    pthread_mutex_unlock(&work->lock);
+
+    return (NULL);
+}
+
+/**
+ * Write the chunks in order as they are rendered.
+ *
+ * @param fd The file
+ * @param work The work
+ * @param stats Statistics, whose bytes and writes are updated
+ * @return Return code
+ */
+static my_rc_e
+dump_write_chunks (int fd, dump_work_st *work, dump_stats_st *stats)
+{
+    struct iovec iov[DUMP_MAX_IOV];
+    dump_slot_st *slot;
+    size_t chunk, end;
+    int iovcnt;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    pthread_mutex_lock(&work->lock);
+    while (my_rc_e_is_ok(work->rc) && (work->next_write < work->num_chunks)) {
+        if (!work->slots[work->next_write % work->num_slots].ready) {
+            pthread_cond_wait(&work->rendered, &work->lock);
+            continue;
+        }
+
+        /* The consecutive chunks already rendered, each slot at most once */
+        iovcnt = 0;
+        end = work->next_write + ((work->num_slots < DUMP_MAX_IOV) ?
+                                  work->num_slots : DUMP_MAX_IOV);
+        end = (end > work->num_chunks) ? work->num_chunks : end;
+        for (chunk = work->next_write; chunk < end; chunk++) {
+            slot = &work->slots[chunk % work->num_slots];
+            if (!slot->ready) {
+                break;
+            }
+            iov[iovcnt].iov_base = slot->buffer;
+            iov[iovcnt].iov_len = slot->len;
+            iovcnt++;
+        }
+        end = chunk;
+        pthread_mutex_unlock(&work->lock);
+
+        rc = dump_writev(fd, iov, iovcnt, stats);
+
+        pthread_mutex_lock(&work->lock);
+        for (chunk = work->next_write; chunk < end; chunk++) {
+            work->slots[chunk % work->num_slots].ready = false;
+        }
+        work->next_write = end;
+        if (my_rc_e_is_notok(rc)) {
+            work->rc = rc;
+        }
+        pthread_cond_broadcast(&work->written);
+    }
+    rc = work->rc;
+    pthread_mutex_unlock(&work->lock);
+
+    return (rc);
+}
+
+/**
+ * Dump objects as text on the calling thread alone.
+ *
+ * @param fd The file to write
+ * @param objs The objects
+ * @param count Number of objects
+ * @param stats Outputs statistics of the dump, or NULL
+ * @return Return code
+ */
+my_rc_e
+dump_objects_serial (int fd, const base1_handle *objs, size_t count,
+                     dump_stats_st *stats)
+{
+    dump_work_st work = { 0 };
+    dump_slot_st slot = { 0 };
+    dump_stats_st local_stats;
+    struct iovec iov;
+    size_t chunk;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if ((fd < 0) || ((NULL == objs) && (0 != count))) {
+        LOG_ERR("Invalid input, fd(%d) objs(%p)", fd, objs);
+        return (MY_RC_E_EINVAL);
+    }
+    if (NULL == stats) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    work.objs = objs;
+    work.count = count;
+    work.chunk_objects = DUMP_DEFAULT_CHUNK_OBJECTS;
+    work.num_chunks = (count + work.chunk_objects - 1) / work.chunk_objects;
+    for (chunk = 0; my_rc_e_is_ok(rc) && (chunk < work.num_chunks);
+         chunk++) {
+        rc = dump_render(&work, chunk, &slot);
+        if (my_rc_e_is_ok(rc)) {
+            iov.iov_base = slot.buffer;
+            iov.iov_len = slot.len;
+            rc = dump_writev(fd, &iov, 1, stats);
+        }
+    }
+    free(slot.buffer);
+
+    stats->objects = count;
+    stats->chunks = work.num_chunks;
+    stats->threads = 1;
+
+    return (rc);
+}
+
+/**
+ * Dump objects as text, rendering them on a pool of threads while the
+ * calling thread writes them in order.  The output is the same as that of
+ * dump_objects_serial().
+ *
+ * @param fd The file to write
+ * @param objs The objects, which must not be mutated during the dump
+ * @param count Number of objects
+ * @param config The configuration, or NULL for the defaults
+ * @param stats Outputs statistics of the dump, or NULL
+ * @return Return code
+ */
+my_rc_e
+dump_objects (int fd, const base1_handle *objs, size_t count,
+              const dump_config_st *config, dump_stats_st *stats)
+{
+    dump_work_st work = { 0 };
+    dump_stats_st local_stats;
+    pthread_t *threads = NULL;
+    size_t num_threads = 0, started = 0, i;
+    long num_cpus;
+    my_rc_e rc;
+
+    if ((fd < 0) || ((NULL == objs) && (0 != count))) {
+        LOG_ERR("Invalid input, fd(%d) objs(%p)", fd, objs);
+        return (MY_RC_E_EINVAL);
+    }
+    if (NULL == stats) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    work.objs = objs;
+    work.count = count;
+    if (NULL != config) {
+        num_threads = config->num_threads;
+        work.chunk_objects = config->chunk_objects;
+        work.num_slots = config->max_chunks;
+    }
+    if (0 == num_threads) {
+        num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = (num_cpus > 0) ? num_cpus : 1;
+    }
+    if (0 == work.chunk_objects) {
+        work.chunk_objects = DUMP_DEFAULT_CHUNK_OBJECTS;
+    }
+    if (0 == work.num_slots) {
+        work.num_slots = num_threads * DUMP_DEFAULT_CHUNKS_PER_THREAD;
+    }
+    work.num_chunks = (count + work.chunk_objects - 1) / work.chunk_objects;
+    num_threads = (num_threads > work.num_chunks) ? work.num_chunks :
+        num_threads;
+
+    work.slots = calloc(work.num_slots, sizeof(*work.slots));
+    threads = calloc(num_threads + 1, sizeof(*threads));
+    if ((NULL == work.slots) || (NULL == threads)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+    pthread_mutex_init(&work.lock, NULL);
+    pthread_cond_init(&work.rendered, NULL);
+    pthread_cond_init(&work.written, NULL);
+    work.rc = MY_RC_E_SUCCESS;
+
+    for (i = 0; i < num_threads; i++) {
+        if (0 != pthread_create(&threads[started], NULL, dump_render_thread,
+                                &work)) {
+            break;
+        }
+        started++;
+    }
+    if ((0 == started) && (work.num_chunks > 0)) {
+        work.rc = MY_RC_E_ENOMEM;
+    }
+
+    rc = dump_write_chunks(fd, &work, stats);
+
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&work.lock);
+    pthread_cond_destroy(&work.rendered);
+    pthread_cond_destroy(&work.written);
+
+    stats->objects = count;
+    stats->chunks = work.num_chunks;
+    stats->threads = started;
+
+exit:
+
+    for (i = 0; (NULL != work.slots) && (i < work.num_slots); i++) {
+        free(work.slots[i].buffer);
+    }
+    free(work.slots);
+    free(threads);
+
+    return (rc);
+}
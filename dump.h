@@ -0,0 +1,76 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for dumping objects as text, each object's
+ * string from base1_string() on a line of its own.  A parallel dump renders
+ * chunks of consecutive objects on a pool of threads while the calling thread
+ * writes the finished chunks in order, so its output is exactly that of the
+ * serial dump.  Only a bounded number of chunks are rendered ahead of the
+ * writer, which bounds the memory used and holds back the renderers when the
+ * file is slower than they are.
+ */
+#ifndef __DUMP_H__
+#define __DUMP_H__
+
+#include "common.h"
+#include "base1.h"
+
+/** Default number of objects in each chunk */
+#define DUMP_DEFAULT_CHUNK_OBJECTS 1024
+
+/** Default number of chunks in flight for each rendering thread */
+#define DUMP_DEFAULT_CHUNKS_PER_THREAD 4
+
+/** Configuration of a dump */
+typedef struct dump_config_st_ {
+    /** Number of rendering threads, or zero for one per online CPU */
+    size_t num_threads;
+    /** Objects in each chunk, or zero for the default */
+    size_t chunk_objects;
+    /** Most chunks rendered but not yet written, or zero for the default */
+    size_t max_chunks;
+} dump_config_st;
+
+/** Statistics of a dump */
+typedef struct dump_stats_st_ {
+    /** Number of objects */
+    size_t objects;
+    /** Number of chunks */
+    size_t chunks;
+    /** Number of bytes written */
+    size_t bytes;
+    /** Number of writes made */
+    size_t writes;
+    /** Number of rendering threads used */
+    size_t threads;
+} dump_stats_st;
+
+/* APIs below are documented in their implementation file */
+
+extern my_rc_e
+dump_objects_serial(int fd, const base1_handle *objs, size_t count,
+                    dump_stats_st *stats);
+
+extern my_rc_e
+dump_objects(int fd, const base1_handle *objs, size_t count,
+             const dump_config_st *config, dump_stats_st *stats);
+
+#endif
@@ -0,0 +1,992 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements secondary indexes on fields of base1.
+ *
+ * Every index is on a list which the mutation hooks walk, so they need not know
+ * which indexes an object is in: an index only moves or removes an object it
+ * holds.  A single reader-writer lock covers the list and every index.  Lookups
+ * share it, while insertions, removals and the hooks take it exclusively.  Each
+ * object counts the indexes holding it and each field the indexes on it, so
+ * the hooks return without the lock for an object in no index or a field with
+ * none, and only mutations of indexed fields of indexed objects serialize.
+ * The hooks read the counts without the lock, so an object must not be mutated
+ * while another thread inserts it into an index.
+ *
+ * A hash slot holds a value and the objects having it, the first of them inline
+ * so that the common case of a distinct value needs no further allocation.
+ * Slots are probed linearly and removed by shifting back later slots of the
+ * same probe run, which needs no tombstones.
+ *
+ * An ordered index sorts entries by value and then by handle, so every entry is
+ * unique and can be found by binary search even among many objects sharing a
+ * value.  Entries are kept in fixed size leaves, and a directory holds each
+ * leaf's first entry contiguously so the search for a leaf stays within a few
+ * cache lines.  A full leaf is split in two and an empty one is freed.
+ */
+#include <pthread.h>
+#include "field_index.h"
+#include "base1_friend.h"
+
+/** Smallest number of slots in a hash index */
+#define FIELD_INDEX_MIN_SLOTS 16
+
+/** Grow a hash index when it is more than this percent full */
+#define FIELD_INDEX_MAX_LOAD_PCT 70
+
+/** Objects a hash slot allocates room for once a value has two */
+#define FIELD_INDEX_MIN_SLOT_OBJS 4
+
+/** Entries in a leaf of an ordered index */
+#define FIELD_INDEX_LEAF_ENTRIES 64
+
+/** Leaves an ordered index's directory first has room for */
+#define FIELD_INDEX_MIN_LEAVES 8
+
+/** An entry of an ordered index */
+typedef struct field_index_entry_st_ {
+    /** The value of the field */
+    uint64_t value;
+    /** The object */
+    base1_handle obj;
+} field_index_entry_st;
+
+/** A slot of a hash index */
+typedef struct field_index_slot_st_ {
+    /** The value of the field */
+    uint64_t value;
+    /** The number of objects with the value, zero if the slot is empty */
+    uint32_t count;
+    /** Room in objs, zero while the only object is held in obj */
+    uint32_t capacity;
+    union {
+        /** The object, when capacity is zero */
+        base1_handle obj;
+        /** The objects, when capacity is nonzero */
+        base1_handle *objs;
+    };
+} field_index_slot_st;
+
+/** A leaf of an ordered index */
+typedef struct field_index_leaf_st_ {
+    /** Number of entries */
+    size_t count;
+    /** The entries, in order */
+    field_index_entry_st entries[FIELD_INDEX_LEAF_ENTRIES];
+} field_index_leaf_st;
+
+/**
+ * Private variables which cannot be directly accessed by any other class.
+ */
+typedef struct field_index_st_ {
+    /** The kind of index */
+    field_index_kind_e kind;
+    /** The field indexed */
+    my_field_e field;
+    /** Number of objects in the index */
+    size_t size;
+    /** The next index on the list */
+    struct field_index_st_ *next;
+    /** The slots of a hash index, the number of which is a power of two */
+    field_index_slot_st *slots;
+    /** The number of slots */
+    size_t num_slots;
+    /** The number of slots in use */
+    size_t used_slots;
+    /** The leaves of an ordered index, in order */
+    field_index_leaf_st **leaves;
+    /** The first entry of each leaf */
+    field_index_entry_st *firsts;
+    /** The number of leaves */
+    size_t num_leaves;
+    /** Room in leaves and firsts */
+    size_t max_leaves;
+} field_index_st;
+
+uint32_t field_index_count = 0;
+
+/** Number of indexes on each field, changed only under the lock */
+static uint32_t field_index_field_counts[MY_FIELD_E_MAX];
+
+/** Protects the list and every index */
+static pthread_rwlock_t field_index_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/** The indexes */
+static field_index_st *field_index_list = NULL;
+
+/**
+ * Get the value of a field of an object.
+ *
+ * @param base1_h The object
+ * @param field The field, which must be a field of base1
+ * @return The value
+ */
+static uint64_t
+field_index_value (base1_handle base1_h, my_field_e field)
+{
+    switch (field) {
+    case MY_FIELD_E_BASE1_VAL1:
+        return (base1_h->public_data.val1);
+    case MY_FIELD_E_BASE1_VAL2:
+        return (base1_h->public_data.val2);
+    default:
+        return (base1_h->val3);
+    }
+}
+
+/**
+ * Mix the bits of a value so sequential values spread evenly over the slots.
+ *
+ * @param value The value
+ * @return The hash value
+ */
+static uint64_t
+field_index_hash (uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+
+    return (value);
+}
+
+/**
+ * Find the slot of a value in a hash index.
+ *
+ * @param index The index
+ * @param value The value
+ * @return The slot holding the value, or the empty slot where it belongs
+ */
+static size_t
+field_index_slot (const field_index_st *index, uint64_t value)
+{
+    size_t mask = index->num_slots - 1;
+    size_t i = field_index_hash(value) & mask;
+
+    while ((0 != index->slots[i].count) && (value != index->slots[i].value)) {
+        i = (i + 1) & mask;
+    }
+
+    return (i);
+}
+
+/**
+ * Get the objects of a hash slot.
+ *
+ * @param slot The slot
+ * @return The objects, of which there are slot->count
+ */
+static base1_handle *
+field_index_slot_objs (field_index_slot_st *slot)
+{
+    return ((0 == slot->capacity) ? &slot->obj : slot->objs);
+}
+
+/**
+ * Resize a hash index to the given number of slots.
+ *
+ * @param index The index
+ * @param num_slots The new number of slots, must be a power of two.
+ * @return Return code
+ */
+static my_rc_e
+field_index_resize (field_index_st *index, size_t num_slots)
+{
+    field_index_slot_st *old_slots = index->slots;
+    size_t old_num_slots = index->num_slots;
+    size_t i;
+
+    index->slots = calloc(num_slots, sizeof(*index->slots));
+    if (NULL == index->slots) {
+        index->slots = old_slots;
+        return (MY_RC_E_ENOMEM);
+    }
+    index->num_slots = num_slots;
+
+    for (i = 0; i < old_num_slots; i++) {
+        if (0 != old_slots[i].count) {
+            index->slots[field_index_slot(index, old_slots[i].value)] =
+                old_slots[i];
+        }
+    }
+
+    free(old_slots);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Add an object to a hash index.  The object must not be in the index.
+ *
+ * @param index The index
+ * @param value The object's value
+ * @param base1_h The object
+ * @return Return code
+ */
+static my_rc_e
+field_index_hash_add (field_index_st *index, uint64_t value,
+                      base1_handle base1_h)
+{
+    field_index_slot_st *slot;
+    base1_handle *objs;
+    uint32_t capacity;
+    my_rc_e rc;
+
+    if (((index->used_slots + 1) * 100) >
+        (index->num_slots * FIELD_INDEX_MAX_LOAD_PCT)) {
+        rc = field_index_resize(index, index->num_slots * 2);
+        if (my_rc_e_is_notok(rc)) {
+            return (rc);
+        }
+    }
+
+    slot = &index->slots[field_index_slot(index, value)];
+    if (0 == slot->count) {
+        slot->value = value;
+        slot->count = 1;
+        slot->capacity = 0;
+        slot->obj = base1_h;
+        index->used_slots++;
+        return (MY_RC_E_SUCCESS);
+    }
+
+    if (slot->count == slot->capacity) {
+        capacity = slot->capacity * 2;
+        objs = realloc(slot->objs, capacity * sizeof(*objs));
+        if (NULL == objs) {
+            return (MY_RC_E_ENOMEM);
+        }
+        slot->objs = objs;
+        slot->capacity = capacity;
+    } else if (0 == slot->capacity) {
+        objs = malloc(FIELD_INDEX_MIN_SLOT_OBJS * sizeof(*objs));
+        if (NULL == objs) {
+            return (MY_RC_E_ENOMEM);
+        }
+        objs[0] = slot->obj;
+        slot->objs = objs;
+        slot->capacity = FIELD_INDEX_MIN_SLOT_OBJS;
+    }
+    slot->objs[slot->count++] = base1_h;
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Remove an object from a hash index.
+ *
+ * @param index The index
+ * @param value The object's value
+ * @param base1_h The object
+ * @param remove Whether to remove the object, else only look for it
+ * @return Whether the object was in the index
+ */
+static bool
+field_index_hash_del (field_index_st *index, uint64_t value,
+                      base1_handle base1_h, bool remove)
+{
+    size_t mask = index->num_slots - 1;
+    size_t hole, i, home;
+    field_index_slot_st *slot;
+    base1_handle *objs;
+    uint32_t j;
+
+    hole = field_index_slot(index, value);
+    slot = &index->slots[hole];
+    objs = field_index_slot_objs(slot);
+    for (j = 0; (j < slot->count) && (base1_h != objs[j]); j++) {
+    }
+    if ((j == slot->count) || !remove) {
+        return (j != slot->count);
+    }
+
+    objs[j] = objs[--slot->count];
+    if (0 != slot->count) {
+        return (true);
+    }
+    if (0 != slot->capacity) {
+        free(slot->objs);
+    }
+
+    i = hole;
+    while (true) {
+        i = (i + 1) & mask;
+        if (0 == index->slots[i].count) {
+            break;
+        }
+
+        /* Only move the slot if the hole lies on its probe path */
+        home = field_index_hash(index->slots[i].value) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            index->slots[hole] = index->slots[i];
+            hole = i;
+        }
+    }
+
+    memset(&index->slots[hole], 0, sizeof(index->slots[hole]));
+    index->used_slots--;
+
+    return (true);
+}
+
+/**
+ * Compare an ordered index entry to a value and object.
+ *
+ * @param entry The entry
+ * @param value The value
+ * @param base1_h The object
+ * @return Negative, zero or positive as the entry orders before, the same as
+ * or after the value and object.
+ */
+static int
+field_index_cmp (const field_index_entry_st *entry, uint64_t value,
+                 base1_handle base1_h)
+{
+    if (entry->value != value) {
+        return ((entry->value < value) ? -1 : 1);
+    }
+    if (entry->obj != base1_h) {
+        return (((uintptr_t) entry->obj < (uintptr_t) base1_h) ? -1 : 1);
+    }
+
+    return (0);
+}
+
+/**
+ * Find the leaf of an ordered index where a value and object belong.
+ *
+ * @param index The index, which must have a leaf
+ * @param value The value
+ * @param base1_h The object
+ * @return The last leaf whose first entry is not after the value and object,
+ * or the first leaf if there is none.
+ */
+static size_t
+field_index_find_leaf (const field_index_st *index, uint64_t value,
+                       base1_handle base1_h)
+{
+    size_t low = 0, high = index->num_leaves, mid;
+
+    while ((high - low) > 1) {
+        mid = low + ((high - low) / 2);
+        if (field_index_cmp(&index->firsts[mid], value, base1_h) <= 0) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    return (low);
+}
+
+/**
+ * Find the position of a value and object within a leaf.
+ *
+ * @param leaf The leaf
+ * @param value The value
+ * @param base1_h The object
+ * @return The first entry not before the value and object
+ */
+static size_t
+field_index_find_entry (const field_index_leaf_st *leaf, uint64_t value,
+                        base1_handle base1_h)
+{
+    size_t low = 0, high = leaf->count, mid;
+
+    while (low < high) {
+        mid = low + ((high - low) / 2);
+        if (field_index_cmp(&leaf->entries[mid], value, base1_h) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return (low);
+}
+
+/**
+ * Insert a leaf into the directory of an ordered index.
+ *
+ * @param index The index
+ * @param i Where the leaf goes
+ * @param leaf The leaf, which must not be empty
+ * @return Return code
+ */
+static my_rc_e
+field_index_add_leaf (field_index_st *index, size_t i,
+                      field_index_leaf_st *leaf)
+{
+    field_index_leaf_st **leaves;
+    field_index_entry_st *firsts;
+    size_t max_leaves;
+
+    if (index->num_leaves == index->max_leaves) {
+        max_leaves = (0 == index->max_leaves) ? FIELD_INDEX_MIN_LEAVES :
+            (index->max_leaves * 2);
+        leaves = realloc(index->leaves, max_leaves * sizeof(*leaves));
+        if (NULL == leaves) {
+            return (MY_RC_E_ENOMEM);
+        }
+        index->leaves = leaves;
+        firsts = realloc(index->firsts, max_leaves * sizeof(*firsts));
+        if (NULL == firsts) {
+            return (MY_RC_E_ENOMEM);
+        }
+        index->firsts = firsts;
+        index->max_leaves = max_leaves;
+    }
+
+    memmove(&index->leaves[i + 1], &index->leaves[i],
+            (index->num_leaves - i) * sizeof(*index->leaves));
+    memmove(&index->firsts[i + 1], &index->firsts[i],
+            (index->num_leaves - i) * sizeof(*index->firsts));
+    index->leaves[i] = leaf;
+    index->firsts[i] = leaf->entries[0];
+    index->num_leaves++;
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Add an object to an ordered index.  The object must not be in the index.
+ *
+ * @param index The index
+ * @param value The object's value
+ * @param base1_h The object
+ * @return Return code
+ */
+static my_rc_e
+field_index_ordered_add (field_index_st *index, uint64_t value,
+                         base1_handle base1_h)
+{
+    field_index_leaf_st *leaf, *split;
+    size_t i = 0, pos, half = FIELD_INDEX_LEAF_ENTRIES / 2;
+    my_rc_e rc;
+
+    if (0 != index->num_leaves) {
+        i = field_index_find_leaf(index, value, base1_h);
+    }
+    leaf = (0 != index->num_leaves) ? index->leaves[i] : NULL;
+
+    if ((NULL == leaf) || (FIELD_INDEX_LEAF_ENTRIES == leaf->count)) {
+        split = calloc(1, sizeof(*split));
+        if (NULL == split) {
+            return (MY_RC_E_ENOMEM);
+        }
+        if (NULL == leaf) {
+            split->entries[0].value = value;
+            split->entries[0].obj = base1_h;
+            split->count = 1;
+            rc = field_index_add_leaf(index, 0, split);
+            if (my_rc_e_is_notok(rc)) {
+                free(split);
+            }
+            return (rc);
+        }
+
+        /* Move the upper half of the full leaf to the new one */
+        memcpy(split->entries, &leaf->entries[half],
+               half * sizeof(*split->entries));
+        split->count = half;
+        rc = field_index_add_leaf(index, i + 1, split);
+        if (my_rc_e_is_notok(rc)) {
+            free(split);
+            return (rc);
+        }
+        leaf->count = half;
+        if (field_index_cmp(&split->entries[0], value, base1_h) < 0) {
+            i++;
+            leaf = split;
+        }
+    }
+
+    pos = field_index_find_entry(leaf, value, base1_h);
+    memmove(&leaf->entries[pos + 1], &leaf->entries[pos],
+            (leaf->count - pos) * sizeof(*leaf->entries));
+    leaf->entries[pos].value = value;
+    leaf->entries[pos].obj = base1_h;
+    leaf->count++;
+    index->firsts[i] = leaf->entries[0];
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Remove an object from an ordered index.
+ *
+ * @param index The index
+ * @param value The object's value
+ * @param base1_h The object
+ * @param remove Whether to remove the object, else only look for it
+ * @return Whether the object was in the index
+ */
+static bool
+field_index_ordered_del (field_index_st *index, uint64_t value,
+                         base1_handle base1_h, bool remove)
+{
+    field_index_leaf_st *leaf;
+    size_t i, pos;
+
+    if (0 == index->num_leaves) {
+        return (false);
+    }
+    i = field_index_find_leaf(index, value, base1_h);
+    leaf = index->leaves[i];
+    pos = field_index_find_entry(leaf, value, base1_h);
+    if ((pos == leaf->count) ||
+        (0 != field_index_cmp(&leaf->entries[pos], value, base1_h))) {
+        return (false);
+    }
+    if (!remove) {
+        return (true);
+    }
+
+    leaf->count--;
+    memmove(&leaf->entries[pos], &leaf->entries[pos + 1],
+            (leaf->count - pos) * sizeof(*leaf->entries));
+    if (0 != leaf->count) {
+        index->firsts[i] = leaf->entries[0];
+        return (true);
+    }
+
+    free(leaf);
+    index->num_leaves--;
+    memmove(&index->leaves[i], &index->leaves[i + 1],
+            (index->num_leaves - i) * sizeof(*index->leaves));
+    memmove(&index->firsts[i], &index->firsts[i + 1],
+            (index->num_leaves - i) * sizeof(*index->firsts));
+
+    return (true);
+}
+
+/**
+ * Add an object to an index.  The object must not be in the index.
+ *
+ * @param index The index
+ * @param value The object's value
+ * @param base1_h The object
+ * @return Return code
+ */
+static my_rc_e
+field_index_add (field_index_st *index, uint64_t value, base1_handle base1_h)
+{
+    my_rc_e rc;
+
+    if (FIELD_INDEX_KIND_E_HASH == index->kind) {
+        rc = field_index_hash_add(index, value, base1_h);
+    } else {
+        rc = field_index_ordered_add(index, value, base1_h);
+    }
+    if (my_rc_e_is_ok(rc)) {
+        index->size++;
+        __atomic_add_fetch(base1_get_field_index_refs(base1_h), 1,
+                           __ATOMIC_RELAXED);
+    }
+
+    return (rc);
+}
+
+/**
+ * Remove an object from an index.
+ *
+ * @param index The index
+ * @param value The object's value
+ * @param base1_h The object
+ * @param remove Whether to remove the object, else only look for it
+ * @return Whether the object was in the index
+ */
+static bool
+field_index_del (field_index_st *index, uint64_t value, base1_handle base1_h,
+                 bool remove)
+{
+    bool found;
+
+    if (FIELD_INDEX_KIND_E_HASH == index->kind) {
+        found = field_index_hash_del(index, value, base1_h, remove);
+    } else {
+        found = field_index_ordered_del(index, value, base1_h, remove);
+    }
+    if (found && remove) {
+        index->size--;
+        __atomic_sub_fetch(base1_get_field_index_refs(base1_h), 1,
+                           __ATOMIC_RELAXED);
+    }
+
+    return (found);
+}
+
+/**
+ * Create a new index, which starts empty.
+ *
+ * @param kind The kind of index
+ * @param field The field indexed, which must be a field of base1
+ * @return The index or NULL on failure
+ */
+field_index_handle
+field_index_new (field_index_kind_e kind, my_field_e field)
+{
+    field_index_st *index;
+
+    if (((FIELD_INDEX_KIND_E_HASH != kind) &&
+         (FIELD_INDEX_KIND_E_ORDERED != kind)) ||
+        ((MY_FIELD_E_BASE1_VAL1 != field) && (MY_FIELD_E_BASE1_VAL2 != field) &&
+         (MY_FIELD_E_BASE1_VAL3 != field))) {
+        LOG_ERR("Invalid input, kind(%u) field(%u)", kind, field);
+        return (NULL);
+    }
+
+    index = calloc(1, sizeof(*index));
+    if (NULL == index) {
+        return (NULL);
+    }
+    index->kind = kind;
+    index->field = field;
+    if ((FIELD_INDEX_KIND_E_HASH == kind) &&
+        my_rc_e_is_notok(field_index_resize(index, FIELD_INDEX_MIN_SLOTS))) {
+        free(index);
+        return (NULL);
+    }
+
+    pthread_rwlock_wrlock(&field_index_lock);
+    index->next = field_index_list;
+    field_index_list = index;
+    __atomic_add_fetch(&field_index_field_counts[field], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&field_index_count, 1, __ATOMIC_RELAXED);
+    pthread_rwlock_unlock(&field_index_lock);
+
+    return (index);
+}
+
+/**
+ * Delete an index.  The objects in it are unaffected, except that they no
+ * longer count it.
+ *
+ * @param field_index_h The index.  If NULL, then this function is a no-op.
+ */
+void
+field_index_delete (field_index_handle field_index_h)
+{
+    field_index_st **prev;
+    field_index_slot_st *slot;
+    base1_handle *objs;
+    size_t i, j;
+
+    if (NULL == field_index_h) {
+        return;
+    }
+
+    pthread_rwlock_wrlock(&field_index_lock);
+    for (prev = &field_index_list; NULL != *prev; prev = &(*prev)->next) {
+        if (field_index_h == *prev) {
+            *prev = field_index_h->next;
+            __atomic_sub_fetch(&field_index_field_counts[field_index_h->field],
+                               1, __ATOMIC_RELAXED);
+            __atomic_sub_fetch(&field_index_count, 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+
+    for (i = 0; i < field_index_h->num_slots; i++) {
+        slot = &field_index_h->slots[i];
+        objs = field_index_slot_objs(slot);
+        for (j = 0; j < slot->count; j++) {
+            __atomic_sub_fetch(base1_get_field_index_refs(objs[j]), 1,
+                               __ATOMIC_RELAXED);
+        }
+    }
+    for (i = 0; i < field_index_h->num_leaves; i++) {
+        for (j = 0; j < field_index_h->leaves[i]->count; j++) {
+            __atomic_sub_fetch(
+                base1_get_field_index_refs(field_index_h->leaves[i]->
+                                           entries[j].obj),
+                1, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_rwlock_unlock(&field_index_lock);
+
+    for (i = 0; i < field_index_h->num_slots; i++) {
+        if (0 != field_index_h->slots[i].capacity) {
+            free(field_index_h->slots[i].objs);
+        }
+    }
+    free(field_index_h->slots);
+    for (i = 0; i < field_index_h->num_leaves; i++) {
+        free(field_index_h->leaves[i]);
+    }
+    free(field_index_h->leaves);
+    free(field_index_h->firsts);
+    free(field_index_h);
+}
+
+/**
+ * Add an object to an index.  Adding an object already in the index has no
+ * effect.
+ *
+ * @param field_index_h The index
+ * @param base1_h The object
+ * @return Return code
+ */
+my_rc_e
+field_index_insert (field_index_handle field_index_h, base1_handle base1_h)
+{
+    uint64_t value;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if ((NULL == field_index_h) || (NULL == base1_h)) {
+        LOG_ERR("Invalid input, field_index_h(%p) base1_h(%p)", field_index_h,
+                base1_h);
+        return (MY_RC_E_EINVAL);
+    }
+
+    value = field_index_value(base1_h, field_index_h->field);
+    pthread_rwlock_wrlock(&field_index_lock);
+    if (!field_index_del(field_index_h, value, base1_h, false)) {
+        rc = field_index_add(field_index_h, value, base1_h);
+    }
+    pthread_rwlock_unlock(&field_index_lock);
+
+    return (rc);
+}
+
+/**
+ * Remove an object from an index.  Removing an object not in the index has no
+ * effect.
+ *
+ * @param field_index_h The index
+ * @param base1_h The object
+ * @return Return code
+ */
+my_rc_e
+field_index_remove (field_index_handle field_index_h, base1_handle base1_h)
+{
+    if ((NULL == field_index_h) || (NULL == base1_h)) {
+        LOG_ERR("Invalid input, field_index_h(%p) base1_h(%p)", field_index_h,
+                base1_h);
+        return (MY_RC_E_EINVAL);
+    }
+
+    pthread_rwlock_wrlock(&field_index_lock);
+    field_index_del(field_index_h,
+                    field_index_value(base1_h, field_index_h->field), base1_h,
+                    true);
+    pthread_rwlock_unlock(&field_index_lock);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Get the number of objects in an index.
+ *
+ * @param field_index_h The index
+ * @return The number of objects
+ */
+size_t
+field_index_size (field_index_handle field_index_h)
+{
+    size_t size;
+
+    if (NULL == field_index_h) {
+        return (0);
+    }
+
+    pthread_rwlock_rdlock(&field_index_lock);
+    size = field_index_h->size;
+    pthread_rwlock_unlock(&field_index_lock);
+
+    return (size);
+}
+
+/**
+ * Find the objects in an ordered index with a value in a range.
+ *
+ * @param index The index
+ * @param low The lowest value
+ * @param high The highest value
+ * @param objs Outputs the first max_objs objects, in order of value
+ * @param max_objs Room in objs
+ * @return The number of objects found
+ */
+static size_t
+field_index_ordered_range (const field_index_st *index, uint64_t low,
+                           uint64_t high, base1_handle *objs, size_t max_objs)
+{
+    const field_index_leaf_st *leaf;
+    size_t count = 0, i, pos;
+
+    if ((0 == index->num_leaves) || (low > high)) {
+        return (0);
+    }
+
+    i = field_index_find_leaf(index, low, NULL);
+    pos = field_index_find_entry(index->leaves[i], low, NULL);
+    for (; i < index->num_leaves; i++, pos = 0) {
+        leaf = index->leaves[i];
+        for (; pos < leaf->count; pos++) {
+            if (leaf->entries[pos].value > high) {
+                return (count);
+            }
+            if (count < max_objs) {
+                objs[count] = leaf->entries[pos].obj;
+            }
+            count++;
+        }
+    }
+
+    return (count);
+}
+
+/**
+ * Find the objects in an index with a value.
+ *
+ * @param field_index_h The index
+ * @param value The value
+ * @param objs Outputs up to max_objs of the objects.  May be NULL if max_objs
+ * is zero.
+ * @param max_objs Room in objs
+ * @param count Outputs the number of objects with the value, which may be
+ * more than max_objs.
+ * @return Return code
+ */
+my_rc_e
+field_index_lookup (field_index_handle field_index_h, uint64_t value,
+                    base1_handle *objs, size_t max_objs, size_t *count)
+{
+    field_index_slot_st *slot;
+
+    if ((NULL == field_index_h) || ((NULL == objs) && (0 != max_objs)) ||
+        (NULL == count)) {
+        LOG_ERR("Invalid input, field_index_h(%p) objs(%p) count(%p)",
+                field_index_h, objs, count);
+        return (MY_RC_E_EINVAL);
+    }
+
+    pthread_rwlock_rdlock(&field_index_lock);
+    if (FIELD_INDEX_KIND_E_HASH == field_index_h->kind) {
+        slot = &field_index_h->slots[field_index_slot(field_index_h, value)];
+        *count = slot->count;
+        memcpy(objs, field_index_slot_objs(slot),
+               ((*count < max_objs) ? *count : max_objs) * sizeof(*objs));
+    } else {
+        *count = field_index_ordered_range(field_index_h, value, value, objs,
+                                           max_objs);
+    }
+    pthread_rwlock_unlock(&field_index_lock);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Find the objects in an ordered index with a value in a range.
+ *
+ * @param field_index_h The index, which must be ordered
+ * @param low The lowest value
+ * @param high The highest value
+ * @param objs Outputs up to max_objs of the objects, in order of value.  May
+ * be NULL if max_objs is zero.
+ * @param max_objs Room in objs
+ * @param count Outputs the number of objects in the range, which may be more
+ * than max_objs.
+ * @return Return code, MY_RC_E_EINVAL if the index is not ordered.
+ */
+my_rc_e
+field_index_range (field_index_handle field_index_h, uint64_t low,
+                   uint64_t high, base1_handle *objs, size_t max_objs,
+                   size_t *count)
+{
+    if ((NULL == field_index_h) ||
+        (FIELD_INDEX_KIND_E_ORDERED != field_index_h->kind) ||
+        ((NULL == objs) && (0 != max_objs)) || (NULL == count)) {
+        LOG_ERR("Invalid input, field_index_h(%p) objs(%p) count(%p)",
+                field_index_h, objs, count);
+        return (MY_RC_E_EINVAL);
+    }
+
+    pthread_rwlock_rdlock(&field_index_lock);
+    *count = field_index_ordered_range(field_index_h, low, high, objs,
+                                       max_objs);
+    pthread_rwlock_unlock(&field_index_lock);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Move an object whose field changed to its new value in every index on the
+ * field holding it.  Returns without the lock if no index holds the object or
+ * is on the field.
+ *
+ * @param base1_h The object
+ * @param field The field
+ * @param old_value The value before the change
+ * @param new_value The value after the change
+ * @see FIELD_INDEX_UPDATE()
+ */
+void
+field_index_update (base1_handle base1_h, my_field_e field, uint64_t old_value,
+                    uint64_t new_value)
+{
+    field_index_st *index;
+
+    if ((0 == __atomic_load_n(&field_index_field_counts[field],
+                              __ATOMIC_RELAXED)) ||
+        (0 == __atomic_load_n(base1_get_field_index_refs(base1_h),
+                              __ATOMIC_RELAXED))) {
+        return;
+    }
+
+    pthread_rwlock_wrlock(&field_index_lock);
+    for (index = field_index_list; NULL != index; index = index->next) {
+        if ((field == index->field) &&
+            field_index_del(index, old_value, base1_h, true) &&
+            my_rc_e_is_notok(field_index_add(index, new_value, base1_h))) {
+            LOG_ERR("Dropped from index, handle(%p) field(%s)", base1_h,
+                    my_field_e_get_string(field));
+        }
+    }
+    pthread_rwlock_unlock(&field_index_lock);
+}
+
+/**
+ * Remove an object from every index holding it.  Returns without the lock if
+ * no index holds the object.
+ *
+ * @param base1_h The object
+ * @see FIELD_INDEX_FORGET()
+ */
+void
+field_index_forget (base1_handle base1_h)
+{
+    field_index_st *index;
+
+    if (0 == __atomic_load_n(base1_get_field_index_refs(base1_h),
+                             __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    pthread_rwlock_wrlock(&field_index_lock);
+    for (index = field_index_list; NULL != index; index = index->next) {
+        field_index_del(index, field_index_value(base1_h, index->field),
+                        base1_h, true);
+    }
+    pthread_rwlock_unlock(&field_index_lock);
+}
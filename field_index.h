@@ -0,0 +1,132 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for secondary indexes on fields of base1.  An
+ * index finds the objects with a field equal to a value, or for an ordered
+ * index within a range of values, without scanning every object.
+ *
+ * A hash index is an open addressing table from each value to the objects
+ * having it, giving lookups in constant time.  It suits fields whose values are
+ * mostly distinct, since removing an object scans the others sharing its value.
+ * An ordered index keeps the objects sorted by value in blocks of contiguous
+ * entries under a sorted directory of the blocks, which is a two level B+-tree.
+ * Lookups and updates are logarithmic and a range is read block by block in
+ * order.
+ *
+ * Objects are added to an index explicitly.  From then on the index follows the
+ * object: base1_set_public_data(), base1_increase_val3() and base1_reset() move
+ * it to its new value, and deleting it or putting it in a recycle bin or object
+ * pool removes it.
+ */
+#ifndef __FIELD_INDEX_H__
+#define __FIELD_INDEX_H__
+
+#include "common.h"
+#include "base1.h"
+#include "class_registry.h"
+
+/** The kinds of index */
+typedef enum field_index_kind_e_ {
+    /** Not a valid kind */
+    FIELD_INDEX_KIND_E_INVALID,
+    /** Equality lookups in constant time */
+    FIELD_INDEX_KIND_E_HASH,
+    /** Equality and range lookups in logarithmic time */
+    FIELD_INDEX_KIND_E_ORDERED,
+    /** The number of kinds */
+    FIELD_INDEX_KIND_E_MAX,
+} field_index_kind_e;
+
+/** Opaque handle of an index */
+typedef struct field_index_st_ *field_index_handle;
+
+/** Number of indexes which exist.  Use field_index_is_enabled(). */
+extern uint32_t field_index_count;
+
+/**
+ * Indicates whether any index exists.  This is inline since it is checked on
+ * every mutation and deletion.
+ *
+ * @return true if an index exists.
+ */
+static inline bool
+field_index_is_enabled (void)
+{
+    return (0 != __atomic_load_n(&field_index_count, __ATOMIC_RELAXED));
+}
+
+/**
+ * Move a mutated object to its new value in the indexes on the field if any
+ * index exists and the value changed.  The arguments are only evaluated when
+ * an index exists.
+ */
+#define FIELD_INDEX_UPDATE(base1_h, field, old_value, new_value) \
+do { \
+    if (field_index_is_enabled() && ((old_value) != (new_value))) { \
+        field_index_update((base1_h), (field), (old_value), (new_value)); \
+    } \
+} while (0)
+
+/**
+ * Remove an object from every index if any index exists.  The argument is
+ * only evaluated when an index exists.
+ */
+#define FIELD_INDEX_FORGET(base1_h) \
+do { \
+    if (field_index_is_enabled()) { \
+        field_index_forget(base1_h); \
+    } \
+} while (0)
+
+/* APIs below are documented in their implementation file */
+
+extern field_index_handle
+field_index_new(field_index_kind_e kind, my_field_e field);
+
+extern void
+field_index_delete(field_index_handle field_index_h);
+
+extern my_rc_e
+field_index_insert(field_index_handle field_index_h, base1_handle base1_h);
+
+extern my_rc_e
+field_index_remove(field_index_handle field_index_h, base1_handle base1_h);
+
+extern size_t
+field_index_size(field_index_handle field_index_h);
+
+extern my_rc_e
+field_index_lookup(field_index_handle field_index_h, uint64_t value,
+                   base1_handle *objs, size_t max_objs, size_t *count);
+
+extern my_rc_e
+field_index_range(field_index_handle field_index_h, uint64_t low,
+                  uint64_t high, base1_handle *objs, size_t max_objs,
+                  size_t *count);
+
+extern void
+field_index_update(base1_handle base1_h, my_field_e field, uint64_t old_value,
+                   uint64_t new_value);
+
+extern void
+field_index_forget(base1_handle base1_h);
+
+#endif
@@ -0,0 +1,382 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements flyweight objects on top of the object table.
+ *
+ * Each class has one shared instance, constructed when the first flyweight of
+ * the class is made and deleted when the last one is deleted or materialized.
+ * Since a flyweight is an object table reference, materializing a copy only
+ * replaces the object in its slot; the reference held by the caller is
+ * unchanged.  The shared instance is read-only, so the mutators, recycle bins
+ * and object pools refuse a base1_handle to it from flyweight_get().
+ */
+#include <pthread.h>
+#include "flyweight.h"
+#include "base1_friend.h"
+#include "derived1.h"
+#include "derived2.h"
+
+/** The shared instance of a class */
+typedef struct flyweight_class_st_ {
+    /** Protects the instance and count */
+    pthread_mutex_t lock;
+    /** The shared instance or NULL if there are no flyweights */
+    base1_handle instance;
+    /** Number of flyweights sharing the instance */
+    size_t count;
+} flyweight_class_st;
+
+/** The shared instance of each class */
+static flyweight_class_st flyweight_classes[MY_CLASS_ID_E_MAX] = {
+    [0 ... (MY_CLASS_ID_E_MAX - 1)] = { .lock = PTHREAD_MUTEX_INITIALIZER },
+};
+
+/**
+ * Construct an object of a class in its default state.
+ *
+ * @param class_id The class
+ * @return The object or NULL if the class cannot be constructed.
+ */
+static base1_handle
+flyweight_construct (my_class_id_e class_id)
+{
+    switch (class_id) {
+    case MY_CLASS_ID_E_BASE1:
+        return (base1_new1());
+    case MY_CLASS_ID_E_DERIVED1:
+        return (derived1_cast_to_base1(derived1_new1()));
+    case MY_CLASS_ID_E_DERIVED2:
+        return (derived1_cast_to_base1(derived2_cast_to_derived1(
+            derived2_new1())));
+    default:
+        LOG_ERR("Class has no flyweights, class_id(%s)",
+                my_class_id_e_get_string(class_id));
+        return (NULL);
+    }
+}
+
+/**
+ * Take a reference on the shared instance of a class, constructing it if
+ * needed.
+ *
+ * @param class_id The class
+ * @return The shared instance or NULL on failure
+ */
+static base1_handle
+flyweight_acquire (my_class_id_e class_id)
+{
+    flyweight_class_st *fw_class = &flyweight_classes[class_id];
+    base1_handle base1_h;
+
+    pthread_mutex_lock(&fw_class->lock);
+    if (NULL == fw_class->instance) {
+        base1_h = flyweight_construct(class_id);
+        if (NULL != base1_h) {
+            base1_set_read_only(base1_h, true);
+        }
+        __atomic_store_n(&fw_class->instance, base1_h, __ATOMIC_RELEASE);
+    }
+    base1_h = fw_class->instance;
+    if (NULL != base1_h) {
+        fw_class->count++;
+    }
+    pthread_mutex_unlock(&fw_class->lock);
+
+    return (base1_h);
+}
+
+/**
+ * Drop a reference on the shared instance of a class, deleting it if it was
+ * the last.
+ *
+ * @param class_id The class
+ */
+static void
+flyweight_release (my_class_id_e class_id)
+{
+    flyweight_class_st *fw_class = &flyweight_classes[class_id];
+    base1_handle base1_h = NULL;
+
+    pthread_mutex_lock(&fw_class->lock);
+    if (0 == --fw_class->count) {
+        base1_h = fw_class->instance;
+        __atomic_store_n(&fw_class->instance, NULL, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&fw_class->lock);
+
+    if (NULL != base1_h) {
+        base1_delete(base1_h);
+    }
+}
+
+/**
+ * Indicates whether an object is the shared instance of its class.
+ *
+ * @param ref Reference the object was resolved from
+ * @param base1_h The object
+ * @return true if the object is shared
+ */
+static inline bool
+flyweight_is_instance (obj_ref ref, base1_handle base1_h)
+{
+    return ((NULL != base1_h) &&
+            (base1_h == __atomic_load_n(
+                &flyweight_classes[obj_ref_class_id(ref)].instance,
+                __ATOMIC_ACQUIRE)));
+}
+
+/**
+ * Create a flyweight of a class.  Until it is modified, the flyweight costs
+ * only its object table slot.
+ *
+ * @param class_id The class, which must have a *_new1() constructor
+ * @return A reference to the flyweight or OBJ_REF_INVALID on failure.
+ */
+obj_ref
+flyweight_new (my_class_id_e class_id)
+{
+    base1_handle base1_h;
+    obj_ref ref;
+
+    if (!my_class_id_e_is_valid(class_id)) {
+        LOG_ERR("Invalid input, class_id(%u)", class_id);
+        return (OBJ_REF_INVALID);
+    }
+
+    base1_h = flyweight_acquire(class_id);
+    if (NULL == base1_h) {
+        return (OBJ_REF_INVALID);
+    }
+
+    ref = obj_table_insert_shared(base1_h);
+    if (OBJ_REF_INVALID == ref) {
+        flyweight_release(class_id);
+    }
+
+    return (ref);
+}
+
+/**
+ * Get the object of a flyweight for reading.  The object may be shared, in
+ * which case it is read-only; use flyweight_get_mutable() to modify it.
+ *
+ * @param ref Reference to the flyweight
+ * @return The object or NULL if the reference is invalid or stale.
+ */
+base1_handle
+flyweight_get (obj_ref ref)
+{
+    return (obj_table_resolve(ref));
+}
+
+/**
+ * Indicates whether a flyweight still shares the instance of its class.
+ *
+ * @param ref Reference to the flyweight
+ * @return true if the flyweight is shared
+ */
+bool
+flyweight_is_shared (obj_ref ref)
+{
+    return (flyweight_is_instance(ref, obj_table_resolve(ref)));
+}
+
+/**
+ * Get the object of a flyweight for modification.  If the flyweight still
+ * shares the instance of its class, it is given its own copy first.
+ *
+ * @param ref Reference to the flyweight
+ * @return The object or NULL if the reference is invalid or stale or the copy
+ * failed.
+ */
+base1_handle
+flyweight_get_mutable (obj_ref ref)
+{
+    base1_handle base1_h, copy_h;
+    my_rc_e rc;
+
+    while (true) {
+        base1_h = obj_table_resolve(ref);
+        if (!flyweight_is_instance(ref, base1_h)) {
+            return (base1_h);
+        }
+
+        copy_h = base1_clone(base1_h);
+        if (NULL == copy_h) {
+            return (NULL);
+        }
+
+        rc = obj_table_replace(ref, base1_h, copy_h, false);
+        if (my_rc_e_is_ok(rc)) {
+            flyweight_release(obj_ref_class_id(ref));
+            return (copy_h);
+        }
+
+        /* Another thread materialized or deleted the flyweight first */
+        base1_delete(copy_h);
+        if (MY_RC_E_EAGAIN != rc) {
+            return (NULL);
+        }
+    }
+}
+
+/**
+ * Set the public data of a flyweight.  Setting a shared flyweight to the data
+ * it already has does not give it its own copy.
+ *
+ * @param ref Reference to the flyweight
+ * @param public_data The data to set
+ * @return Return code
+ * @see base1_set_public_data()
+ */
+my_rc_e
+flyweight_set_public_data (obj_ref ref, base1_public_data_st *public_data)
+{
+    base1_public_data_st cur_data;
+    base1_handle base1_h;
+
+    if (NULL == public_data) {
+        LOG_ERR("Invalid input, public_data(%p)", public_data);
+        return (MY_RC_E_EINVAL);
+    }
+
+    base1_h = obj_table_resolve(ref);
+    if (flyweight_is_instance(ref, base1_h) &&
+        my_rc_e_is_ok(base1_get_public_data(base1_h, &cur_data)) &&
+        (cur_data.val1 == public_data->val1) &&
+        (cur_data.val2 == public_data->val2)) {
+        return (MY_RC_E_SUCCESS);
+    }
+
+    base1_h = flyweight_get_mutable(ref);
+    if (NULL == base1_h) {
+        return (MY_RC_E_EINVAL);
+    }
+
+    return (base1_set_public_data(base1_h, public_data));
+}
+
+/**
+ * Increase val3 of a flyweight.
+ *
+ * @param ref Reference to the flyweight
+ * @return Return code
+ * @see base1_increase_val3()
+ */
+my_rc_e
+flyweight_increase_val3 (obj_ref ref)
+{
+    base1_handle base1_h;
+
+    base1_h = flyweight_get_mutable(ref);
+    if (NULL == base1_h) {
+        return (MY_RC_E_EINVAL);
+    }
+
+    return (base1_increase_val3(base1_h));
+}
+
+/**
+ * Return a flyweight to the default state of its class.  A flyweight with its
+ * own copy goes back to sharing the instance of its class and its copy is
+ * deleted.
+ *
+ * @param ref Reference to the flyweight
+ * @return Return code
+ */
+my_rc_e
+flyweight_reset (obj_ref ref)
+{
+    base1_handle base1_h, shared_h;
+    my_rc_e rc;
+
+    base1_h = obj_table_resolve(ref);
+    if (NULL == base1_h) {
+        return (MY_RC_E_EINVAL);
+    }
+
+    if (flyweight_is_instance(ref, base1_h)) {
+        return (MY_RC_E_SUCCESS);
+    }
+
+    shared_h = flyweight_acquire(obj_ref_class_id(ref));
+    if (NULL == shared_h) {
+        return (MY_RC_E_ENOMEM);
+    }
+
+    rc = obj_table_replace(ref, base1_h, shared_h, true);
+    if (my_rc_e_is_notok(rc)) {
+        flyweight_release(obj_ref_class_id(ref));
+        return (rc);
+    }
+
+    base1_delete(base1_h);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Delete a flyweight.  Stale references are ignored.
+ *
+ * @param ref Reference to the flyweight
+ */
+void
+flyweight_delete (obj_ref ref)
+{
+    base1_handle base1_h;
+    bool shared;
+
+    base1_h = obj_table_resolve(ref);
+    if (NULL == base1_h) {
+        return;
+    }
+    shared = flyweight_is_instance(ref, base1_h);
+
+    if (obj_table_remove(ref)) {
+        if (shared) {
+            flyweight_release(obj_ref_class_id(ref));
+        } else {
+            base1_delete(base1_h);
+        }
+    }
+}
+
+/**
+ * Get the number of flyweights of a class sharing its instance.
+ *
+ * @param class_id The class
+ * @return The number of shared flyweights
+ */
+size_t
+flyweight_shared_count (my_class_id_e class_id)
+{
+    size_t count;
+
+    if (!my_class_id_e_is_valid(class_id)) {
+        return (0);
+    }
+
+    pthread_mutex_lock(&flyweight_classes[class_id].lock);
+    count = flyweight_classes[class_id].count;
+    pthread_mutex_unlock(&flyweight_classes[class_id].lock);
+
+    return (count);
+}
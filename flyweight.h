@@ -0,0 +1,64 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for flyweight objects.  A flyweight is a
+ * reference to an object in the default state of its class which shares a
+ * single immutable instance with all other unmodified flyweights of the class.
+ * The first mutation through the flyweight API gives the flyweight its own copy
+ * of the object, transparently to holders of the reference.
+ */
+#ifndef __FLYWEIGHT_H__
+#define __FLYWEIGHT_H__
+
+#include "common.h"
+#include "base1.h"
+#include "obj_table.h"
+
+/* APIs below are documented in their implementation file */
+
+extern obj_ref
+flyweight_new(my_class_id_e class_id);
+
+extern base1_handle
+flyweight_get(obj_ref ref);
+
+extern base1_handle
+flyweight_get_mutable(obj_ref ref);
+
+extern bool
+flyweight_is_shared(obj_ref ref);
+
+extern my_rc_e
+flyweight_set_public_data(obj_ref ref, base1_public_data_st *public_data);
+
+extern my_rc_e
+flyweight_increase_val3(obj_ref ref);
+
+extern my_rc_e
+flyweight_reset(obj_ref ref);
+
+extern void
+flyweight_delete(obj_ref ref);
+
+extern size_t
+flyweight_shared_count(my_class_id_e class_id);
+
+#endif
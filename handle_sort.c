@@ -0,0 +1,444 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements radix sorting of handle arrays.
+ *
+ * The key of each handle is read once into an array of key and handle pairs,
+ * which the passes then sort by one byte of the key at a time, alternating
+ * between that array and a second one.  Reading the keys is a gather over
+ * scattered objects, so objects are prefetched a fixed distance ahead.  The
+ * number of passes is the number of bytes in the largest key, and a pass in
+ * which every key has the same byte is skipped, so sorting by class is a single
+ * pass.
+ *
+ * With several threads, each owns an equal range of the array.  For each pass,
+ * every thread counts the bytes in its range, one thread turns the counts into
+ * where each thread writes each byte, and every thread then moves its range.
+ * Ranges are laid out in thread order within each byte, so the sort stays
+ * stable.  Barriers separate the steps.
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <unistd.h>
+#include "handle_sort.h"
+
+/** Bits sorted by each pass */
+#define HANDLE_SORT_DIGIT_BITS 8
+
+/** Number of values of a digit */
+#define HANDLE_SORT_DIGITS (1 << HANDLE_SORT_DIGIT_BITS)
+
+/** How many objects ahead of reading keys an object is prefetched */
+#define HANDLE_SORT_PREFETCH_DISTANCE 16
+
+/** Fewest handles each thread sorts */
+#define HANDLE_SORT_MIN_PER_THREAD 4096
+
+/** A handle with its key */
+typedef struct handle_sort_item_st_ {
+    /** The key */
+    uint64_t key;
+    /** The handle */
+    base1_handle obj;
+} handle_sort_item_st;
+
+/** A sort shared by its threads */
+typedef struct handle_sort_st_ {
+    /** The handles */
+    base1_handle *objs;
+    /** Number of handles */
+    size_t count;
+    /** Number of threads */
+    size_t num_threads;
+    /** Whether the key is the class ID, else the field */
+    bool by_class;
+    /** Whether objects of each class have the field */
+    bool has[MY_CLASS_ID_E_MAX];
+    /** Offset of the field from the base1 view, for each class */
+    ptrdiff_t offsets[MY_CLASS_ID_E_MAX];
+    /** Width of the field, for each class */
+    size_t widths[MY_CLASS_ID_E_MAX];
+    /** Key of objects lacking the field, past every value of the field */
+    uint64_t missing_key;
+    /** The keys and handles */
+    handle_sort_item_st *items;
+    /** The array the passes alternate with */
+    handle_sort_item_st *spare;
+    /** Per thread, the counts of each digit and then where each goes */
+    size_t (*counts)[HANDLE_SORT_DIGITS];
+    /** Per thread, the largest key */
+    uint64_t *max_keys;
+    /** Number of handles with each digit in the first pass */
+    size_t totals[HANDLE_SORT_DIGITS];
+    /** Whether the current pass is skipped */
+    bool skip;
+    /** Separates the steps of a pass */
+    pthread_barrier_t barrier;
+    /** Held while threads are started, until the number started is known */
+    pthread_mutex_t start_lock;
+} handle_sort_st;
+
+/** A thread of a sort */
+typedef struct handle_sort_thread_st_ {
+    /** The sort */
+    handle_sort_st *sort;
+    /** Index of the thread */
+    size_t id;
+} handle_sort_thread_st;
+
+/**
+ * Load an unsigned field of the given width.
+ *
+ * @param ptr The field
+ * @param width The width of the field
+ * @return The value
+ */
+static inline uint64_t
+handle_sort_load (const uint8_t *ptr, size_t width)
+{
+    uint16_t val16;
+    uint32_t val32;
+    uint64_t val64;
+
+    switch (width) {
+    case 1:
+        return (*ptr);
+    case 2:
+        memcpy(&val16, ptr, sizeof(val16));
+        return (val16);
+    case 4:
+        memcpy(&val32, ptr, sizeof(val32));
+        return (val32);
+    default:
+        memcpy(&val64, ptr, sizeof(val64));
+        return (val64);
+    }
+}
+
+/**
+ * Get the key of an object.
+ *
+ * @param sort The sort
+ * @param base1_h The object
+ * @return The key
+ */
+static inline uint64_t
+handle_sort_key (const handle_sort_st *sort, base1_handle base1_h)
+{
+    my_class_id_e class_id = base1_class_id(base1_h);
+
+    if (sort->by_class) {
+        return (class_id);
+    }
+    if (!my_class_id_e_is_valid(class_id) || !sort->has[class_id]) {
+        return (sort->missing_key);
+    }
+
+    return (handle_sort_load((const uint8_t *) base1_h +
+                             sort->offsets[class_id], sort->widths[class_id]));
+}
+
+/**
+ * Sort a thread's range of the handles, in step with the other threads.
+ *
+ * @param arg The thread
+ * @return NULL
+ */
+static void *
+handle_sort_thread (void *arg)
+{
+    handle_sort_thread_st *thread = arg;
+    handle_sort_st *sort = thread->sort;
+    handle_sort_item_st *src = sort->items, *dst = sort->spare, *swap;
+    size_t i, t, d, next, first, shift, start, end, *counts, bits = 0;
+    uint64_t max_key = 0, key;
+
+    pthread_mutex_lock(&sort->start_lock);
+    pthread_mutex_unlock(&sort->start_lock);
+    start = (sort->count * thread->id) / sort->num_threads;
+    end = (sort->count * (thread->id + 1)) / sort->num_threads;
+    counts = sort->counts[thread->id];
+
+    for (i = start; i < end; i++) {
+        if ((i + HANDLE_SORT_PREFETCH_DISTANCE) < end) {
+            __builtin_prefetch(sort->objs[i + HANDLE_SORT_PREFETCH_DISTANCE]);
+        }
+        key = handle_sort_key(sort, sort->objs[i]);
+        src[i].key = key;
+        src[i].obj = sort->objs[i];
+        max_key = (key > max_key) ? key : max_key;
+    }
+    sort->max_keys[thread->id] = max_key;
+    pthread_barrier_wait(&sort->barrier);
+
+    for (t = 0; t < sort->num_threads; t++) {
+        max_key = (sort->max_keys[t] > max_key) ? sort->max_keys[t] : max_key;
+    }
+    while ((bits < 64) && (0 != (max_key >> bits))) {
+        bits += HANDLE_SORT_DIGIT_BITS;
+    }
+
+    for (shift = 0; (0 == shift) || (shift < bits);
+         shift += HANDLE_SORT_DIGIT_BITS) {
+        memset(counts, 0, sizeof(sort->counts[0]));
+        for (i = start; i < end; i++) {
+            counts[(src[i].key >> shift) & (HANDLE_SORT_DIGITS - 1)]++;
+        }
+        pthread_barrier_wait(&sort->barrier);
+
+        if (0 == thread->id) {
+            next = 0;
+            sort->skip = false;
+            for (d = 0; d < HANDLE_SORT_DIGITS; d++) {
+                if (0 == shift) {
+                    sort->totals[d] = 0;
+                }
+                first = next;
+                for (t = 0; t < sort->num_threads; t++) {
+                    if (0 == shift) {
+                        sort->totals[d] += sort->counts[t][d];
+                    }
+                    i = sort->counts[t][d];
+                    sort->counts[t][d] = next;
+                    next += i;
+                }
+                /* Skip the pass if every thread's keys have the digit */
+                sort->skip |= (sort->count == (next - first));
+            }
+        }
+        pthread_barrier_wait(&sort->barrier);
+
+        if (!sort->skip) {
+            for (i = start; i < end; i++) {
+                dst[counts[(src[i].key >> shift) &
+                           (HANDLE_SORT_DIGITS - 1)]++] = src[i];
+            }
+            swap = src;
+            src = dst;
+            dst = swap;
+        }
+        pthread_barrier_wait(&sort->barrier);
+    }
+
+    for (i = start; i < end; i++) {
+        sort->objs[i] = src[i].obj;
+    }
+
+    return (NULL);
+}
+
+/**
+ * Run a sort whose keys are set up.
+ *
+ * @param sort The sort
+ * @param num_threads Number of threads, zero to use one per online CPU if
+ * there are at least HANDLE_SORT_PARALLEL_MIN_OBJECTS handles.
+ * @return Return code
+ */
+static my_rc_e
+handle_sort_run (handle_sort_st *sort, size_t num_threads)
+{
+    handle_sort_thread_st *threads = NULL;
+    pthread_t *pthreads = NULL;
+    size_t started = 1, i;
+    long num_cpus;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if (0 == sort->count) {
+        return (MY_RC_E_SUCCESS);
+    }
+
+    if (0 == num_threads) {
+        num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = ((sort->count < HANDLE_SORT_PARALLEL_MIN_OBJECTS) ||
+                       (num_cpus < 1)) ? 1 : num_cpus;
+    }
+    if (num_threads > ((sort->count / HANDLE_SORT_MIN_PER_THREAD) + 1)) {
+        num_threads = (sort->count / HANDLE_SORT_MIN_PER_THREAD) + 1;
+    }
+    sort->num_threads = num_threads;
+
+    sort->items = malloc(sort->count * sizeof(*sort->items));
+    sort->spare = malloc(sort->count * sizeof(*sort->spare));
+    sort->counts = malloc(num_threads * sizeof(*sort->counts));
+    sort->max_keys = malloc(num_threads * sizeof(*sort->max_keys));
+    threads = malloc(num_threads * sizeof(*threads));
+    pthreads = malloc(num_threads * sizeof(*pthreads));
+    if ((NULL == sort->items) || (NULL == sort->spare) ||
+        (NULL == sort->counts) || (NULL == sort->max_keys) ||
+        (NULL == threads) || (NULL == pthreads)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    /*
+     * Threads wait to start until the number which could be created is
+     * known, since that sets their ranges and the barrier's count.  The
+     * calling thread is thread zero.
+     */
+    pthread_mutex_init(&sort->start_lock, NULL);
+    pthread_mutex_lock(&sort->start_lock);
+    for (i = 0; i < num_threads; i++) {
+        threads[i].sort = sort;
+        threads[i].id = i;
+    }
+    for (; started < num_threads; started++) {
+        if (0 != pthread_create(&pthreads[started], NULL, handle_sort_thread,
+                                &threads[started])) {
+            break;
+        }
+    }
+    sort->num_threads = started;
+    pthread_barrier_init(&sort->barrier, NULL, started);
+    pthread_mutex_unlock(&sort->start_lock);
+
+    handle_sort_thread(&threads[0]);
+    for (i = 1; i < started; i++) {
+        pthread_join(pthreads[i], NULL);
+    }
+    pthread_barrier_destroy(&sort->barrier);
+    pthread_mutex_destroy(&sort->start_lock);
+
+exit:
+
+    free(sort->items);
+    free(sort->spare);
+    free(sort->counts);
+    free(sort->max_keys);
+    free(threads);
+    free(pthreads);
+
+    return (rc);
+}
+
+/**
+ * Stably partition handles by the class of their objects, in order of class
+ * ID.  Each class's objects are then contiguous, so they can be dispatched
+ * as a batch.
+ *
+ * @param objs The handles, reordered
+ * @param count Number of handles
+ * @param num_threads Number of threads, zero to use one per online CPU if
+ * there are at least HANDLE_SORT_PARALLEL_MIN_OBJECTS handles.
+ * @param class_counts Outputs the number of objects of each class, indexed
+ * by class ID.  It must have MY_CLASS_ID_E_MAX entries.  May be NULL.
+ * @return Return code
+ */
+my_rc_e
+handle_sort_by_class (base1_handle *objs, size_t count, size_t num_threads,
+                      size_t *class_counts)
+{
+    handle_sort_st *sort;
+    my_class_id_e class_id;
+    my_rc_e rc;
+
+    if ((NULL == objs) && (0 != count)) {
+        LOG_ERR("Invalid input, objs(%p)", objs);
+        return (MY_RC_E_EINVAL);
+    }
+
+    sort = calloc(1, sizeof(*sort));
+    if (NULL == sort) {
+        return (MY_RC_E_ENOMEM);
+    }
+    sort->objs = objs;
+    sort->count = count;
+    sort->by_class = true;
+
+    rc = handle_sort_run(sort, num_threads);
+    if (my_rc_e_is_ok(rc) && (NULL != class_counts)) {
+        for (class_id = 0; class_id < MY_CLASS_ID_E_MAX; class_id++) {
+            class_counts[class_id] = sort->totals[class_id];
+        }
+    }
+    free(sort);
+
+    return (rc);
+}
+
+/**
+ * Stably sort handles by the value of a field of their objects, in
+ * ascending order.  Objects lacking the field follow all the others, in
+ * their original order.
+ *
+ * @param objs The handles, reordered
+ * @param count Number of handles
+ * @param field The field
+ * @param num_threads Number of threads, zero to use one per online CPU if
+ * there are at least HANDLE_SORT_PARALLEL_MIN_OBJECTS handles.
+ * @param num_with_field Outputs the number of objects having the field,
+ * which are the first ones.  May be NULL.
+ * @return Return code
+ */
+my_rc_e
+handle_sort_by_field (base1_handle *objs, size_t count, my_field_e field,
+                      size_t num_threads, size_t *num_with_field)
+{
+    handle_sort_st *sort;
+    my_class_id_e class_id;
+    size_t max_width = 0, d;
+    my_rc_e rc;
+
+    if (((NULL == objs) && (0 != count)) || (field <= MY_FIELD_E_INVALID) ||
+        (field >= MY_FIELD_E_MAX)) {
+        LOG_ERR("Invalid input, objs(%p) field(%u)", objs, field);
+        return (MY_RC_E_EINVAL);
+    }
+
+    sort = calloc(1, sizeof(*sort));
+    if (NULL == sort) {
+        return (MY_RC_E_ENOMEM);
+    }
+    sort->objs = objs;
+    sort->count = count;
+
+    for (class_id = 0; class_id < MY_CLASS_ID_E_MAX; class_id++) {
+        sort->has[class_id] = my_rc_e_is_ok(
+            class_registry_base1_field_offset(class_id, field,
+                                              &sort->offsets[class_id],
+                                              &sort->widths[class_id]));
+        if (sort->has[class_id] && (sort->widths[class_id] > max_width)) {
+            max_width = sort->widths[class_id];
+        }
+    }
+
+    /*
+     * A key one past the widest value sorts objects lacking the field last.
+     * A field of 64 bits leaves no such key, so those objects tie with the
+     * largest value instead.
+     */
+    sort->missing_key = (max_width < sizeof(uint64_t)) ?
+        (UINT64_C(1) << (max_width * 8)) : UINT64_MAX;
+
+    rc = handle_sort_run(sort, num_threads);
+    if (my_rc_e_is_ok(rc) && (NULL != num_with_field)) {
+        for (d = count; d > 0; d--) {
+            class_id = base1_class_id(objs[d - 1]);
+            if (my_class_id_e_is_valid(class_id) && sort->has[class_id]) {
+                break;
+            }
+        }
+        *num_with_field = d;
+    }
+    free(sort);
+
+    return (rc);
+}
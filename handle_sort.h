@@ -0,0 +1,52 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for reordering arrays of object handles by class
+ * or by the value of a field.  Grouping objects by class lets batches of them
+ * be dispatched through one virtual function table at a time, and sorting by a
+ * field puts them in order for export or range processing.
+ *
+ * Both are stable least significant digit radix sorts.  The keys are taken
+ * directly from the objects, as the class ID or as the field at its offset for
+ * each class, rather than through a comparison callback, and each pass moves
+ * every handle once.  Large arrays are sorted by several threads.
+ */
+#ifndef __HANDLE_SORT_H__
+#define __HANDLE_SORT_H__
+
+#include "common.h"
+#include "base1.h"
+#include "class_registry.h"
+
+/** Fewest handles sorted by several threads when the number is automatic */
+#define HANDLE_SORT_PARALLEL_MIN_OBJECTS (64 * 1024)
+
+/* APIs below are documented in their implementation file */
+
+extern my_rc_e
+handle_sort_by_class(base1_handle *objs, size_t count, size_t num_threads,
+                     size_t *class_counts);
+
+extern my_rc_e
+handle_sort_by_field(base1_handle *objs, size_t count, my_field_e field,
+                     size_t num_threads, size_t *num_with_field);
+
+#endif
@@ -0,0 +1,335 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements a map from 64-bit IDs to pointer sized values.  It is an open
+ * addressing hash table with linear probing, which keeps lookups to a single
+ * cache line in the common case.  A key of zero is reserved to mark empty
+ * slots, which matches zero never being a valid object ID.
+ */
+#include "id_map.h"
+
+/** Smallest number of slots in a map */
+#define ID_MAP_MIN_CAPACITY 16
+
+/** Grow the map when it is more than this percent full */
+#define ID_MAP_MAX_LOAD_PCT 70
+
+/** A single slot of the map */
+typedef struct id_map_entry_st_ {
+    /** The key, or zero if the slot is empty */
+    uint64_t key;
+    /** The value stored for the key */
+    uintptr_t value;
+} id_map_entry_st;
+
+/**
+ * Private variables which cannot be directly accessed by any other class.
+ */
+typedef struct id_map_st_ {
+    /** The slots, the number of which is always a power of two */
+    id_map_entry_st *entries;
+    /** The number of slots */
+    size_t capacity;
+    /** The number of slots in use */
+    size_t count;
+} id_map_st;
+
+/**
+ * Mix the bits of the key so sequential IDs spread evenly over the slots.
+ *
+ * @param key The key
+ * @return The hash value
+ */
+static uint64_t
+id_map_hash (uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+
+    return (key);
+}
+
+/**
+ * Resize the map to the given number of slots and rehash all entries.
+ *
+ * @param id_map_h The map
+ * @param capacity The new number of slots, must be a power of two.
+ * @return Return code
+ */
+static my_rc_e
+id_map_resize (id_map_handle id_map_h, size_t capacity)
+{
+    id_map_entry_st *old_entries = id_map_h->entries;
+    size_t old_capacity = id_map_h->capacity;
+    size_t i, slot;
+
+    id_map_h->entries = calloc(capacity, sizeof(*id_map_h->entries));
+    if (NULL == id_map_h->entries) {
+        id_map_h->entries = old_entries;
+        return (MY_RC_E_ENOMEM);
+    }
+    id_map_h->capacity = capacity;
+
+    for (i = 0; i < old_capacity; i++) {
+        if (0 == old_entries[i].key) {
+            continue;
+        }
+
+        slot = id_map_hash(old_entries[i].key) & (capacity - 1);
+        while (0 != id_map_h->entries[slot].key) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        id_map_h->entries[slot] = old_entries[i];
+    }
+
+    free(old_entries);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Create a new map.
+ *
+ * @param capacity_hint The number of entries expected, used to size the map so
+ * that it need not grow.  Zero may be given if the number is unknown.
+ * @return The map or NULL if creation failed
+ */
+id_map_handle
+id_map_new (size_t capacity_hint)
+{
+    id_map_st *id_map = NULL;
+    size_t capacity = ID_MAP_MIN_CAPACITY;
+
+    while (((capacity * ID_MAP_MAX_LOAD_PCT) / 100) <= capacity_hint) {
+        capacity *= 2;
+    }
+
+    id_map = calloc(1, sizeof(*id_map));
+    if (NULL == id_map) {
+        return (NULL);
+    }
+
+    if (my_rc_e_is_notok(id_map_resize(id_map, capacity))) {
+        free(id_map);
+        return (NULL);
+    }
+
+    return (id_map);
+}
+
+/**
+ * Delete the map.  Values stored in the map are not touched.
+ *
+ * @param id_map_h The map.  If NULL, then this function is a no-op.
+ */
+void
+id_map_delete (id_map_handle id_map_h)
+{
+    if (NULL == id_map_h) {
+        return;
+    }
+
+    free(id_map_h->entries);
+    free(id_map_h);
+}
+
+/**
+ * Insert a value for the key, replacing any value already stored for it.
+ *
+ * @param id_map_h The map
+ * @param key The key, must be non-zero
+ * @param value The value
+ * @return Return code
+ */
+my_rc_e
+id_map_insert (id_map_handle id_map_h, uint64_t key, uintptr_t value)
+{
+    size_t slot;
+    my_rc_e rc;
+
+    if ((NULL == id_map_h) || (0 == key)) {
+        LOG_ERR("Invalid input, id_map_h(%p) key(%" PRIu64 ")", id_map_h, key);
+        return (MY_RC_E_EINVAL);
+    }
+
+    if (((id_map_h->count + 1) * 100) >
+        (id_map_h->capacity * ID_MAP_MAX_LOAD_PCT)) {
+        rc = id_map_resize(id_map_h, id_map_h->capacity * 2);
+        if (my_rc_e_is_notok(rc)) {
+            return (rc);
+        }
+    }
+
+    slot = id_map_hash(key) & (id_map_h->capacity - 1);
+    while ((0 != id_map_h->entries[slot].key) &&
+           (key != id_map_h->entries[slot].key)) {
+        slot = (slot + 1) & (id_map_h->capacity - 1);
+    }
+
+    if (0 == id_map_h->entries[slot].key) {
+        id_map_h->entries[slot].key = key;
+        id_map_h->count++;
+    }
+    id_map_h->entries[slot].value = value;
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Find the slot holding the key.
+ *
+ * @param id_map_h The map
+ * @param key The key
+ * @param slot Outputs the slot index if the key is found.
+ * @return true if the key was found.
+ */
+static bool
+id_map_find (id_map_handle id_map_h, uint64_t key, size_t *slot)
+{
+    size_t i;
+
+    if ((NULL == id_map_h) || (0 == key)) {
+        return (false);
+    }
+
+    i = id_map_hash(key) & (id_map_h->capacity - 1);
+    while (0 != id_map_h->entries[i].key) {
+        if (key == id_map_h->entries[i].key) {
+            *slot = i;
+            return (true);
+        }
+        i = (i + 1) & (id_map_h->capacity - 1);
+    }
+
+    return (false);
+}
+
+/**
+ * Look up the value stored for a key.
+ *
+ * @param id_map_h The map
+ * @param key The key
+ * @param value Outputs the value if found.  May be NULL.
+ * @return true if the key was found.
+ */
+bool
+id_map_lookup (id_map_handle id_map_h, uint64_t key, uintptr_t *value)
+{
+    size_t slot;
+
+    if (!id_map_find(id_map_h, key, &slot)) {
+        return (false);
+    }
+
+    if (NULL != value) {
+        *value = id_map_h->entries[slot].value;
+    }
+
+    return (true);
+}
+
+/**
+ * Remove a key from the map.  Entries after the removed one in its probe
+ * sequence are shifted back so that no tombstones are needed.
+ *
+ * @param id_map_h The map
+ * @param key The key
+ * @param value Outputs the value that was stored if found.  May be NULL.
+ * @return true if the key was found and removed.
+ */
+bool
+id_map_remove (id_map_handle id_map_h, uint64_t key, uintptr_t *value)
+{
+    size_t mask, hole, i, home;
+
+    if (!id_map_find(id_map_h, key, &hole)) {
+        return (false);
+    }
+
+    if (NULL != value) {
+        *value = id_map_h->entries[hole].value;
+    }
+
+    mask = id_map_h->capacity - 1;
+    i = hole;
+    while (true) {
+        i = (i + 1) & mask;
+        if (0 == id_map_h->entries[i].key) {
+            break;
+        }
+
+        /* Only move the entry if the hole lies on its probe path */
+        home = id_map_hash(id_map_h->entries[i].key) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            id_map_h->entries[hole] = id_map_h->entries[i];
+            hole = i;
+        }
+    }
+
+    id_map_h->entries[hole].key = 0;
+    id_map_h->entries[hole].value = 0;
+    id_map_h->count--;
+
+    return (true);
+}
+
+/**
+ * Get the number of keys in the map.
+ *
+ * @param id_map_h The map
+ * @return The number of keys
+ */
+size_t
+id_map_count (id_map_handle id_map_h)
+{
+    if (NULL == id_map_h) {
+        return (0);
+    }
+
+    return (id_map_h->count);
+}
+
+/**
+ * Call a function for each entry in the map, in no particular order.  The map
+ * must not be modified by the function.
+ *
+ * @param id_map_h The map
+ * @param fn The function to call
+ * @param ctx Context passed through to the function
+ */
+void
+id_map_foreach (id_map_handle id_map_h, id_map_foreach_fn fn, void *ctx)
+{
+    size_t i;
+
+    if ((NULL == id_map_h) || (NULL == fn)) {
+        return;
+    }
+
+    for (i = 0; i < id_map_h->capacity; i++) {
+        if (0 != id_map_h->entries[i].key) {
+            fn(id_map_h->entries[i].key, id_map_h->entries[i].value, ctx);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for a map from 64-bit IDs (e.g., object IDs) to
+ * pointer sized values.
+ */
+#ifndef __ID_MAP_H__
+#define __ID_MAP_H__
+
+#include "common.h"
+
+/** Opaque pointer to reference instances of this class */
+typedef struct id_map_st_ *id_map_handle;
+
+/**
+ * Function called for each entry of the map.
+ */
+typedef void
+(*id_map_foreach_fn)(uint64_t key, uintptr_t value, void *ctx);
+
+/* APIs below are documented in their implementation file */
+
+extern id_map_handle
+id_map_new(size_t capacity_hint);
+
+extern void
+id_map_delete(id_map_handle id_map_h);
+
+extern my_rc_e
+id_map_insert(id_map_handle id_map_h, uint64_t key, uintptr_t value);
+
+extern bool
+id_map_lookup(id_map_handle id_map_h, uint64_t key, uintptr_t *value);
+
+extern bool
+id_map_remove(id_map_handle id_map_h, uint64_t key, uintptr_t *value);
+
+extern size_t
+id_map_count(id_map_handle id_map_h);
+
+extern void
+id_map_foreach(id_map_handle id_map_h, id_map_foreach_fn fn, void *ctx);
+
+#endif
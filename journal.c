@@ -0,0 +1,313 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements the mutation journal.
+ *
+ * Each producing thread gets its own single producer, single consumer ring on
+ * first use.  The producer owns the head and the consumer owns the tail, which
+ * live on separate cache lines; the producer also keeps its last view of the
+ * tail, so it only reads the consumer's cache line when its ring looks full.
+ * Rings are never freed: when a thread exits, its ring is released for the next
+ * new thread to adopt, so a producer can never write to freed memory, even if
+ * the journal is stopped concurrently.  The list of rings only grows, at its
+ * head, so the consumer walks it without a lock.
+ */
+#include <pthread.h>
+#include "journal.h"
+
+/** A ring of records */
+typedef struct journal_ring_st_ {
+    /** Position of the next record to write, owned by the producer */
+    uint64_t head __attribute__((aligned(MY_CACHE_LINE_SIZE)));
+    /** The producer's last view of the tail */
+    uint64_t cached_tail;
+    /** Sequence number of the next record */
+    uint32_t seq;
+    /** Records dropped because the ring was full */
+    uint64_t dropped;
+    /** Position of the next record to read, owned by the consumer */
+    uint64_t tail __attribute__((aligned(MY_CACHE_LINE_SIZE)));
+    /** Whether a live thread produces to the ring */
+    bool owned __attribute__((aligned(MY_CACHE_LINE_SIZE)));
+    /** Index of the ring */
+    uint16_t index;
+    /** Number of records minus one, the number being a power of two */
+    uint64_t mask;
+    /** The records */
+    journal_record_st *records;
+    /** The next ring on the list */
+    struct journal_ring_st_ *next;
+} journal_ring_st;
+
+bool journal_active = false;
+
+/** The calling thread's ring, or NULL if it has not recorded yet */
+static __thread journal_ring_st *journal_thread_ring;
+
+/** Key whose destructor releases an exiting thread's ring */
+static pthread_key_t journal_key;
+
+/** Ensures the key is created once */
+static pthread_once_t journal_key_once = PTHREAD_ONCE_INIT;
+
+/** Serializes adding and adopting rings */
+static pthread_mutex_t journal_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Serializes consumers */
+static pthread_mutex_t journal_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** List of all rings, most recent first */
+static journal_ring_st *journal_rings;
+
+/** Number of rings */
+static size_t journal_num_rings;
+
+/** Number of records in newly created rings */
+static size_t journal_capacity = JOURNAL_DEFAULT_CAPACITY;
+
+/**
+ * Release an exiting thread's ring for adoption.  This is the destructor of
+ * the thread-specific key.
+ *
+ * @param arg The ring
+ */
+static void
+journal_ring_release (void *arg)
+{
+    journal_ring_st *ring = arg;
+
+    __atomic_store_n(&ring->owned, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * Create the key releasing the rings of exiting threads.
+ */
+static void
+journal_key_init (void)
+{
+    pthread_key_create(&journal_key, journal_ring_release);
+}
+
+/**
+ * Get the calling thread's ring, adopting a released ring or creating one on
+ * first use.
+ *
+ * @return The ring or NULL if it could not be created
+ */
+static journal_ring_st *
+journal_ring_get (void)
+{
+    journal_ring_st *ring;
+
+    if (NULL != journal_thread_ring) {
+        return (journal_thread_ring);
+    }
+
+    pthread_once(&journal_key_once, journal_key_init);
+
+    pthread_mutex_lock(&journal_lock);
+
+    for (ring = journal_rings; NULL != ring; ring = ring->next) {
+        if (!__atomic_load_n(&ring->owned, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+
+    if ((NULL == ring) && (journal_num_rings <= UINT16_MAX)) {
+        ring = aligned_alloc(MY_CACHE_LINE_SIZE, sizeof(*ring));
+        if (NULL != ring) {
+            memset(ring, 0, sizeof(*ring));
+            ring->records = calloc(journal_capacity, sizeof(*ring->records));
+            if (NULL == ring->records) {
+                free(ring);
+                ring = NULL;
+            }
+        }
+        if (NULL != ring) {
+            ring->mask = journal_capacity - 1;
+            ring->index = journal_num_rings++;
+            ring->next = journal_rings;
+            __atomic_store_n(&journal_rings, ring, __ATOMIC_RELEASE);
+        }
+    }
+
+    if ((NULL != ring) && (0 == pthread_setspecific(journal_key, ring))) {
+        ring->owned = true;
+        journal_thread_ring = ring;
+    } else {
+        ring = NULL;
+    }
+
+    pthread_mutex_unlock(&journal_lock);
+
+    return (ring);
+}
+
+/**
+ * Start the journal.  Mutations from then on are recorded until the journal
+ * is stopped.
+ *
+ * @param capacity Number of records in each thread's ring, rounded up to a
+ * power of two, or zero for the default.  It applies to rings created from
+ * now on; existing rings keep their size.
+ * @return Return code
+ * @see journal_stop()
+ */
+my_rc_e
+journal_start (size_t capacity)
+{
+    size_t num_records = 1;
+
+    if (0 == capacity) {
+        capacity = JOURNAL_DEFAULT_CAPACITY;
+    }
+    if (capacity > UINT32_MAX) {
+        LOG_ERR("Invalid input, capacity(%zu)", capacity);
+        return (MY_RC_E_EINVAL);
+    }
+    while (num_records < capacity) {
+        num_records <<= 1;
+    }
+
+    pthread_mutex_lock(&journal_lock);
+    journal_capacity = num_records;
+    pthread_mutex_unlock(&journal_lock);
+
+    __atomic_store_n(&journal_active, true, __ATOMIC_RELEASE);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Stop the journal.  Records already made remain to be drained.  A mutation
+ * racing with this may still be recorded.
+ *
+ * @see journal_start()
+ */
+void
+journal_stop (void)
+{
+    __atomic_store_n(&journal_active, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * Append a record to the calling thread's ring.  Callers should normally use
+ * JOURNAL_RECORD() rather than calling this directly.
+ *
+ * @param object_id The ID of the object
+ * @param class_id The class of the object
+ * @param field The field
+ * @param value The field's new value
+ */
+void
+journal_record (uint64_t object_id, my_class_id_e class_id, my_field_e field,
+                uint64_t value)
+{
+    journal_record_st *record;
+    journal_ring_st *ring;
+    uint64_t head;
+
+    ring = journal_ring_get();
+    if (NULL == ring) {
+        return;
+    }
+
+    head = ring->head;
+    if ((head - ring->cached_tail) > ring->mask) {
+        ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if ((head - ring->cached_tail) > ring->mask) {
+            ring->seq++;
+            __atomic_store_n(&ring->dropped, ring->dropped + 1,
+                             __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    record = &ring->records[head & ring->mask];
+    record->object_id = object_id;
+    record->value = value;
+    record->seq = ring->seq++;
+    record->ring = ring->index;
+    record->class_id = class_id;
+    record->field = field;
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Drain records from the journal.  Records of each producing thread come out
+ * in the order they were made; records of different threads are not ordered
+ * with respect to each other.  Concurrent calls are serialized.
+ *
+ * @param records Filled in with the records
+ * @param max_records Most records to drain
+ * @return The number of records drained
+ */
+size_t
+journal_drain (journal_record_st *records, size_t max_records)
+{
+    journal_ring_st *ring;
+    uint64_t head, tail;
+    size_t count = 0;
+
+    if (NULL == records) {
+        LOG_ERR("Invalid input, records(%p)", records);
+        return (0);
+    }
+
+    pthread_mutex_lock(&journal_drain_lock);
+
+    ring = __atomic_load_n(&journal_rings, __ATOMIC_ACQUIRE);
+    for (; (NULL != ring) && (count < max_records); ring = ring->next) {
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        tail = ring->tail;
+        while ((tail != head) && (count < max_records)) {
+            records[count++] = ring->records[tail++ & ring->mask];
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    pthread_mutex_unlock(&journal_drain_lock);
+
+    return (count);
+}
+
+/**
+ * Get the statistics of the journal.  They are approximate while threads
+ * record.
+ *
+ * @param stats Filled in with the statistics
+ */
+void
+journal_get_stats (journal_stats_st *stats)
+{
+    journal_ring_st *ring;
+
+    memset(stats, 0, sizeof(*stats));
+
+    ring = __atomic_load_n(&journal_rings, __ATOMIC_ACQUIRE);
+    for (; NULL != ring; ring = ring->next) {
+        stats->rings++;
+        stats->pending += __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) -
+            __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        stats->dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    }
+}
@@ -0,0 +1,112 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for the mutation journal, a change data
+ * capture stream of object mutations.  While the journal is started, each
+ * mutation of a field through the public API appends a compact record of the
+ * field's new value to a ring buffer owned by the mutating thread.  A consumer
+ * (e.g., a thread mirroring object state to another process) drains the
+ * records, which come out in order for each producing thread.  Producers
+ * never block or take locks; if a thread's ring is full, its records are
+ * dropped and counted.
+ */
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+
+#include "common.h"
+#include "class_registry.h"
+
+/** Default number of records in each thread's ring */
+#define JOURNAL_DEFAULT_CAPACITY 4096
+
+/** A journal record, the new value of a field of an object */
+typedef struct journal_record_st_ {
+    /** ID of the object */
+    uint64_t object_id;
+    /** New value of the field */
+    uint64_t value;
+    /** Sequence number within the producing thread's ring, which skips the
+     *  numbers of dropped records */
+    uint32_t seq;
+    /** Index of the producing thread's ring */
+    uint16_t ring;
+    /** Class of the object, a my_class_id_e */
+    uint8_t class_id;
+    /** The field, a my_field_e */
+    uint8_t field;
+} journal_record_st;
+
+/** Statistics of the journal */
+typedef struct journal_stats_st_ {
+    /** Number of rings, one per thread which has recorded */
+    size_t rings;
+    /** Records waiting to be drained */
+    size_t pending;
+    /** Records dropped because a ring was full */
+    uint64_t dropped;
+} journal_stats_st;
+
+/** Indicates whether the journal is started.  Use journal_is_enabled(). */
+extern bool journal_active;
+
+/**
+ * Indicates whether mutations should be recorded.  This is inline since it is
+ * checked on every mutation, and must cost next to nothing when the journal
+ * is stopped.
+ *
+ * @return true if the journal is started.
+ */
+static inline bool
+journal_is_enabled (void)
+{
+    return (__atomic_load_n(&journal_active, __ATOMIC_RELAXED));
+}
+
+/**
+ * Record the new value of a field if the journal is started.  The arguments
+ * are only evaluated when the journal is enabled.
+ */
+#define JOURNAL_RECORD(object_id, class_id, field, value) \
+do { \
+    if (journal_is_enabled()) { \
+        journal_record(object_id, class_id, field, value); \
+    } \
+} while (0)
+
+/* APIs below are documented in their implementation file */
+
+extern my_rc_e
+journal_start(size_t capacity);
+
+extern void
+journal_stop(void);
+
+extern void
+journal_record(uint64_t object_id, my_class_id_e class_id, my_field_e field,
+               uint64_t value);
+
+extern size_t
+journal_drain(journal_record_st *records, size_t max_records);
+
+extern void
+journal_get_stats(journal_stats_st *stats);
+
+#endif
@@ -0,0 +1,642 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements magazine allocators.
+ *
+ * Each thread using a magazine allocator has a cache, found through a
+ * thread-specific key, holding a loaded and a previous magazine per size class.
+ * Allocation pops from the loaded magazine and free pushes to it.  When the
+ * loaded magazine is empty (or full), it is swapped with the previous one if
+ * that helps; only when both are empty (or full) does the thread lock the
+ * depot for the size class to exchange a whole magazine.  A block may be freed
+ * by any thread: blocks have no owner, so a cross-thread free simply lands in
+ * the freeing thread's magazine and reaches other threads through the depot.
+ *
+ * When a thread exits, its magazines are flushed to the depot.  Deleting the
+ * allocator returns every cached block to the backing allocator, so no thread
+ * may use the allocator, or objects from it, once deletion begins.
+ */
+#include <pthread.h>
+#include "magazine.h"
+
+/** Alignment and granularity of the size classes */
+#define MAGAZINE_ALIGN 16
+
+/** Largest allocation served by magazines */
+#define MAGAZINE_MAX_SIZE 512
+
+/** Number of size classes */
+#define MAGAZINE_NUM_CLASSES (MAGAZINE_MAX_SIZE / MAGAZINE_ALIGN)
+
+/** Default number of blocks per magazine */
+#define MAGAZINE_DEFAULT_ROUNDS 64
+
+/** Default most full magazines in the depot per size class */
+#define MAGAZINE_DEFAULT_DEPOT_LIMIT 1024
+
+/** Round a size up to the size class granularity */
+#define MAGAZINE_ROUND(size) \
+    (((size) + MAGAZINE_ALIGN - 1) & ~((size_t) MAGAZINE_ALIGN - 1))
+
+/** A magazine, a bounded stack of free blocks of one size class */
+typedef struct magazine_st_ {
+    /** The next magazine on a depot list */
+    struct magazine_st_ *next;
+    /** Number of blocks held */
+    size_t count;
+    /** The blocks */
+    void *rounds[];
+} magazine_st;
+
+/** The depot for a size class */
+typedef struct magazine_depot_st_ {
+    /** Protects the depot */
+    pthread_mutex_t lock;
+    /** Full magazines */
+    magazine_st *full;
+    /** Empty magazines */
+    magazine_st *empty;
+    /** Number of full magazines */
+    size_t num_full;
+} magazine_depot_st;
+
+struct magazine_allocator_st_;
+
+/** The magazines of a thread */
+typedef struct magazine_cache_st_ {
+    /** The allocator */
+    struct magazine_allocator_st_ *mags;
+    /** Previous cache on the allocator's list */
+    struct magazine_cache_st_ *prev;
+    /** Next cache on the allocator's list */
+    struct magazine_cache_st_ *next;
+    /** Magazine allocated from and freed to, per size class */
+    magazine_st *loaded[MAGAZINE_NUM_CLASSES];
+    /** Full or empty magazine used before the loaded one, per size class */
+    magazine_st *previous[MAGAZINE_NUM_CLASSES];
+} magazine_cache_st;
+
+/** State of a magazine allocator */
+typedef struct magazine_allocator_st_ {
+    /** The allocator, whose ctx points back at this state */
+    allocator_st allocator;
+    /** The configuration, with defaults filled in */
+    magazine_config_st config;
+    /** Key to find the calling thread's cache */
+    pthread_key_t key;
+    /** Protects the list of caches */
+    pthread_mutex_t lock;
+    /** Caches of threads which used the allocator */
+    magazine_cache_st *caches;
+    /** The depot for each size class */
+    magazine_depot_st depots[MAGAZINE_NUM_CLASSES];
+    /** Statistics, updated atomically */
+    magazine_stats_st stats;
+} magazine_allocator_st;
+
+/**
+ * Allocate an empty magazine.
+ *
+ * @param mags The allocator
+ * @return The magazine or NULL
+ */
+static magazine_st *
+magazine_new (magazine_allocator_st *mags)
+{
+    magazine_st *mag;
+
+    mag = malloc(sizeof(*mag) + (mags->config.rounds * sizeof(void *)));
+    if (NULL != mag) {
+        mag->next = NULL;
+        mag->count = 0;
+    }
+
+    return (mag);
+}
+
+/**
+ * Return the blocks in a magazine to the backing allocator.
+ *
+ * @param mags The allocator
+ * @param mag The magazine
+ * @param size Size of the blocks
+ */
+static void
+magazine_drain (magazine_allocator_st *mags, magazine_st *mag, size_t size)
+{
+    __atomic_add_fetch(&mags->stats.backing_frees, mag->count,
+                       __ATOMIC_RELAXED);
+    while (mag->count > 0) {
+        allocator_free(mags->config.backing, mag->rounds[--mag->count],
+                       size);
+    }
+}
+
+/**
+ * Give a magazine to the depot of a size class.  Full magazines beyond the
+ * depot limit are drained to the backing allocator and kept as empty.
+ *
+ * @param mags The allocator
+ * @param class The size class
+ * @param mag The magazine, full or empty.  If NULL, this function is a no-op.
+ */
+static void
+magazine_depot_put (magazine_allocator_st *mags, size_t class,
+                    magazine_st *mag)
+{
+    magazine_depot_st *depot = &mags->depots[class];
+
+    if (NULL == mag) {
+        return;
+    }
+
+    if ((0 != mag->count) &&
+        (__atomic_load_n(&depot->num_full, __ATOMIC_RELAXED) >=
+         mags->config.depot_limit)) {
+        magazine_drain(mags, mag, (class + 1) * MAGAZINE_ALIGN);
+    }
+
+    pthread_mutex_lock(&depot->lock);
+    if (0 != mag->count) {
+        mag->next = depot->full;
+        depot->full = mag;
+        depot->num_full++;
+        __atomic_add_fetch(&mags->stats.depot_puts, 1, __ATOMIC_RELAXED);
+    } else {
+        mag->next = depot->empty;
+        depot->empty = mag;
+    }
+    pthread_mutex_unlock(&depot->lock);
+}
+
+/**
+ * Take a magazine from the depot of a size class.
+ *
+ * @param mags The allocator
+ * @param class The size class
+ * @param full Whether to take a full magazine rather than an empty one
+ * @return The magazine or NULL if the depot has none of the kind.
+ */
+static magazine_st *
+magazine_depot_get (magazine_allocator_st *mags, size_t class, bool full)
+{
+    magazine_depot_st *depot = &mags->depots[class];
+    magazine_st *mag;
+
+    /* Avoid the lock in the common case of no full magazines */
+    if (full && (0 == __atomic_load_n(&depot->num_full, __ATOMIC_RELAXED))) {
+        return (NULL);
+    }
+
+    pthread_mutex_lock(&depot->lock);
+    if (full) {
+        mag = depot->full;
+        if (NULL != mag) {
+            depot->full = mag->next;
+            depot->num_full--;
+            __atomic_add_fetch(&mags->stats.depot_gets, 1,
+                               __ATOMIC_RELAXED);
+        }
+    } else {
+        mag = depot->empty;
+        if (NULL != mag) {
+            depot->empty = mag->next;
+        }
+    }
+    pthread_mutex_unlock(&depot->lock);
+
+    return (mag);
+}
+
+/**
+ * Give every magazine of a cache to the depots.
+ *
+ * @param cache The cache
+ */
+static void
+magazine_cache_flush (magazine_cache_st *cache)
+{
+    size_t class;
+
+    for (class = 0; class < MAGAZINE_NUM_CLASSES; class++) {
+        magazine_depot_put(cache->mags, class, cache->loaded[class]);
+        magazine_depot_put(cache->mags, class, cache->previous[class]);
+        cache->loaded[class] = NULL;
+        cache->previous[class] = NULL;
+    }
+}
+
+/**
+ * Flush the cache of an exiting thread and free it.  This is the destructor
+ * of the thread-specific key.
+ *
+ * @param arg The cache
+ */
+static void
+magazine_cache_delete (void *arg)
+{
+    magazine_cache_st *cache = arg;
+    magazine_allocator_st *mags = cache->mags;
+
+    magazine_cache_flush(cache);
+
+    pthread_mutex_lock(&mags->lock);
+    if (NULL != cache->prev) {
+        cache->prev->next = cache->next;
+    } else {
+        mags->caches = cache->next;
+    }
+    if (NULL != cache->next) {
+        cache->next->prev = cache->prev;
+    }
+    mags->stats.threads--;
+    pthread_mutex_unlock(&mags->lock);
+
+    free(cache);
+}
+
+/**
+ * Get the calling thread's cache, creating it on first use.
+ *
+ * @param mags The allocator
+ * @return The cache or NULL if it could not be created
+ */
+static magazine_cache_st *
+magazine_cache_get (magazine_allocator_st *mags)
+{
+    magazine_cache_st *cache;
+
+    cache = pthread_getspecific(mags->key);
+    if (NULL != cache) {
+        return (cache);
+    }
+
+    cache = calloc(1, sizeof(*cache));
+    if (NULL == cache) {
+        return (NULL);
+    }
+    cache->mags = mags;
+
+    if (0 != pthread_setspecific(mags->key, cache)) {
+        free(cache);
+        return (NULL);
+    }
+
+    pthread_mutex_lock(&mags->lock);
+    cache->next = mags->caches;
+    if (NULL != cache->next) {
+        cache->next->prev = cache;
+    }
+    mags->caches = cache;
+    mags->stats.threads++;
+    pthread_mutex_unlock(&mags->lock);
+
+    return (cache);
+}
+
+/**
+ * Allocate when the loaded magazine is empty.  The previous magazine is used
+ * if it has blocks, then a full magazine from the depot, and finally half a
+ * magazine of blocks from the backing allocator.
+ *
+ * @param mags The allocator
+ * @param cache The calling thread's cache
+ * @param class The size class
+ * @return The memory or NULL
+ */
+static void *
+magazine_alloc_slow (magazine_allocator_st *mags, magazine_cache_st *cache,
+                     size_t class)
+{
+    size_t size = (class + 1) * MAGAZINE_ALIGN;
+    magazine_st *mag;
+    size_t batch;
+
+    mag = cache->previous[class];
+    if ((NULL != mag) && (0 != mag->count)) {
+        cache->previous[class] = cache->loaded[class];
+        cache->loaded[class] = mag;
+        return (mag->rounds[--mag->count]);
+    }
+
+    mag = magazine_depot_get(mags, class, true);
+    if (NULL != mag) {
+        /* Both cached magazines are empty, so one is spare */
+        magazine_depot_put(mags, class, cache->previous[class]);
+        cache->previous[class] = cache->loaded[class];
+        cache->loaded[class] = mag;
+        return (mag->rounds[--mag->count]);
+    }
+
+    mag = cache->loaded[class];
+    if (NULL == mag) {
+        mag = magazine_depot_get(mags, class, false);
+        if (NULL == mag) {
+            mag = magazine_new(mags);
+        }
+        if (NULL == mag) {
+            return (allocator_alloc(mags->config.backing, size));
+        }
+        cache->loaded[class] = mag;
+    }
+
+    /* Leave room for frees, so they do not go straight to the depot */
+    batch = (mags->config.rounds + 1) / 2;
+    while (mag->count < batch) {
+        mag->rounds[mag->count] = allocator_alloc(mags->config.backing,
+                                                  size);
+        if (NULL == mag->rounds[mag->count]) {
+            break;
+        }
+        mag->count++;
+    }
+    __atomic_add_fetch(&mags->stats.backing_allocs, mag->count,
+                       __ATOMIC_RELAXED);
+
+    return ((0 != mag->count) ? mag->rounds[--mag->count] : NULL);
+}
+
+/**
+ * Allocate from a magazine allocator.
+ *
+ * @param ctx The magazine allocator state
+ * @param size Number of bytes
+ * @return The memory or NULL
+ */
+static void *
+magazine_alloc (void *ctx, size_t size)
+{
+    magazine_allocator_st *mags = ctx;
+    magazine_cache_st *cache;
+    magazine_st *mag;
+    size_t class;
+
+    size = MAGAZINE_ROUND((0 == size) ? 1 : size);
+    cache = (size <= MAGAZINE_MAX_SIZE) ? magazine_cache_get(mags) : NULL;
+    if (NULL == cache) {
+        return (allocator_alloc(mags->config.backing, size));
+    }
+    class = (size / MAGAZINE_ALIGN) - 1;
+
+    mag = cache->loaded[class];
+    if ((NULL != mag) && (0 != mag->count)) {
+        return (mag->rounds[--mag->count]);
+    }
+
+    return (magazine_alloc_slow(mags, cache, class));
+}
+
+/**
+ * Free when the loaded magazine is full.  The previous magazine is used if it
+ * has room, otherwise the full previous magazine goes to the depot and an
+ * empty one takes its place.
+ *
+ * @param mags The allocator
+ * @param cache The calling thread's cache
+ * @param class The size class
+ * @param ptr The memory
+ */
+static void
+magazine_free_slow (magazine_allocator_st *mags, magazine_cache_st *cache,
+                    size_t class, void *ptr)
+{
+    magazine_st *mag;
+
+    mag = cache->previous[class];
+    if ((NULL != mag) && (mag->count < mags->config.rounds)) {
+        cache->previous[class] = cache->loaded[class];
+        cache->loaded[class] = mag;
+        mag->rounds[mag->count++] = ptr;
+        return;
+    }
+
+    mag = magazine_depot_get(mags, class, false);
+    if (NULL == mag) {
+        mag = magazine_new(mags);
+    }
+    if (NULL == mag) {
+        __atomic_add_fetch(&mags->stats.backing_frees, 1, __ATOMIC_RELAXED);
+        allocator_free(mags->config.backing, ptr,
+                       (class + 1) * MAGAZINE_ALIGN);
+        return;
+    }
+
+    /* Both cached magazines are full (or missing), so one goes to the depot */
+    magazine_depot_put(mags, class, cache->previous[class]);
+    cache->previous[class] = cache->loaded[class];
+    cache->loaded[class] = mag;
+    mag->rounds[mag->count++] = ptr;
+}
+
+/**
+ * Free to a magazine allocator.
+ *
+ * @param ctx The magazine allocator state
+ * @param ptr The memory
+ * @param size The size given at allocation
+ */
+static void
+magazine_free (void *ctx, void *ptr, size_t size)
+{
+    magazine_allocator_st *mags = ctx;
+    magazine_cache_st *cache;
+    magazine_st *mag;
+    size_t class;
+
+    size = MAGAZINE_ROUND((0 == size) ? 1 : size);
+    cache = (size <= MAGAZINE_MAX_SIZE) ? magazine_cache_get(mags) : NULL;
+    if (NULL == cache) {
+        allocator_free(mags->config.backing, ptr, size);
+        return;
+    }
+    class = (size / MAGAZINE_ALIGN) - 1;
+
+    mag = cache->loaded[class];
+    if ((NULL != mag) && (mag->count < mags->config.rounds)) {
+        mag->rounds[mag->count++] = ptr;
+        return;
+    }
+
+    magazine_free_slow(mags, cache, class, ptr);
+}
+
+/**
+ * Create a magazine allocator.  It is thread safe and scales with the number
+ * of threads, since allocations and frees mostly stay within per-thread
+ * magazines.
+ *
+ * @param config The configuration or NULL for the defaults (the default
+ * allocator as backing, 64 blocks per magazine and a depot limit of 1024
+ * magazines per size class).
+ * @return The allocator or NULL if creation failed
+ */
+allocator_st *
+magazine_allocator_new (const magazine_config_st *config)
+{
+    magazine_allocator_st *mags;
+    size_t class;
+
+    mags = calloc(1, sizeof(*mags));
+    if (NULL == mags) {
+        return (NULL);
+    }
+
+    if (NULL != config) {
+        mags->config = *config;
+    } else {
+        mags->config.depot_limit = MAGAZINE_DEFAULT_DEPOT_LIMIT;
+    }
+    if (NULL == mags->config.backing) {
+        mags->config.backing = allocator_get_default();
+    }
+    if (0 == mags->config.rounds) {
+        mags->config.rounds = MAGAZINE_DEFAULT_ROUNDS;
+    }
+
+    if (0 != pthread_key_create(&mags->key, magazine_cache_delete)) {
+        free(mags);
+        return (NULL);
+    }
+
+    pthread_mutex_init(&mags->lock, NULL);
+    for (class = 0; class < MAGAZINE_NUM_CLASSES; class++) {
+        pthread_mutex_init(&mags->depots[class].lock, NULL);
+    }
+
+    mags->allocator.alloc_fn = magazine_alloc;
+    mags->allocator.free_fn = magazine_free;
+    mags->allocator.ctx = mags;
+
+    return (&mags->allocator);
+}
+
+/**
+ * Delete a magazine allocator, returning every cached block to the backing
+ * allocator.  Every object allocated from it must already be deleted, and no
+ * thread may use it concurrently.
+ *
+ * @param allocator The allocator.  If NULL, then this function is a no-op.
+ */
+void
+magazine_allocator_delete (allocator_st *allocator)
+{
+    magazine_allocator_st *mags;
+    magazine_cache_st *cache;
+    magazine_depot_st *depot;
+    magazine_st *mag;
+    size_t class;
+
+    if (NULL == allocator) {
+        return;
+    }
+    mags = allocator->ctx;
+
+    /* Caches of live threads are no longer reachable through the key */
+    pthread_key_delete(mags->key);
+    mags->config.depot_limit = SIZE_MAX;
+    while (NULL != mags->caches) {
+        cache = mags->caches;
+        mags->caches = cache->next;
+        magazine_cache_flush(cache);
+        free(cache);
+    }
+
+    for (class = 0; class < MAGAZINE_NUM_CLASSES; class++) {
+        depot = &mags->depots[class];
+        while (NULL != depot->full) {
+            mag = depot->full;
+            depot->full = mag->next;
+            magazine_drain(mags, mag, (class + 1) * MAGAZINE_ALIGN);
+            free(mag);
+        }
+        while (NULL != depot->empty) {
+            mag = depot->empty;
+            depot->empty = mag->next;
+            free(mag);
+        }
+        pthread_mutex_destroy(&depot->lock);
+    }
+
+    pthread_mutex_destroy(&mags->lock);
+    free(mags);
+}
+
+/**
+ * Give the calling thread's magazines to the depot, e.g. before a thread
+ * which allocated many objects goes idle.  Threads flush automatically when
+ * they exit.
+ *
+ * @param allocator The allocator
+ */
+void
+magazine_flush (allocator_st *allocator)
+{
+    magazine_allocator_st *mags = allocator->ctx;
+    magazine_cache_st *cache;
+
+    cache = pthread_getspecific(mags->key);
+    if (NULL != cache) {
+        magazine_cache_flush(cache);
+    }
+}
+
+/**
+ * Get the statistics of a magazine allocator.
+ *
+ * @param allocator The allocator
+ * @param stats Filled in with the statistics
+ * @return Return code
+ */
+my_rc_e
+magazine_get_stats (allocator_st *allocator, magazine_stats_st *stats)
+{
+    magazine_allocator_st *mags;
+    size_t class;
+
+    if ((NULL == allocator) || (magazine_alloc != allocator->alloc_fn) ||
+        (NULL == stats)) {
+        LOG_ERR("Invalid input, allocator(%p) stats(%p)", allocator, stats);
+        return (MY_RC_E_EINVAL);
+    }
+    mags = allocator->ctx;
+
+    stats->depot_gets = __atomic_load_n(&mags->stats.depot_gets,
+                                        __ATOMIC_RELAXED);
+    stats->depot_puts = __atomic_load_n(&mags->stats.depot_puts,
+                                        __ATOMIC_RELAXED);
+    stats->backing_allocs = __atomic_load_n(&mags->stats.backing_allocs,
+                                            __ATOMIC_RELAXED);
+    stats->backing_frees = __atomic_load_n(&mags->stats.backing_frees,
+                                           __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&mags->lock);
+    stats->threads = mags->stats.threads;
+    pthread_mutex_unlock(&mags->lock);
+
+    stats->depot_full = 0;
+    for (class = 0; class < MAGAZINE_NUM_CLASSES; class++) {
+        pthread_mutex_lock(&mags->depots[class].lock);
+        stats->depot_full += mags->depots[class].num_full;
+        pthread_mutex_unlock(&mags->depots[class].lock);
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
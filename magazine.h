@@ -0,0 +1,79 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for magazine allocators.  A magazine allocator
+ * keeps per-thread caches of free blocks, one pair of magazines per 16 byte
+ * size class, in front of a backing allocator.  Objects and their private
+ * blocks therefore fall in separate size classes, and most allocations and
+ * frees touch only the calling thread's magazines.  Full and empty magazines
+ * are exchanged in batches with a global depot, so threads which mostly free
+ * (e.g., consumers of objects made by other threads) pass their blocks on to
+ * threads which mostly allocate.
+ */
+#ifndef __MAGAZINE_H__
+#define __MAGAZINE_H__
+
+#include "common.h"
+#include "allocator.h"
+
+/** Configuration of a magazine allocator */
+typedef struct magazine_config_st_ {
+    /** The allocator blocks come from and return to, or NULL for the
+     *  default allocator at creation */
+    const allocator_st *backing;
+    /** Number of blocks a magazine holds, or zero for a default */
+    size_t rounds;
+    /** Most full magazines the depot keeps per size class; beyond this,
+     *  blocks return to the backing allocator */
+    size_t depot_limit;
+} magazine_config_st;
+
+/** Statistics of a magazine allocator */
+typedef struct magazine_stats_st_ {
+    /** Full magazines taken from the depot by threads */
+    uint64_t depot_gets;
+    /** Full magazines given to the depot by threads */
+    uint64_t depot_puts;
+    /** Blocks allocated from the backing allocator */
+    uint64_t backing_allocs;
+    /** Blocks freed to the backing allocator */
+    uint64_t backing_frees;
+    /** Full magazines now in the depot */
+    size_t depot_full;
+    /** Threads now holding magazines */
+    size_t threads;
+} magazine_stats_st;
+
+/* APIs below are documented in their implementation file */
+
+extern allocator_st *
+magazine_allocator_new(const magazine_config_st *config);
+
+extern void
+magazine_allocator_delete(allocator_st *allocator);
+
+extern void
+magazine_flush(allocator_st *allocator);
+
+extern my_rc_e
+magazine_get_stats(allocator_st *allocator, magazine_stats_st *stats);
+
+#endif
@@ -0,0 +1,332 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements NUMA aware allocation.
+ *
+ * The kernel is used directly through the getcpu, mbind and affinity system
+ * calls, rather than through libnuma, so there is no extra dependency.  Node
+ * and CPU topology is read from sysfs.  If sysfs has no node information, the
+ * machine is treated as a single node holding every CPU.  Memory binding uses
+ * the preferred policy, so allocations fall back to other nodes rather than
+ * fail when a node is out of memory.
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "numa.h"
+#include "arena.h"
+
+/** The kernel's memory policy to prefer a node, from numaif.h */
+#define NUMA_MPOL_PREFERRED 1
+
+/** Path of the list of online nodes */
+#define NUMA_ONLINE_PATH "/sys/devices/system/node/online"
+
+/** Format of the path of the list of CPUs of a node */
+#define NUMA_CPULIST_PATH "/sys/devices/system/node/node%u/cpulist"
+
+/** Number of nodes, computed once */
+static unsigned int numa_nodes;
+
+/** Ensures the number of nodes is computed once */
+static pthread_once_t numa_nodes_once = PTHREAD_ONCE_INIT;
+
+/** The arena for each node, created on first use */
+static allocator_st *numa_arenas[NUMA_MAX_NODES];
+
+/** Protects creation of the arenas */
+static pthread_mutex_t numa_arenas_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Parse a sysfs list (e.g., "0-3,8,10-11") into flags.
+ *
+ * @param path Path of the file holding the list
+ * @param bits Set to true for each listed number below max
+ * @param max Number of flags
+ * @return Return code, MY_RC_E_EIO if the file is missing or malformed.
+ */
+static my_rc_e
+numa_parse_list (const char *path, bool *bits, size_t max)
+{
+    unsigned int first, last, i;
+    FILE *file;
+    int c = ',';
+
+    file = fopen(path, "r");
+    if (NULL == file) {
+        return (MY_RC_E_EIO);
+    }
+
+    while ((',' == c) && (1 == fscanf(file, "%u", &first))) {
+        last = first;
+        c = fgetc(file);
+        if ('-' == c) {
+            if (1 != fscanf(file, "%u", &last)) {
+                break;
+            }
+            c = fgetc(file);
+        }
+
+        for (i = first; (i <= last) && (i < max); i++) {
+            bits[i] = true;
+        }
+    }
+
+    fclose(file);
+
+    return (((EOF == c) || ('\n' == c)) ? MY_RC_E_SUCCESS : MY_RC_E_EIO);
+}
+
+/**
+ * Compute the number of nodes.
+ */
+static void
+numa_nodes_init (void)
+{
+    bool online[NUMA_MAX_NODES] = { false };
+    unsigned int i;
+
+    numa_nodes = 1;
+    if (my_rc_e_is_notok(numa_parse_list(NUMA_ONLINE_PATH, online,
+                                         NUMA_MAX_NODES))) {
+        return;
+    }
+
+    for (i = 0; i < NUMA_MAX_NODES; i++) {
+        if (online[i]) {
+            numa_nodes = i + 1;
+        }
+    }
+}
+
+/**
+ * Get the number of NUMA nodes.  Node IDs are below this, though on machines
+ * with offline nodes not every ID below it is online.
+ *
+ * @return The number of nodes, at least one.
+ */
+unsigned int
+numa_num_nodes (void)
+{
+    pthread_once(&numa_nodes_once, numa_nodes_init);
+
+    return (numa_nodes);
+}
+
+/**
+ * Get the node of the CPU the calling thread is running on.  The thread may
+ * be migrated at any time unless it is bound to a node.
+ *
+ * @return The node, zero if unknown.
+ * @see numa_bind_thread()
+ */
+unsigned int
+numa_current_node (void)
+{
+    unsigned int cpu, node;
+
+    if ((0 != syscall(SYS_getcpu, &cpu, &node, NULL)) ||
+        (node >= numa_num_nodes())) {
+        return (0);
+    }
+
+    return (node);
+}
+
+/**
+ * Ask the kernel to place memory on a node.  This must be done before the
+ * memory is first touched.
+ *
+ * @param mem Start of the memory, which must be page aligned
+ * @param len Length of the memory
+ * @param node The node
+ * @return Return code
+ */
+my_rc_e
+numa_bind_memory (void *mem, size_t len, unsigned int node)
+{
+    unsigned long nodemask[(NUMA_MAX_NODES + 63) / 64] = { 0 };
+
+    if (node >= numa_num_nodes()) {
+        LOG_ERR("Invalid input, node(%u)", node);
+        return (MY_RC_E_EINVAL);
+    }
+
+    /* Binding is pointless with one node, and the kernel may lack NUMA */
+    if (1 == numa_num_nodes()) {
+        return (MY_RC_E_SUCCESS);
+    }
+
+    nodemask[node / 64] = 1UL << (node % 64);
+    if (0 != syscall(SYS_mbind, mem, len, NUMA_MPOL_PREFERRED, nodemask,
+                     (unsigned long) NUMA_MAX_NODES + 1, 0)) {
+        LOG_ERR("Binding failed, mem(%p) node(%u)", mem, node);
+        return (MY_RC_E_EINVAL);
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Restrict the calling thread to the CPUs of a node.
+ *
+ * @param node The node
+ * @return Return code
+ */
+my_rc_e
+numa_bind_thread (unsigned int node)
+{
+    bool cpus[CPU_SETSIZE] = { false };
+    char path[64];
+    cpu_set_t cpu_set;
+    unsigned int i;
+
+    if (node >= numa_num_nodes()) {
+        LOG_ERR("Invalid input, node(%u)", node);
+        return (MY_RC_E_EINVAL);
+    }
+
+    snprintf(path, sizeof(path), NUMA_CPULIST_PATH, node);
+    if (my_rc_e_is_notok(numa_parse_list(path, cpus, CPU_SETSIZE))) {
+        /* Without node information, the single node holds every CPU */
+        return (MY_RC_E_SUCCESS);
+    }
+
+    CPU_ZERO(&cpu_set);
+    for (i = 0; i < CPU_SETSIZE; i++) {
+        if (cpus[i]) {
+            CPU_SET(i, &cpu_set);
+        }
+    }
+
+    if (0 != pthread_setaffinity_np(pthread_self(), sizeof(cpu_set),
+                                    &cpu_set)) {
+        return (MY_RC_E_EINVAL);
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Get the allocator for a node.  Its memory is placed on the node.
+ *
+ * @param node The node or NUMA_NODE_LOCAL for the node of the calling thread
+ * @return The allocator or NULL if the node is invalid or its arena could not
+ * be created.
+ */
+const allocator_st *
+numa_node_allocator (int node)
+{
+    arena_config_st config = {
+        .capacity = 0,
+        .huge_pages = false,
+        .populate = false,
+        .idle_limit = SIZE_MAX,
+        .bind_node = true,
+    };
+    allocator_st *arena;
+    unsigned int index;
+
+    /* A negative node other than NUMA_NODE_LOCAL wraps to an invalid index */
+    index = (NUMA_NODE_LOCAL == node) ? numa_current_node() :
+        (unsigned int)node;
+    if (index >= numa_num_nodes()) {
+        LOG_ERR("Invalid input, node(%d)", node);
+        return (NULL);
+    }
+
+    arena = __atomic_load_n(&numa_arenas[index], __ATOMIC_ACQUIRE);
+    if (NULL != arena) {
+        return (arena);
+    }
+
+    pthread_mutex_lock(&numa_arenas_lock);
+    arena = numa_arenas[index];
+    if (NULL == arena) {
+        config.node = index;
+        arena = arena_new(&config);
+        __atomic_store_n(&numa_arenas[index], arena, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&numa_arenas_lock);
+
+    return (arena);
+}
+
+/**
+ * Allocate from the arena of the calling thread's node.
+ *
+ * @param ctx Unused
+ * @param size Number of bytes
+ * @return The memory or NULL
+ */
+static void *
+numa_alloc (void *ctx, size_t size)
+{
+    return (allocator_alloc(numa_node_allocator(NUMA_NODE_LOCAL), size));
+}
+
+/**
+ * Free to the arena the memory came from, which may be that of another node.
+ *
+ * @param ctx Unused
+ * @param ptr The memory
+ * @param size The size given at allocation
+ */
+static void
+numa_free (void *ctx, void *ptr, size_t size)
+{
+    const allocator_st *arena;
+    unsigned int node;
+
+    for (node = 0; node < numa_num_nodes(); node++) {
+        arena = __atomic_load_n(&numa_arenas[node], __ATOMIC_ACQUIRE);
+        if ((NULL != arena) && arena_owns(arena, ptr)) {
+            allocator_free(arena, ptr, size);
+            return;
+        }
+    }
+
+    /* Allocations too large for the arenas came from the heap */
+    free(ptr);
+}
+
+/** The allocator which allocates on the calling thread's node */
+static const allocator_st numa_local_allocator = {
+    numa_alloc,
+    numa_free,
+    NULL
+};
+
+/**
+ * Get the allocator which places each allocation on the node of the thread
+ * making it.  Setting it as the default allocator makes the *_new1()
+ * constructors node local.  Objects may be deleted from any node.
+ *
+ * @return The allocator
+ * @see allocator_set_default()
+ */
+const allocator_st *
+numa_allocator (void)
+{
+    return (&numa_local_allocator);
+}
@@ -0,0 +1,60 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for NUMA aware allocation.  Each NUMA node has
+ * its own arena, bound to the node's memory, so objects can be constructed on
+ * the node of the threads that will use them.  On machines with a single node,
+ * or where the kernel does not support NUMA, everything works as a single
+ * node.
+ */
+#ifndef __NUMA_H__
+#define __NUMA_H__
+
+#include "common.h"
+#include "allocator.h"
+
+/** Most NUMA nodes supported */
+#define NUMA_MAX_NODES 64
+
+/** Node hint meaning the node of the calling thread */
+#define NUMA_NODE_LOCAL (-1)
+
+/* APIs below are documented in their implementation file */
+
+extern unsigned int
+numa_num_nodes(void);
+
+extern unsigned int
+numa_current_node(void);
+
+extern my_rc_e
+numa_bind_memory(void *mem, size_t len, unsigned int node);
+
+extern my_rc_e
+numa_bind_thread(unsigned int node);
+
+extern const allocator_st *
+numa_node_allocator(int node);
+
+extern const allocator_st *
+numa_allocator(void);
+
+#endif
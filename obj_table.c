@@ -0,0 +1,537 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements the object table.
+ *
+ * Each class has its own table of slots, so a reference resolves with one
+ * indexed load and a generation compare, without touching any object.  Slots
+ * are allocated in fixed size pages which are never moved, so references can be
+ * resolved without taking a lock while other threads insert objects.  A freed
+ * slot's generation is bumped, so stale references to it fail to resolve.
+ * Freed slots are reused least recently freed first, spreading reuse over every
+ * free slot, and a slot whose generation would wrap is retired instead of
+ * freed, so a stale reference never resolves to a later object.
+ */
+#include <pthread.h>
+#include "obj_table.h"
+#include "id_map.h"
+
+/** Number of slots in each page of a table */
+#define OBJ_TABLE_PAGE_SLOTS 4096
+
+/** Number of pages in a full table */
+#define OBJ_TABLE_MAX_PAGES (OBJ_TABLE_MAX_SLOTS / OBJ_TABLE_PAGE_SLOTS)
+
+/** Mask for the slot index of a reference */
+#define OBJ_REF_INDEX_MASK ((1u << OBJ_REF_INDEX_BITS) - 1)
+
+/** Mask for the generation of a reference, after shifting */
+#define OBJ_REF_GEN_MASK ((1u << OBJ_REF_GEN_BITS) - 1)
+
+/** Shift for the class ID of a reference */
+#define OBJ_REF_CLASS_SHIFT (OBJ_REF_INDEX_BITS + OBJ_REF_GEN_BITS)
+
+/** A slot of a table */
+typedef struct obj_table_slot_st_ {
+    /** The object, NULL if the slot is free */
+    base1_handle obj;
+    /** Generation of the slot, bumped each time the slot is freed */
+    uint32_t generation;
+    /** Index plus one of the next free slot, zero for none */
+    uint32_t next_free;
+} obj_table_slot_st;
+
+/** The table for a class */
+typedef struct obj_table_st_ {
+    /** Protects changes to the table */
+    pthread_mutex_t lock;
+    /** Pages of slots, allocated as needed */
+    obj_table_slot_st *pages[OBJ_TABLE_MAX_PAGES];
+    /** Number of slots ever used */
+    uint32_t num_slots;
+    /** Index plus one of the least recently freed slot, zero for none */
+    uint32_t free_head;
+    /** Index plus one of the most recently freed slot, zero for none */
+    uint32_t free_tail;
+    /** Number of objects in the table */
+    size_t count;
+    /** Map from object ID to reference, for translating pointers */
+    id_map_handle refs;
+} obj_table_st;
+
+/** The table for each class */
+static obj_table_st obj_tables[MY_CLASS_ID_E_MAX] = {
+    [0 ... (MY_CLASS_ID_E_MAX - 1)] = { .lock = PTHREAD_MUTEX_INITIALIZER },
+};
+
+/**
+ * Build a reference.
+ *
+ * @param class_id The class of the object
+ * @param generation The generation of the slot
+ * @param index The index of the slot
+ * @return The reference
+ */
+static inline obj_ref
+obj_ref_make (my_class_id_e class_id, uint32_t generation, uint32_t index)
+{
+    return (((obj_ref) class_id << OBJ_REF_CLASS_SHIFT) |
+            ((generation & OBJ_REF_GEN_MASK) << OBJ_REF_INDEX_BITS) | index);
+}
+
+/**
+ * Get the generation of the slot a reference refers to.
+ *
+ * @param ref The reference
+ * @return The generation
+ */
+static inline uint32_t
+obj_ref_generation (obj_ref ref)
+{
+    return ((ref >> OBJ_REF_INDEX_BITS) & OBJ_REF_GEN_MASK);
+}
+
+/**
+ * Add a slot to the end of the free list.
+ *
+ * @param table The table, which must be locked
+ * @param slot The slot
+ * @param index The index of the slot
+ */
+static void
+obj_table_free_slot (obj_table_st *table, obj_table_slot_st *slot,
+                     uint32_t index)
+{
+    obj_table_slot_st *tail;
+
+    slot->next_free = 0;
+    if (0 == table->free_tail) {
+        table->free_head = index + 1;
+    } else {
+        tail = &table->pages[(table->free_tail - 1) / OBJ_TABLE_PAGE_SLOTS]
+            [(table->free_tail - 1) % OBJ_TABLE_PAGE_SLOTS];
+        tail->next_free = index + 1;
+    }
+    table->free_tail = index + 1;
+}
+
+/**
+ * Get the class of the object a reference refers to.  This does not check
+ * whether the reference is stale.
+ *
+ * @param ref The reference
+ * @return The class ID or MY_CLASS_ID_E_INVALID if the reference is invalid.
+ */
+my_class_id_e
+obj_ref_class_id (obj_ref ref)
+{
+    my_class_id_e class_id = (ref >> OBJ_REF_CLASS_SHIFT);
+
+    if (!my_class_id_e_is_valid(class_id)) {
+        return (MY_CLASS_ID_E_INVALID);
+    }
+
+    return (class_id);
+}
+
+/**
+ * Get the slot a reference refers to.
+ *
+ * @param ref The reference
+ * @param table Outputs the table holding the slot
+ * @return The slot or NULL if the slot was never allocated.
+ */
+static obj_table_slot_st *
+obj_table_slot (obj_ref ref, obj_table_st **table)
+{
+    my_class_id_e class_id = obj_ref_class_id(ref);
+    uint32_t index = ref & OBJ_REF_INDEX_MASK;
+    obj_table_slot_st *page;
+
+    if (MY_CLASS_ID_E_INVALID == class_id) {
+        return (NULL);
+    }
+
+    *table = &obj_tables[class_id];
+    page = __atomic_load_n(&(*table)->pages[index / OBJ_TABLE_PAGE_SLOTS],
+                           __ATOMIC_ACQUIRE);
+    if (NULL == page) {
+        return (NULL);
+    }
+
+    return (&page[index % OBJ_TABLE_PAGE_SLOTS]);
+}
+
+/**
+ * Unmap an object from the reference to its slot, if it is mapped to it.
+ *
+ * @param table The table, which must be locked
+ * @param base1_h The object
+ * @param ref The reference to the slot
+ */
+static void
+obj_table_unmap (obj_table_st *table, base1_handle base1_h, obj_ref ref)
+{
+    uintptr_t mapped_ref;
+
+    if (id_map_lookup(table->refs, base1_get_object_id(base1_h),
+                      &mapped_ref) &&
+        (ref == mapped_ref)) {
+        id_map_remove(table->refs, base1_get_object_id(base1_h), NULL);
+    }
+}
+
+/**
+ * Insert an object into the table of its class.
+ *
+ * @param base1_h The object
+ * @param shared Whether the object may be in several slots, in which case it
+ * is not mapped back to the reference.
+ * @return A reference to the object or OBJ_REF_INVALID on failure.
+ */
+static obj_ref
+obj_table_insert_internal (base1_handle base1_h, bool shared)
+{
+    my_class_id_e class_id;
+    obj_table_st *table;
+    obj_table_slot_st *page, *slot;
+    uint32_t index;
+    obj_ref ref = OBJ_REF_INVALID;
+
+    class_id = base1_class_id(base1_h);
+    if (!my_class_id_e_is_valid(class_id)) {
+        LOG_ERR("Invalid input, base1_h(%p)", base1_h);
+        return (OBJ_REF_INVALID);
+    }
+    table = &obj_tables[class_id];
+
+    pthread_mutex_lock(&table->lock);
+
+    if (NULL == table->refs) {
+        table->refs = id_map_new(0);
+        if (NULL == table->refs) {
+            goto exit;
+        }
+    }
+
+    if (0 != table->free_head) {
+        index = table->free_head - 1;
+        slot = &table->pages[index / OBJ_TABLE_PAGE_SLOTS]
+            [index % OBJ_TABLE_PAGE_SLOTS];
+        table->free_head = slot->next_free;
+        if (0 == table->free_head) {
+            table->free_tail = 0;
+        }
+    } else {
+        if (table->num_slots >= OBJ_TABLE_MAX_SLOTS) {
+            LOG_ERR("Table full, class(%s)",
+                    my_class_id_e_get_string(class_id));
+            goto exit;
+        }
+
+        index = table->num_slots;
+        page = table->pages[index / OBJ_TABLE_PAGE_SLOTS];
+        if (NULL == page) {
+            page = calloc(OBJ_TABLE_PAGE_SLOTS, sizeof(*page));
+            if (NULL == page) {
+                goto exit;
+            }
+            __atomic_store_n(&table->pages[index / OBJ_TABLE_PAGE_SLOTS], page,
+                             __ATOMIC_RELEASE);
+        }
+        slot = &page[index % OBJ_TABLE_PAGE_SLOTS];
+        table->num_slots++;
+    }
+
+    ref = obj_ref_make(class_id, slot->generation, index);
+    if (!shared &&
+        my_rc_e_is_notok(id_map_insert(table->refs,
+                                       base1_get_object_id(base1_h), ref))) {
+        obj_table_free_slot(table, slot, index);
+        ref = OBJ_REF_INVALID;
+        goto exit;
+    }
+
+    slot->next_free = 0;
+    __atomic_store_n(&slot->obj, base1_h, __ATOMIC_RELEASE);
+    table->count++;
+
+exit:
+
+    pthread_mutex_unlock(&table->lock);
+
+    return (ref);
+}
+
+/**
+ * Insert an object into the table of its class.
+ *
+ * @param base1_h The object
+ * @return A reference to the object or OBJ_REF_INVALID on failure.
+ */
+obj_ref
+obj_table_insert (base1_handle base1_h)
+{
+    return (obj_table_insert_internal(base1_h, false));
+}
+
+/**
+ * Insert an object which is shared by several slots (e.g., a flyweight) into
+ * the table of its class.  The object may be inserted any number of times and
+ * obj_table_find() does not find it.
+ *
+ * @param base1_h The object
+ * @return A reference to the new slot or OBJ_REF_INVALID on failure.
+ */
+obj_ref
+obj_table_insert_shared (base1_handle base1_h)
+{
+    return (obj_table_insert_internal(base1_h, true));
+}
+
+/**
+ * Resolve a reference to its object.  This does not take a lock.
+ *
+ * @param ref The reference
+ * @return The object or NULL if the reference is invalid or stale.
+ */
+base1_handle
+obj_table_resolve (obj_ref ref)
+{
+    obj_table_st *table;
+    obj_table_slot_st *slot;
+    base1_handle base1_h;
+
+    slot = obj_table_slot(ref, &table);
+    if (NULL == slot) {
+        return (NULL);
+    }
+
+    base1_h = __atomic_load_n(&slot->obj, __ATOMIC_ACQUIRE);
+    if (obj_ref_generation(ref) !=
+        __atomic_load_n(&slot->generation, __ATOMIC_ACQUIRE)) {
+        return (NULL);
+    }
+
+    return (base1_h);
+}
+
+/**
+ * Remove an object from the table.  The object itself is not deleted and
+ * every reference to it becomes stale.
+ *
+ * @param ref Reference to the object
+ * @return Whether the object was in the table.
+ */
+bool
+obj_table_remove (obj_ref ref)
+{
+    obj_table_st *table;
+    obj_table_slot_st *slot;
+    base1_handle base1_h;
+    bool removed = false;
+
+    slot = obj_table_slot(ref, &table);
+    if (NULL == slot) {
+        return (false);
+    }
+
+    pthread_mutex_lock(&table->lock);
+
+    base1_h = slot->obj;
+    if ((NULL != base1_h) &&
+        (obj_ref_generation(ref) == slot->generation)) {
+        obj_table_unmap(table, base1_h, ref);
+        __atomic_store_n(&slot->generation,
+                         (slot->generation + 1) & OBJ_REF_GEN_MASK,
+                         __ATOMIC_RELEASE);
+        __atomic_store_n(&slot->obj, NULL, __ATOMIC_RELEASE);
+        /* A slot whose generation wrapped is retired */
+        if (0 != slot->generation) {
+            obj_table_free_slot(table, slot, ref & OBJ_REF_INDEX_MASK);
+        }
+        table->count--;
+        removed = true;
+    }
+
+    pthread_mutex_unlock(&table->lock);
+
+    return (removed);
+}
+
+/**
+ * Remove an object from the table and delete it.  Stale references are
+ * ignored.
+ *
+ * @param ref Reference to the object
+ */
+void
+obj_table_delete_object (obj_ref ref)
+{
+    base1_handle base1_h = obj_table_resolve(ref);
+
+    if ((NULL != base1_h) && obj_table_remove(ref)) {
+        base1_delete(base1_h);
+    }
+}
+
+/**
+ * Update the location of an object, after the caller has moved (e.g., while
+ * compacting) it.  References to the object remain valid.
+ *
+ * @param ref Reference to the object
+ * @param base1_h The new location of the object, which must be the same
+ * object (i.e., have the same class and object ID).
+ * @return Return code
+ */
+my_rc_e
+obj_table_relocate (obj_ref ref, base1_handle base1_h)
+{
+    obj_table_st *table;
+    obj_table_slot_st *slot;
+    my_rc_e rc = MY_RC_E_EINVAL;
+
+    slot = obj_table_slot(ref, &table);
+    if ((NULL == slot) || (base1_class_id(base1_h) != obj_ref_class_id(ref))) {
+        LOG_ERR("Invalid input, ref(%#x) base1_h(%p)", ref, base1_h);
+        return (MY_RC_E_EINVAL);
+    }
+
+    pthread_mutex_lock(&table->lock);
+
+    if ((NULL != slot->obj) &&
+        (obj_ref_generation(ref) == slot->generation) &&
+        (base1_get_object_id(base1_h) == base1_get_object_id(slot->obj))) {
+        __atomic_store_n(&slot->obj, base1_h, __ATOMIC_RELEASE);
+        rc = MY_RC_E_SUCCESS;
+    }
+
+    pthread_mutex_unlock(&table->lock);
+
+    return (rc);
+}
+
+/**
+ * Replace the object in a slot with a different object of the same class, if
+ * the slot still holds the expected object.  References to the slot remain
+ * valid and now resolve to the new object.  Neither object is deleted.
+ *
+ * @param ref Reference to the slot
+ * @param old_base1_h The object the slot is expected to hold
+ * @param base1_h The new object
+ * @param shared Whether the new object may be in several slots
+ * @return Return code, MY_RC_E_EAGAIN if the slot no longer holds
+ * old_base1_h.
+ * @see obj_table_insert_shared()
+ */
+my_rc_e
+obj_table_replace (obj_ref ref, base1_handle old_base1_h,
+                   base1_handle base1_h, bool shared)
+{
+    obj_table_st *table;
+    obj_table_slot_st *slot;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    slot = obj_table_slot(ref, &table);
+    if ((NULL == slot) || (NULL == old_base1_h) ||
+        (base1_class_id(base1_h) != obj_ref_class_id(ref))) {
+        LOG_ERR("Invalid input, ref(%#x) base1_h(%p)", ref, base1_h);
+        return (MY_RC_E_EINVAL);
+    }
+
+    pthread_mutex_lock(&table->lock);
+
+    if ((old_base1_h != slot->obj) ||
+        (obj_ref_generation(ref) != slot->generation)) {
+        rc = MY_RC_E_EAGAIN;
+        goto exit;
+    }
+
+    if (!shared) {
+        rc = id_map_insert(table->refs, base1_get_object_id(base1_h), ref);
+        if (my_rc_e_is_notok(rc)) {
+            goto exit;
+        }
+    }
+
+    if (base1_get_object_id(old_base1_h) != base1_get_object_id(base1_h)) {
+        obj_table_unmap(table, old_base1_h, ref);
+    }
+    __atomic_store_n(&slot->obj, base1_h, __ATOMIC_RELEASE);
+
+exit:
+
+    pthread_mutex_unlock(&table->lock);
+
+    return (rc);
+}
+
+/**
+ * Find the reference for an object in the table, to translate from the
+ * pointer based API.
+ *
+ * @param base1_h The object
+ * @return The reference or OBJ_REF_INVALID if the object is not in the table.
+ */
+obj_ref
+obj_table_find (base1_handle base1_h)
+{
+    my_class_id_e class_id;
+    obj_table_st *table;
+    uintptr_t ref = OBJ_REF_INVALID;
+
+    class_id = base1_class_id(base1_h);
+    if (!my_class_id_e_is_valid(class_id)) {
+        return (OBJ_REF_INVALID);
+    }
+    table = &obj_tables[class_id];
+
+    pthread_mutex_lock(&table->lock);
+    if ((NULL != table->refs) &&
+        !id_map_lookup(table->refs, base1_get_object_id(base1_h), &ref)) {
+        ref = OBJ_REF_INVALID;
+    }
+    pthread_mutex_unlock(&table->lock);
+
+    return ((obj_ref) ref);
+}
+
+/**
+ * Get the number of objects of a class in the table.
+ *
+ * @param class_id The class
+ * @return The number of objects
+ */
+size_t
+obj_table_count (my_class_id_e class_id)
+{
+    size_t count;
+
+    if (!my_class_id_e_is_valid(class_id)) {
+        return (0);
+    }
+
+    pthread_mutex_lock(&obj_tables[class_id].lock);
+    count = obj_tables[class_id].count;
+    pthread_mutex_unlock(&obj_tables[class_id].lock);
+
+    return (count);
+}
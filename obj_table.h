@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for the object table.  The table hands out
+ * compact 32-bit references to objects in place of pointers.  A reference
+ * encodes the class of the object, the index of its slot in that class's table
+ * and the generation of the slot, so references to deleted objects are detected
+ * rather than dereferenced, and objects can be moved without invalidating
+ * references to them.
+ */
+#ifndef __OBJ_TABLE_H__
+#define __OBJ_TABLE_H__
+
+#include "common.h"
+#include "base1.h"
+
+/**
+ * A reference to an object in the table.  The bits are laid out as:
+ * class ID (3 bits) | generation (9 bits) | index (20 bits)
+ * by default.  Build with -DOBJ_REF_INDEX_BITS=N to trade generation bits
+ * for more objects per class.
+ */
+typedef uint32_t obj_ref;
+
+/** The reference that never refers to an object */
+#define OBJ_REF_INVALID ((obj_ref) 0)
+
+/** Number of bits for the class ID */
+#define OBJ_REF_CLASS_BITS 3
+
+#ifndef OBJ_REF_INDEX_BITS
+/** Number of bits for the slot index */
+#define OBJ_REF_INDEX_BITS 20
+#endif
+
+/** Number of bits for the slot generation, the rest of the reference */
+#define OBJ_REF_GEN_BITS \
+    ((8 * sizeof(obj_ref)) - OBJ_REF_CLASS_BITS - OBJ_REF_INDEX_BITS)
+
+/**
+ * Most objects of a single class the table may hold at once, about a million
+ * by default.  A slot is retired rather than reused once its generation would
+ * wrap, so a class may have at most OBJ_TABLE_MAX_SLOTS << OBJ_REF_GEN_BITS
+ * insertions over the life of the program.
+ */
+#define OBJ_TABLE_MAX_SLOTS (1u << OBJ_REF_INDEX_BITS)
+
+/** @cond doxygen_suppress */
+/* Ensure the class fits and leaves room for a useful generation */
+CT_ASSERT(MY_CLASS_ID_E_MAX <= (1u << OBJ_REF_CLASS_BITS));
+CT_ASSERT((OBJ_REF_INDEX_BITS >= 12) && (OBJ_REF_GEN_BITS >= 4));
+/** @endcond */
+
+/* APIs below are documented in their implementation file */
+
+extern obj_ref
+obj_table_insert(base1_handle base1_h);
+
+extern obj_ref
+obj_table_insert_shared(base1_handle base1_h);
+
+extern base1_handle
+obj_table_resolve(obj_ref ref);
+
+extern bool
+obj_table_remove(obj_ref ref);
+
+extern void
+obj_table_delete_object(obj_ref ref);
+
+extern my_rc_e
+obj_table_relocate(obj_ref ref, base1_handle base1_h);
+
+extern my_rc_e
+obj_table_replace(obj_ref ref, base1_handle old_base1_h,
+                  base1_handle base1_h, bool shared);
+
+extern obj_ref
+obj_table_find(base1_handle base1_h);
+
+extern size_t
+obj_table_count(my_class_id_e class_id);
+
+extern my_class_id_e
+obj_ref_class_id(obj_ref ref);
+
+#endif
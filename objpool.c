@@ -0,0 +1,437 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements object pools.
+ *
+ * Each pool has a fixed array of nodes and two lock-free (Treiber) stacks
+ * threaded through it: one of nodes holding objects and one of free nodes.
+ * Releasing pops a free node, stores the object in it and pushes it on the
+ * object stack; acquiring does the reverse.  Each stack head packs a node
+ * index with a tag that is incremented on every update, so a thread delayed
+ * between reading the head and its compare-and-swap fails rather than
+ * installing a stale next index after the node was popped and pushed again
+ * (the ABA problem).  Nodes are never freed while the pool exists, so reading
+ * a popped node's next index is always safe.  Unlike a ring, a thread
+ * preempted in the middle of an operation never blocks other threads.
+ *
+ * Objects are reset when released, so acquired objects are in their default
+ * state, and are given a new identity when acquired, as with the recycle bin.
+ */
+#include "objpool.h"
+#include "base1_friend.h"
+#include "derived1_friend.h"
+#include "derived2.h"
+#include "trace.h"
+#include "wal.h"
+#include "checkpoint.h"
+#include "aggregate.h"
+#include "field_index.h"
+
+/** Node index terminating a stack */
+#define OBJPOOL_NODE_NONE UINT32_MAX
+
+/** Pack a stack head from a tag and a node index */
+#define OBJPOOL_HEAD(tag, index) (((uint64_t) (tag) << 32) | (index))
+
+/** Get the node index of a stack head */
+#define OBJPOOL_HEAD_INDEX(head) ((uint32_t) (head))
+
+/** Get the tag of a stack head */
+#define OBJPOOL_HEAD_TAG(head) ((uint32_t) ((head) >> 32))
+
+/** A node of a pool */
+typedef struct objpool_node_st_ {
+    /** Index of the next node on the same stack */
+    uint32_t next;
+    /** The object, if the node is on the object stack */
+    base1_handle base1_h;
+} objpool_node_st;
+
+/** A pool */
+typedef struct objpool_st_ {
+    /** Head of the stack of nodes holding objects */
+    uint64_t objs __attribute__((aligned(MY_CACHE_LINE_SIZE)));
+    /** Head of the stack of free nodes */
+    uint64_t free __attribute__((aligned(MY_CACHE_LINE_SIZE)));
+    /** Acquires served from the pool */
+    uint64_t hits __attribute__((aligned(MY_CACHE_LINE_SIZE)));
+    /** Acquires which found the pool empty */
+    uint64_t misses;
+    /** Releases which found the pool full */
+    uint64_t overflows;
+    /** Number of nodes */
+    size_t capacity __attribute__((aligned(MY_CACHE_LINE_SIZE)));
+    /** The nodes */
+    objpool_node_st *nodes;
+} objpool_st;
+
+/** The pool of each class, or NULL */
+static objpool_st *objpool_pools[MY_CLASS_ID_E_MAX];
+
+/**
+ * Construct an object of a class in its default state.
+ *
+ * @param class_id The class
+ * @return The object or NULL if the class cannot be constructed.
+ */
+static base1_handle
+objpool_construct (my_class_id_e class_id)
+{
+    switch (class_id) {
+    case MY_CLASS_ID_E_BASE1:
+        return (base1_new1());
+    case MY_CLASS_ID_E_DERIVED1:
+        return (derived1_cast_to_base1(derived1_new1()));
+    case MY_CLASS_ID_E_DERIVED2:
+        return (derived1_cast_to_base1(derived2_cast_to_derived1(
+            derived2_new1())));
+    default:
+        LOG_ERR("Class has no pool, class_id(%s)",
+                my_class_id_e_get_string(class_id));
+        return (NULL);
+    }
+}
+
+/**
+ * Pop a node from one of a pool's stacks.
+ *
+ * @param pool The pool
+ * @param head The head of the stack
+ * @return The node's index or OBJPOOL_NODE_NONE if the stack is empty.
+ */
+static uint32_t
+objpool_pop (objpool_st *pool, uint64_t *head)
+{
+    uint64_t old_head, new_head;
+    uint32_t index, next;
+
+    old_head = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+    do {
+        index = OBJPOOL_HEAD_INDEX(old_head);
+        if (OBJPOOL_NODE_NONE == index) {
+            return (OBJPOOL_NODE_NONE);
+        }
+        /* Stale if the node was popped meanwhile, but then the tag differs */
+        next = __atomic_load_n(&pool->nodes[index].next, __ATOMIC_RELAXED);
+        new_head = OBJPOOL_HEAD(OBJPOOL_HEAD_TAG(old_head) + 1, next);
+    } while (!__atomic_compare_exchange_n(head, &old_head, new_head, true,
+                                          __ATOMIC_ACQUIRE,
+                                          __ATOMIC_ACQUIRE));
+
+    return (index);
+}
+
+/**
+ * Push a node on one of a pool's stacks.
+ *
+ * @param pool The pool
+ * @param head The head of the stack
+ * @param index The node's index
+ */
+static void
+objpool_push (objpool_st *pool, uint64_t *head, uint32_t index)
+{
+    uint64_t old_head, new_head;
+
+    old_head = __atomic_load_n(head, __ATOMIC_RELAXED);
+    do {
+        __atomic_store_n(&pool->nodes[index].next,
+                         OBJPOOL_HEAD_INDEX(old_head), __ATOMIC_RELAXED);
+        new_head = OBJPOOL_HEAD(OBJPOOL_HEAD_TAG(old_head) + 1, index);
+    } while (!__atomic_compare_exchange_n(head, &old_head, new_head, true,
+                                          __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+}
+
+/**
+ * Put an object in a pool.
+ *
+ * @param pool The pool
+ * @param base1_h The object
+ * @return Whether the object was put in the pool, false if it is full.
+ */
+static bool
+objpool_put (objpool_st *pool, base1_handle base1_h)
+{
+    uint32_t index;
+
+    index = objpool_pop(pool, &pool->free);
+    if (OBJPOOL_NODE_NONE == index) {
+        return (false);
+    }
+
+    pool->nodes[index].base1_h = base1_h;
+    objpool_push(pool, &pool->objs, index);
+
+    return (true);
+}
+
+/**
+ * Take an object from a pool.
+ *
+ * @param pool The pool
+ * @return The object or NULL if the pool is empty.
+ */
+static base1_handle
+objpool_take (objpool_st *pool)
+{
+    base1_handle base1_h;
+    uint32_t index;
+
+    index = objpool_pop(pool, &pool->objs);
+    if (OBJPOOL_NODE_NONE == index) {
+        return (NULL);
+    }
+
+    base1_h = pool->nodes[index].base1_h;
+    objpool_push(pool, &pool->free, index);
+
+    return (base1_h);
+}
+
+/**
+ * Create the pool of a class.  This must not race with other calls for the
+ * class.
+ *
+ * @param class_id The class
+ * @param capacity Most objects the pool may hold
+ * @param prefill Number of objects to construct into the pool now, at most
+ * the capacity
+ * @return Return code, MY_RC_E_EINVAL if the class already has a pool.
+ */
+my_rc_e
+objpool_create (my_class_id_e class_id, size_t capacity, size_t prefill)
+{
+    base1_handle base1_h;
+    objpool_st *pool;
+    size_t i;
+
+    if ((MY_CLASS_ID_E_BASE2 == class_id) ||
+        !my_class_id_e_is_valid(class_id) || (0 == capacity) ||
+        (capacity >= OBJPOOL_NODE_NONE) || (prefill > capacity) ||
+        (NULL != objpool_pools[class_id])) {
+        LOG_ERR("Invalid input, class_id(%u) capacity(%zu) prefill(%zu)",
+                class_id, capacity, prefill);
+        return (MY_RC_E_EINVAL);
+    }
+
+    pool = aligned_alloc(MY_CACHE_LINE_SIZE, sizeof(*pool));
+    if (NULL == pool) {
+        return (MY_RC_E_ENOMEM);
+    }
+    memset(pool, 0, sizeof(*pool));
+    pool->capacity = capacity;
+
+    pool->nodes = calloc(capacity, sizeof(*pool->nodes));
+    if (NULL == pool->nodes) {
+        free(pool);
+        return (MY_RC_E_ENOMEM);
+    }
+    for (i = 0; i < capacity; i++) {
+        pool->nodes[i].next = ((i + 1) < capacity) ? (i + 1) :
+            OBJPOOL_NODE_NONE;
+    }
+    pool->objs = OBJPOOL_HEAD(0, OBJPOOL_NODE_NONE);
+    pool->free = OBJPOOL_HEAD(0, 0);
+
+    __atomic_store_n(&objpool_pools[class_id], pool, __ATOMIC_RELEASE);
+
+    for (i = 0; i < prefill; i++) {
+        base1_h = objpool_construct(class_id);
+        if (NULL == base1_h) {
+            objpool_destroy(class_id);
+            return (MY_RC_E_ENOMEM);
+        }
+        objpool_release(base1_h);
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Destroy the pool of a class, deleting the objects in it.  This must not
+ * race with other calls for the class.
+ *
+ * @param class_id The class.  If it has no pool, this function is a no-op.
+ */
+void
+objpool_destroy (my_class_id_e class_id)
+{
+    base1_handle base1_h;
+    objpool_st *pool;
+
+    if (!my_class_id_e_is_valid(class_id)) {
+        return;
+    }
+
+    pool = __atomic_exchange_n(&objpool_pools[class_id], NULL,
+                               __ATOMIC_ACQ_REL);
+    if (NULL == pool) {
+        return;
+    }
+
+    while (NULL != (base1_h = objpool_take(pool))) {
+        base1_delete_unlogged(base1_h);
+    }
+
+    free(pool->nodes);
+    free(pool);
+}
+
+/**
+ * Acquire an object of a class in its default state.  It comes from the
+ * class's pool if it has one that is not empty; otherwise a new object is
+ * constructed.  The object should be released with objpool_release() or
+ * deleted.
+ *
+ * @param class_id The class
+ * @return The object or NULL on failure
+ */
+base1_handle
+objpool_acquire (my_class_id_e class_id)
+{
+    base1_handle base1_h = NULL;
+    objpool_st *pool = NULL;
+    uint64_t object_id;
+
+    if (my_class_id_e_is_valid(class_id)) {
+        pool = __atomic_load_n(&objpool_pools[class_id], __ATOMIC_ACQUIRE);
+    }
+    if (NULL != pool) {
+        base1_h = objpool_take(pool);
+    }
+
+    if (NULL == base1_h) {
+        if (NULL != pool) {
+            __atomic_add_fetch(&pool->misses, 1, __ATOMIC_RELAXED);
+        }
+        return (objpool_construct(class_id));
+    }
+    __atomic_add_fetch(&pool->hits, 1, __ATOMIC_RELAXED);
+
+    if (MY_CLASS_ID_E_BASE1 == class_id) {
+        object_id = base1_renew_object_id(base1_h);
+        TRACE_RECORD(TRACE_OP_E_BASE1_NEW1, object_id, 0, 0);
+    } else {
+        object_id = derived1_renew_object_id(base1_try_cast_to_derived1(
+            base1_h));
+        TRACE_RECORD((MY_CLASS_ID_E_DERIVED1 == class_id) ?
+                     TRACE_OP_E_DERIVED1_NEW1 : TRACE_OP_E_DERIVED2_NEW1,
+                     object_id, 0, 0);
+    }
+    WAL_LOG_OBJECT(base1_h);
+    CHECKPOINT_TRACK(base1_h);
+    AGGREGATE_ADD(base1_h);
+
+    return (base1_h);
+}
+
+/**
+ * Release an object to the pool of its class in place of deleting it.  The
+ * object is reset to its default state.  If its class has no pool or the
+ * pool is full, the object is deleted.  Either way, the caller must no
+ * longer use the object.  A read-only object, such as the instance shared by
+ * flyweights, is refused and left as it is.
+ *
+ * @param base1_h The object.  If NULL, then this function is a no-op.
+ * @see base1_reset()
+ */
+void
+objpool_release (base1_handle base1_h)
+{
+    my_class_id_e class_id;
+    objpool_st *pool = NULL;
+    uint64_t object_id;
+
+    if (NULL == base1_h) {
+        return;
+    }
+    if (base1_is_read_only(base1_h)) {
+        LOG_ERR("Object is read-only, base1_h(%p)", base1_h);
+        return;
+    }
+
+    class_id = base1_class_id(base1_h);
+    if (my_class_id_e_is_valid(class_id)) {
+        pool = __atomic_load_n(&objpool_pools[class_id], __ATOMIC_ACQUIRE);
+    }
+    if (NULL == pool) {
+        base1_delete(base1_h);
+        return;
+    }
+
+    /*
+     * To a trace, the object is deleted and a new one made on acquire, so
+     * the reset is not logged and the object is not logged again if deleted.
+     */
+    object_id = base1_get_object_id(base1_h);
+    checkpoint_untrack(base1_h);
+    FIELD_INDEX_FORGET(base1_h);
+    AGGREGATE_REMOVE(base1_h);
+    TRACE_RECORD(TRACE_OP_E_BASE1_DELETE, object_id, 0, 0);
+    WAL_LOG_DELETE(object_id);
+    if (my_rc_e_is_notok(base1_reset_unlogged(base1_h))) {
+        base1_delete_unlogged(base1_h);
+        return;
+    }
+
+    if (!objpool_put(pool, base1_h)) {
+        __atomic_add_fetch(&pool->overflows, 1, __ATOMIC_RELAXED);
+        base1_delete_unlogged(base1_h);
+    }
+}
+
+/**
+ * Get the statistics of the pool of a class.  The count is found by walking
+ * the object stack, so it is approximate while other threads use the pool.
+ *
+ * @param class_id The class
+ * @param stats Filled in with the statistics
+ * @return Return code, MY_RC_E_EINVAL if the class has no pool.
+ */
+my_rc_e
+objpool_get_stats (my_class_id_e class_id, objpool_stats_st *stats)
+{
+    objpool_st *pool = NULL;
+    uint32_t index;
+
+    if (my_class_id_e_is_valid(class_id)) {
+        pool = __atomic_load_n(&objpool_pools[class_id], __ATOMIC_ACQUIRE);
+    }
+    if ((NULL == pool) || (NULL == stats)) {
+        LOG_ERR("Invalid input, class_id(%u) stats(%p)", class_id, stats);
+        return (MY_RC_E_EINVAL);
+    }
+
+    stats->capacity = pool->capacity;
+    stats->count = 0;
+    index = OBJPOOL_HEAD_INDEX(__atomic_load_n(&pool->objs,
+                                               __ATOMIC_ACQUIRE));
+    while ((OBJPOOL_NODE_NONE != index) && (stats->count < pool->capacity)) {
+        stats->count++;
+        index = __atomic_load_n(&pool->nodes[index].next, __ATOMIC_RELAXED);
+    }
+    stats->hits = __atomic_load_n(&pool->hits, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&pool->misses, __ATOMIC_RELAXED);
+    stats->overflows = __atomic_load_n(&pool->overflows, __ATOMIC_RELAXED);
+
+    return (MY_RC_E_SUCCESS);
+}
@@ -0,0 +1,65 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for object pools.  An object pool holds
+ * preconstructed objects of one class, in their default state, for handing
+ * off between threads: producers acquire objects from the pool and consumers
+ * release them back instead of deleting them.  Acquiring and releasing are
+ * lock-free, so they scale with the number of threads.
+ */
+#ifndef __OBJPOOL_H__
+#define __OBJPOOL_H__
+
+#include "common.h"
+#include "base1.h"
+
+/** Statistics of a pool */
+typedef struct objpool_stats_st_ {
+    /** Most objects the pool may hold */
+    size_t capacity;
+    /** Objects in the pool */
+    size_t count;
+    /** Acquires served from the pool */
+    uint64_t hits;
+    /** Acquires which found the pool empty and constructed an object */
+    uint64_t misses;
+    /** Releases which found the pool full and deleted the object */
+    uint64_t overflows;
+} objpool_stats_st;
+
+/* APIs below are documented in their implementation file */
+
+extern my_rc_e
+objpool_create(my_class_id_e class_id, size_t capacity, size_t prefill);
+
+extern void
+objpool_destroy(my_class_id_e class_id);
+
+extern base1_handle
+objpool_acquire(my_class_id_e class_id);
+
+extern void
+objpool_release(base1_handle base1_h);
+
+extern my_rc_e
+objpool_get_stats(my_class_id_e class_id, objpool_stats_st *stats);
+
+#endif
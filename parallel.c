@@ -0,0 +1,664 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements running methods over collections of objects on a pool of
+ * threads.
+ *
+ * Each worker has a Chase-Lev deque of ranges of blocks.  The owner pushes and
+ * takes at the bottom without contention except over the last range, while
+ * thieves take the oldest, and so largest, range from the top with a
+ * compare-and-swap.  A range is packed into one word so it is read and written
+ * atomically.
+ *
+ * Splitting is lazy: a worker only splits its range in half, pushing the upper
+ * half, while its deque is empty, and otherwise runs the range a block at a
+ * time.  Ranges are therefore only split as often as other workers come looking
+ * for work, and a grain of zero picks blocks small enough to balance a few per
+ * worker.
+ *
+ * The caller runs as the first worker, so a pool of one thread has no other
+ * threads.  The other workers sleep until a collection is submitted, steal
+ * until every block has run, and leave it before the caller returns.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include "parallel.h"
+
+/** Number of ranges a deque holds, a power of two */
+#define PARALLEL_DEQUE_SIZE 64
+
+/** Blocks per worker a grain of zero aims for */
+#define PARALLEL_BLOCKS_PER_WORKER 16
+
+/** Fewest objects in a block with a grain of zero */
+#define PARALLEL_MIN_GRAIN 64
+
+/** How many objects ahead of the one being run to prefetch */
+#define PARALLEL_PREFETCH_DISTANCE 8
+
+/** Value taken from a deque which held no range */
+#define PARALLEL_EMPTY UINT64_MAX
+
+/** A collection being run */
+typedef struct parallel_job_st_ {
+    /** The objects */
+    base1_handle *objs;
+    /** Number of objects */
+    size_t count;
+    /** Objects in a block */
+    size_t grain;
+    /** Method run on each object, or NULL for a reduction */
+    parallel_object_fn fn;
+    /** Value of each object for a reduction */
+    parallel_value_fn value_fn;
+    /** Combines values for a reduction */
+    parallel_combine_fn combine_fn;
+    /** The result of reducing no values */
+    uint64_t identity;
+    /** Argument of the methods */
+    void *arg;
+    /** Result of each block for a reduction */
+    uint64_t *partials;
+    /** Number of blocks yet to run */
+    size_t remaining;
+    /** The first failure of a method */
+    my_rc_e rc;
+} parallel_job_st;
+
+/** A worker and its deque */
+typedef struct parallel_worker_st_ {
+    /** Index of the next range to steal */
+    int64_t top __attribute__((aligned(MY_CACHE_LINE_SIZE)));
+    /** Index after the range the owner pushed last */
+    int64_t bottom __attribute__((aligned(MY_CACHE_LINE_SIZE)));
+    /** The ranges, each the first block above the last block */
+    uint64_t ranges[PARALLEL_DEQUE_SIZE];
+    /** The pool */
+    struct parallel_pool_st_ *pool;
+    /** Index of the worker */
+    size_t index;
+    /** State for choosing a worker to steal from */
+    uint64_t seed;
+    /** Scratch buffer for methods */
+    void *scratch;
+    /** Size of the scratch buffer */
+    size_t scratch_size;
+    /** The thread, unused for the first worker */
+    pthread_t thread;
+} parallel_worker_st;
+
+/**
+ * Private variables which cannot be directly accessed by any other class.
+ */
+typedef struct parallel_pool_st_ {
+    /** Number of workers, including the caller */
+    size_t num_workers;
+    /** The workers */
+    parallel_worker_st *workers;
+    /** Serializes collections submitted to the pool */
+    pthread_mutex_t run_lock;
+    /** Guards the fields below */
+    pthread_mutex_t lock;
+    /** Signalled when a collection is submitted or the pool is deleted */
+    pthread_cond_t start;
+    /** Signalled when the last worker leaves a collection */
+    pthread_cond_t idle;
+    /** The collection being run, or NULL */
+    parallel_job_st *job;
+    /** Incremented for each collection submitted */
+    uint64_t job_gen;
+    /** Number of workers other than the caller in the collection */
+    size_t active;
+    /** Whether the workers are to exit */
+    bool stopping;
+} parallel_pool_st;
+
+/**
+ * Push a range to the bottom of a worker's own deque.
+ *
+ * @param worker The worker
+ * @param first The first block
+ * @param end The block after the last
+ * @return true if the range was pushed, false if the deque is full
+ */
+static bool
+parallel_push (parallel_worker_st *worker, uint32_t first, uint32_t end)
+{
+    int64_t bottom, top;
+
+    bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED);
+    top = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+    if (bottom - top >= PARALLEL_DEQUE_SIZE) {
+        return (false);
+    }
+    __atomic_store_n(&worker->ranges[bottom & (PARALLEL_DEQUE_SIZE - 1)],
+                     ((uint64_t) end << 32) | first, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+
+    return (true);
+}
+
+/**
+ * Take the range pushed last from the bottom of a worker's own deque.
+ *
+ * @param worker The worker
+ * @return The range, or PARALLEL_EMPTY
+ */
+static uint64_t
+parallel_take (parallel_worker_st *worker)
+{
+    int64_t bottom, top;
+    uint64_t range = PARALLEL_EMPTY;
+
+    bottom = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&worker->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    top = __atomic_load_n(&worker->top, __ATOMIC_RELAXED);
+    if (top > bottom) {
+        __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return (PARALLEL_EMPTY);
+    }
+
+    range = __atomic_load_n(&worker->ranges[bottom & (PARALLEL_DEQUE_SIZE - 1)],
+                            __ATOMIC_RELAXED);
+    if (top == bottom) {
+        /* The last range, which a thief may be taking too */
+        if (!__atomic_compare_exchange_n(&worker->top, &top, top + 1, false,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            range = PARALLEL_EMPTY;
+        }
+        __atomic_store_n(&worker->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+
+    return (range);
+}
+
+/**
+ * Steal the oldest range from the top of another worker's deque.
+ *
+ * @param victim The worker to steal from
+ * @return The range, or PARALLEL_EMPTY if there was none or another thread
+ * took it first
+ */
+static uint64_t
+parallel_steal (parallel_worker_st *victim)
+{
+    int64_t bottom, top;
+    uint64_t range;
+
+    top = __atomic_load_n(&victim->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    bottom = __atomic_load_n(&victim->bottom, __ATOMIC_ACQUIRE);
+    if (top >= bottom) {
+        return (PARALLEL_EMPTY);
+    }
+
+    range = __atomic_load_n(&victim->ranges[top & (PARALLEL_DEQUE_SIZE - 1)],
+                            __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&victim->top, &top, top + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return (PARALLEL_EMPTY);
+    }
+
+    return (range);
+}
+
+/**
+ * Run the method on each object of a block, or reduce the values of its
+ * objects in order.
+ *
+ * @param worker The worker
+ * @param job The collection
+ * @param block The block
+ */
+static void
+parallel_run_block (parallel_worker_st *worker, parallel_job_st *job,
+                    size_t block)
+{
+    size_t i, first, end;
+    uint64_t result, value;
+    my_rc_e rc = MY_RC_E_SUCCESS, expected = MY_RC_E_SUCCESS;
+
+    if (my_rc_e_is_notok(__atomic_load_n(&job->rc, __ATOMIC_RELAXED))) {
+        return;
+    }
+
+    first = block * job->grain;
+    end = ((job->count - first) < job->grain) ? job->count :
+        (first + job->grain);
+    result = job->identity;
+    for (i = first; my_rc_e_is_ok(rc) && (i < end); i++) {
+        if ((i + PARALLEL_PREFETCH_DISTANCE) < end) {
+            __builtin_prefetch(job->objs[i + PARALLEL_PREFETCH_DISTANCE]);
+        }
+        if (NULL != job->fn) {
+            rc = job->fn(worker, job->objs[i], i, job->arg);
+            continue;
+        }
+        rc = job->value_fn(worker, job->objs[i], job->arg, &value);
+        result = job->combine_fn(result, value);
+    }
+
+    if (my_rc_e_is_notok(rc)) {
+        __atomic_compare_exchange_n(&job->rc, &expected, rc, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    } else if (NULL == job->fn) {
+        job->partials[block] = result;
+    }
+}
+
+/**
+ * Run a range of blocks, pushing its upper half for other workers to steal
+ * whenever the worker's deque is empty.
+ *
+ * @param worker The worker
+ * @param job The collection
+ * @param range The range
+ */
+static void
+parallel_run_range (parallel_worker_st *worker, parallel_job_st *job,
+                    uint64_t range)
+{
+    uint32_t first = range, end = range >> 32, middle;
+
+    while (first < end) {
+        if (((end - first) > 1) &&
+            (__atomic_load_n(&worker->bottom, __ATOMIC_RELAXED) <=
+             __atomic_load_n(&worker->top, __ATOMIC_RELAXED))) {
+            middle = first + ((end - first) / 2);
+            if (parallel_push(worker, middle, end)) {
+                end = middle;
+                continue;
+            }
+        }
+        parallel_run_block(worker, job, first++);
+        __atomic_fetch_sub(&job->remaining, 1, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * Run ranges from the worker's own deque, or stolen from others, until every
+ * block of the collection has run.
+ *
+ * @param worker The worker
+ * @param job The collection
+ */
+static void
+parallel_work (parallel_worker_st *worker, parallel_job_st *job)
+{
+    parallel_pool_st *pool = worker->pool;
+    uint64_t range;
+    size_t i, victim;
+
+    while (0 != __atomic_load_n(&job->remaining, __ATOMIC_ACQUIRE)) {
+        range = parallel_take(worker);
+        if (PARALLEL_EMPTY == range) {
+            worker->seed ^= worker->seed << 13;
+            worker->seed ^= worker->seed >> 7;
+            worker->seed ^= worker->seed << 17;
+            victim = worker->seed % pool->num_workers;
+            for (i = 0; (PARALLEL_EMPTY == range) &&
+                 (i < pool->num_workers); i++) {
+                if (victim != worker->index) {
+                    range = parallel_steal(&pool->workers[victim]);
+                }
+                victim = (victim + 1) % pool->num_workers;
+            }
+        }
+        if (PARALLEL_EMPTY == range) {
+            sched_yield();
+            continue;
+        }
+        parallel_run_range(worker, job, range);
+    }
+}
+
+/**
+ * Wait for collections to be submitted and help run them, until the pool is
+ * deleted.
+ *
+ * @param arg The worker
+ * @return NULL
+ */
+static void *
+parallel_worker_thread (void *arg)
+{
+    parallel_worker_st *worker = arg;
+    parallel_pool_st *pool = worker->pool;
+    parallel_job_st *job;
+    uint64_t job_gen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (!pool->stopping &&
+               ((NULL == pool->job) || (job_gen == pool->job_gen))) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stopping) {
+            break;
+        }
+        job = pool->job;
+        job_gen = pool->job_gen;
+        pool->active++;
+        pthread_mutex_unlock(&pool->lock);
+
+        parallel_work(worker, job);
+
+        pthread_mutex_lock(&pool->lock);
+        if (0 == --pool->active) {
+            pthread_cond_signal(&pool->idle);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return (NULL);
+}
+
+/**
+ * Stop the workers other than the caller and free the pool.
+ *
+ * @param pool_h The pool
+ * @param num_started Number of workers whose threads were started
+ */
+static void
+parallel_pool_free (parallel_pool_handle pool_h, size_t num_started)
+{
+    size_t i;
+
+    pthread_mutex_lock(&pool_h->lock);
+    pool_h->stopping = true;
+    pthread_cond_broadcast(&pool_h->start);
+    pthread_mutex_unlock(&pool_h->lock);
+    for (i = 1; i < num_started; i++) {
+        pthread_join(pool_h->workers[i].thread, NULL);
+    }
+
+    for (i = 0; i < pool_h->num_workers; i++) {
+        free(pool_h->workers[i].scratch);
+    }
+    pthread_mutex_destroy(&pool_h->run_lock);
+    pthread_mutex_destroy(&pool_h->lock);
+    pthread_cond_destroy(&pool_h->start);
+    pthread_cond_destroy(&pool_h->idle);
+    free(pool_h->workers);
+    free(pool_h);
+}
+
+/**
+ * Create a pool of threads.
+ *
+ * @param num_threads Number of threads, including each caller submitting a
+ * collection, so a pool of one thread runs collections on the caller alone
+ * @return The pool, or NULL on failure
+ */
+parallel_pool_handle
+parallel_pool_new (size_t num_threads)
+{
+    parallel_pool_handle pool_h;
+    parallel_worker_st *worker;
+    size_t i;
+
+    if (0 == num_threads) {
+        LOG_ERR("Invalid input, num_threads(%zu)", num_threads);
+        return (NULL);
+    }
+
+    pool_h = calloc(1, sizeof(*pool_h));
+    if (NULL == pool_h) {
+        return (NULL);
+    }
+    pool_h->workers = aligned_alloc(MY_CACHE_LINE_SIZE,
+                                    num_threads * sizeof(*pool_h->workers));
+    if (NULL == pool_h->workers) {
+        free(pool_h);
+        return (NULL);
+    }
+    memset(pool_h->workers, 0, num_threads * sizeof(*pool_h->workers));
+    pool_h->num_workers = num_threads;
+    pthread_mutex_init(&pool_h->run_lock, NULL);
+    pthread_mutex_init(&pool_h->lock, NULL);
+    pthread_cond_init(&pool_h->start, NULL);
+    pthread_cond_init(&pool_h->idle, NULL);
+
+    for (i = 0; i < num_threads; i++) {
+        worker = &pool_h->workers[i];
+        worker->pool = pool_h;
+        worker->index = i;
+        worker->seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+        if ((i > 0) && (0 != pthread_create(&worker->thread, NULL,
+                                            parallel_worker_thread, worker))) {
+            parallel_pool_free(pool_h, i);
+            return (NULL);
+        }
+    }
+
+    return (pool_h);
+}
+
+/**
+ * Delete a pool of threads.  No collection may be running on it.
+ *
+ * @param pool_h The pool
+ */
+void
+parallel_pool_delete (parallel_pool_handle pool_h)
+{
+    if (NULL == pool_h) {
+        return;
+    }
+
+    parallel_pool_free(pool_h, pool_h->num_workers);
+}
+
+/**
+ * Run a collection on the pool, with the caller as the first worker, and
+ * wait for the other workers to leave it.
+ *
+ * @param pool_h The pool
+ * @param job The collection, with its objects, grain and methods set
+ * @return Return code
+ */
+static my_rc_e
+parallel_submit (parallel_pool_handle pool_h, parallel_job_st *job)
+{
+    size_t num_blocks;
+
+    if (0 == job->grain) {
+        job->grain = job->count / (pool_h->num_workers *
+                                   PARALLEL_BLOCKS_PER_WORKER);
+        job->grain = (job->grain < PARALLEL_MIN_GRAIN) ? PARALLEL_MIN_GRAIN :
+            job->grain;
+    }
+    num_blocks = (job->count + job->grain - 1) / job->grain;
+    if (num_blocks > UINT32_MAX) {
+        LOG_ERR("Invalid input, count(%zu) grain(%zu)", job->count,
+                job->grain);
+        return (MY_RC_E_EINVAL);
+    }
+    if (NULL == job->fn) {
+        job->partials = malloc(num_blocks * sizeof(*job->partials));
+        if (NULL == job->partials) {
+            return (MY_RC_E_ENOMEM);
+        }
+    }
+    job->remaining = num_blocks;
+    job->rc = MY_RC_E_SUCCESS;
+
+    pthread_mutex_lock(&pool_h->run_lock);
+    parallel_push(&pool_h->workers[0], 0, num_blocks);
+    if (pool_h->num_workers > 1) {
+        pthread_mutex_lock(&pool_h->lock);
+        pool_h->job = job;
+        pool_h->job_gen++;
+        pthread_cond_broadcast(&pool_h->start);
+        pthread_mutex_unlock(&pool_h->lock);
+    }
+
+    parallel_work(&pool_h->workers[0], job);
+
+    pthread_mutex_lock(&pool_h->lock);
+    pool_h->job = NULL;
+    while (0 != pool_h->active) {
+        pthread_cond_wait(&pool_h->idle, &pool_h->lock);
+    }
+    pthread_mutex_unlock(&pool_h->lock);
+    pthread_mutex_unlock(&pool_h->run_lock);
+
+    return (job->rc);
+}
+
+/**
+ * Run a method on each object of a collection using every thread of a pool.
+ * The method runs concurrently on different objects, so an object must not
+ * appear twice, and it must not submit another collection to the pool.
+ *
+ * @param pool_h The pool
+ * @param objs The objects
+ * @param count Number of objects
+ * @param fn The method
+ * @param arg Argument of the method
+ * @param grain Number of objects in a block, the least work a thread takes,
+ * or zero to choose from the number of objects and threads
+ * @return Return code, the first failure of the method if any
+ */
+my_rc_e
+parallel_for_each_object (parallel_pool_handle pool_h, base1_handle *objs,
+                          size_t count, parallel_object_fn fn, void *arg,
+                          size_t grain)
+{
+    parallel_job_st job = { 0 };
+
+    if ((NULL == pool_h) || ((NULL == objs) && (count > 0)) || (NULL == fn)) {
+        LOG_ERR("Invalid input, pool_h(%p) objs(%p) fn(%p)", pool_h, objs,
+                fn);
+        return (MY_RC_E_EINVAL);
+    }
+    if (0 == count) {
+        return (MY_RC_E_SUCCESS);
+    }
+
+    job.objs = objs;
+    job.count = count;
+    job.grain = grain;
+    job.fn = fn;
+    job.arg = arg;
+
+    return (parallel_submit(pool_h, &job));
+}
+
+/**
+ * Reduce a value of each object of a collection using every thread of a
+ * pool.  The values of each block are combined in order starting from the
+ * identity, and then the results of the blocks in order starting from the
+ * identity, so the result only depends on the grain, not on the threads.
+ * With a grain of zero it depends on the number of threads in the pool.
+ *
+ * @param pool_h The pool
+ * @param objs The objects
+ * @param count Number of objects
+ * @param value_fn Computes the value of an object
+ * @param arg Argument of value_fn
+ * @param combine_fn Combines values and results
+ * @param identity The result of combining no values
+ * @param grain Number of objects in a block, or zero to choose from the
+ * number of objects and threads
+ * @param result Outputs the result
+ * @return Return code, the first failure of value_fn if any
+ */
+my_rc_e
+parallel_reduce_objects (parallel_pool_handle pool_h, base1_handle *objs,
+                         size_t count, parallel_value_fn value_fn, void *arg,
+                         parallel_combine_fn combine_fn, uint64_t identity,
+                         size_t grain, uint64_t *result)
+{
+    parallel_job_st job = { 0 };
+    size_t i, num_blocks;
+    my_rc_e rc;
+
+    if ((NULL == pool_h) || ((NULL == objs) && (count > 0)) ||
+        (NULL == value_fn) || (NULL == combine_fn) || (NULL == result)) {
+        LOG_ERR("Invalid input, pool_h(%p) objs(%p) value_fn(%p) "
+                "combine_fn(%p) result(%p)", pool_h, objs, value_fn,
+                combine_fn, result);
+        return (MY_RC_E_EINVAL);
+    }
+    *result = identity;
+    if (0 == count) {
+        return (MY_RC_E_SUCCESS);
+    }
+
+    job.objs = objs;
+    job.count = count;
+    job.grain = grain;
+    job.value_fn = value_fn;
+    job.combine_fn = combine_fn;
+    job.identity = identity;
+    job.arg = arg;
+
+    rc = parallel_submit(pool_h, &job);
+    if (my_rc_e_is_ok(rc)) {
+        num_blocks = (count + job.grain - 1) / job.grain;
+        for (i = 0; i < num_blocks; i++) {
+            *result = combine_fn(*result, job.partials[i]);
+        }
+    }
+    free(job.partials);
+
+    return (rc);
+}
+
+/**
+ * Get the index of a worker within its pool, the caller's being zero.
+ *
+ * @param worker_h The worker
+ * @return The index
+ */
+size_t
+parallel_worker_index (parallel_worker_handle worker_h)
+{
+    return (worker_h->index);
+}
+
+/**
+ * Get a worker's scratch buffer, which only its methods use, growing it to
+ * the size needed.  Its contents are kept from one object to the next.
+ *
+ * @param worker_h The worker
+ * @param size Size needed
+ * @return The buffer, or NULL if it could not grow
+ */
+void *
+parallel_scratch (parallel_worker_handle worker_h, size_t size)
+{
+    void *scratch;
+
+    if (size > worker_h->scratch_size) {
+        scratch = realloc(worker_h->scratch, size);
+        if (NULL == scratch) {
+            return (NULL);
+        }
+        worker_h->scratch = scratch;
+        worker_h->scratch_size = size;
+    }
+
+    return (worker_h->scratch);
+}
@@ -0,0 +1,108 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for running methods over a collection of objects
+ * on a pool of threads.  The collection is split into blocks of objects, and
+ * each thread takes ranges of blocks from its own deque and steals from the
+ * others' when it runs out, so threads that finish early help those with slower
+ * objects.
+ *
+ * A method is called with the worker running it, which provides a scratch
+ * buffer of its own, such as for rendering strings without allocating per
+ * object.  A reduction folds a value of each object, in order, into a result
+ * per block, and then folds the results of the blocks in order, so for a given
+ * grain the result does not depend on the number of threads or on which thread
+ * ran each block.
+ */
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include "common.h"
+#include "base1.h"
+
+/** Opaque handle of a pool of threads */
+typedef struct parallel_pool_st_ *parallel_pool_handle;
+
+/** Opaque handle of a worker of a pool, valid while it runs a method */
+typedef struct parallel_worker_st_ *parallel_worker_handle;
+
+/**
+ * A method run on each object of a collection.
+ *
+ * @param worker_h The worker running it
+ * @param base1_h The object
+ * @param index Index of the object in the collection
+ * @param arg Argument given for the collection
+ * @return Return code, where a failure stops the remaining objects
+ */
+typedef my_rc_e
+(*parallel_object_fn)(parallel_worker_handle worker_h, base1_handle base1_h,
+                      size_t index, void *arg);
+
+/**
+ * A method computing a value of each object to reduce.
+ *
+ * @param worker_h The worker running it
+ * @param base1_h The object
+ * @param arg Argument given for the collection
+ * @param value Outputs the value
+ * @return Return code, where a failure stops the remaining objects
+ */
+typedef my_rc_e
+(*parallel_value_fn)(parallel_worker_handle worker_h, base1_handle base1_h,
+                     void *arg, uint64_t *value);
+
+/**
+ * Combine a partial result with the next value or partial result.
+ *
+ * @param result The result so far
+ * @param value The value following it
+ * @return The combined result
+ */
+typedef uint64_t
+(*parallel_combine_fn)(uint64_t result, uint64_t value);
+
+/* APIs below are documented in their implementation file */
+
+extern parallel_pool_handle
+parallel_pool_new(size_t num_threads);
+
+extern void
+parallel_pool_delete(parallel_pool_handle pool_h);
+
+extern my_rc_e
+parallel_for_each_object(parallel_pool_handle pool_h, base1_handle *objs,
+                         size_t count, parallel_object_fn fn, void *arg,
+                         size_t grain);
+
+extern my_rc_e
+parallel_reduce_objects(parallel_pool_handle pool_h, base1_handle *objs,
+                        size_t count, parallel_value_fn value_fn, void *arg,
+                        parallel_combine_fn combine_fn, uint64_t identity,
+                        size_t grain, uint64_t *result);
+
+extern size_t
+parallel_worker_index(parallel_worker_handle worker_h);
+
+extern void *
+parallel_scratch(parallel_worker_handle worker_h, size_t size);
+
+#endif
@@ -0,0 +1,592 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements aggregate queries.
+ *
+ * Queries are evaluated a batch of rows at a time.  Each predicate narrows a
+ * byte per row selecting the rows still passing, and the aggregates are then
+ * folded over the selected rows.  The loops are branch free over plain arrays,
+ * so the compiler can vectorize them.
+ *
+ * Over columns, a batch is simply a window into each column.  Over object
+ * handles, the fields the query uses are first gathered from the objects into
+ * small per-batch columns, so the same batch code runs over both.  The gather
+ * first prefetches every object of the batch, since each one is a dependent
+ * load the hardware prefetcher cannot predict.  Fields of base1 are at a fixed
+ * offset from every object's base1 view, so if the query uses only those it
+ * never looks up an object's class.  Otherwise the class is needed, which reads
+ * the object's private block, so that is prefetched too, a fixed distance ahead
+ * of the gather.
+ *
+ * Large collections are split into equal ranges, one per thread, and the
+ * threads' results are merged.
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <unistd.h>
+#include "query.h"
+#include "base1_friend.h"
+
+/** Number of rows evaluated together */
+#define QUERY_BATCH 256
+
+/** How many objects ahead of the gather an object's class is prefetched */
+#define QUERY_PREFETCH_DISTANCE 8
+
+/** Most distinct fields a query uses */
+#define QUERY_MAX_FIELDS (QUERY_MAX_PREDICATES + 1)
+
+/** A query prepared for running */
+typedef struct query_plan_st_ {
+    /** The query */
+    const query_st *query;
+    /** Number of distinct fields used */
+    size_t num_fields;
+    /** The distinct fields used */
+    my_field_e fields[QUERY_MAX_FIELDS];
+    /** Whether every field used is a field of base1 */
+    bool base1_only;
+    /** Whether objects of each class have each field used */
+    bool has[MY_CLASS_ID_E_MAX][QUERY_MAX_FIELDS];
+    /** Offset of each field used from the base1 view, for each class */
+    ptrdiff_t offsets[MY_CLASS_ID_E_MAX][QUERY_MAX_FIELDS];
+    /** Width of each field used, for each class */
+    size_t widths[MY_CLASS_ID_E_MAX][QUERY_MAX_FIELDS];
+} query_plan_st;
+
+/** A range of rows run by one thread */
+typedef struct query_part_st_ {
+    /** The prepared query */
+    const query_plan_st *plan;
+    /** The columns, when running over columns */
+    const query_columns_st *columns;
+    /** The objects, when running over objects */
+    const base1_handle *objs;
+    /** First row */
+    size_t start;
+    /** Row after the last */
+    size_t end;
+    /** Result for the range */
+    query_result_st result;
+} query_part_st;
+
+/**
+ * Reset a result to that of no rows.
+ *
+ * @param result The result
+ */
+static void
+query_result_init (query_result_st *result)
+{
+    memset(result, 0, sizeof(*result));
+    result->min = UINT64_MAX;
+}
+
+/**
+ * Merge the result of some rows into the result of others.
+ *
+ * @param result The result merged into
+ * @param part The result merged
+ */
+static void
+query_result_merge (query_result_st *result, const query_result_st *part)
+{
+    size_t i;
+
+    result->count += part->count;
+    result->sum += part->sum;
+    result->min = (part->min < result->min) ? part->min : result->min;
+    result->max = (part->max > result->max) ? part->max : result->max;
+    for (i = 0; i < QUERY_MAX_BUCKETS; i++) {
+        result->buckets[i] += part->buckets[i];
+    }
+}
+
+/**
+ * Filter one predicate's comparison over a batch.
+ */
+#define QUERY_FILTER_LOOP(sel, col, n, cmp, value) \
+do { \
+    size_t i_; \
+\
+    for (i_ = 0; i_ < (n); i_++) { \
+        (sel)[i_] &= ((col)[i_] cmp (value)); \
+    } \
+} while (0)
+
+/**
+ * Evaluate a query over a batch of rows.
+ *
+ * @param query The query
+ * @param cols The batch's values of each field, indexed by field
+ * @param sel On input, a byte per row which is one if the row may pass;
+ * filtered by the predicates
+ * @param n Number of rows
+ * @param result Updated with the rows passing
+ */
+static void
+query_batch (const query_st *query, const uint64_t *const *cols,
+             uint8_t *sel, size_t n, query_result_st *result)
+{
+    const query_pred_st *pred;
+    const uint64_t *col;
+    uint64_t count = 0, sum = 0, min = result->min, max = result->max, bucket;
+    size_t i;
+
+    for (i = 0; i < query->num_preds; i++) {
+        pred = &query->preds[i];
+        col = cols[pred->field];
+        switch (pred->op) {
+        case QUERY_OP_E_EQ:
+            QUERY_FILTER_LOOP(sel, col, n, ==, pred->value);
+            break;
+        case QUERY_OP_E_NE:
+            QUERY_FILTER_LOOP(sel, col, n, !=, pred->value);
+            break;
+        case QUERY_OP_E_LT:
+            QUERY_FILTER_LOOP(sel, col, n, <, pred->value);
+            break;
+        case QUERY_OP_E_LE:
+            QUERY_FILTER_LOOP(sel, col, n, <=, pred->value);
+            break;
+        case QUERY_OP_E_GT:
+            QUERY_FILTER_LOOP(sel, col, n, >, pred->value);
+            break;
+        default:
+            QUERY_FILTER_LOOP(sel, col, n, >=, pred->value);
+            break;
+        }
+    }
+
+    col = cols[query->field];
+    for (i = 0; i < n; i++) {
+        count += sel[i];
+        sum += col[i] & -(uint64_t) sel[i];
+        min = (sel[i] && (col[i] < min)) ? col[i] : min;
+        max = (sel[i] && (col[i] > max)) ? col[i] : max;
+    }
+    result->count += count;
+    result->sum += sum;
+    result->min = min;
+    result->max = max;
+
+    if (0 == query->num_buckets) {
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        if (!sel[i]) {
+            continue;
+        }
+        bucket = (col[i] < query->bucket_base) ? 0 :
+            ((col[i] - query->bucket_base) / query->bucket_width);
+        if (bucket >= query->num_buckets) {
+            bucket = query->num_buckets - 1;
+        }
+        result->buckets[bucket]++;
+    }
+}
+
+/**
+ * Run a query over a range of columns.
+ *
+ * @param part The range
+ */
+static void
+query_part_columns (query_part_st *part)
+{
+    const query_plan_st *plan = part->plan;
+    const uint64_t *cols[MY_FIELD_E_MAX] = { NULL };
+    uint8_t sel[QUERY_BATCH];
+    size_t start, n, i;
+
+    for (start = part->start; start < part->end; start += n) {
+        n = part->end - start;
+        if (n > QUERY_BATCH) {
+            n = QUERY_BATCH;
+        }
+        for (i = 0; i < plan->num_fields; i++) {
+            cols[plan->fields[i]] =
+                part->columns->columns[plan->fields[i]] + start;
+        }
+        memset(sel, 1, n);
+        query_batch(plan->query, cols, sel, n, &part->result);
+    }
+}
+
+/**
+ * Gather a field of base1 from a batch of objects into a column.  The switch
+ * on the width is outside the loop so each case is a plain strided load.
+ *
+ * @param objs The objects
+ * @param n Number of objects
+ * @param offset Offset of the field from the base1 view
+ * @param width Width of the field
+ * @param values Outputs the values
+ */
+static void
+query_gather (const base1_handle *objs, size_t n, ptrdiff_t offset,
+              size_t width, uint64_t *values)
+{
+    uint32_t val32;
+    uint16_t val16;
+    size_t i;
+
+    switch (width) {
+    case 1:
+        for (i = 0; i < n; i++) {
+            values[i] = *((const uint8_t *) objs[i] + offset);
+        }
+        break;
+    case 2:
+        for (i = 0; i < n; i++) {
+            memcpy(&val16, (const uint8_t *) objs[i] + offset, sizeof(val16));
+            values[i] = val16;
+        }
+        break;
+    case 4:
+        for (i = 0; i < n; i++) {
+            memcpy(&val32, (const uint8_t *) objs[i] + offset, sizeof(val32));
+            values[i] = val32;
+        }
+        break;
+    default:
+        for (i = 0; i < n; i++) {
+            memcpy(&values[i], (const uint8_t *) objs[i] + offset,
+                   sizeof(values[i]));
+        }
+        break;
+    }
+}
+
+/**
+ * Gather the fields a query uses from a batch of objects whose classes are
+ * looked up one by one, deselecting objects lacking a field.
+ *
+ * @param plan The prepared query
+ * @param objs The objects
+ * @param n Number of objects
+ * @param values Outputs the values of each field used
+ * @param sel Outputs a byte per object which is one if it has every field
+ */
+static void
+query_gather_classes (const query_plan_st *plan, const base1_handle *objs,
+                      size_t n,
+                      uint64_t (*values)[QUERY_BATCH], uint8_t *sel)
+{
+    my_class_id_e class_id;
+    size_t i, k;
+
+    for (i = 0; i < n; i++) {
+        /* The class is behind the private block, so fetch that in turn */
+        if ((i + QUERY_PREFETCH_DISTANCE) < n) {
+            __builtin_prefetch(
+                objs[i + QUERY_PREFETCH_DISTANCE]->private_h);
+        }
+        class_id = base1_class_id(objs[i]);
+        sel[i] = my_class_id_e_is_valid(class_id);
+        for (k = 0; k < plan->num_fields; k++) {
+            values[k][i] = 0;
+            if (!sel[i] || !plan->has[class_id][k]) {
+                sel[i] = 0;
+                continue;
+            }
+            query_gather(&objs[i], 1, plan->offsets[class_id][k],
+                         plan->widths[class_id][k], &values[k][i]);
+        }
+    }
+}
+
+/**
+ * Run a query over a range of objects, gathering the fields it uses into
+ * columns a batch at a time.
+ *
+ * @param part The range
+ */
+static void
+query_part_objects (query_part_st *part)
+{
+    const query_plan_st *plan = part->plan;
+    const uint64_t *cols[MY_FIELD_E_MAX] = { NULL };
+    uint64_t values[QUERY_MAX_FIELDS][QUERY_BATCH];
+    uint8_t sel[QUERY_BATCH];
+    const base1_handle *objs;
+    size_t start, n, i, k;
+
+    for (k = 0; k < plan->num_fields; k++) {
+        cols[plan->fields[k]] = values[k];
+    }
+
+    for (start = part->start; start < part->end; start += n) {
+        n = part->end - start;
+        if (n > QUERY_BATCH) {
+            n = QUERY_BATCH;
+        }
+        objs = part->objs + start;
+
+        /*
+         * Objects are scattered, so fetch the whole batch before the gather,
+         * letting the misses overlap instead of each stalling in turn
+         */
+        for (i = 0; i < n; i++) {
+            __builtin_prefetch(objs[i]);
+        }
+
+        if (plan->base1_only) {
+            for (k = 0; k < plan->num_fields; k++) {
+                query_gather(objs, n,
+                             plan->offsets[MY_CLASS_ID_E_BASE1][k],
+                             plan->widths[MY_CLASS_ID_E_BASE1][k], values[k]);
+            }
+            memset(sel, 1, n);
+        } else {
+            query_gather_classes(plan, objs, n, values, sel);
+        }
+
+        query_batch(plan->query, cols, sel, n, &part->result);
+    }
+}
+
+/**
+ * Run a thread's range.
+ *
+ * @param arg The range
+ * @return NULL
+ */
+static void *
+query_part_thread (void *arg)
+{
+    query_part_st *part = arg;
+
+    if (NULL != part->columns) {
+        query_part_columns(part);
+    } else {
+        query_part_objects(part);
+    }
+
+    return (NULL);
+}
+
+/**
+ * Check a query and find the distinct fields it uses.
+ *
+ * @param query The query
+ * @param plan Filled in with the fields
+ * @return Return code
+ */
+static my_rc_e
+query_plan (const query_st *query, query_plan_st *plan)
+{
+    my_field_e field;
+    size_t i, k;
+
+    if ((NULL == query) || (query->num_preds > QUERY_MAX_PREDICATES) ||
+        (query->num_buckets > QUERY_MAX_BUCKETS) ||
+        ((0 != query->num_buckets) && (0 == query->bucket_width))) {
+        LOG_ERR("Invalid input, query(%p)", query);
+        return (MY_RC_E_EINVAL);
+    }
+
+    memset(plan, 0, sizeof(*plan));
+    plan->query = query;
+    plan->base1_only = true;
+
+    for (i = 0; i <= query->num_preds; i++) {
+        field = (i < query->num_preds) ? query->preds[i].field : query->field;
+        if ((field <= MY_FIELD_E_INVALID) || (field >= MY_FIELD_E_MAX) ||
+            ((i < query->num_preds) &&
+             ((query->preds[i].op <= QUERY_OP_E_INVALID) ||
+              (query->preds[i].op >= QUERY_OP_E_MAX)))) {
+            LOG_ERR("Invalid input, field(%u)", field);
+            return (MY_RC_E_EINVAL);
+        }
+        for (k = 0; (k < plan->num_fields) && (plan->fields[k] != field);
+             k++) {
+        }
+        if (k == plan->num_fields) {
+            plan->fields[plan->num_fields++] = field;
+        }
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Run a query split into ranges across threads.
+ *
+ * @param plan The prepared query
+ * @param columns The columns, or NULL
+ * @param objs The objects, or NULL
+ * @param count Number of rows
+ * @param result Outputs the result
+ * @return Return code
+ */
+static my_rc_e
+query_run (const query_plan_st *plan, const query_columns_st *columns,
+           const base1_handle *objs, size_t count, query_result_st *result)
+{
+    size_t num_threads = plan->query->num_threads, started = 0, i;
+    query_part_st *parts;
+    pthread_t *threads;
+    long num_cpus;
+
+    if (0 == num_threads) {
+        num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = ((count < QUERY_PARALLEL_MIN_OBJECTS) ||
+                       (num_cpus < 1)) ? 1 : num_cpus;
+    }
+    if (num_threads > ((count / QUERY_BATCH) + 1)) {
+        num_threads = (count / QUERY_BATCH) + 1;
+    }
+
+    parts = calloc(num_threads, sizeof(*parts));
+    threads = calloc(num_threads, sizeof(*threads));
+    if ((NULL == parts) || (NULL == threads)) {
+        free(parts);
+        free(threads);
+        return (MY_RC_E_ENOMEM);
+    }
+
+    for (i = 0; i < num_threads; i++) {
+        parts[i].plan = plan;
+        parts[i].columns = columns;
+        parts[i].objs = objs;
+        parts[i].start = (count * i) / num_threads;
+        parts[i].end = (count * (i + 1)) / num_threads;
+        query_result_init(&parts[i].result);
+    }
+
+    /* The calling thread runs the first range */
+    for (i = 1; i < num_threads; i++) {
+        if (0 != pthread_create(&threads[i], NULL, query_part_thread,
+                                &parts[i])) {
+            break;
+        }
+        started = i;
+    }
+    for (i = started + 1; i < num_threads; i++) {
+        query_part_thread(&parts[i]);
+    }
+    query_part_thread(&parts[0]);
+    for (i = 1; i <= started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    query_result_init(result);
+    for (i = 0; i < num_threads; i++) {
+        query_result_merge(result, &parts[i].result);
+    }
+
+    free(parts);
+    free(threads);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Run a query over columns of field values.  This is the fastest form, as
+ * each field is scanned sequentially.
+ *
+ * @param query The query
+ * @param columns The columns, which must include every field the query uses
+ * @param result Outputs the result
+ * @return Return code, MY_RC_E_EINVAL if a column the query uses is missing.
+ * @see class_registry_extract_column()
+ */
+my_rc_e
+query_run_columns (const query_st *query, const query_columns_st *columns,
+                   query_result_st *result)
+{
+    query_plan_st plan;
+    size_t i;
+    my_rc_e rc;
+
+    if ((NULL == columns) || (NULL == result)) {
+        LOG_ERR("Invalid input, columns(%p) result(%p)", columns, result);
+        return (MY_RC_E_EINVAL);
+    }
+
+    rc = query_plan(query, &plan);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+    for (i = 0; i < plan.num_fields; i++) {
+        if ((NULL == columns->columns[plan.fields[i]]) &&
+            (0 != columns->count)) {
+            LOG_ERR("Missing column, field(%s)",
+                    my_field_e_get_string(plan.fields[i]));
+            return (MY_RC_E_EINVAL);
+        }
+    }
+
+    return (query_run(&plan, columns, NULL, columns->count, result));
+}
+
+/**
+ * Run a query over objects of any classes.  Objects lacking a field the query
+ * uses do not pass it.
+ *
+ * @param query The query
+ * @param objs The objects
+ * @param count Number of objects
+ * @param result Outputs the result
+ * @return Return code
+ */
+my_rc_e
+query_run_objects (const query_st *query, const base1_handle *objs,
+                   size_t count, query_result_st *result)
+{
+    query_plan_st *plan;
+    my_class_id_e class_id;
+    size_t k;
+    my_rc_e rc;
+
+    if (((NULL == objs) && (0 != count)) || (NULL == result)) {
+        LOG_ERR("Invalid input, objs(%p) result(%p)", objs, result);
+        return (MY_RC_E_EINVAL);
+    }
+
+    plan = malloc(sizeof(*plan));
+    if (NULL == plan) {
+        return (MY_RC_E_ENOMEM);
+    }
+    rc = query_plan(query, plan);
+    if (my_rc_e_is_notok(rc)) {
+        free(plan);
+        return (rc);
+    }
+
+    for (class_id = 0; class_id < MY_CLASS_ID_E_MAX; class_id++) {
+        for (k = 0; k < plan->num_fields; k++) {
+            plan->has[class_id][k] = my_rc_e_is_ok(
+                class_registry_base1_field_offset(class_id, plan->fields[k],
+                                                  &plan->offsets[class_id][k],
+                                                  &plan->widths[class_id][k]));
+            if (MY_CLASS_ID_E_BASE1 == class_id) {
+                plan->base1_only &= plan->has[class_id][k];
+            }
+        }
+    }
+
+    rc = query_run(plan, NULL, objs, count, result);
+    free(plan);
+
+    return (rc);
+}
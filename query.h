@@ -0,0 +1,127 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for aggregate queries over collections of
+ * objects.  A query filters objects by predicates on their fields and computes
+ * the count, sum, minimum, maximum and a histogram of one field over the
+ * objects that pass.  Queries run over columns of field values, one array per
+ * field (structure of arrays), or directly over an array of object handles, and
+ * large collections are split across threads.
+ */
+#ifndef __QUERY_H__
+#define __QUERY_H__
+
+#include "common.h"
+#include "base1.h"
+#include "class_registry.h"
+
+/** Most predicates in a query */
+#define QUERY_MAX_PREDICATES 8
+
+/** Most histogram buckets */
+#define QUERY_MAX_BUCKETS 64
+
+/** Fewest objects for which a query uses more than one thread by default */
+#define QUERY_PARALLEL_MIN_OBJECTS (64 * 1024)
+
+/** Comparisons of a predicate */
+typedef enum query_op_e_ {
+    /** Invalid comparison, should never be used */
+    QUERY_OP_E_INVALID,
+    /** Field equals the value */
+    QUERY_OP_E_EQ,
+    /** Field differs from the value */
+    QUERY_OP_E_NE,
+    /** Field is below the value */
+    QUERY_OP_E_LT,
+    /** Field is at most the value */
+    QUERY_OP_E_LE,
+    /** Field is above the value */
+    QUERY_OP_E_GT,
+    /** Field is at least the value */
+    QUERY_OP_E_GE,
+    /** Max comparison for bounds testing */
+    QUERY_OP_E_MAX,
+} query_op_e;
+
+/** A predicate on a field */
+typedef struct query_pred_st_ {
+    /** The field */
+    my_field_e field;
+    /** The comparison */
+    query_op_e op;
+    /** The value compared with */
+    uint64_t value;
+} query_pred_st;
+
+/** A query */
+typedef struct query_st_ {
+    /** Number of predicates, all of which an object must pass */
+    size_t num_preds;
+    /** The predicates */
+    query_pred_st preds[QUERY_MAX_PREDICATES];
+    /** The field aggregated */
+    my_field_e field;
+    /** Number of histogram buckets, or zero for no histogram */
+    size_t num_buckets;
+    /** Lowest value of the first bucket */
+    uint64_t bucket_base;
+    /** Range of values in each bucket; values outside all buckets are
+     *  counted in the first or last */
+    uint64_t bucket_width;
+    /** Number of threads, or zero to use one per online CPU for large
+     *  collections */
+    size_t num_threads;
+} query_st;
+
+/** The result of a query */
+typedef struct query_result_st_ {
+    /** Number of objects passing the predicates */
+    uint64_t count;
+    /** Sum of the field */
+    uint64_t sum;
+    /** Minimum of the field, UINT64_MAX if no objects passed */
+    uint64_t min;
+    /** Maximum of the field */
+    uint64_t max;
+    /** Number of objects in each bucket */
+    uint64_t buckets[QUERY_MAX_BUCKETS];
+} query_result_st;
+
+/** Columns of field values for a query, one row per object */
+typedef struct query_columns_st_ {
+    /** Number of rows */
+    size_t count;
+    /** The column of each field, NULL for fields the query does not use */
+    const uint64_t *columns[MY_FIELD_E_MAX];
+} query_columns_st;
+
+/* APIs below are documented in their implementation file */
+
+extern my_rc_e
+query_run_columns(const query_st *query, const query_columns_st *columns,
+                  query_result_st *result);
+
+extern my_rc_e
+query_run_objects(const query_st *query, const base1_handle *objs,
+                  size_t count, query_result_st *result);
+
+#endif
@@ -0,0 +1,281 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements the recycle bin.
+ *
+ * Each class has its own bin, a bounded stack of reset objects protected by a
+ * mutex.  Objects keep the allocator they were allocated from, so an object put
+ * in a bin must not outlive its allocator.
+ */
+#include <pthread.h>
+#include "recycle.h"
+#include "base1_friend.h"
+#include "trace.h"
+#include "wal.h"
+#include "checkpoint.h"
+#include "field_index.h"
+#include "aggregate.h"
+
+/** The bin for a class */
+typedef struct recycle_bin_st_ {
+    /** Protects the bin */
+    pthread_mutex_t lock;
+    /** The objects in the bin, allocated on first use */
+    base1_handle *objs;
+    /** Number of objects in the bin, stored atomically under the lock so
+     *  recycle_get() may read it without the lock */
+    size_t count;
+    /** Most objects the bin may hold */
+    size_t capacity;
+} recycle_bin_st;
+
+/** The bin for each class */
+static recycle_bin_st recycle_bins[MY_CLASS_ID_E_MAX] = {
+    [0 ... (MY_CLASS_ID_E_MAX - 1)] = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .capacity = RECYCLE_DEFAULT_CAPACITY,
+    },
+};
+
+/**
+ * Check whether the bin has room for another object, allocating it on first
+ * use.
+ *
+ * @param bin The bin, which must be locked
+ * @return true if the bin has room
+ */
+static bool
+recycle_has_room (recycle_bin_st *bin)
+{
+    if ((NULL == bin->objs) && (0 != bin->capacity)) {
+        bin->objs = calloc(bin->capacity, sizeof(*bin->objs));
+    }
+
+    return ((NULL != bin->objs) && (bin->count < bin->capacity));
+}
+
+/**
+ * Put an object in the bin of its class in place of deleting it.  The object
+ * is reset to its default state.  If the bin is full, the object is deleted.
+ * Either way, the caller must no longer use the object.  A read-only object,
+ * such as the instance shared by flyweights, is refused and left as it is.
+ *
+ * @param base1_h The object.  If NULL, then this function is a no-op.
+ * @see base1_reset()
+ */
+void
+recycle_put (base1_handle base1_h)
+{
+    my_class_id_e class_id;
+    recycle_bin_st *bin;
+    uint64_t object_id;
+    bool binned = false;
+
+    if (NULL == base1_h) {
+        return;
+    }
+    if (base1_is_read_only(base1_h)) {
+        LOG_ERR("Object is read-only, base1_h(%p)", base1_h);
+        return;
+    }
+
+    class_id = base1_class_id(base1_h);
+    if (!my_class_id_e_is_valid(class_id)) {
+        base1_delete(base1_h);
+        return;
+    }
+    bin = &recycle_bins[class_id];
+
+    pthread_mutex_lock(&bin->lock);
+    binned = recycle_has_room(bin);
+    pthread_mutex_unlock(&bin->lock);
+    if (!binned) {
+        base1_delete(base1_h);
+        return;
+    }
+
+    /*
+     * To a trace, the object is deleted and a new one made on reuse, so the
+     * reset is not logged and the object is not logged again if deleted.
+     */
+    object_id = base1_get_object_id(base1_h);
+    checkpoint_untrack(base1_h);
+    FIELD_INDEX_FORGET(base1_h);
+    AGGREGATE_REMOVE(base1_h);
+    TRACE_RECORD(TRACE_OP_E_BASE1_DELETE, object_id, 0, 0);
+    WAL_LOG_DELETE(object_id);
+    if (my_rc_e_is_notok(base1_reset_unlogged(base1_h))) {
+        base1_delete_unlogged(base1_h);
+        return;
+    }
+
+    /* Another thread may have filled the bin meanwhile */
+    pthread_mutex_lock(&bin->lock);
+    binned = recycle_has_room(bin);
+    if (binned) {
+        bin->objs[bin->count] = base1_h;
+        __atomic_store_n(&bin->count, bin->count + 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&bin->lock);
+    if (!binned) {
+        base1_delete_unlogged(base1_h);
+    }
+}
+
+/**
+ * Take an object from the bin of a class.  This is used by the class's
+ * *_new1() constructor, which gives the object a new identity.
+ *
+ * @param class_id The class
+ * @return An object in its default state or NULL if the bin is empty.
+ */
+base1_handle
+recycle_get (my_class_id_e class_id)
+{
+    recycle_bin_st *bin;
+    base1_handle base1_h = NULL;
+
+    if (!my_class_id_e_is_valid(class_id)) {
+        return (NULL);
+    }
+    bin = &recycle_bins[class_id];
+
+    /* Avoid the lock for the common case of an empty bin */
+    if (0 == __atomic_load_n(&bin->count, __ATOMIC_RELAXED)) {
+        return (NULL);
+    }
+
+    pthread_mutex_lock(&bin->lock);
+    if (0 != bin->count) {
+        __atomic_store_n(&bin->count, bin->count - 1, __ATOMIC_RELAXED);
+        base1_h = bin->objs[bin->count];
+    }
+    pthread_mutex_unlock(&bin->lock);
+
+    return (base1_h);
+}
+
+/**
+ * Set the number of objects the bin of a class may hold.  Objects beyond the
+ * new capacity are deleted.  A capacity of zero disables the bin.
+ *
+ * @param class_id The class
+ * @param capacity The capacity
+ * @return Return code
+ */
+my_rc_e
+recycle_set_capacity (my_class_id_e class_id, size_t capacity)
+{
+    recycle_bin_st *bin;
+    base1_handle *objs = NULL, *old_objs;
+    size_t old_count;
+
+    if (!my_class_id_e_is_valid(class_id)) {
+        LOG_ERR("Invalid input, class_id(%u)", class_id);
+        return (MY_RC_E_EINVAL);
+    }
+    bin = &recycle_bins[class_id];
+
+    if (0 != capacity) {
+        objs = calloc(capacity, sizeof(*objs));
+        if (NULL == objs) {
+            return (MY_RC_E_ENOMEM);
+        }
+    }
+
+    pthread_mutex_lock(&bin->lock);
+    old_objs = bin->objs;
+    old_count = bin->count;
+    __atomic_store_n(&bin->count, (old_count < capacity) ? old_count : capacity,
+                     __ATOMIC_RELAXED);
+    if (0 != bin->count) {
+        memcpy(objs, old_objs, bin->count * sizeof(*objs));
+    }
+    bin->objs = objs;
+    bin->capacity = capacity;
+    pthread_mutex_unlock(&bin->lock);
+
+    while (old_count > capacity) {
+        base1_delete_unlogged(old_objs[--old_count]);
+    }
+    free(old_objs);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Get the number of objects in the bin of a class.
+ *
+ * @param class_id The class
+ * @return The number of objects
+ */
+size_t
+recycle_count (my_class_id_e class_id)
+{
+    size_t count;
+
+    if (!my_class_id_e_is_valid(class_id)) {
+        return (0);
+    }
+
+    pthread_mutex_lock(&recycle_bins[class_id].lock);
+    count = recycle_bins[class_id].count;
+    pthread_mutex_unlock(&recycle_bins[class_id].lock);
+
+    return (count);
+}
+
+/**
+ * Delete all objects in the bin of a class, e.g., before the allocator they
+ * came from is destroyed.
+ *
+ * @param class_id The class or MY_CLASS_ID_E_INVALID for all classes
+ */
+void
+recycle_drain (my_class_id_e class_id)
+{
+    recycle_bin_st *bin;
+    base1_handle base1_h;
+
+    if (MY_CLASS_ID_E_INVALID == class_id) {
+        for (class_id = MY_CLASS_ID_E_INVALID + 1; class_id < MY_CLASS_ID_E_MAX;
+             class_id++) {
+            recycle_drain(class_id);
+        }
+        return;
+    }
+
+    if (!my_class_id_e_is_valid(class_id)) {
+        return;
+    }
+    bin = &recycle_bins[class_id];
+
+    pthread_mutex_lock(&bin->lock);
+    while (0 != bin->count) {
+        __atomic_store_n(&bin->count, bin->count - 1, __ATOMIC_RELAXED);
+        base1_h = bin->objs[bin->count];
+        /* Delete outside the lock, since it may trace or free memory */
+        pthread_mutex_unlock(&bin->lock);
+        base1_delete_unlogged(base1_h);
+        pthread_mutex_lock(&bin->lock);
+    }
+    pthread_mutex_unlock(&bin->lock);
+}
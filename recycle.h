@@ -0,0 +1,53 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for the recycle bin.  Objects which are no
+ * longer needed may be put in the bin of their class instead of being deleted.
+ * They are reset to their default state and reused by the class's *_new1()
+ * constructor before it allocates a new object.
+ */
+#ifndef __RECYCLE_H__
+#define __RECYCLE_H__
+
+#include "common.h"
+#include "base1.h"
+
+/** Default number of objects each class's bin may hold */
+#define RECYCLE_DEFAULT_CAPACITY 64
+
+/* APIs below are documented in their implementation file */
+
+extern void
+recycle_put(base1_handle base1_h);
+
+extern base1_handle
+recycle_get(my_class_id_e class_id);
+
+extern my_rc_e
+recycle_set_capacity(my_class_id_e class_id, size_t capacity);
+
+extern size_t
+recycle_count(my_class_id_e class_id);
+
+extern void
+recycle_drain(my_class_id_e class_id);
+
+#endif
@@ -0,0 +1,805 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements snapshots.
+ *
+ * The file starts with a header giving the number of blocks and objects and the
+ * offset of the block index.  Each block holds a small header with the class
+ * and object count, the object IDs, then the objects' states in the format of
+ * class_registry_export().  Every object of a class has the same exported size,
+ * so the saver computes each block's offset and size before encoding anything,
+ * and the index records them along with a checksum of each block.  All integers
+ * are little-endian.
+ *
+ * Saving sorts the objects by class, then threads claim blocks from a shared
+ * counter, encode each into a private buffer and write it with pwrite() at its
+ * offset.  Loading reads the index, then threads claim blocks, read and check
+ * each one, and construct its objects through the class registry, which sets up
+ * each object's vtable and private block, before importing their states.  Each
+ * block's objects go to a position in the output computed from the index, so no
+ * thread waits on another.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snapshot.h"
+#include "class_registry.h"
+
+/** Magic at the start of a snapshot */
+#define SNAPSHOT_MAGIC "OOSS"
+
+/** Version of the file format */
+#define SNAPSHOT_VERSION 1
+
+/** Size of the file header */
+#define SNAPSHOT_HEADER_SIZE 32
+
+/** Size of a block's header: class and object count */
+#define SNAPSHOT_BLOCK_HEADER_SIZE 8
+
+/** Size of a block's index entry */
+#define SNAPSHOT_INDEX_ENTRY_SIZE 24
+
+/** A block of objects of one class */
+typedef struct snapshot_block_st_ {
+    /** Offset of the block in the file */
+    uint64_t offset;
+    /** Size of the block */
+    uint32_t size;
+    /** Number of objects */
+    uint32_t count;
+    /** Position of the block's first object in the sorted or loaded
+     *  objects */
+    size_t first;
+    /** Checksum of the block */
+    uint32_t checksum;
+    /** Class of the objects */
+    my_class_id_e class_id;
+} snapshot_block_st;
+
+/** Work shared by the threads saving or loading a snapshot */
+typedef struct snapshot_work_st_ {
+    /** The file */
+    int fd;
+    /** The blocks */
+    snapshot_block_st *blocks;
+    /** Number of blocks */
+    size_t num_blocks;
+    /** Index of the next block to claim */
+    size_t next;
+    /** Size of the largest block */
+    size_t max_block_size;
+    /** The objects, sorted by class when saving */
+    base1_handle *objs;
+    /** Allocator for loaded objects */
+    const allocator_st *allocator;
+    /** Highest object ID loaded */
+    uint64_t max_object_id;
+    /** First failure */
+    my_rc_e rc;
+} snapshot_work_st;
+
+/**
+ * Store a little-endian value.
+ *
+ * @param buffer Where to write
+ * @param value The value
+ * @param width Number of bytes
+ */
+static void
+snapshot_put (uint8_t *buffer, uint64_t value, size_t width)
+{
+    size_t i;
+
+    for (i = 0; i < width; i++) {
+        buffer[i] = value >> (8 * i);
+    }
+}
+
+/**
+ * Load a little-endian value.
+ *
+ * @param buffer Where to read
+ * @param width Number of bytes
+ * @return The value
+ */
+static uint64_t
+snapshot_get (const uint8_t *buffer, size_t width)
+{
+    uint64_t value = 0;
+    size_t i;
+
+    for (i = 0; i < width; i++) {
+        value |= (uint64_t) buffer[i] << (8 * i);
+    }
+
+    return (value);
+}
+
+/**
+ * Compute the FNV-1a checksum of a block.
+ *
+ * @param buffer The block
+ * @param len Size of the block
+ * @return The checksum
+ */
+static uint32_t
+snapshot_checksum (const uint8_t *buffer, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ buffer[i]) * 16777619u;
+    }
+
+    return (hash);
+}
+
+/**
+ * Record a failure, keeping the first.
+ *
+ * @param work The work
+ * @param rc The failure
+ */
+static void
+snapshot_fail (snapshot_work_st *work, my_rc_e rc)
+{
+    my_rc_e expected = MY_RC_E_SUCCESS;
+
+    __atomic_compare_exchange_n(&work->rc, &expected, rc, false,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+/**
+ * Claim the next block to process.
+ *
+ * @param work The work
+ * @return The block or NULL when every block is claimed or a thread failed
+ */
+static snapshot_block_st *
+snapshot_claim (snapshot_work_st *work)
+{
+    size_t index;
+
+    if (my_rc_e_is_notok(__atomic_load_n(&work->rc, __ATOMIC_RELAXED))) {
+        return (NULL);
+    }
+
+    index = __atomic_fetch_add(&work->next, 1, __ATOMIC_RELAXED);
+
+    return ((index < work->num_blocks) ? &work->blocks[index] : NULL);
+}
+
+/**
+ * Write a whole buffer at an offset.
+ *
+ * @param fd The file
+ * @param buffer The data
+ * @param len Length of the data
+ * @param offset Offset in the file
+ * @return Return code
+ */
+static my_rc_e
+snapshot_pwrite (int fd, const uint8_t *buffer, size_t len, uint64_t offset)
+{
+    ssize_t written;
+
+    while (len > 0) {
+        written = pwrite(fd, buffer, len, offset);
+        if (written < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            LOG_ERR("Write failed, errno(%d)", errno);
+            return (MY_RC_E_EIO);
+        }
+        buffer += written;
+        len -= written;
+        offset += written;
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Read a whole buffer from an offset.
+ *
+ * @param fd The file
+ * @param buffer Where to read
+ * @param len Length of the data
+ * @param offset Offset in the file
+ * @return Return code, MY_RC_E_EIO if the file is too short
+ */
+static my_rc_e
+snapshot_pread (int fd, uint8_t *buffer, size_t len, uint64_t offset)
+{
+    ssize_t got;
+
+    while (len > 0) {
+        got = pread(fd, buffer, len, offset);
+        if (got <= 0) {
+            if ((got < 0) && (EINTR == errno)) {
+                continue;
+            }
+            return (MY_RC_E_EIO);
+        }
+        buffer += got;
+        len -= got;
+        offset += got;
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Run a function on a number of threads, including the calling thread.
+ *
+ * @param fn The function
+ * @param work The work, passed to the function
+ * @param num_threads Number of threads
+ * @return Number of threads used
+ */
+static size_t
+snapshot_run (void *(*fn)(void *), snapshot_work_st *work,
+              size_t num_threads)
+{
+    pthread_t *threads;
+    size_t started = 0, i;
+
+    threads = calloc(num_threads, sizeof(*threads));
+    for (i = 1; (NULL != threads) && (i < num_threads); i++) {
+        if (0 != pthread_create(&threads[started], NULL, fn, work)) {
+            break;
+        }
+        started++;
+    }
+
+    fn(work);
+
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    return (started + 1);
+}
+
+/**
+ * Get the number of threads to use.
+ *
+ * @param config The configuration or NULL
+ * @param num_blocks Number of blocks, the most threads useful
+ * @return Number of threads
+ */
+static size_t
+snapshot_num_threads (const snapshot_config_st *config, size_t num_blocks)
+{
+    size_t num_threads = 0;
+    long num_cpus;
+
+    if (NULL != config) {
+        num_threads = config->num_threads;
+    }
+    if (0 == num_threads) {
+        num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = (num_cpus > 0) ? num_cpus : 1;
+    }
+    if (num_threads > num_blocks) {
+        num_threads = num_blocks;
+    }
+
+    return ((0 == num_threads) ? 1 : num_threads);
+}
+
+/**
+ * Encode and write blocks until none are left.
+ *
+ * @param arg The work
+ * @return NULL
+ */
+static void *
+snapshot_save_thread (void *arg)
+{
+    snapshot_work_st *work = arg;
+    snapshot_block_st *block;
+    uint8_t *buffer, *states;
+    size_t i, used, states_size;
+    my_rc_e rc;
+
+    buffer = malloc(work->max_block_size);
+    if (NULL == buffer) {
+        snapshot_fail(work, MY_RC_E_ENOMEM);
+        return (NULL);
+    }
+
+    while (NULL != (block = snapshot_claim(work))) {
+        memset(buffer, 0, SNAPSHOT_BLOCK_HEADER_SIZE);
+        buffer[0] = block->class_id;
+        snapshot_put(buffer + 4, block->count, 4);
+        for (i = 0; i < block->count; i++) {
+            snapshot_put(buffer + SNAPSHOT_BLOCK_HEADER_SIZE + (8 * i),
+                         base1_get_object_id(work->objs[block->first + i]),
+                         8);
+        }
+
+        states_size = block->size - SNAPSHOT_BLOCK_HEADER_SIZE -
+            (8 * block->count);
+        states = buffer + block->size - states_size;
+        rc = class_registry_export(work->objs + block->first, block->count,
+                                   states, states_size, &used);
+        if (my_rc_e_is_ok(rc) && (used != states_size)) {
+            rc = MY_RC_E_INVALID;
+        }
+        if (my_rc_e_is_ok(rc)) {
+            block->checksum = snapshot_checksum(buffer, block->size);
+            rc = snapshot_pwrite(work->fd, buffer, block->size,
+                                 block->offset);
+        }
+        if (my_rc_e_is_notok(rc)) {
+            snapshot_fail(work, rc);
+        }
+    }
+
+    free(buffer);
+
+    return (NULL);
+}
+
+/**
+ * Sort objects by class and lay out the blocks holding them.
+ *
+ * @param objs The objects
+ * @param count Number of objects
+ * @param block_objects Most objects in a block
+ * @param work Filled in with the sorted objects and the blocks
+ * @return Return code
+ */
+static my_rc_e
+snapshot_layout (const base1_handle *objs, size_t count, size_t block_objects,
+                 snapshot_work_st *work)
+{
+    size_t class_counts[MY_CLASS_ID_E_MAX] = { 0 };
+    size_t class_first[MY_CLASS_ID_E_MAX];
+    size_t state_sizes[MY_CLASS_ID_E_MAX] = { 0 };
+    uint8_t *classes = NULL;
+    uint64_t offset = SNAPSHOT_HEADER_SIZE;
+    size_t i, first, block_count;
+    my_class_id_e class_id;
+    snapshot_block_st *block;
+
+    classes = malloc((0 == count) ? 1 : count);
+    work->objs = malloc(((0 == count) ? 1 : count) * sizeof(*work->objs));
+    if ((NULL == classes) || (NULL == work->objs)) {
+        free(classes);
+        return (MY_RC_E_ENOMEM);
+    }
+
+    for (i = 0; i < count; i++) {
+        class_id = base1_class_id(objs[i]);
+        if (!my_class_id_e_is_valid(class_id)) {
+            free(classes);
+            return (MY_RC_E_EINVAL);
+        }
+        classes[i] = class_id;
+        if (0 == class_counts[class_id]++) {
+            (void) class_registry_export(&objs[i], 1, NULL, 0,
+                                         &state_sizes[class_id]);
+        }
+    }
+
+    for (i = 0, first = 0; i < MY_CLASS_ID_E_MAX; i++) {
+        class_first[i] = first;
+        first += class_counts[i];
+        work->num_blocks += (class_counts[i] + block_objects - 1) /
+            block_objects;
+    }
+    for (i = 0; i < count; i++) {
+        work->objs[class_first[classes[i]]++] = objs[i];
+    }
+    free(classes);
+
+    work->blocks = calloc((0 == work->num_blocks) ? 1 : work->num_blocks,
+                          sizeof(*work->blocks));
+    if (NULL == work->blocks) {
+        return (MY_RC_E_ENOMEM);
+    }
+
+    block = work->blocks;
+    for (class_id = 0, first = 0; class_id < MY_CLASS_ID_E_MAX; class_id++) {
+        for (i = 0; i < class_counts[class_id]; i += block_count, block++) {
+            block_count = class_counts[class_id] - i;
+            if (block_count > block_objects) {
+                block_count = block_objects;
+            }
+            block->offset = offset;
+            block->size = SNAPSHOT_BLOCK_HEADER_SIZE +
+                (block_count * (8 + state_sizes[class_id]));
+            block->count = block_count;
+            block->first = first;
+            block->class_id = class_id;
+            offset += block->size;
+            first += block_count;
+            if (block->size > work->max_block_size) {
+                work->max_block_size = block->size;
+            }
+        }
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Save objects to a snapshot.  The objects are written in parallel by a pool
+ * of threads, each encoding whole blocks.  The file is written under a
+ * temporary name and renamed once it is complete and synced.  The objects
+ * must not be mutated or deleted meanwhile.
+ *
+ * @param path The file to write
+ * @param objs The objects
+ * @param count Number of objects
+ * @param config The configuration or NULL for the defaults
+ * @param stats Outputs statistics of the save, or NULL
+ * @return Return code
+ * @see snapshot_load()
+ */
+my_rc_e
+snapshot_save (const char *path, const base1_handle *objs, size_t count,
+               const snapshot_config_st *config, snapshot_stats_st *stats)
+{
+    snapshot_work_st work = { .fd = -1, .rc = MY_RC_E_SUCCESS };
+    uint8_t header[SNAPSHOT_HEADER_SIZE] = SNAPSHOT_MAGIC;
+    uint8_t *index = NULL, *entry;
+    snapshot_stats_st local_stats;
+    size_t block_objects = 0, i;
+    uint64_t index_offset;
+    char *tmp_path = NULL;
+    my_rc_e rc;
+
+    if ((NULL == path) || ((NULL == objs) && (0 != count))) {
+        LOG_ERR("Invalid input, path(%p) objs(%p)", path, objs);
+        return (MY_RC_E_EINVAL);
+    }
+    if (NULL == stats) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (NULL != config) {
+        block_objects = config->block_objects;
+    }
+    if (0 == block_objects) {
+        block_objects = SNAPSHOT_DEFAULT_BLOCK_OBJECTS;
+    }
+
+    rc = snapshot_layout(objs, count, block_objects, &work);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    tmp_path = malloc(strlen(path) + 5);
+    index = malloc((work.num_blocks * SNAPSHOT_INDEX_ENTRY_SIZE) + 1);
+    if ((NULL == tmp_path) || (NULL == index)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+    sprintf(tmp_path, "%s.tmp", path);
+    work.fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (work.fd < 0) {
+        LOG_ERR("Failed to create, path(%s) errno(%d)", tmp_path, errno);
+        rc = MY_RC_E_EIO;
+        goto exit;
+    }
+
+    stats->threads = snapshot_run(snapshot_save_thread, &work,
+                                  snapshot_num_threads(config,
+                                                       work.num_blocks));
+    rc = work.rc;
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    index_offset = (0 == work.num_blocks) ? SNAPSHOT_HEADER_SIZE :
+        (work.blocks[work.num_blocks - 1].offset +
+         work.blocks[work.num_blocks - 1].size);
+    for (i = 0; i < work.num_blocks; i++) {
+        entry = index + (i * SNAPSHOT_INDEX_ENTRY_SIZE);
+        memset(entry, 0, SNAPSHOT_INDEX_ENTRY_SIZE);
+        snapshot_put(entry, work.blocks[i].offset, 8);
+        snapshot_put(entry + 8, work.blocks[i].size, 4);
+        snapshot_put(entry + 12, work.blocks[i].count, 4);
+        snapshot_put(entry + 16, work.blocks[i].checksum, 4);
+        entry[20] = work.blocks[i].class_id;
+    }
+    snapshot_put(header + 4, SNAPSHOT_VERSION, 4);
+    snapshot_put(header + 8, work.num_blocks, 4);
+    snapshot_put(header + 16, count, 8);
+    snapshot_put(header + 24, index_offset, 8);
+
+    rc = snapshot_pwrite(work.fd, index,
+                         work.num_blocks * SNAPSHOT_INDEX_ENTRY_SIZE,
+                         index_offset);
+    if (my_rc_e_is_ok(rc)) {
+        rc = snapshot_pwrite(work.fd, header, sizeof(header), 0);
+    }
+    if (my_rc_e_is_ok(rc) && (0 != fsync(work.fd))) {
+        rc = MY_RC_E_EIO;
+    }
+    if (my_rc_e_is_ok(rc) && (0 != rename(tmp_path, path))) {
+        LOG_ERR("Failed to rename, path(%s) errno(%d)", path, errno);
+        rc = MY_RC_E_EIO;
+    }
+
+    stats->objects = count;
+    stats->blocks = work.num_blocks;
+    stats->bytes = index_offset +
+        (work.num_blocks * SNAPSHOT_INDEX_ENTRY_SIZE);
+
+exit:
+
+    if (work.fd >= 0) {
+        close(work.fd);
+        if (my_rc_e_is_notok(rc)) {
+            unlink(tmp_path);
+        }
+    }
+    free(tmp_path);
+    free(index);
+    free(work.blocks);
+    free(work.objs);
+
+    return (rc);
+}
+
+/**
+ * Read, check and decode blocks until none are left.
+ *
+ * @param arg The work
+ * @return NULL
+ */
+static void *
+snapshot_load_thread (void *arg)
+{
+    snapshot_work_st *work = arg;
+    snapshot_block_st *block;
+    uint64_t object_id, max_object_id = 0;
+    base1_handle base1_h;
+    uint8_t *buffer, *states;
+    size_t i, pos, used;
+    my_rc_e rc;
+
+    buffer = malloc(work->max_block_size);
+    if (NULL == buffer) {
+        snapshot_fail(work, MY_RC_E_ENOMEM);
+        return (NULL);
+    }
+
+    while (NULL != (block = snapshot_claim(work))) {
+        rc = snapshot_pread(work->fd, buffer, block->size, block->offset);
+        if (my_rc_e_is_ok(rc) &&
+            ((snapshot_checksum(buffer, block->size) != block->checksum) ||
+             (buffer[0] != block->class_id) ||
+             (snapshot_get(buffer + 4, 4) != block->count))) {
+            LOG_ERR("Corrupt block, offset(%" PRIu64 ")", block->offset);
+            rc = MY_RC_E_EIO;
+        }
+
+        states = buffer + SNAPSHOT_BLOCK_HEADER_SIZE + (8 * block->count);
+        for (i = 0, pos = 0; (i < block->count) && my_rc_e_is_ok(rc); i++) {
+            object_id = snapshot_get(buffer + SNAPSHOT_BLOCK_HEADER_SIZE +
+                                     (8 * i), 8);
+            base1_h = class_registry_new(block->class_id, work->allocator,
+                                         object_id);
+            if (NULL == base1_h) {
+                rc = MY_RC_E_ENOMEM;
+                break;
+            }
+            work->objs[block->first + i] = base1_h;
+
+            rc = class_registry_import(base1_h, states + pos,
+                                       buffer + block->size - states - pos,
+                                       &used);
+            pos += used;
+            if (object_id > max_object_id) {
+                max_object_id = object_id;
+            }
+        }
+        if (my_rc_e_is_notok(rc)) {
+            snapshot_fail(work, rc);
+        }
+    }
+
+    free(buffer);
+
+    /* Publish the highest ID; a CAS loop is an atomic maximum */
+    object_id = __atomic_load_n(&work->max_object_id, __ATOMIC_RELAXED);
+    while ((max_object_id > object_id) &&
+           !__atomic_compare_exchange_n(&work->max_object_id, &object_id,
+                                        max_object_id, true, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED)) {
+    }
+
+    return (NULL);
+}
+
+/**
+ * Read a snapshot's header and block index.
+ *
+ * @param work Filled in with the blocks
+ * @param count Outputs the number of objects
+ * @return Return code, MY_RC_E_EIO if the file is invalid
+ */
+static my_rc_e
+snapshot_read_index (snapshot_work_st *work, size_t *count)
+{
+    uint8_t header[SNAPSHOT_HEADER_SIZE], *index, *entry;
+    uint64_t index_offset, first = 0;
+    snapshot_block_st *block;
+    struct stat st;
+    size_t i;
+    my_rc_e rc;
+
+    if ((0 != fstat(work->fd, &st)) ||
+        my_rc_e_is_notok(snapshot_pread(work->fd, header, sizeof(header),
+                                        0)) ||
+        (0 != memcmp(header, SNAPSHOT_MAGIC, 4)) ||
+        (SNAPSHOT_VERSION != snapshot_get(header + 4, 4))) {
+        LOG_ERR("Invalid header");
+        return (MY_RC_E_EIO);
+    }
+    work->num_blocks = snapshot_get(header + 8, 4);
+    *count = snapshot_get(header + 16, 8);
+    index_offset = snapshot_get(header + 24, 8);
+    if ((index_offset + (work->num_blocks * SNAPSHOT_INDEX_ENTRY_SIZE)) !=
+        (uint64_t) st.st_size) {
+        LOG_ERR("Invalid size, size(%lld)", (long long) st.st_size);
+        return (MY_RC_E_EIO);
+    }
+
+    index = malloc((work->num_blocks * SNAPSHOT_INDEX_ENTRY_SIZE) + 1);
+    work->blocks = calloc(work->num_blocks + 1, sizeof(*work->blocks));
+    if ((NULL == index) || (NULL == work->blocks)) {
+        free(index);
+        return (MY_RC_E_ENOMEM);
+    }
+
+    rc = snapshot_pread(work->fd, index,
+                        work->num_blocks * SNAPSHOT_INDEX_ENTRY_SIZE,
+                        index_offset);
+    for (i = 0; (i < work->num_blocks) && my_rc_e_is_ok(rc); i++) {
+        entry = index + (i * SNAPSHOT_INDEX_ENTRY_SIZE);
+        block = &work->blocks[i];
+        block->offset = snapshot_get(entry, 8);
+        block->size = snapshot_get(entry + 8, 4);
+        block->count = snapshot_get(entry + 12, 4);
+        block->checksum = snapshot_get(entry + 16, 4);
+        block->class_id = entry[20];
+        block->first = first;
+        first += block->count;
+
+        if (((block->offset + block->size) > index_offset) ||
+            (block->size < (SNAPSHOT_BLOCK_HEADER_SIZE +
+                            (8 * (uint64_t) block->count))) ||
+            (first > *count)) {
+            rc = MY_RC_E_EIO;
+        }
+        if (block->size > work->max_block_size) {
+            work->max_block_size = block->size;
+        }
+    }
+    if (my_rc_e_is_ok(rc) && (first != *count)) {
+        rc = MY_RC_E_EIO;
+    }
+    free(index);
+
+    return (rc);
+}
+
+/**
+ * Load the objects of a snapshot.  Blocks are read and decoded in parallel
+ * by a pool of threads.  The objects are returned in the order saved within
+ * each class, grouped by class, and keep their saved object IDs; IDs
+ * allocated afterwards are above them.  This should be done before other
+ * threads construct objects, and before the write-ahead log is opened.
+ *
+ * @param path The file
+ * @param config The configuration or NULL for the defaults
+ * @param objs Outputs an array of the objects, which the caller frees along
+ * with the objects
+ * @param count Outputs the number of objects
+ * @param stats Outputs statistics of the load, or NULL
+ * @return Return code, MY_RC_E_EIO if the file is invalid or corrupt.
+ * @see snapshot_save()
+ */
+my_rc_e
+snapshot_load (const char *path, const snapshot_config_st *config,
+               base1_handle **objs, size_t *count, snapshot_stats_st *stats)
+{
+    snapshot_work_st work = { .fd = -1, .rc = MY_RC_E_SUCCESS };
+    snapshot_stats_st local_stats;
+    size_t num_objects = 0, i;
+    my_rc_e rc;
+
+    if ((NULL == path) || (NULL == objs) || (NULL == count)) {
+        LOG_ERR("Invalid input, path(%p) objs(%p) count(%p)", path, objs,
+                count);
+        return (MY_RC_E_EINVAL);
+    }
+    if (NULL == stats) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(*stats));
+    *objs = NULL;
+    *count = 0;
+    if (NULL != config) {
+        work.allocator = config->allocator;
+    }
+
+    work.fd = open(path, O_RDONLY);
+    if (work.fd < 0) {
+        LOG_ERR("Failed to open, path(%s) errno(%d)", path, errno);
+        return (MY_RC_E_EIO);
+    }
+
+    rc = snapshot_read_index(&work, &num_objects);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    work.objs = calloc(num_objects + 1, sizeof(*work.objs));
+    if (NULL == work.objs) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    stats->threads = snapshot_run(snapshot_load_thread, &work,
+                                  snapshot_num_threads(config,
+                                                       work.num_blocks));
+    rc = work.rc;
+    if (my_rc_e_is_notok(rc)) {
+        for (i = 0; i < num_objects; i++) {
+            if (NULL != work.objs[i]) {
+                base1_delete(work.objs[i]);
+            }
+        }
+        goto exit;
+    }
+
+    if (0 != work.max_object_id) {
+        my_object_id_reserve(work.max_object_id);
+    }
+    *objs = work.objs;
+    *count = num_objects;
+    work.objs = NULL;
+    stats->objects = num_objects;
+    stats->blocks = work.num_blocks;
+    stats->bytes = lseek(work.fd, 0, SEEK_END);
+
+exit:
+
+    close(work.fd);
+    free(work.blocks);
+    free(work.objs);
+
+    return (rc);
+}
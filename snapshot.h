@@ -0,0 +1,70 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for snapshots, which save a population of
+ * objects to a file and load it back in parallel.  A snapshot is made of
+ * blocks, each holding objects of a single class, and a block index at the end
+ * of the file.  Each block can be encoded and decoded on its own, so a pool of
+ * threads saves or loads blocks concurrently, each writing or reading its
+ * blocks at offsets given by the index.
+ */
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include "common.h"
+#include "base1.h"
+
+/** Default number of objects in each block */
+#define SNAPSHOT_DEFAULT_BLOCK_OBJECTS 4096
+
+/** Configuration of saving or loading a snapshot */
+typedef struct snapshot_config_st_ {
+    /** Number of threads, or zero for one per online CPU */
+    size_t num_threads;
+    /** Most objects in each block when saving, or zero for the default */
+    size_t block_objects;
+    /** Allocator for loaded objects, or NULL for the default allocator */
+    const allocator_st *allocator;
+} snapshot_config_st;
+
+/** Statistics of saving or loading a snapshot */
+typedef struct snapshot_stats_st_ {
+    /** Number of objects */
+    size_t objects;
+    /** Number of blocks */
+    size_t blocks;
+    /** Size of the file */
+    size_t bytes;
+    /** Number of threads used */
+    size_t threads;
+} snapshot_stats_st;
+
+/* APIs below are documented in their implementation file */
+
+extern my_rc_e
+snapshot_save(const char *path, const base1_handle *objs, size_t count,
+              const snapshot_config_st *config, snapshot_stats_st *stats);
+
+extern my_rc_e
+snapshot_load(const char *path, const snapshot_config_st *config,
+              base1_handle **objs, size_t *count, snapshot_stats_st *stats);
+
+#endif
@@ -57,71 +57,2856 @@
  * edit \c test_c_oo.c to try various things with this class hierarchy.
  * Running <tt>make clean</tt> will remove the executable and .o files.
  *
+ * Running <tt>make POISON=1</tt> builds with newly allocated memory filled with
+ * a poison pattern, and constructors abort if they leave any field
+ * uninitialized.  Run <tt>make clean</tt> first so every file is rebuilt.
+ *
+ * Running <tt>make bench</tt> builds the \c bench_c_oo benchmark program.
+ * Run it without arguments to list the benchmarks.  Its \c replay benchmark
+ * re-executes a trace of public API calls recorded with \c trace_start(), so
+ * library changes can be measured against a real workload.
+ *
  * @section sec_license GNU General Public License
  *
- * This program is free software: you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation, either version 2 of the License, or
- * (at your option) any later version.
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "base1.h"
+#include "base2.h"
+#include "derived1.h"
+#include "derived2.h"
+#include "trace.h"
+#include "class_registry.h"
+#include "obj_table.h"
+#include "recycle.h"
+#include "flyweight.h"
+#include "arena.h"
+#include "numa.h"
+#include "magazine.h"
+#include "objpool.h"
+#include "journal.h"
+#include "wal.h"
+#include "checkpoint.h"
+#include "snapshot.h"
+#include "query.h"
+#include "field_index.h"
+#include "handle_sort.h"
+#include "aggregate.h"
+#include "txn.h"
+#include "actor.h"
+#include "parallel.h"
+#include "dump.h"
+
+/**
+ * Output a string representation of a base1 object.
+ *
+ * @param base1_h The object
+ */
+static void
+display_base1 (base1_handle base1_h)
+{
+    size_t string_size;
+    my_rc_e rc;
+
+    rc = base1_string_size(base1_h, &string_size);
+    if (my_rc_e_is_notok(rc)) {
+        return;
+    }
+
+    {
+        char base1_str[string_size];
+        base1_string(base1_h, base1_str, sizeof(base1_str));
+        printf("type(%s): %s\n", base1_type_string(base1_h), base1_str);
+    }
+}
+
+/**
+ * Output a string representation of a base2 object.
+ *
+ * @param base2_h The object
+ */
+static void
+display_base2 (base2_handle base2_h)
+{
+    size_t string_size;
+    my_rc_e rc;
+
+    rc = base2_string_size(base2_h, &string_size);
+    if (my_rc_e_is_notok(rc)) {
+        return;
+    }
+
+    {
+        char base2_str[string_size];
+        base2_string(base2_h, base2_str, sizeof(base2_str));
+        printf("type(%s): %s\n", base2_type_string(base2_h), base2_str);
+    }
+}
+
+/**
+ * Record a trace of calls on some objects and replay it on two threads.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_trace (void)
+{
+    char path[] = "/tmp/test_c_oo_trace.XXXXXX";
+    trace_replay_stats_st stats;
+    derived1_handle derived1_h;
+    base1_handle base1_h;
+    int fd;
+    my_rc_e rc;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        return (MY_RC_E_EIO);
+    }
+    close(fd);
+
+    rc = trace_start(path);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    base1_h = base1_new3(9, 10);
+    derived1_h = derived1_new1();
+    base1_increase_val3(base1_h);
+    derived1_increase_val4(derived1_h);
+    base2_increase_val1(derived1_cast_to_base2(derived1_h));
+    base1_delete(base1_h);
+    base1_delete(derived1_cast_to_base1(derived1_h));
+
+    rc = trace_stop();
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    rc = trace_replay(path, 2, &stats);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    printf("trace: ops(%" PRIu64 ") objects(%" PRIu64 ") leaked(%" PRIu64
+           ")\n", stats.ops, stats.objects, stats.leaked);
+    if ((7 != stats.ops) || (2 != stats.objects) || (0 != stats.leaked)) {
+        rc = MY_RC_E_INVALID;
+    }
+
+exit:
+
+    unlink(path);
+
+    return (rc);
+}
+
+/**
+ * Construct objects from a pool allocator and check they are deleted back to
+ * it.  Allocations too large for the free lists are left for the pool's
+ * deletion to free.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_allocator (void)
+{
+    allocator_st *pool;
+    derived2_handle derived2_h;
+    base1_handle base1_h;
+    void *large;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    pool = allocator_pool_new();
+    if (NULL == pool) {
+        return (MY_RC_E_ENOMEM);
+    }
+
+    large = allocator_alloc(pool, 4096);
+    if (NULL == large) {
+        allocator_pool_delete(pool);
+        return (MY_RC_E_ENOMEM);
+    }
+    allocator_free(pool, large, 4096);
+    if ((NULL == allocator_alloc(pool, 4096)) ||
+        (NULL == allocator_alloc(pool, 1024))) {
+        allocator_pool_delete(pool);
+        return (MY_RC_E_ENOMEM);
+    }
+
+    base1_h = base1_new_with_allocator(pool);
+    derived2_h = derived2_new_with_allocator(pool);
+    if ((NULL == base1_h) || (NULL == derived2_h)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    printf("allocator: ");
+    display_base1(derived1_cast_to_base1(derived2_cast_to_derived1(
+        derived2_h)));
+
+    base1_delete(derived1_cast_to_base1(derived2_cast_to_derived1(
+        derived2_h)));
+
+exit:
+
+    base1_delete(base1_h);
+    allocator_pool_delete(pool);
+
+    return (rc);
+}
+
+/**
+ * Check runtime type identification and checked downcasts.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_rtti (void)
+{
+    base1_handle base1_h;
+    derived1_handle derived1_h;
+    derived2_handle derived2_h;
+    base2_handle base2_h;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    base1_h = base1_new1();
+    derived1_h = derived1_new1();
+    derived2_h = derived2_new1();
+    if ((NULL == base1_h) || (NULL == derived1_h) || (NULL == derived2_h)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+    base2_h = derived1_cast_to_base2(derived2_cast_to_derived1(derived2_h));
+
+    printf("rtti: %s %s %s\n",
+           my_class_id_e_get_string(base1_class_id(base1_h)),
+           my_class_id_e_get_string(derived1_class_id(derived1_h)),
+           my_class_id_e_get_string(base2_class_id(base2_h)));
+
+    if ((NULL != base1_try_cast_to_derived1(base1_h)) ||
+        (derived1_h !=
+         base1_try_cast_to_derived1(derived1_cast_to_base1(derived1_h))) ||
+        (NULL != derived1_try_cast_to_derived2(derived1_h)) ||
+        (derived2_h != base2_try_cast_to_derived2(base2_h)) ||
+        (derived2_cast_to_derived1(derived2_h) !=
+         base2_try_cast_to_derived1(base2_h)) ||
+        !base2_is_a(base2_h, MY_CLASS_ID_E_BASE1) ||
+        base1_is_a(base1_h, MY_CLASS_ID_E_BASE2)) {
+        rc = MY_RC_E_INVALID;
+    }
+
+exit:
+
+    base1_delete(base1_h);
+    base1_delete(derived1_cast_to_base1(derived1_h));
+    base1_delete(derived1_cast_to_base1(derived2_cast_to_derived1(
+        derived2_h)));
+
+    return (rc);
+}
+
+/**
+ * Check the class registry's generic field access, column extraction, export
+ * and dump.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_registry (void)
+{
+    base1_handle handles[2] = { NULL, NULL };
+    derived2_handle derived2_h;
+    uint64_t values[2] = {0}, val4 = 0;
+    uint8_t buffer[64];
+    char str[256];
+    size_t used = 0;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    handles[0] = base1_new1();
+    derived2_h = derived2_new1();
+    if ((NULL == handles[0]) || (NULL == derived2_h)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+    handles[1] = derived1_cast_to_base1(derived2_cast_to_derived1(derived2_h));
+
+    rc = class_registry_dump(handles[1], str, sizeof(str));
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    printf("registry: %s\n", str);
+
+    rc = class_registry_extract_column(MY_FIELD_E_BASE1_VAL2, handles,
+                                       NELEMS(handles), values);
+    if (my_rc_e_is_ok(rc)) {
+        rc = class_registry_get_field(handles[1], MY_FIELD_E_DERIVED1_VAL4,
+                                      &val4);
+    }
+    if (my_rc_e_is_ok(rc)) {
+        rc = class_registry_export(handles, NELEMS(handles), buffer,
+                                   sizeof(buffer), &used);
+    }
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    if ((2 != values[0]) || (2 != values[1]) || (700 != val4) ||
+        (28 != used) || (MY_CLASS_ID_E_DERIVED2 != buffer[10]) ||
+        my_rc_e_is_ok(class_registry_extract_column(MY_FIELD_E_DERIVED1_VAL4,
+                                                    handles, NELEMS(handles),
+                                                    values))) {
+        rc = MY_RC_E_INVALID;
+    }
+
+exit:
+
+    base1_delete(handles[0]);
+    if (NULL != derived2_h) {
+        base1_delete(handles[1]);
+    }
+
+    return (rc);
+}
+
+/**
+ * Check object table references, including detection of stale references.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_obj_table (void)
+{
+    base1_handle base1_h;
+    derived1_handle derived1_h;
+    obj_ref base1_ref, derived1_ref, reused_ref, ref;
+    size_t i;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    base1_h = base1_new1();
+    derived1_h = derived1_new1();
+    if ((NULL == base1_h) || (NULL == derived1_h)) {
+        base1_delete(base1_h);
+        base1_delete(derived1_cast_to_base1(derived1_h));
+        return (MY_RC_E_ENOMEM);
+    }
+
+    base1_ref = obj_table_insert(base1_h);
+    derived1_ref = obj_table_insert(derived1_cast_to_base1(derived1_h));
+    printf("obj_table: base1(%#x) derived1(%#x)\n", base1_ref, derived1_ref);
+
+    if ((base1_h != obj_table_resolve(base1_ref)) ||
+        (derived1_ref != obj_table_find(derived1_cast_to_base1(derived1_h))) ||
+        (MY_CLASS_ID_E_DERIVED1 != obj_ref_class_id(derived1_ref))) {
+        rc = MY_RC_E_INVALID;
+    }
+
+    obj_table_delete_object(base1_ref);
+    base1_h = base1_new1();
+    reused_ref = obj_table_insert(base1_h);
+    if ((NULL != obj_table_resolve(base1_ref)) ||
+        (base1_h != obj_table_resolve(reused_ref)) ||
+        (1 != obj_table_count(MY_CLASS_ID_E_BASE1))) {
+        rc = MY_RC_E_INVALID;
+    }
+
+    /* Cycle the slots past their generations, which never revives a ref */
+    obj_table_remove(reused_ref);
+    for (i = 0; i < (2u << OBJ_REF_GEN_BITS); i++) {
+        ref = obj_table_insert(base1_h);
+        if ((OBJ_REF_INVALID == ref) ||
+            (NULL != obj_table_resolve(base1_ref)) ||
+            (NULL != obj_table_resolve(reused_ref))) {
+            rc = MY_RC_E_INVALID;
+            break;
+        }
+        obj_table_remove(ref);
+    }
+    base1_delete(base1_h);
+
+    obj_table_delete_object(derived1_ref);
+    if ((NULL != obj_table_resolve(derived1_ref)) ||
+        (0 != obj_table_count(MY_CLASS_ID_E_DERIVED1))) {
+        rc = MY_RC_E_INVALID;
+    }
+
+    return (rc);
+}
+
+/**
+ * Check that cloning a prototype copies its state and class but gives the copy
+ * its own identity.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_clone (void)
+{
+    base1_public_data_st public_data = { .val1 = 17, .val2 = 18 };
+    base1_public_data_st clone_data = {0};
+    derived2_handle prototype_h, clone_h = NULL;
+    derived1_handle derived1_h;
+    uint32_t val1 = 0;
+    uint64_t val4 = 0;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    prototype_h = derived2_new1();
+    if (NULL == prototype_h) {
+        return (MY_RC_E_ENOMEM);
+    }
+    derived1_h = derived2_cast_to_derived1(prototype_h);
+    base1_set_public_data(derived1_cast_to_base1(derived1_h), &public_data);
+    derived1_increase_val4(derived1_h);
+
+    clone_h = derived2_clone(prototype_h);
+    if (NULL == clone_h) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    /* The clone must be independent of the prototype from here on */
+    derived1_increase_val4(derived1_h);
+    derived1_h = derived2_cast_to_derived1(clone_h);
+    base1_get_public_data(derived1_cast_to_base1(derived1_h), &clone_data);
+    base2_get_val1(derived1_cast_to_base2(derived1_h), &val1);
+    class_registry_get_field(derived1_cast_to_base1(derived1_h),
+                             MY_FIELD_E_DERIVED1_VAL4, &val4);
+    if ((MY_CLASS_ID_E_DERIVED2 != derived1_class_id(derived1_h)) ||
+        (17 != clone_data.val1) || (18 != clone_data.val2) || (999 != val1) ||
+        (720 != val4) ||
+        (base1_get_object_id(derived1_cast_to_base1(derived1_h)) ==
+         base1_get_object_id(derived1_cast_to_base1(
+             derived2_cast_to_derived1(prototype_h)))) ||
+        (base1_get_object_id(derived1_cast_to_base1(derived1_h)) !=
+         base2_get_object_id(derived1_cast_to_base2(derived1_h)))) {
+        rc = MY_RC_E_INVALID;
+    }
+
+exit:
+
+    if (NULL != clone_h) {
+        base1_delete(derived1_cast_to_base1(derived2_cast_to_derived1(
+            clone_h)));
+    }
+    base1_delete(derived1_cast_to_base1(derived2_cast_to_derived1(
+        prototype_h)));
+
+    return (rc);
+}
+
+/**
+ * Check that reset restores the default state in place and that recycled
+ * objects are reused by the constructor with a new identity.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_recycle (void)
+{
+    base1_public_data_st public_data = { .val1 = 5, .val2 = 6 };
+    derived1_handle derived1_h, reused_h;
+    derived2_handle derived2_h;
+    uint64_t object_id, val4 = 0;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    derived1_h = derived1_new1();
+    derived2_h = derived2_new1();
+    if ((NULL == derived1_h) || (NULL == derived2_h)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    derived1_increase_val4(derived2_cast_to_derived1(derived2_h));
+    rc = derived2_reset(derived2_h);
+    if (my_rc_e_is_ok(rc)) {
+        rc = class_registry_get_field(derived1_cast_to_base1(
+            derived2_cast_to_derived1(derived2_h)), MY_FIELD_E_DERIVED1_VAL4,
+                                      &val4);
+    }
+    if (my_rc_e_is_notok(rc) || (700 != val4)) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+
+    base1_set_public_data(derived1_cast_to_base1(derived1_h), &public_data);
+    derived1_increase_val4(derived1_h);
+    object_id = base1_get_object_id(derived1_cast_to_base1(derived1_h));
+    recycle_put(derived1_cast_to_base1(derived1_h));
+    if (1 != recycle_count(MY_CLASS_ID_E_DERIVED1)) {
+        derived1_h = NULL;
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+
+    reused_h = derived1_new1();
+    public_data.val1 = 0;
+    base1_get_public_data(derived1_cast_to_base1(reused_h), &public_data);
+    class_registry_get_field(derived1_cast_to_base1(reused_h),
+                             MY_FIELD_E_DERIVED1_VAL4, &val4);
+    printf("recycle: reused(%s) val1(%u) val4(%" PRIu64 ")\n",
+           (reused_h == derived1_h) ? "yes" : "no", public_data.val1, val4);
+    if ((reused_h != derived1_h) || (1 != public_data.val1) || (500 != val4) ||
+        (object_id == base1_get_object_id(derived1_cast_to_base1(reused_h))) ||
+        (0 != recycle_count(MY_CLASS_ID_E_DERIVED1))) {
+        rc = MY_RC_E_INVALID;
+    }
+    derived1_h = reused_h;
+
+exit:
+
+    if (NULL != derived1_h) {
+        recycle_put(derived1_cast_to_base1(derived1_h));
+    }
+    if (NULL != derived2_h) {
+        base1_delete(derived1_cast_to_base1(derived2_cast_to_derived1(
+            derived2_h)));
+    }
+    recycle_drain(MY_CLASS_ID_E_INVALID);
+
+    return (rc);
+}
+
+/**
+ * Check that flyweights share one instance until modified, that modifying
+ * one does not affect the others and that the shared instance refuses raw
+ * mutation.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_flyweight (void)
+{
+    base1_public_data_st public_data = { .val1 = 9, .val2 = 10 };
+    base1_public_data_st read_data = {0};
+    derived1_handle shared_h;
+    obj_ref refs[100];
+    size_t i, num_refs = 0;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    for (num_refs = 0; num_refs < NELEMS(refs); num_refs++) {
+        refs[num_refs] = flyweight_new(MY_CLASS_ID_E_DERIVED1);
+        if (OBJ_REF_INVALID == refs[num_refs]) {
+            rc = MY_RC_E_ENOMEM;
+            goto exit;
+        }
+    }
+
+    rc = flyweight_set_public_data(refs[3], &public_data);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    base1_get_public_data(flyweight_get(refs[4]), &read_data);
+    printf("flyweight: shared(%zu) ", flyweight_shared_count(
+        MY_CLASS_ID_E_DERIVED1));
+    if ((NELEMS(refs) - 1 != flyweight_shared_count(MY_CLASS_ID_E_DERIVED1)) ||
+        flyweight_is_shared(refs[3]) || !flyweight_is_shared(refs[4]) ||
+        (1 != read_data.val1)) {
+        rc = MY_RC_E_INVALID;
+    }
+
+    base1_get_public_data(flyweight_get(refs[3]), &read_data);
+    if ((9 != read_data.val1) || base1_is_read_only(flyweight_get(refs[3]))) {
+        rc = MY_RC_E_INVALID;
+    }
+
+    /* Raw mutators must refuse to change the instance flyweights share */
+    shared_h = base1_try_cast_to_derived1(flyweight_get(refs[4]));
+    if (!base1_is_read_only(derived1_cast_to_base1(shared_h)) ||
+        (MY_RC_E_EINVAL != base1_set_public_data(
+            derived1_cast_to_base1(shared_h), &public_data)) ||
+        (MY_RC_E_EINVAL != base1_increase_val3(
+            derived1_cast_to_base1(shared_h))) ||
+        (MY_RC_E_EINVAL != base2_increase_val1(
+            derived1_cast_to_base2(shared_h))) ||
+        (MY_RC_E_EINVAL != derived1_increase_val4(shared_h)) ||
+        (MY_RC_E_EINVAL != base1_reset(derived1_cast_to_base1(shared_h)))) {
+        rc = MY_RC_E_INVALID;
+    }
+    recycle_put(derived1_cast_to_base1(shared_h));
+    objpool_release(derived1_cast_to_base1(shared_h));
+    base1_get_public_data(flyweight_get(refs[5]), &read_data);
+    if ((1 != read_data.val1) ||
+        (derived1_cast_to_base1(shared_h) != flyweight_get(refs[5])) ||
+        !base1_is_read_only(flyweight_get(refs[5]))) {
+        rc = MY_RC_E_INVALID;
+    }
+
+    flyweight_reset(refs[3]);
+    printf("after reset(%zu)\n",
+           flyweight_shared_count(MY_CLASS_ID_E_DERIVED1));
+    if (!flyweight_is_shared(refs[3])) {
+        rc = MY_RC_E_INVALID;
+    }
+
+exit:
+
+    for (i = 0; i < num_refs; i++) {
+        flyweight_delete(refs[i]);
+    }
+    if (0 != flyweight_shared_count(MY_CLASS_ID_E_DERIVED1)) {
+        rc = MY_RC_E_INVALID;
+    }
+
+    return (rc);
+}
+
+/**
+ * Check that objects can be built in an arena and that emptied slabs are
+ * returned to the kernel when trimmed.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_arena (void)
+{
+    arena_config_st config = {
+        .capacity = 16 * 1024 * 1024,
+        .populate = true,
+        .idle_limit = SIZE_MAX,
+    };
+    derived1_handle handles[1000];
+    arena_stats_st stats;
+    allocator_st *arena;
+    size_t i, num_handles = 0;
+    my_rc_e rc;
+
+    arena = arena_new(&config);
+    if (NULL == arena) {
+        return (MY_RC_E_ENOMEM);
+    }
+
+    rc = arena_reserve_objects(arena, MY_CLASS_ID_E_DERIVED1,
+                               NELEMS(handles));
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    for (num_handles = 0; num_handles < NELEMS(handles); num_handles++) {
+        handles[num_handles] = derived1_new_with_allocator(arena);
+        if (NULL == handles[num_handles]) {
+            rc = MY_RC_E_ENOMEM;
+            goto exit;
+        }
+    }
+
+    arena_get_stats(arena, &stats);
+    printf("arena: slabs(%zu) bytes(%zu) ", stats.slabs_in_use,
+           stats.bytes_in_use);
+    if ((0 == stats.slabs_in_use) || (0 == stats.rss_bytes)) {
+        rc = MY_RC_E_INVALID;
+    }
+
+exit:
+
+    for (i = 0; i < num_handles; i++) {
+        base1_delete(derived1_cast_to_base1(handles[i]));
+    }
+
+    arena_trim(arena, 0);
+    arena_get_stats(arena, &stats);
+    printf("trimmed(%zu)\n", stats.slabs_trimmed);
+    if (my_rc_e_is_ok(rc) &&
+        ((0 != stats.slabs_in_use) || (0 != stats.bytes_in_use) ||
+         (0 == stats.slabs_trimmed) || (0 != stats.slabs_idle))) {
+        rc = MY_RC_E_INVALID;
+    }
+    arena_delete(arena);
+
+    return (rc);
+}
+
+/**
+ * Check that objects can be built on the local node, on an explicit node and
+ * through the node local default allocator, and deleted from any of them.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_numa (void)
+{
+    const allocator_st *old_default = allocator_get_default();
+    derived1_handle handles[3] = { NULL };
+    unsigned int node;
+    size_t i;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    node = numa_current_node();
+    printf("numa: nodes(%u) current(%u)\n", numa_num_nodes(), node);
+    if ((node >= numa_num_nodes()) ||
+        (NULL != numa_node_allocator(numa_num_nodes())) ||
+        my_rc_e_is_notok(numa_bind_thread(node))) {
+        return (MY_RC_E_INVALID);
+    }
+
+    handles[0] = derived1_new_with_allocator(
+        numa_node_allocator(NUMA_NODE_LOCAL));
+    handles[1] = derived1_new_with_allocator(
+        numa_node_allocator(numa_num_nodes() - 1));
+
+    allocator_set_default(numa_allocator());
+    handles[2] = derived1_new1();
+    allocator_set_default(old_default);
+
+    for (i = 0; i < NELEMS(handles); i++) {
+        if ((NULL == handles[i]) ||
+            my_rc_e_is_notok(derived1_increase_val4(handles[i]))) {
+            rc = MY_RC_E_INVALID;
+        }
+    }
+
+    if (my_rc_e_is_ok(rc) &&
+        !arena_owns(numa_node_allocator(node), handles[0])) {
+        rc = MY_RC_E_INVALID;
+    }
+
+    for (i = 0; i < NELEMS(handles); i++) {
+        if (NULL != handles[i]) {
+            base1_delete(derived1_cast_to_base1(handles[i]));
+        }
+    }
+
+    return (rc);
+}
+
+/** Number of objects the magazine test constructs per pass */
+#define TEST_MAGAZINE_OBJECTS 64
+
+/**
+ * Delete objects, from a thread other than the one that constructed them.
+ *
+ * @param arg Array of TEST_MAGAZINE_OBJECTS objects
+ * @return NULL
+ */
+static void *
+test_magazine_thread (void *arg)
+{
+    derived1_handle *handles = arg;
+    size_t i;
+
+    for (i = 0; i < TEST_MAGAZINE_OBJECTS; i++) {
+        base1_delete(derived1_cast_to_base1(handles[i]));
+        handles[i] = NULL;
+    }
+
+    return (NULL);
+}
+
+/**
+ * Check that blocks freed by another thread reach the depot when that thread
+ * exits, and are reused from the depot by the constructing thread.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_magazine (void)
+{
+    magazine_config_st config = {
+        .backing = &allocator_heap,
+        .rounds = 8,
+        .depot_limit = SIZE_MAX,
+    };
+    derived1_handle handles[TEST_MAGAZINE_OBJECTS] = { NULL };
+    magazine_stats_st stats;
+    allocator_st *mags;
+    pthread_t thread;
+    uint64_t backing_allocs = 0;
+    size_t i, pass;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    mags = magazine_allocator_new(&config);
+    if (NULL == mags) {
+        return (MY_RC_E_ENOMEM);
+    }
+
+    for (pass = 0; (pass < 2) && my_rc_e_is_ok(rc); pass++) {
+        for (i = 0; i < TEST_MAGAZINE_OBJECTS; i++) {
+            handles[i] = derived1_new_with_allocator(mags);
+            if (NULL == handles[i]) {
+                rc = MY_RC_E_ENOMEM;
+                break;
+            }
+        }
+        if (my_rc_e_is_notok(rc)) {
+            break;
+        }
+
+        magazine_get_stats(mags, &stats);
+        if (1 == pass) {
+            /* The second pass is served from the first pass's frees */
+            if ((stats.backing_allocs != backing_allocs) ||
+                (0 == stats.depot_gets)) {
+                rc = MY_RC_E_INVALID;
+            }
+        }
+        backing_allocs = stats.backing_allocs;
+
+        if (0 != pthread_create(&thread, NULL, test_magazine_thread,
+                                handles)) {
+            rc = MY_RC_E_ENOMEM;
+            break;
+        }
+        pthread_join(thread, NULL);
+
+        magazine_get_stats(mags, &stats);
+        if ((1 != stats.threads) || (0 == stats.depot_full)) {
+            rc = MY_RC_E_INVALID;
+        }
+    }
+
+    printf("magazine: allocs(%" PRIu64 ") gets(%" PRIu64 ") "
+           "puts(%" PRIu64 ")\n", stats.backing_allocs, stats.depot_gets,
+           stats.depot_puts);
+
+    for (i = 0; i < TEST_MAGAZINE_OBJECTS; i++) {
+        if (NULL != handles[i]) {
+            base1_delete(derived1_cast_to_base1(handles[i]));
+        }
+    }
+    magazine_allocator_delete(mags);
+
+    return (rc);
+}
+
+/** Number of acquire/release cycles per thread in the objpool test */
+#define TEST_OBJPOOL_CYCLES 10000
+
+/** Number of threads in the objpool test */
+#define TEST_OBJPOOL_THREADS 4
+
+/**
+ * Acquire, mutate and release derived1 objects.
+ *
+ * @param arg Returned on failure, so must not be NULL
+ * @return NULL on success, otherwise arg
+ */
+static void *
+test_objpool_thread (void *arg)
+{
+    base1_handle base1_h;
+    uint64_t val4 = 0;
+    size_t i;
+
+    for (i = 0; i < TEST_OBJPOOL_CYCLES; i++) {
+        base1_h = objpool_acquire(MY_CLASS_ID_E_DERIVED1);
+        if (NULL == base1_h) {
+            return (arg);
+        }
+
+        /* Released objects were mutated, so this checks they were reset */
+        class_registry_get_field(base1_h, MY_FIELD_E_DERIVED1_VAL4, &val4);
+        if (500 != val4) {
+            base1_delete(base1_h);
+            return (arg);
+        }
+        derived1_increase_val4(base1_try_cast_to_derived1(base1_h));
+        objpool_release(base1_h);
+    }
+
+    return (NULL);
+}
+
+/**
+ * Check that pooled objects come back in their default state with a new
+ * identity, that a full pool deletes released objects and that concurrent
+ * acquires and releases account for every object.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_objpool (void)
+{
+    pthread_t threads[TEST_OBJPOOL_THREADS];
+    base1_handle handles[10] = { NULL };
+    objpool_stats_st stats;
+    uint64_t object_id = 0;
+    void *result;
+    size_t i;
+    my_rc_e rc;
+
+    rc = objpool_create(MY_CLASS_ID_E_DERIVED1, 8, 4);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+
+    for (i = 0; i < NELEMS(handles); i++) {
+        handles[i] = objpool_acquire(MY_CLASS_ID_E_DERIVED1);
+        if ((NULL == handles[i]) ||
+            (base1_get_object_id(handles[i]) <= object_id)) {
+            rc = MY_RC_E_INVALID;
+            goto exit;
+        }
+        object_id = base1_get_object_id(handles[i]);
+        derived1_increase_val4(base1_try_cast_to_derived1(handles[i]));
+    }
+    for (i = 0; i < NELEMS(handles); i++) {
+        objpool_release(handles[i]);
+        handles[i] = NULL;
+    }
+
+    objpool_get_stats(MY_CLASS_ID_E_DERIVED1, &stats);
+    if ((4 != stats.hits) || (6 != stats.misses) || (2 != stats.overflows) ||
+        (8 != stats.count)) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+
+    for (i = 0; i < NELEMS(threads); i++) {
+        if (0 != pthread_create(&threads[i], NULL, test_objpool_thread,
+                                &stats)) {
+            rc = MY_RC_E_ENOMEM;
+            break;
+        }
+    }
+    while (i > 0) {
+        pthread_join(threads[--i], &result);
+        if (NULL != result) {
+            rc = MY_RC_E_INVALID;
+        }
+    }
+
+    objpool_get_stats(MY_CLASS_ID_E_DERIVED1, &stats);
+    printf("objpool: hits(%" PRIu64 ") misses(%" PRIu64 ") "
+           "overflows(%" PRIu64 ") count(%zu)\n", stats.hits, stats.misses,
+           stats.overflows, stats.count);
+    if (my_rc_e_is_ok(rc) &&
+        (((stats.hits + stats.misses) !=
+          (NELEMS(handles) + (NELEMS(threads) * TEST_OBJPOOL_CYCLES))) ||
+         (stats.count > stats.capacity))) {
+        rc = MY_RC_E_INVALID;
+    }
+
+exit:
+
+    for (i = 0; i < NELEMS(handles); i++) {
+        if (NULL != handles[i]) {
+            base1_delete(handles[i]);
+        }
+    }
+    objpool_destroy(MY_CLASS_ID_E_DERIVED1);
+
+    return (rc);
+}
+
+/** Number of mutations the journal test makes on another thread */
+#define TEST_JOURNAL_MUTATIONS 100
+
+/**
+ * Mutate an object more times than the journal's ring holds.
+ *
+ * @param arg The derived1 object
+ * @return NULL
+ */
+static void *
+test_journal_thread (void *arg)
+{
+    size_t i;
+
+    for (i = 0; i < TEST_JOURNAL_MUTATIONS; i++) {
+        derived1_increase_val4(arg);
+    }
+
+    return (NULL);
+}
+
+/**
+ * Check that each journaled mutation produces a record of the new value, in
+ * order, that a full ring drops and counts records, and that nothing is
+ * recorded once the journal is stopped.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_journal (void)
+{
+    static const my_field_e fields[] = {
+        MY_FIELD_E_BASE1_VAL1,
+        MY_FIELD_E_BASE1_VAL2,
+        MY_FIELD_E_BASE1_VAL3,
+        MY_FIELD_E_DERIVED1_VAL4,
+        MY_FIELD_E_BASE2_VAL1,
+    };
+    base1_public_data_st public_data = { .val1 = 7, .val2 = 8 };
+    journal_record_st records[2 * TEST_JOURNAL_MUTATIONS];
+    journal_stats_st stats;
+    derived1_handle derived1_h;
+    base1_handle base1_h;
+    pthread_t thread;
+    uint64_t value;
+    size_t i, count;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    derived1_h = derived1_new1();
+    if (NULL == derived1_h) {
+        return (MY_RC_E_ENOMEM);
+    }
+    base1_h = derived1_cast_to_base1(derived1_h);
+
+    /* Drop anything left from before, then record with small rings */
+    journal_drain(records, NELEMS(records));
+    journal_start(16);
+
+    base1_set_public_data(base1_h, &public_data);
+    base1_increase_val3(base1_h);
+    derived1_increase_val4(derived1_h);
+    base2_increase_val1(derived1_cast_to_base2(derived1_h));
+
+    count = journal_drain(records, NELEMS(records));
+    if (NELEMS(fields) != count) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+    for (i = 0; i < count; i++) {
+        class_registry_get_field(base1_h, fields[i], &value);
+        if ((records[i].object_id != base1_get_object_id(base1_h)) ||
+            (MY_CLASS_ID_E_DERIVED1 != records[i].class_id) ||
+            (fields[i] != records[i].field) ||
+            ((0 != i) && (records[i].seq != (records[i - 1].seq + 1))) ||
+            (records[i].value != value)) {
+            rc = MY_RC_E_INVALID;
+            goto exit;
+        }
+    }
+
+    if (0 != pthread_create(&thread, NULL, test_journal_thread, derived1_h)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+    pthread_join(thread, NULL);
+
+    journal_get_stats(&stats);
+    count = journal_drain(records, NELEMS(records));
+    printf("journal: rings(%zu) drained(%zu) dropped(%" PRIu64 ")\n",
+           stats.rings, count, stats.dropped);
+    if ((16 != count) || (count != stats.pending) ||
+        ((TEST_JOURNAL_MUTATIONS - count) != stats.dropped)) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+
+    journal_stop();
+    derived1_increase_val4(derived1_h);
+    if (0 != journal_drain(records, NELEMS(records))) {
+        rc = MY_RC_E_INVALID;
+    }
+
+exit:
+
+    journal_stop();
+    base1_delete(base1_h);
+
+    return (rc);
+}
+
+/**
+ * Check that two objects have the same class and field values.
+ *
+ * @param base1_h The first object
+ * @param other_h The second object
+ * @return true if they match.
+ */
+static bool
+test_wal_same (base1_handle base1_h, base1_handle other_h)
+{
+    const class_field_st *fields;
+    uint64_t value, other_value;
+    size_t count, i;
+
+    if ((NULL == other_h) || (base1_class_id(base1_h) !=
+                              base1_class_id(other_h))) {
+        return (false);
+    }
+
+    count = class_registry_get_fields(base1_class_id(base1_h), &fields);
+    for (i = 0; i < count; i++) {
+        class_registry_get_field(base1_h, fields[i].field, &value);
+        class_registry_get_field(other_h, fields[i].field, &other_value);
+        if (value != other_value) {
+            return (false);
+        }
+    }
+
+    return (true);
+}
+
+/**
+ * Remove a log directory and its files.
+ *
+ * @param dir The directory
+ */
+static void
+test_wal_remove_dir (const char *dir)
+{
+    char path[512];
+    struct dirent *entry;
+    DIR *dirp;
+
+    dirp = opendir(dir);
+    if (NULL != dirp) {
+        while (NULL != (entry = readdir(dirp))) {
+            if ('.' != entry->d_name[0]) {
+                snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+                unlink(path);
+            }
+        }
+        closedir(dirp);
+    }
+    rmdir(dir);
+}
+
+/**
+ * Check that objects constructed, mutated and deleted while the log is open
+ * are recovered with their IDs and last values from a snapshot and the log
+ * written after it, and that a torn record at the end of the log is ignored.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_wal (void)
+{
+    base1_public_data_st public_data = { .val1 = 9, .val2 = 10 };
+    char dir[] = "/tmp/test_c_oo_wal.XXXXXX";
+    char path[sizeof(dir) + 32];
+    base1_handle objs[4] = { NULL }, deleted_h, recovered_h;
+    derived1_handle derived1_h, derived2_h;
+    wal_recovery_stats_st recovery_stats;
+    wal_stats_st stats;
+    id_map_handle id_map_h = NULL;
+    uintptr_t value;
+    FILE *file;
+    size_t i;
+    my_rc_e rc;
+
+    if (NULL == mkdtemp(dir)) {
+        return (MY_RC_E_EIO);
+    }
+
+    rc = wal_open(dir, NULL);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    derived1_h = derived1_new1();
+    derived2_h = derived2_cast_to_derived1(derived2_new1());
+    objs[0] = derived1_cast_to_base1(derived1_h);
+    objs[1] = base1_new3(3, 5);
+    objs[2] = derived1_cast_to_base1(derived2_h);
+    deleted_h = base1_new1();
+    base1_set_public_data(objs[0], &public_data);
+    base1_increase_val3(objs[0]);
+    derived1_increase_val4(derived1_h);
+    base2_increase_val1(derived1_cast_to_base2(derived2_h));
+    base1_increase_val3(objs[1]);
+    base1_delete(deleted_h);
+
+    rc = wal_snapshot(objs, 3);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    /* These are only in the log written after the snapshot */
+    derived1_increase_val4(derived1_h);
+    base1_increase_val3(objs[1]);
+    objs[3] = base1_new1();
+    base1_set_public_data(objs[3], &public_data);
+
+    wal_get_stats(&stats);
+    rc = wal_close();
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    /* A crash mid-write leaves a partial record at the end of the log */
+    snprintf(path, sizeof(path), "%s/wal.%" PRIu64, dir, stats.generation);
+    file = fopen(path, "ab");
+    if (NULL != file) {
+        fwrite("\x20\x00\x00\x00\x01", 5, 1, file);
+        fclose(file);
+    }
+
+    id_map_h = id_map_new(0);
+    if (NULL == id_map_h) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+    rc = wal_recover(dir, id_map_h, &recovery_stats);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    printf("wal: syncs(%" PRIu64 ") snapshot_objects(%" PRIu64 ") "
+           "records(%" PRIu64 ") torn_files(%" PRIu64 ")\n", stats.syncs,
+           recovery_stats.snapshot_objects, recovery_stats.records,
+           recovery_stats.torn_files);
+
+    if ((NELEMS(objs) != id_map_count(id_map_h)) ||
+        (3 != recovery_stats.snapshot_objects) ||
+        (1 != recovery_stats.torn_files)) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+    for (i = 0; i < NELEMS(objs); i++) {
+        recovered_h = NULL;
+        if (id_map_lookup(id_map_h, base1_get_object_id(objs[i]), &value)) {
+            recovered_h = (base1_handle) value;
+        }
+        if (!test_wal_same(objs[i], recovered_h) ||
+            (base1_get_object_id(objs[i]) !=
+             base1_get_object_id(recovered_h))) {
+            rc = MY_RC_E_INVALID;
+            goto exit;
+        }
+    }
+
+exit:
+
+    if (wal_is_enabled()) {
+        wal_close();
+    }
+    for (i = 0; i < NELEMS(objs); i++) {
+        if ((NULL != objs[i]) && (NULL != id_map_h) &&
+            id_map_remove(id_map_h, base1_get_object_id(objs[i]), &value)) {
+            base1_delete((base1_handle) value);
+        }
+        base1_delete(objs[i]);
+    }
+    id_map_delete(id_map_h);
+    test_wal_remove_dir(dir);
+
+    return (rc);
+}
+
+/**
+ * Check that once the log cannot be written, mutations fail instead of
+ * returning as if their records were durable.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_wal_failure (void)
+{
+    char dir[] = "/tmp/test_c_oo_wal.XXXXXX";
+    struct rlimit limit, old_limit;
+    base1_handle base1_h = NULL;
+    my_rc_e rc, mutate_rc;
+
+    if (NULL == mkdtemp(dir)) {
+        return (MY_RC_E_EIO);
+    }
+
+    rc = wal_open(dir, NULL);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    base1_h = base1_new1();
+    if (NULL == base1_h) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    /* Writing past the file size limit then fails rather than signalling */
+    signal(SIGXFSZ, SIG_IGN);
+    getrlimit(RLIMIT_FSIZE, &old_limit);
+    limit = old_limit;
+    limit.rlim_cur = 1;
+    setrlimit(RLIMIT_FSIZE, &limit);
+    mutate_rc = base1_increase_val3(base1_h);
+    setrlimit(RLIMIT_FSIZE, &old_limit);
+    signal(SIGXFSZ, SIG_DFL);
+
+    /* The failure is sticky, for later mutations and for closing */
+    printf("wal failure: rc(%s)\n", my_rc_e_get_string(mutate_rc));
+    if ((MY_RC_E_EIO != mutate_rc) ||
+        (MY_RC_E_EIO != base1_increase_val3(base1_h)) ||
+        (MY_RC_E_EIO != wal_close())) {
+        rc = MY_RC_E_INVALID;
+    }
+
+exit:
+
+    if (wal_is_enabled()) {
+        wal_close();
+    }
+    base1_delete(base1_h);
+    test_wal_remove_dir(dir);
+
+    return (rc);
+}
+
+/** Number of objects the checkpoint test tracks besides those it mutates */
+#define TEST_CHECKPOINT_OBJECTS 100
+
+/** Context for checking a checkpoint's records */
+typedef struct test_checkpoint_ctx_st_ {
+    /** Objects whose states are checked */
+    base1_handle objs[2];
+    /** Number of those objects whose states matched */
+    size_t matched;
+    /** Number of records */
+    size_t count;
+    /** ID of an object which must not be in the checkpoint */
+    uint64_t deleted_id;
+    /** Set if the deleted object was found */
+    bool found_deleted;
+} test_checkpoint_ctx_st;
+
+/**
+ * Check a record of a checkpoint against the live objects.
+ *
+ * @param object_id The object ID
+ * @param data The object's state
+ * @param len Length of the state
+ * @param ctx The test_checkpoint_ctx_st
+ */
+static void
+test_checkpoint_record (uint64_t object_id, const uint8_t *data, size_t len,
+                        void *ctx)
+{
+    test_checkpoint_ctx_st *check = ctx;
+    uint8_t state[256];
+    size_t used, i;
+
+    check->count++;
+    if ((object_id == check->deleted_id) || (0 == len)) {
+        check->found_deleted = true;
+    }
+
+    for (i = 0; i < NELEMS(check->objs); i++) {
+        if ((object_id == base1_get_object_id(check->objs[i])) &&
+            my_rc_e_is_ok(class_registry_export(&check->objs[i], 1, state,
+                                                sizeof(state), &used)) &&
+            (used == len) && (0 == memcmp(state, data, len))) {
+            check->matched++;
+        }
+    }
+}
+
+/**
+ * Check that checkpoints write only the objects dirtied or deleted since the
+ * previous one, and that compacting them yields the live objects' states.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_checkpoint (void)
+{
+    char dir[] = "/tmp/test_c_oo_checkpoint.XXXXXX";
+    char paths[4][sizeof(dir) + 16];
+    const char *deltas[3] = { paths[0], paths[1], paths[2] };
+    base1_handle objs[TEST_CHECKPOINT_OBJECTS] = { NULL }, base1_h, old_h;
+    test_checkpoint_ctx_st check = { .matched = 0 };
+    checkpoint_write_stats_st stats[3];
+    derived1_handle derived1_h;
+    derived2_handle derived2_h;
+    size_t i;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if (NULL == mkdtemp(dir)) {
+        return (MY_RC_E_EIO);
+    }
+    for (i = 0; i < NELEMS(paths); i++) {
+        snprintf(paths[i], sizeof(paths[i]), "%s/ckpt.%zu", dir, i);
+    }
+
+    /* Objects from before tracking started are tracked explicitly */
+    old_h = base1_new1();
+    checkpoint_start();
+    checkpoint_track(old_h);
+
+    derived1_h = derived1_new1();
+    derived2_h = derived2_new1();
+    base1_h = base1_new3(1, 2);
+    for (i = 0; i < NELEMS(objs); i++) {
+        objs[i] = base1_new1();
+    }
+    if ((NELEMS(objs) + 4) != checkpoint_count()) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+
+    rc = checkpoint_write(paths[0], &stats[0]);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    derived1_increase_val4(derived1_h);
+    base2_increase_val1(derived1_cast_to_base2(derived2_cast_to_derived1(
+        derived2_h)));
+    check.deleted_id = base1_get_object_id(base1_h);
+    base1_delete(base1_h);
+    base1_h = NULL;
+    rc = checkpoint_write(paths[1], &stats[1]);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    rc = checkpoint_write(paths[2], &stats[2]);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    printf("checkpoint: objects(%zu/%zu/%zu) deletions(%zu) "
+           "dirty_pages(%zu/%zu/%zu)\n", stats[0].objects, stats[1].objects,
+           stats[2].objects, stats[1].deletions, stats[0].dirty_pages,
+           stats[1].dirty_pages, stats[2].dirty_pages);
+    if (((NELEMS(objs) + 4) != stats[0].objects) ||
+        (2 != stats[1].objects) || (1 != stats[1].deletions) ||
+        (0 != stats[2].objects) || (0 != stats[2].dirty_pages)) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+
+    rc = checkpoint_compact(NULL, deltas, NELEMS(deltas), paths[3]);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    check.objs[0] = derived1_cast_to_base1(derived1_h);
+    check.objs[1] = derived1_cast_to_base1(derived2_cast_to_derived1(
+        derived2_h));
+    rc = checkpoint_foreach(paths[3], test_checkpoint_record, &check);
+    if (my_rc_e_is_ok(rc) &&
+        (((NELEMS(objs) + 3) != check.count) ||
+         (NELEMS(check.objs) != check.matched) || check.found_deleted)) {
+        rc = MY_RC_E_INVALID;
+    }
+
+exit:
+
+    checkpoint_stop();
+    for (i = 0; i < NELEMS(objs); i++) {
+        base1_delete(objs[i]);
+    }
+    base1_delete(derived1_cast_to_base1(derived1_h));
+    base1_delete(derived1_cast_to_base1(derived2_cast_to_derived1(
+        derived2_h)));
+    if (NULL != base1_h) {
+        base1_delete(base1_h);
+    }
+    base1_delete(old_h);
+    for (i = 0; i < NELEMS(paths); i++) {
+        unlink(paths[i]);
+    }
+    rmdir(dir);
+
+    return (rc);
+}
+
+/** Number of objects the snapshot test saves */
+#define TEST_SNAPSHOT_OBJECTS 1000
+
+/**
+ * Check that a snapshot saved and loaded by several threads in small blocks
+ * gives back every object with its ID and state, and that a corrupt block
+ * fails the load.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_snapshot (void)
+{
+    snapshot_config_st config = { .num_threads = 4, .block_objects = 64 };
+    char path[] = "/tmp/test_c_oo_snapshot.XXXXXX";
+    base1_handle objs[TEST_SNAPSHOT_OBJECTS] = { NULL }, *loaded = NULL;
+    base1_handle *corrupt = NULL;
+    uint8_t state[256], loaded_state[256];
+    snapshot_stats_st stats;
+    id_map_handle id_map_h = NULL;
+    size_t count = 0, corrupt_count, i, used, loaded_used;
+    uintptr_t value;
+    FILE *file;
+    int fd, c;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        return (MY_RC_E_EIO);
+    }
+    close(fd);
+
+    for (i = 0; i < NELEMS(objs); i++) {
+        switch (i % 3) {
+        case 0:
+            objs[i] = base1_new3(i, i * 7);
+            break;
+        case 1:
+            objs[i] = derived1_cast_to_base1(derived1_new1());
+            break;
+        default:
+            objs[i] = derived1_cast_to_base1(derived2_cast_to_derived1(
+                derived2_new1()));
+            break;
+        }
+        if (NULL == objs[i]) {
+            rc = MY_RC_E_ENOMEM;
+            goto exit;
+        }
+        base1_increase_val3(objs[i]);
+    }
+
+    rc = snapshot_save(path, objs, NELEMS(objs), &config, &stats);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    printf("snapshot: objects(%zu) blocks(%zu) bytes(%zu) threads(%zu)\n",
+           stats.objects, stats.blocks, stats.bytes, stats.threads);
+
+    rc = snapshot_load(path, &config, &loaded, &count, &stats);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    id_map_h = id_map_new(count);
+    if ((NULL == id_map_h) || (NELEMS(objs) != count)) {
+        rc = (NULL == id_map_h) ? MY_RC_E_ENOMEM : MY_RC_E_INVALID;
+        goto exit;
+    }
+    for (i = 0; i < count; i++) {
+        id_map_insert(id_map_h, base1_get_object_id(loaded[i]),
+                      (uintptr_t) loaded[i]);
+    }
+    for (i = 0; i < NELEMS(objs); i++) {
+        if (!id_map_lookup(id_map_h, base1_get_object_id(objs[i]), &value) ||
+            my_rc_e_is_notok(class_registry_export(&objs[i], 1, state,
+                                                   sizeof(state), &used)) ||
+            my_rc_e_is_notok(class_registry_export((base1_handle *) &value, 1,
+                                                   loaded_state,
+                                                   sizeof(loaded_state),
+                                                   &loaded_used)) ||
+            (used != loaded_used) || (0 != memcmp(state, loaded_state, used))) {
+            rc = MY_RC_E_INVALID;
+            goto exit;
+        }
+    }
+
+    /* Corrupt a byte in the first block */
+    file = fopen(path, "r+b");
+    if (NULL != file) {
+        fseek(file, 40, SEEK_SET);
+        c = fgetc(file);
+        fseek(file, 40, SEEK_SET);
+        fputc(0xff ^ c, file);
+        fclose(file);
+    }
+    if ((MY_RC_E_EIO != snapshot_load(path, &config, &corrupt,
+                                      &corrupt_count, NULL)) ||
+        (NULL != corrupt)) {
+        rc = MY_RC_E_INVALID;
+    }
+
+exit:
+
+    for (i = 0; (NULL != loaded) && (i < count); i++) {
+        base1_delete(loaded[i]);
+    }
+    free(loaded);
+    id_map_delete(id_map_h);
+    for (i = 0; i < NELEMS(objs); i++) {
+        if (NULL != objs[i]) {
+            base1_delete(objs[i]);
+        }
+    }
+    unlink(path);
+
+    return (rc);
+}
+
+/** Number of objects the query test runs over */
+#define TEST_QUERY_OBJECTS 3000
+
+/**
+ * Check a query's result against evaluating it one object at a time.
+ *
+ * @param query The query
+ * @param objs The objects
+ * @param count Number of objects
+ * @param result The result checked
+ * @return Whether the result matches
+ */
+static bool
+test_query_check (const query_st *query, const base1_handle *objs,
+                  size_t count, const query_result_st *result)
+{
+    query_result_st expected = { .min = UINT64_MAX };
+    uint64_t value, bucket;
+    bool pass;
+    size_t i, j;
+
+    for (i = 0; i < count; i++) {
+        pass = my_rc_e_is_ok(class_registry_get_field(objs[i], query->field,
+                                                      &value));
+        for (j = 0; pass && (j < query->num_preds); j++) {
+            pass = my_rc_e_is_ok(class_registry_get_field(
+                objs[i], query->preds[j].field, &value)) &&
+                (value < query->preds[j].value);
+        }
+        if (!pass) {
+            continue;
+        }
+        class_registry_get_field(objs[i], query->field, &value);
+        expected.count++;
+        expected.sum += value;
+        expected.min = (value < expected.min) ? value : expected.min;
+        expected.max = (value > expected.max) ? value : expected.max;
+        if (0 != query->num_buckets) {
+            bucket = (value < query->bucket_base) ? 0 :
+                (value - query->bucket_base) / query->bucket_width;
+            if (bucket >= query->num_buckets) {
+                bucket = query->num_buckets - 1;
+            }
+            expected.buckets[bucket]++;
+        }
+    }
+
+    return (0 == memcmp(&expected, result, sizeof(expected)));
+}
+
+/**
+ * Check that queries over mixed objects, by one thread and by several, and
+ * over columns extracted from them, agree with evaluating the query one
+ * object at a time.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_query (void)
+{
+    query_st query = { .num_preds = 1, .num_buckets = 8, .bucket_base = 500,
+                       .bucket_width = 50 };
+    base1_handle objs[TEST_QUERY_OBJECTS] = { NULL };
+    uint64_t *val1 = NULL, *val3 = NULL;
+    query_columns_st columns = { .count = NELEMS(objs) };
+    derived1_handle derived1_h;
+    query_result_st result;
+    size_t i, threads;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    val1 = calloc(NELEMS(objs), sizeof(*val1));
+    val3 = calloc(NELEMS(objs), sizeof(*val3));
+    if ((NULL == val1) || (NULL == val3)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    for (i = 0; i < NELEMS(objs); i++) {
+        switch (i % 3) {
+        case 0:
+            objs[i] = base1_new3(i, i * 3);
+            break;
+        case 1:
+            derived1_h = derived1_new1();
+            objs[i] = derived1_cast_to_base1(derived1_h);
+            if (NULL != derived1_h) {
+                derived1_increase_val4(derived1_h);
+            }
+            break;
+        default:
+            objs[i] = derived1_cast_to_base1(derived2_cast_to_derived1(
+                derived2_new1()));
+            break;
+        }
+        if (NULL == objs[i]) {
+            rc = MY_RC_E_ENOMEM;
+            goto exit;
+        }
+    }
+
+    for (threads = 1; threads <= 4; threads *= 4) {
+        query.num_threads = threads;
+
+        /* Only derived objects have val4 */
+        query.preds[0] = (query_pred_st) { MY_FIELD_E_BASE1_VAL1,
+                                           QUERY_OP_E_LT, 100 };
+        query.field = MY_FIELD_E_DERIVED1_VAL4;
+        rc = query_run_objects(&query, objs, NELEMS(objs), &result);
+        if (my_rc_e_is_notok(rc)) {
+            goto exit;
+        }
+        if (!test_query_check(&query, objs, NELEMS(objs), &result)) {
+            rc = MY_RC_E_INVALID;
+            goto exit;
+        }
+
+        query.preds[0].value = 200;
+        query.field = MY_FIELD_E_BASE1_VAL3;
+        rc = query_run_objects(&query, objs, NELEMS(objs), &result);
+        if (my_rc_e_is_notok(rc)) {
+            goto exit;
+        }
+        if (!test_query_check(&query, objs, NELEMS(objs), &result)) {
+            rc = MY_RC_E_INVALID;
+            goto exit;
+        }
+    }
+    printf("query: count(%" PRIu64 ") sum(%" PRIu64 ") min(%" PRIu64
+           ") max(%" PRIu64 ")\n", result.count, result.sum, result.min,
+           result.max);
+
+    /* The same query over columns gives the same result */
+    rc = class_registry_extract_column(MY_FIELD_E_BASE1_VAL1, objs,
+                                       NELEMS(objs), val1);
+    if (my_rc_e_is_ok(rc)) {
+        rc = class_registry_extract_column(MY_FIELD_E_BASE1_VAL3, objs,
+                                           NELEMS(objs), val3);
+    }
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    columns.columns[MY_FIELD_E_BASE1_VAL1] = val1;
+    columns.columns[MY_FIELD_E_BASE1_VAL3] = val3;
+    rc = query_run_columns(&query, &columns, &result);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    if (!test_query_check(&query, objs, NELEMS(objs), &result)) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+
+    /* A column the query uses is missing */
+    query.field = MY_FIELD_E_DERIVED1_VAL4;
+    if (MY_RC_E_EINVAL != query_run_columns(&query, &columns, &result)) {
+        rc = MY_RC_E_INVALID;
+    }
+
+exit:
+
+    for (i = 0; i < NELEMS(objs); i++) {
+        if (NULL != objs[i]) {
+            base1_delete(objs[i]);
+        }
+    }
+    free(val1);
+    free(val3);
+
+    return (rc);
+}
+
+/** Number of objects the field index test indexes */
+#define TEST_FIELD_INDEX_OBJECTS 2000
+
+/**
+ * Check that an index finds exactly the objects with a field in a range.
+ *
+ * @param field_index_h The index
+ * @param objs The objects, NULL for those deleted
+ * @param count Number of objects
+ * @param field The field indexed
+ * @param low The lowest value
+ * @param high The highest value, equal to low for an equality lookup
+ * @return Whether the index agrees with the objects
+ */
+static bool
+test_field_index_check (field_index_handle field_index_h,
+                        const base1_handle *objs, size_t count,
+                        my_field_e field, uint64_t low, uint64_t high)
+{
+    base1_handle found[TEST_FIELD_INDEX_OBJECTS];
+    size_t expected = 0, num_found, i;
+    uint64_t value, prev = 0;
+    my_rc_e rc;
+
+    for (i = 0; i < count; i++) {
+        if ((NULL != objs[i]) &&
+            my_rc_e_is_ok(class_registry_get_field(objs[i], field, &value)) &&
+            (value >= low) && (value <= high)) {
+            expected++;
+        }
+    }
+
+    if (low == high) {
+        rc = field_index_lookup(field_index_h, low, found, NELEMS(found),
+                                &num_found);
+    } else {
+        rc = field_index_range(field_index_h, low, high, found, NELEMS(found),
+                               &num_found);
+    }
+    if (my_rc_e_is_notok(rc) || (expected != num_found)) {
+        return (false);
+    }
+
+    /* Ranges come back in order */
+    for (i = 0; i < num_found; i++) {
+        if (my_rc_e_is_notok(class_registry_get_field(found[i], field,
+                                                      &value)) ||
+            (value < low) || (value > high) || (value < prev)) {
+            return (false);
+        }
+        prev = value;
+    }
+
+    return (true);
+}
+
+/**
+ * Check that hash and ordered indexes on val2 and val3 find the objects with a
+ * value, and ordered ones a range of values, as objects are mutated, reset
+ * and deleted.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_field_index (void)
+{
+    base1_handle objs[TEST_FIELD_INDEX_OBJECTS] = { NULL };
+    field_index_handle hash_val2 = NULL, ordered_val2 = NULL;
+    field_index_handle ordered_val3 = NULL;
+    base1_public_data_st public_data;
+    size_t i;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    hash_val2 = field_index_new(FIELD_INDEX_KIND_E_HASH,
+                                MY_FIELD_E_BASE1_VAL2);
+    ordered_val2 = field_index_new(FIELD_INDEX_KIND_E_ORDERED,
+                                   MY_FIELD_E_BASE1_VAL2);
+    ordered_val3 = field_index_new(FIELD_INDEX_KIND_E_ORDERED,
+                                   MY_FIELD_E_BASE1_VAL3);
+    if ((NULL == hash_val2) || (NULL == ordered_val2) ||
+        (NULL == ordered_val3)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    /* Many objects share each val2, spanning several leaves */
+    for (i = 0; i < NELEMS(objs); i++) {
+        objs[i] = (0 == (i % 2)) ? base1_new3(i, i * 3) :
+            derived1_cast_to_base1(derived1_new1());
+        if (NULL == objs[i]) {
+            rc = MY_RC_E_ENOMEM;
+            goto exit;
+        }
+        public_data.val1 = i;
+        public_data.val2 = i % 10;
+        base1_set_public_data(objs[i], &public_data);
+        if (my_rc_e_is_notok(field_index_insert(hash_val2, objs[i])) ||
+            my_rc_e_is_notok(field_index_insert(ordered_val2, objs[i])) ||
+            my_rc_e_is_notok(field_index_insert(ordered_val3, objs[i]))) {
+            rc = MY_RC_E_ENOMEM;
+            goto exit;
+        }
+    }
+    /* Inserting again has no effect */
+    field_index_insert(hash_val2, objs[0]);
+    field_index_insert(ordered_val2, objs[0]);
+    if ((NELEMS(objs) != field_index_size(hash_val2)) ||
+        (NELEMS(objs) != field_index_size(ordered_val2))) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+
+    /* Mutate, reset and delete some objects */
+    for (i = 0; i < NELEMS(objs); i += 3) {
+        public_data.val1 = i;
+        public_data.val2 = 1000 + i;
+        base1_set_public_data(objs[i], &public_data);
+        base1_increase_val3(objs[i]);
+    }
+    for (i = 1; i < NELEMS(objs); i += 7) {
+        base1_reset(objs[i]);
+    }
+    for (i = 2; i < NELEMS(objs); i += 5) {
+        base1_delete(objs[i]);
+        objs[i] = NULL;
+    }
+
+    for (i = 0; i < 10; i++) {
+        if (!test_field_index_check(hash_val2, objs, NELEMS(objs),
+                                    MY_FIELD_E_BASE1_VAL2, i, i) ||
+            !test_field_index_check(ordered_val2, objs, NELEMS(objs),
+                                    MY_FIELD_E_BASE1_VAL2, i, i)) {
+            rc = MY_RC_E_INVALID;
+            goto exit;
+        }
+    }
+    if (!test_field_index_check(hash_val2, objs, NELEMS(objs),
+                                MY_FIELD_E_BASE1_VAL2, 1003, 1003) ||
+        !test_field_index_check(ordered_val2, objs, NELEMS(objs),
+                                MY_FIELD_E_BASE1_VAL2, 1000, 1500) ||
+        !test_field_index_check(ordered_val3, objs, NELEMS(objs),
+                                MY_FIELD_E_BASE1_VAL3, 300, 3000) ||
+        !test_field_index_check(ordered_val3, objs, NELEMS(objs),
+                                MY_FIELD_E_BASE1_VAL3, 0, UINT64_MAX)) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+    printf("field_index: objects(%zu) hash(%zu)\n",
+           field_index_size(ordered_val3), field_index_size(hash_val2));
+
+exit:
+
+    field_index_delete(hash_val2);
+    field_index_delete(ordered_val2);
+    field_index_delete(ordered_val3);
+    for (i = 0; i < NELEMS(objs); i++) {
+        if (NULL != objs[i]) {
+            base1_delete(objs[i]);
+        }
+    }
+
+    return (rc);
+}
+
+/** Number of objects the handle sort test sorts, enough for several threads */
+#define TEST_HANDLE_SORT_OBJECTS 12500
+
+/**
+ * Check that sorting handles by class groups them in order of class, and
+ * sorting by a field orders them by value with objects lacking the field
+ * last, both stably and with one thread or several.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_handle_sort (void)
+{
+    size_t class_counts[MY_CLASS_ID_E_MAX], expected[MY_CLASS_ID_E_MAX] = { 0 };
+    base1_handle *objs, *sorted = NULL;
+    derived1_handle derived1_h;
+    size_t threads, num_with_field, i;
+    uint64_t value, prev_value;
+    my_class_id_e class_id, prev_class;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    objs = calloc(TEST_HANDLE_SORT_OBJECTS, sizeof(*objs));
+    sorted = calloc(TEST_HANDLE_SORT_OBJECTS, sizeof(*sorted));
+    if ((NULL == objs) || (NULL == sorted)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    /* Object IDs increase in array order, which shows stability */
+    for (i = 0; i < TEST_HANDLE_SORT_OBJECTS; i++) {
+        switch ((i * 7) % 3) {
+        case 0:
+            objs[i] = base1_new3(i, i * 3);
+            break;
+        case 1:
+            derived1_h = derived1_new1();
+            objs[i] = derived1_cast_to_base1(derived1_h);
+            if ((NULL != derived1_h) && (0 == (i % 2))) {
+                derived1_increase_val4(derived1_h);
+            }
+            break;
+        default:
+            objs[i] = derived1_cast_to_base1(derived2_cast_to_derived1(
+                derived2_new1()));
+            break;
+        }
+        if (NULL == objs[i]) {
+            rc = MY_RC_E_ENOMEM;
+            goto exit;
+        }
+        expected[base1_class_id(objs[i])]++;
+    }
+
+    for (threads = 1; threads <= 3; threads += 2) {
+        memcpy(sorted, objs, TEST_HANDLE_SORT_OBJECTS * sizeof(*sorted));
+        rc = handle_sort_by_class(sorted, TEST_HANDLE_SORT_OBJECTS, threads,
+                                  class_counts);
+        if (my_rc_e_is_notok(rc)) {
+            goto exit;
+        }
+        if (0 != memcmp(class_counts, expected, sizeof(expected))) {
+            rc = MY_RC_E_INVALID;
+            goto exit;
+        }
+        for (i = 1; i < TEST_HANDLE_SORT_OBJECTS; i++) {
+            class_id = base1_class_id(sorted[i]);
+            prev_class = base1_class_id(sorted[i - 1]);
+            if ((class_id < prev_class) ||
+                ((class_id == prev_class) &&
+                 (base1_get_object_id(sorted[i]) <
+                  base1_get_object_id(sorted[i - 1])))) {
+                rc = MY_RC_E_INVALID;
+                goto exit;
+            }
+        }
+
+        /* Only derived objects have val4 */
+        memcpy(sorted, objs, TEST_HANDLE_SORT_OBJECTS * sizeof(*sorted));
+        rc = handle_sort_by_field(sorted, TEST_HANDLE_SORT_OBJECTS,
+                                  MY_FIELD_E_DERIVED1_VAL4, threads,
+                                  &num_with_field);
+        if (my_rc_e_is_notok(rc)) {
+            goto exit;
+        }
+        if (num_with_field != (expected[MY_CLASS_ID_E_DERIVED1] +
+                               expected[MY_CLASS_ID_E_DERIVED2])) {
+            rc = MY_RC_E_INVALID;
+            goto exit;
+        }
+        prev_value = 0;
+        for (i = 0; i < TEST_HANDLE_SORT_OBJECTS; i++) {
+            if (i >= num_with_field) {
+                if ((MY_CLASS_ID_E_BASE1 != base1_class_id(sorted[i])) ||
+                    ((i > num_with_field) &&
+                     (base1_get_object_id(sorted[i]) <
+                      base1_get_object_id(sorted[i - 1])))) {
+                    rc = MY_RC_E_INVALID;
+                    goto exit;
+                }
+                continue;
+            }
+            class_registry_get_field(sorted[i], MY_FIELD_E_DERIVED1_VAL4,
+                                     &value);
+            if ((value < prev_value) ||
+                ((i > 0) && (value == prev_value) &&
+                 (base1_get_object_id(sorted[i]) <
+                  base1_get_object_id(sorted[i - 1])))) {
+                rc = MY_RC_E_INVALID;
+                goto exit;
+            }
+            prev_value = value;
+        }
+    }
+    printf("handle_sort: base1(%zu) derived1(%zu) derived2(%zu) val4(%zu)\n",
+           class_counts[MY_CLASS_ID_E_BASE1],
+           class_counts[MY_CLASS_ID_E_DERIVED1],
+           class_counts[MY_CLASS_ID_E_DERIVED2], num_with_field);
+
+exit:
+
+    for (i = 0; (NULL != objs) && (i < TEST_HANDLE_SORT_OBJECTS); i++) {
+        if (NULL != objs[i]) {
+            base1_delete(objs[i]);
+        }
+    }
+    free(objs);
+    free(sorted);
+
+    return (rc);
+}
+
+/** Number of objects the aggregate test counts */
+#define TEST_AGGREGATE_OBJECTS 300
+
+/**
+ * Mutate objects from another thread, which updates its own shard.
+ *
+ * @param arg The objects, TEST_AGGREGATE_OBJECTS of them
+ * @return NULL
+ */
+static void *
+test_aggregate_thread (void *arg)
+{
+    base1_handle *objs = arg;
+    size_t i;
+
+    for (i = 0; i < TEST_AGGREGATE_OBJECTS; i += 4) {
+        if (NULL != objs[i]) {
+            base1_increase_val3(objs[i]);
+        }
+    }
+
+    return (NULL);
+}
+
+/**
+ * Check that running aggregates follow objects as they are constructed,
+ * added, mutated by several threads, reset, recycled and deleted, and agree
+ * with computing them over the live objects.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_aggregate (void)
+{
+    base1_handle objs[TEST_AGGREGATE_OBJECTS] = { NULL }, uncounted = NULL;
+    aggregate_result_st result, expected;
+    base1_public_data_st public_data = { 3, 4 };
+    const class_field_st *fields;
+    derived1_handle derived1_h;
+    my_class_id_e class_id;
+    my_field_e field;
+    pthread_t thread;
+    size_t i, j, num_fields;
+    uint64_t value;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    /* Objects constructed before starting count only when added */
+    objs[0] = base1_new3(9, 99);
+    uncounted = base1_new3(8, 88);
+    if ((NULL == objs[0]) || (NULL == uncounted)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+    aggregate_start();
+    aggregate_add(objs[0]);
+    aggregate_add(objs[0]);
+
+    for (i = 1; i < NELEMS(objs); i++) {
+        switch (i % 3) {
+        case 0:
+            objs[i] = base1_new3(i, i * 3);
+            break;
+        case 1:
+            derived1_h = derived1_new1();
+            objs[i] = derived1_cast_to_base1(derived1_h);
+            if (NULL != derived1_h) {
+                derived1_increase_val4(derived1_h);
+                base2_increase_val1(derived1_cast_to_base2(derived1_h));
+            }
+            break;
+        default:
+            objs[i] = derived1_cast_to_base1(derived2_cast_to_derived1(
+                derived2_new1()));
+            break;
+        }
+        if (NULL == objs[i]) {
+            rc = MY_RC_E_ENOMEM;
+            goto exit;
+        }
+    }
+
+    for (i = 0; i < NELEMS(objs); i += 5) {
+        base1_set_public_data(objs[i], &public_data);
+    }
+    base1_increase_val3(uncounted);
+    if (0 != pthread_create(&thread, NULL, test_aggregate_thread, objs)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+    pthread_join(thread, NULL);
+    for (i = 2; i < NELEMS(objs); i += 7) {
+        base1_reset(objs[i]);
+    }
+    for (i = 3; i < NELEMS(objs); i += 11) {
+        base1_delete(objs[i]);
+        objs[i] = NULL;
+    }
+    recycle_put(objs[1]);
+    objs[1] = NULL;
+
+    for (class_id = 0; class_id < MY_CLASS_ID_E_MAX; class_id++) {
+        for (field = MY_FIELD_E_INVALID + 1; field < MY_FIELD_E_MAX; field++) {
+            memset(&expected, 0, sizeof(expected));
+            expected.min = UINT64_MAX;
+            for (i = 0; i < NELEMS(objs); i++) {
+                if ((NULL == objs[i]) ||
+                    ((MY_CLASS_ID_E_INVALID != class_id) &&
+                     (class_id != base1_class_id(objs[i])))) {
+                    continue;
+                }
+                num_fields = class_registry_get_fields(
+                    base1_class_id(objs[i]), &fields);
+                for (j = 0; j < num_fields; j++) {
+                    if (field != fields[j].field) {
+                        continue;
+                    }
+                    class_registry_get_field(objs[i], field, &value);
+                    expected.count++;
+                    expected.sum += value;
+                    expected.min = (value < expected.min) ? value :
+                        expected.min;
+                    expected.max = (value > expected.max) ? value :
+                        expected.max;
+                }
+            }
+
+            /* The extremes bound those of the live values */
+            rc = aggregate_get(class_id, field, &result);
+            if (my_rc_e_is_notok(rc)) {
+                goto exit;
+            }
+            if ((result.count != expected.count) ||
+                (result.sum != expected.sum) || (result.min > expected.min) ||
+                (result.max < expected.max)) {
+                rc = MY_RC_E_INVALID;
+                goto exit;
+            }
+        }
+    }
+    aggregate_get(MY_CLASS_ID_E_INVALID, MY_FIELD_E_BASE1_VAL3, &result);
+    printf("aggregate: val3 count(%" PRIu64 ") sum(%" PRIu64 ") min(%" PRIu64
+           ") max(%" PRIu64 ")\n", result.count, result.sum, result.min,
+           result.max);
+
+exit:
+
+    aggregate_stop();
+    for (i = 0; i < NELEMS(objs); i++) {
+        if (NULL != objs[i]) {
+            base1_delete(objs[i]);
+        }
+    }
+    if (NULL != uncounted) {
+        base1_delete(uncounted);
+    }
+
+    return (rc);
+}
+
+/** Number of transfers each thread of the transaction test commits */
+#define TEST_TXN_TRANSFERS 2000
+
+/** Total of val2 the transfers of the transaction test preserve */
+#define TEST_TXN_TOTAL 2000
+
+/**
+ * Transfer val2 between two objects in transactions, or when only checking
+ * read both and check the total is preserved.
+ *
+ * @param arg The two objects, and a third entry which is non-NULL to check
+ * @return NULL, or non-NULL if a check failed
+ */
+static void *
+test_txn_thread (void *arg)
+{
+    base1_handle *objs = arg;
+    base1_public_data_st public_data[2];
+    uint64_t val1[2], val2[2];
+    size_t i, j;
+    txn_st txn;
+    my_rc_e rc;
+
+    for (i = 0; i < TEST_TXN_TRANSFERS;) {
+        txn_begin(&txn);
+        rc = MY_RC_E_SUCCESS;
+        for (j = 0; my_rc_e_is_ok(rc) && (j < 2); j++) {
+            rc = txn_read(&txn, objs[j], MY_FIELD_E_BASE1_VAL1, &val1[j]);
+            if (my_rc_e_is_ok(rc)) {
+                rc = txn_read(&txn, objs[j], MY_FIELD_E_BASE1_VAL2,
+                              &val2[j]);
+            }
+        }
+        if (my_rc_e_is_notok(rc)) {
+            continue;
+        }
+        if (NULL == objs[2]) {
+            for (j = 0; j < 2; j++) {
+                public_data[j].val1 = val1[j];
+                public_data[j].val2 = val2[j] + ((i % 2) == j ? 1 : -1);
+                txn_set_public_data(&txn, objs[j], &public_data[j]);
+            }
+        }
+        rc = txn_commit(&txn);
+        if (MY_RC_E_EAGAIN == rc) {
+            continue;
+        }
+        if (my_rc_e_is_notok(rc) || (TEST_TXN_TOTAL != val2[0] + val2[1])) {
+            return (arg);
+        }
+        i++;
+    }
+
+    return (NULL);
+}
+
+/**
+ * Check that transactions apply their updates together, fail when an object
+ * they read changes, and keep an invariant across objects while several
+ * threads update and check them.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_txn (void)
+{
+    base1_handle objs[3] = { NULL }, checker[3];
+    base1_public_data_st public_data;
+    derived1_handle derived1_h = NULL;
+    pthread_t threads[3];
+    size_t i, num_threads = 0;
+    uint64_t value, val3;
+    void *result;
+    txn_st txn, other;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    objs[0] = base1_new3(1, 10);
+    derived1_h = derived1_new1();
+    objs[1] = derived1_cast_to_base1(derived1_h);
+    if ((NULL == objs[0]) || (NULL == objs[1])) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    /* Updates of several objects commit together */
+    txn_begin(&txn);
+    public_data.val1 = 2;
+    public_data.val2 = TEST_TXN_TOTAL / 2;
+    txn_set_public_data(&txn, objs[0], &public_data);
+    txn_set_public_data(&txn, objs[1], &public_data);
+    txn_increase_val3(&txn, objs[0]);
+    txn_increase_val4(&txn, derived1_h);
+    rc = txn_commit(&txn);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    class_registry_get_field(objs[0], MY_FIELD_E_BASE1_VAL3, &val3);
+    class_registry_get_field(objs[1], MY_FIELD_E_DERIVED1_VAL4, &value);
+    if ((20 != val3) || (1500 != value)) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+
+    /* A transaction whose read was overtaken commits nothing */
+    txn_begin(&txn);
+    txn_read(&txn, objs[0], MY_FIELD_E_BASE1_VAL3, &value);
+    txn_increase_val4(&txn, derived1_h);
+    txn_begin(&other);
+    txn_increase_val3(&other, objs[0]);
+    rc = txn_commit(&other);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    if (MY_RC_E_EAGAIN != txn_read(&txn, objs[0], MY_FIELD_E_BASE1_VAL3,
+                                   &value)) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+    if (MY_RC_E_EAGAIN != txn_commit(&txn)) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+    class_registry_get_field(objs[1], MY_FIELD_E_DERIVED1_VAL4, &value);
+    if (1500 != value) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+
+    /* Reading and updating the same object in one transaction commits */
+    txn_begin(&txn);
+    txn_read(&txn, objs[0], MY_FIELD_E_BASE1_VAL3, &value);
+    txn_increase_val3(&txn, objs[0]);
+    rc = txn_commit(&txn);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    /* Two threads transfer while another checks the total */
+    checker[0] = objs[0];
+    checker[1] = objs[1];
+    checker[2] = objs[0];
+    for (num_threads = 0; num_threads < NELEMS(threads); num_threads++) {
+        if (0 != pthread_create(&threads[num_threads], NULL, test_txn_thread,
+                                (num_threads < 2) ? objs : checker)) {
+            rc = MY_RC_E_ENOMEM;
+            break;
+        }
+    }
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], &result);
+        if (NULL != result) {
+            rc = MY_RC_E_INVALID;
+        }
+    }
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    base1_get_public_data(objs[0], &public_data);
+    value = public_data.val2;
+    base1_get_public_data(objs[1], &public_data);
+    if (TEST_TXN_TOTAL != value + public_data.val2) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+    printf("txn: val2 after transfers (%" PRIu64 ", %" PRIu32 ")\n", value,
+           public_data.val2);
+
+exit:
+
+    for (i = 0; i < 2; i++) {
+        if (NULL != objs[i]) {
+            base1_delete(objs[i]);
+        }
+    }
+
+    return (rc);
+}
+
+/** Number of objects the actor test sends methods to */
+#define TEST_ACTOR_OBJECTS 64
+
+/** Number of val3 increases each thread of the actor test sends an object */
+#define TEST_ACTOR_INCREASES 4
+
+/** Arguments of a thread of the actor test */
+typedef struct test_actor_arg_st_ {
+    /** The executor */
+    actor_executor_handle executor_h;
+    /** The objects, TEST_ACTOR_OBJECTS of them */
+    base1_handle *objs;
+} test_actor_arg_st;
+
+/**
+ * Send val3 increases to every object, without waiting for them.
+ *
+ * @param arg The arguments, as test_actor_arg_st
+ * @return NULL, or non-NULL if sending failed
+ */
+static void *
+test_actor_thread (void *arg)
+{
+    test_actor_arg_st *actor_arg = arg;
+    size_t i, j;
+
+    for (j = 0; j < TEST_ACTOR_INCREASES; j++) {
+        for (i = 0; i < TEST_ACTOR_OBJECTS; i++) {
+            if (my_rc_e_is_notok(actor_increase_val3(actor_arg->executor_h,
+                                                     actor_arg->objs[i],
+                                                     NULL))) {
+                return (arg);
+            }
+        }
+    }
+
+    return (NULL);
+}
+
+/**
+ * Check that methods sent to objects by several threads all run, that each
+ * object runs its methods in the order sent, and that futures return results.
  *
- * This program is distributed in the hope that it will be useful,
- * but WITHOUT ANY WARRANTY; without even the implied warranty of
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- * GNU General Public License for more details.
+ * @return Return code
+ */
+static my_rc_e
+test_actor (void)
+{
+    base1_handle objs[TEST_ACTOR_OBJECTS] = { NULL };
+    actor_future_st futures[TEST_ACTOR_OBJECTS], future;
+    actor_executor_handle executor_h = NULL;
+    base1_public_data_st public_data;
+    test_actor_arg_st arg;
+    derived1_handle derived1_h;
+    pthread_t threads[2];
+    size_t i, num_threads = 0;
+    char buffer[256];
+    void *result;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    executor_h = actor_executor_new(3);
+    if (NULL == executor_h) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+    for (i = 0; i < NELEMS(objs); i++) {
+        objs[i] = (0 == (i % 2)) ? base1_new3(i, i + 1) :
+            derived1_cast_to_base1(derived1_new1());
+        if (NULL == objs[i]) {
+            rc = MY_RC_E_ENOMEM;
+            goto exit;
+        }
+    }
+
+    /* Increases sent by several threads all run */
+    arg.executor_h = executor_h;
+    arg.objs = objs;
+    for (num_threads = 0; num_threads < NELEMS(threads); num_threads++) {
+        if (0 != pthread_create(&threads[num_threads], NULL,
+                                test_actor_thread, &arg)) {
+            rc = MY_RC_E_ENOMEM;
+            break;
+        }
+    }
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], &result);
+        if (NULL != result) {
+            rc = MY_RC_E_INVALID;
+        }
+    }
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    for (i = 0; i < NELEMS(objs); i++) {
+        rc = actor_get_field(executor_h, objs[i], MY_FIELD_E_BASE1_VAL3,
+                             &futures[i]);
+        if (my_rc_e_is_notok(rc)) {
+            goto exit;
+        }
+    }
+    for (i = 0; i < NELEMS(objs); i++) {
+        rc = actor_future_wait(&futures[i]);
+        if (my_rc_e_is_notok(rc)) {
+            goto exit;
+        }
+        if (futures[i].value != ((0 == (i % 2)) ? (i + 1) : 42) <<
+            (TEST_ACTOR_INCREASES * NELEMS(threads))) {
+            rc = MY_RC_E_INVALID;
+            goto exit;
+        }
+    }
+
+    /* Methods of an object run in the order sent */
+    derived1_h = base1_try_cast_to_derived1(objs[1]);
+    public_data.val1 = 1;
+    for (i = 0; i < 10; i++) {
+        public_data.val2 = i;
+        actor_set_public_data(executor_h, objs[1], &public_data, NULL);
+    }
+    actor_increase_val4(executor_h, derived1_h, NULL);
+    rc = actor_string(executor_h, objs[1], &future);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    rc = actor_future_wait(&future);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    base1_string(objs[1], buffer, sizeof(buffer));
+    if ((NULL == future.string) || (0 != strcmp(buffer, future.string))) {
+        rc = MY_RC_E_INVALID;
+        free(future.string);
+        goto exit;
+    }
+    printf("actor: %s\n", future.string);
+    free(future.string);
+
+    /* Methods the object lacks fail through the future */
+    rc = actor_get_field(executor_h, objs[0], MY_FIELD_E_DERIVED1_VAL4,
+                         &future);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    if (my_rc_e_is_ok(actor_future_wait(&future))) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+
+exit:
+
+    actor_executor_delete(executor_h);
+    for (i = 0; i < NELEMS(objs); i++) {
+        if (NULL != objs[i]) {
+            base1_delete(objs[i]);
+        }
+    }
+
+    return (rc);
+}
+
+/** Number of objects the parallel test runs methods over */
+#define TEST_PARALLEL_OBJECTS 20000
+
+/**
+ * Increase val3 of an object.
  *
- * You should have received a copy of the GNU General Public License
- * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * @param worker_h The worker
+ * @param base1_h The object
+ * @param index Index of the object
+ * @param arg Counts the objects run by each worker, as size_t
+ * @return Return code
  */
+static my_rc_e
+test_parallel_increase (parallel_worker_handle worker_h, base1_handle base1_h,
+                        size_t index, void *arg)
+{
+    __atomic_fetch_add(&((size_t *) arg)[parallel_worker_index(worker_h)], 1,
+                       __ATOMIC_RELAXED);
 
-#include "base1.h"
-#include "base2.h"
-#include "derived1.h"
-#include "derived2.h"
+    return (base1_increase_val3(base1_h));
+}
 
 /**
- * Output a string representation of a base1 object.
+ * Render an object's string into the worker's scratch buffer.
  *
+ * @param worker_h The worker
  * @param base1_h The object
+ * @param arg Unused
+ * @param value Outputs the length of the string
+ * @return Return code
  */
-static void
-display_base1 (base1_handle base1_h)
+static my_rc_e
+test_parallel_string_length (parallel_worker_handle worker_h,
+                             base1_handle base1_h, void *arg, uint64_t *value)
 {
-    size_t string_size;
+    size_t size;
+    char *buffer;
     my_rc_e rc;
 
-    rc = base1_string_size(base1_h, &string_size);
+    rc = base1_string_size(base1_h, &size);
     if (my_rc_e_is_notok(rc)) {
-        return;
+        return (rc);
+    }
+    buffer = parallel_scratch(worker_h, size);
+    if (NULL == buffer) {
+        return (MY_RC_E_ENOMEM);
     }
+    rc = base1_string(base1_h, buffer, size);
+    *value = strlen(buffer);
 
-    {
-        char base1_str[string_size];
-        base1_string(base1_h, base1_str, sizeof(base1_str));
-        printf("type(%s): %s\n", base1_type_string(base1_h), base1_str);
+    return (rc);
+}
+
+/**
+ * Get val3 of an object.
+ *
+ * @param worker_h The worker
+ * @param base1_h The object
+ * @param arg Unused
+ * @param value Outputs val3
+ * @return Return code
+ */
+static my_rc_e
+test_parallel_val3 (parallel_worker_handle worker_h, base1_handle base1_h,
+                    void *arg, uint64_t *value)
+{
+    return (class_registry_get_field(base1_h, MY_FIELD_E_BASE1_VAL3, value));
+}
+
+/**
+ * Combine values in an order dependent way.
+ *
+ * @param result The result so far
+ * @param value The next value
+ * @return The combined result
+ */
+static uint64_t
+test_parallel_hash (uint64_t result, uint64_t value)
+{
+    return ((result * 31) + value);
+}
+
+/**
+ * Add values.
+ *
+ * @param result The result so far
+ * @param value The next value
+ * @return The combined result
+ */
+static uint64_t
+test_parallel_sum (uint64_t result, uint64_t value)
+{
+    return (result + value);
+}
+
+/**
+ * Check that a method runs once on each object of a collection however the
+ * work is stolen, that scratch buffers render strings, and that reductions
+ * combine in the same order with one thread or several.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_parallel (void)
+{
+    parallel_pool_handle pools[2] = { NULL };
+    size_t counts[3] = { 0 }, i, j;
+    base1_handle *objs = NULL;
+    uint64_t value, expected, block, results[2];
+    char buffer[256];
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    objs = calloc(TEST_PARALLEL_OBJECTS, sizeof(*objs));
+    pools[0] = parallel_pool_new(1);
+    pools[1] = parallel_pool_new(NELEMS(counts));
+    if ((NULL == objs) || (NULL == pools[0]) || (NULL == pools[1])) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+    for (i = 0; i < TEST_PARALLEL_OBJECTS; i++) {
+        objs[i] = (0 == (i % 3)) ? derived1_cast_to_base1(derived1_new1()) :
+            base1_new3(i, i);
+        if (NULL == objs[i]) {
+            rc = MY_RC_E_ENOMEM;
+            goto exit;
+        }
+    }
+
+    /* Each object is increased once */
+    rc = parallel_for_each_object(pools[1], objs, TEST_PARALLEL_OBJECTS,
+                                  test_parallel_increase, counts, 0);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    for (i = 0; i < TEST_PARALLEL_OBJECTS; i++) {
+        class_registry_get_field(objs[i], MY_FIELD_E_BASE1_VAL3, &value);
+        if (value != (uint32_t) (((0 == (i % 3)) ? 42 : i) * 2)) {
+            rc = MY_RC_E_INVALID;
+            goto exit;
+        }
+    }
+    if (TEST_PARALLEL_OBJECTS != counts[0] + counts[1] + counts[2]) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+
+    /* Both pools combine in the order of the objects and blocks */
+    expected = 0;
+    for (i = 0; i < TEST_PARALLEL_OBJECTS; i += 100) {
+        block = 0;
+        for (j = i; (j < i + 100) && (j < TEST_PARALLEL_OBJECTS); j++) {
+            class_registry_get_field(objs[j], MY_FIELD_E_BASE1_VAL3, &value);
+            block = test_parallel_hash(block, value);
+        }
+        expected = test_parallel_hash(expected, block);
     }
+    for (i = 0; i < NELEMS(pools); i++) {
+        rc = parallel_reduce_objects(pools[i], objs, TEST_PARALLEL_OBJECTS,
+                                     test_parallel_val3, NULL,
+                                     test_parallel_hash, 0, 100, &results[i]);
+        if (my_rc_e_is_notok(rc)) {
+            goto exit;
+        }
+        if (expected != results[i]) {
+            rc = MY_RC_E_INVALID;
+            goto exit;
+        }
+    }
+
+    /* Strings rendered in scratch buffers */
+    expected = 0;
+    for (i = 0; i < TEST_PARALLEL_OBJECTS; i++) {
+        base1_string(objs[i], buffer, sizeof(buffer));
+        expected += strlen(buffer);
+    }
+    rc = parallel_reduce_objects(pools[1], objs, TEST_PARALLEL_OBJECTS,
+                                 test_parallel_string_length, NULL,
+                                 test_parallel_sum, 0, 0, &value);
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+    if (expected != value) {
+        rc = MY_RC_E_INVALID;
+        goto exit;
+    }
+    printf("parallel: objects per worker(%zu, %zu, %zu) string bytes(%"
+           PRIu64 ")\n", counts[0], counts[1], counts[2], value);
+
+exit:
+
+    for (i = 0; i < NELEMS(pools); i++) {
+        parallel_pool_delete(pools[i]);
+    }
+    for (i = 0; (NULL != objs) && (i < TEST_PARALLEL_OBJECTS); i++) {
+        if (NULL != objs[i]) {
+            base1_delete(objs[i]);
+        }
+    }
+    free(objs);
+
+    return (rc);
 }
 
+/** Number of objects the dump test dumps */
+#define TEST_DUMP_OBJECTS 5000
+
 /**
- * Output a string representation of a base2 object.
+ * Read back the whole of a dump.
  *
- * @param base2_h The object
+ * @param fd The file
+ * @param size Outputs the size of the dump
+ * @return The dump, which the caller frees, or NULL on failure
  */
-static void
-display_base2 (base2_handle base2_h)
+static char *
+test_dump_read (int fd, size_t *size)
 {
-    size_t string_size;
-    my_rc_e rc;
+    off_t end;
+    char *text;
 
-    rc = base2_string_size(base2_h, &string_size);
+    end = lseek(fd, 0, SEEK_END);
+    text = malloc(end + 1);
+    if ((end < 0) || (NULL == text) || (end != pread(fd, text, end, 0))) {
+        free(text);
+        return (NULL);
+    }
+    *size = end;
+
+    return (text);
+}
+
+/**
+ * Check that parallel dumps with various threads, chunk sizes and bounds
+ * write exactly what the serial dump writes.
+ *
+ * @return Return code
+ */
+static my_rc_e
+test_dump (void)
+{
+    static const dump_config_st configs[] = {
+        { .num_threads = 1, .chunk_objects = 1000, .max_chunks = 1 },
+        { .num_threads = 3, .chunk_objects = 37, .max_chunks = 2 },
+        { .num_threads = 4, .chunk_objects = 1, .max_chunks = 0 },
+        { 0 },
+    };
+    char path[] = "/tmp/test_c_oo_dump.XXXXXX";
+    base1_handle objs[TEST_DUMP_OBJECTS] = { NULL };
+    char *serial = NULL, *parallel;
+    size_t serial_size, size, i;
+    dump_stats_st stats;
+    int fd;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    fd = mkstemp(path);
+    if (fd < 0) {
+        return (MY_RC_E_EIO);
+    }
+
+    for (i = 0; i < NELEMS(objs); i++) {
+        switch (i % 3) {
+        case 0:
+            objs[i] = base1_new3(i, i * 5);
+            break;
+        case 1:
+            objs[i] = derived1_cast_to_base1(derived1_new1());
+            break;
+        default:
+            objs[i] = derived1_cast_to_base1(derived2_cast_to_derived1(
+                derived2_new1()));
+            break;
+        }
+        if (NULL == objs[i]) {
+            rc = MY_RC_E_ENOMEM;
+            goto exit;
+        }
+    }
+
+    rc = dump_objects_serial(fd, objs, NELEMS(objs), &stats);
     if (my_rc_e_is_notok(rc)) {
-        return;
+        goto exit;
+    }
+    serial = test_dump_read(fd, &serial_size);
+    if ((NULL == serial) || (serial_size != stats.bytes)) {
+        rc = MY_RC_E_EIO;
+        goto exit;
     }
 
-    {
-        char base2_str[string_size];
-        base2_string(base2_h, base2_str, sizeof(base2_str));
-        printf("type(%s): %s\n", base2_type_string(base2_h), base2_str);
+    for (i = 0; i < NELEMS(configs); i++) {
+        if ((0 != ftruncate(fd, 0)) || (0 != lseek(fd, 0, SEEK_SET))) {
+            rc = MY_RC_E_EIO;
+            goto exit;
+        }
+        rc = dump_objects(fd, objs, NELEMS(objs), &configs[i], &stats);
+        if (my_rc_e_is_notok(rc)) {
+            goto exit;
+        }
+        parallel = test_dump_read(fd, &size);
+        if ((NULL == parallel) || (size != serial_size) ||
+            (0 != memcmp(parallel, serial, size))) {
+            rc = MY_RC_E_INVALID;
+            free(parallel);
+            goto exit;
+        }
+        free(parallel);
+    }
+    printf("dump: bytes(%zu) chunks(%zu) writes(%zu) threads(%zu)\n",
+           stats.bytes, stats.chunks, stats.writes, stats.threads);
+
+exit:
+
+    free(serial);
+    for (i = 0; i < NELEMS(objs); i++) {
+        if (NULL != objs[i]) {
+            base1_delete(objs[i]);
+        }
     }
+    close(fd);
+    unlink(path);
+
+    return (rc);
 }
 
 /**
@@ -226,5 +3011,132 @@ main (int argc, char *argv[])
 
     printf("\n");
 
+    rc = test_trace();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_allocator();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_rtti();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_registry();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_obj_table();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_clone();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_recycle();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_flyweight();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_arena();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_numa();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_magazine();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_objpool();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_journal();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_wal();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_wal_failure();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_checkpoint();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_snapshot();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_query();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_field_index();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_handle_sort();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_aggregate();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_txn();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_actor();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_parallel();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    rc = test_dump();
+    if (my_rc_e_is_notok(rc)) {
+        return (1);
+    }
+
+    printf("\n");
+
     return (0);
 }
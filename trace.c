@@ -0,0 +1,806 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements recording and replaying traces of public API calls.
+ *
+ * A trace file starts with a header of the magic "COTR" followed by a 32-bit
+ * little endian version.  Each record is then an operation byte, the object ID
+ * as an unsigned LEB128 varint and one varint for each argument the operation
+ * takes.  Object IDs in a trace are those assigned when the trace was recorded;
+ * the replayer maps them to the objects it constructs.
+ *
+ * Records are appended to a single buffer under a lock, so the trace keeps the
+ * order in which calls were made across threads.  On replay, records are
+ * sharded by object ID, so all calls on one object run on one thread in their
+ * recorded order.
+ */
+#include <pthread.h>
+#include <time.h>
+#include "trace.h"
+#include "id_map.h"
+#include "base1.h"
+#include "base2.h"
+#include "derived1.h"
+#include "derived2.h"
+
+/** Magic at the start of every trace file */
+#define TRACE_MAGIC "COTR"
+
+/** Version of the trace file format */
+#define TRACE_VERSION 1
+
+/** Size of the header at the start of a trace file */
+#define TRACE_HEADER_SIZE 8
+
+/** Size of the buffer records are staged in before being written */
+#define TRACE_BUFFER_SIZE (64 * 1024)
+
+/** Largest possible encoded record: the op, then three 10 byte varints */
+#define TRACE_MAX_RECORD_SIZE 31
+
+/** Most threads a replay may be sharded across */
+#define TRACE_MAX_THREADS 256
+
+/**
+ * The class of an object constructed during replay.  This is stored in the low
+ * bits of the object pointer in the replayer's ID map.
+ */
+typedef enum trace_class_e_ {
+    /** Object is a base1 and the pointer is a base1_handle */
+    TRACE_CLASS_E_BASE1,
+    /** Object is a derived1 and the pointer is a derived1_handle */
+    TRACE_CLASS_E_DERIVED1,
+    /** Object is a derived2 and the pointer is a derived2_handle */
+    TRACE_CLASS_E_DERIVED2,
+    /** Mask of the pointer bits used for the class */
+    TRACE_CLASS_E_MASK = 0x3,
+} trace_class_e;
+
+/** Per operation information */
+typedef struct trace_op_info_st_ {
+    /** String for the operation */
+    const char *name;
+    /** Number of arguments recorded for the operation */
+    uint8_t num_args;
+} trace_op_info_st;
+
+/**
+ * Information for each operation.
+ *
+ * @see trace_op_e
+ */
+static const trace_op_info_st trace_op_info[] = {
+    { "Invalid op", 0 },
+    { "base1_new1", 0 },
+    { "base1_new2", 2 },
+    { "base1_new3", 2 },
+    { "derived1_new1", 0 },
+    { "derived2_new1", 0 },
+    { "base1_set_public_data", 2 },
+    { "base1_increase_val3", 0 },
+    { "base1_string", 0 },
+    { "base1_delete", 0 },
+    { "base2_increase_val1", 0 },
+    { "base2_string", 0 },
+    { "base2_delete", 0 },
+    { "derived1_increase_val4", 0 },
+    { "base1_reset", 0 },
+    { "Max op", 0 },
+};
+
+/** @cond doxygen_suppress */
+/* Ensure there is information for each operation declared */
+CT_ASSERT(NELEMS(trace_op_info) == (TRACE_OP_E_MAX + 1));
+/** @endcond */
+
+/** State of the trace being recorded */
+typedef struct trace_recorder_st_ {
+    /** Serializes records from all threads */
+    pthread_mutex_t lock;
+    /** The trace file, NULL if no trace is being recorded */
+    FILE *file;
+    /** Number of bytes staged in buffer */
+    size_t len;
+    /** Records not yet written to the file */
+    uint8_t buffer[TRACE_BUFFER_SIZE];
+} trace_recorder_st;
+
+/** Arguments and results for the thread replaying one shard of a trace */
+typedef struct trace_shard_st_ {
+    /** The records of the trace, following the header */
+    const uint8_t *records;
+    /** Size of the records */
+    size_t len;
+    /** The shard this thread replays */
+    uint32_t shard;
+    /** The total number of shards */
+    uint32_t num_shards;
+    /** Outputs the result of the replay */
+    my_rc_e rc;
+    /** Outputs the statistics of the replay */
+    trace_replay_stats_st stats;
+} trace_shard_st;
+
+bool trace_active = false;
+
+/** The trace being recorded */
+static trace_recorder_st trace_recorder = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/**
+ * Get a string representation of the operation.
+ *
+ * @param op The operation
+ * @return A string representation of the operation or "__Invalid__" if an
+ * invalid operation is input.
+ */
+const char *
+trace_op_e_get_string (trace_op_e op)
+{
+    const char *retval = "__Invalid__";
+
+    if ((op >= TRACE_OP_E_INVALID) && (op <= TRACE_OP_E_MAX)) {
+        retval = trace_op_info[op].name;
+    }
+
+    return (retval);
+}
+
+/**
+ * Encode a value as an unsigned LEB128 varint.
+ *
+ * @param buffer The buffer to write into, must have room for 10 bytes.
+ * @param value The value
+ * @return The number of bytes written
+ */
+static size_t
+trace_varint_encode (uint8_t *buffer, uint64_t value)
+{
+    size_t len = 0;
+
+    while (value >= 0x80) {
+        buffer[len++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    buffer[len++] = (uint8_t) value;
+
+    return (len);
+}
+
+/**
+ * Decode an unsigned LEB128 varint.
+ *
+ * @param buffer The buffer to read from
+ * @param len The number of bytes left in the buffer
+ * @param value Outputs the value
+ * @return The number of bytes read or zero if the varint is truncated.
+ */
+static size_t
+trace_varint_decode (const uint8_t *buffer, size_t len, uint64_t *value)
+{
+    size_t i;
+    uint64_t result = 0;
+
+    for (i = 0; (i < len) && (i < 10); i++) {
+        result |= ((uint64_t) (buffer[i] & 0x7f)) << (7 * i);
+        if (0 == (buffer[i] & 0x80)) {
+            *value = result;
+            return (i + 1);
+        }
+    }
+
+    return (0);
+}
+
+/**
+ * Write the staged records to the trace file.  The recorder lock must be held.
+ *
+ * @return Return code
+ */
+static my_rc_e
+trace_flush (void)
+{
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if ((0 != trace_recorder.len) &&
+        (fwrite(trace_recorder.buffer, 1, trace_recorder.len,
+                trace_recorder.file) != trace_recorder.len)) {
+        LOG_ERR("Failed to write trace, len(%zu)", trace_recorder.len);
+        rc = MY_RC_E_EIO;
+    }
+    trace_recorder.len = 0;
+
+    return (rc);
+}
+
+/**
+ * Start recording a trace of public API calls.  Only one trace may be recorded
+ * at a time.  Objects constructed before the trace starts are not in the
+ * trace and calls on them are skipped on replay.
+ *
+ * @param path The file to write the trace to.  It is truncated if it exists.
+ * @return Return code
+ * @see trace_stop()
+ */
+my_rc_e
+trace_start (const char *path)
+{
+    uint8_t header[TRACE_HEADER_SIZE] = TRACE_MAGIC;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if (NULL == path) {
+        LOG_ERR("Invalid input, path(%p)", path);
+        return (MY_RC_E_EINVAL);
+    }
+
+    pthread_mutex_lock(&trace_recorder.lock);
+
+    if (NULL != trace_recorder.file) {
+        LOG_ERR("Trace already started");
+        rc = MY_RC_E_EINVAL;
+        goto err_exit;
+    }
+
+    trace_recorder.file = fopen(path, "wb");
+    if (NULL == trace_recorder.file) {
+        LOG_ERR("Failed to open trace, path(%s)", path);
+        rc = MY_RC_E_EIO;
+        goto err_exit;
+    }
+
+    header[4] = TRACE_VERSION & 0xff;
+    header[5] = (TRACE_VERSION >> 8) & 0xff;
+    header[6] = (TRACE_VERSION >> 16) & 0xff;
+    header[7] = (TRACE_VERSION >> 24) & 0xff;
+    memcpy(trace_recorder.buffer, header, sizeof(header));
+    trace_recorder.len = sizeof(header);
+
+    __atomic_store_n(&trace_active, true, __ATOMIC_RELEASE);
+
+err_exit:
+
+    pthread_mutex_unlock(&trace_recorder.lock);
+
+    return (rc);
+}
+
+/**
+ * Stop recording the trace and close the trace file.
+ *
+ * @return Return code
+ * @see trace_start()
+ */
+my_rc_e
+trace_stop (void)
+{
+    my_rc_e rc;
+
+    pthread_mutex_lock(&trace_recorder.lock);
+
+    if (NULL == trace_recorder.file) {
+        pthread_mutex_unlock(&trace_recorder.lock);
+        LOG_ERR("Trace not started");
+        return (MY_RC_E_EINVAL);
+    }
+
+    __atomic_store_n(&trace_active, false, __ATOMIC_RELEASE);
+
+    rc = trace_flush();
+    if (0 != fclose(trace_recorder.file)) {
+        LOG_ERR("Failed to close trace");
+        rc = MY_RC_E_EIO;
+    }
+    trace_recorder.file = NULL;
+
+    pthread_mutex_unlock(&trace_recorder.lock);
+
+    return (rc);
+}
+
+/**
+ * Append a record to the trace.  Callers should normally use TRACE_RECORD()
+ * rather than calling this directly.  Records made while no trace is being
+ * recorded are dropped.
+ *
+ * @param op The operation
+ * @param object_id The ID of the object the operation is for
+ * @param arg1 The first argument, ignored if the operation takes none.
+ * @param arg2 The second argument, ignored if the operation takes fewer.
+ */
+void
+trace_record (trace_op_e op, uint64_t object_id, uint32_t arg1, uint32_t arg2)
+{
+    uint8_t *buffer;
+
+    if ((op <= TRACE_OP_E_INVALID) || (op >= TRACE_OP_E_MAX)) {
+        LOG_ERR("Invalid input, op(%u)", op);
+        return;
+    }
+
+    pthread_mutex_lock(&trace_recorder.lock);
+
+    if (NULL == trace_recorder.file) {
+        goto exit;
+    }
+
+    if ((trace_recorder.len + TRACE_MAX_RECORD_SIZE) > TRACE_BUFFER_SIZE) {
+        (void) trace_flush();
+    }
+
+    buffer = trace_recorder.buffer + trace_recorder.len;
+    *buffer++ = (uint8_t) op;
+    buffer += trace_varint_encode(buffer, object_id);
+    if (trace_op_info[op].num_args > 0) {
+        buffer += trace_varint_encode(buffer, arg1);
+    }
+    if (trace_op_info[op].num_args > 1) {
+        buffer += trace_varint_encode(buffer, arg2);
+    }
+    trace_recorder.len = buffer - trace_recorder.buffer;
+
+exit:
+
+    pthread_mutex_unlock(&trace_recorder.lock);
+}
+
+/**
+ * Get the base1 view of an object constructed during replay.
+ *
+ * @param tagged The object pointer tagged with its class
+ * @return The base1 view
+ */
+static base1_handle
+trace_obj_to_base1 (uintptr_t tagged)
+{
+    void *obj = (void *) (tagged & ~((uintptr_t) TRACE_CLASS_E_MASK));
+
+    switch (tagged & TRACE_CLASS_E_MASK) {
+    case TRACE_CLASS_E_DERIVED1:
+        return (derived1_cast_to_base1(obj));
+    case TRACE_CLASS_E_DERIVED2:
+        return (derived1_cast_to_base1(derived2_cast_to_derived1(obj)));
+    default:
+        return (obj);
+    }
+}
+
+/**
+ * Get the derived1 view of an object constructed during replay.
+ *
+ * @param tagged The object pointer tagged with its class
+ * @return The derived1 view or NULL if the object is not a derived1.
+ */
+static derived1_handle
+trace_obj_to_derived1 (uintptr_t tagged)
+{
+    void *obj = (void *) (tagged & ~((uintptr_t) TRACE_CLASS_E_MASK));
+
+    switch (tagged & TRACE_CLASS_E_MASK) {
+    case TRACE_CLASS_E_DERIVED1:
+        return (obj);
+    case TRACE_CLASS_E_DERIVED2:
+        return (derived2_cast_to_derived1(obj));
+    default:
+        return (NULL);
+    }
+}
+
+/**
+ * Output a string representation of an object, as the traced call did, to
+ * include the cost of formatting in the replay.
+ *
+ * @param base1_h The base1 view of the object or NULL
+ * @param base2_h The base2 view of the object or NULL
+ * @return Return code
+ */
+static my_rc_e
+trace_replay_string (base1_handle base1_h, base2_handle base2_h)
+{
+    size_t string_size;
+    my_rc_e rc;
+
+    if (NULL != base1_h) {
+        rc = base1_string_size(base1_h, &string_size);
+    } else {
+        rc = base2_string_size(base2_h, &string_size);
+    }
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+
+    {
+        char str[string_size];
+
+        if (NULL != base1_h) {
+            rc = base1_string(base1_h, str, sizeof(str));
+        } else {
+            rc = base2_string(base2_h, str, sizeof(str));
+        }
+    }
+
+    return (rc);
+}
+
+/**
+ * Execute a single record of the trace.
+ *
+ * @param objs Map of recorded object IDs to the tagged objects constructed
+ * @param op The operation
+ * @param object_id The recorded object ID
+ * @param args The arguments of the operation
+ * @param stats The statistics to update
+ * @return Return code
+ */
+static my_rc_e
+trace_replay_op (id_map_handle objs, trace_op_e op, uint64_t object_id,
+                 const uint64_t *args, trace_replay_stats_st *stats)
+{
+    base1_public_data_st public_data;
+    uintptr_t tagged = 0;
+    derived1_handle derived1_h;
+    void *obj = NULL;
+    trace_class_e obj_class = TRACE_CLASS_E_BASE1;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    switch (op) {
+    case TRACE_OP_E_BASE1_NEW1:
+        obj = base1_new1();
+        break;
+    case TRACE_OP_E_BASE1_NEW2:
+        public_data.val1 = args[0];
+        public_data.val2 = args[1];
+        obj = base1_new2(&public_data);
+        break;
+    case TRACE_OP_E_BASE1_NEW3:
+        obj = base1_new3(args[0], args[1]);
+        break;
+    case TRACE_OP_E_DERIVED1_NEW1:
+        obj = derived1_new1();
+        obj_class = TRACE_CLASS_E_DERIVED1;
+        break;
+    case TRACE_OP_E_DERIVED2_NEW1:
+        obj = derived2_new1();
+        obj_class = TRACE_CLASS_E_DERIVED2;
+        break;
+    default:
+        if (!id_map_lookup(objs, object_id, &tagged)) {
+            stats->skipped++;
+            return (MY_RC_E_SUCCESS);
+        }
+        break;
+    }
+
+    if (0 == tagged) {
+        if (NULL == obj) {
+            stats->skipped++;
+            return (MY_RC_E_SUCCESS);
+        }
+
+        stats->ops++;
+        stats->objects++;
+        return (id_map_insert(objs, object_id, (uintptr_t) obj | obj_class));
+    }
+
+    derived1_h = trace_obj_to_derived1(tagged);
+    if ((NULL == derived1_h) &&
+        ((TRACE_OP_E_BASE2_INCREASE_VAL1 == op) ||
+         (TRACE_OP_E_BASE2_STRING == op) ||
+         (TRACE_OP_E_BASE2_DELETE == op) ||
+         (TRACE_OP_E_DERIVED1_INCREASE_VAL4 == op))) {
+        LOG_ERR("Operation on wrong class, op(%s) object_id(%" PRIu64 ")",
+                trace_op_e_get_string(op), object_id);
+        return (MY_RC_E_EINVAL);
+    }
+
+    switch (op) {
+    case TRACE_OP_E_BASE1_SET_PUBLIC_DATA:
+        public_data.val1 = args[0];
+        public_data.val2 = args[1];
+        rc = base1_set_public_data(trace_obj_to_base1(tagged), &public_data);
+        break;
+    case TRACE_OP_E_BASE1_INCREASE_VAL3:
+        rc = base1_increase_val3(trace_obj_to_base1(tagged));
+        break;
+    case TRACE_OP_E_BASE1_STRING:
+        rc = trace_replay_string(trace_obj_to_base1(tagged), NULL);
+        break;
+    case TRACE_OP_E_BASE1_RESET:
+        rc = base1_reset(trace_obj_to_base1(tagged));
+        break;
+    case TRACE_OP_E_BASE1_DELETE:
+        id_map_remove(objs, object_id, NULL);
+        base1_delete(trace_obj_to_base1(tagged));
+        break;
+    case TRACE_OP_E_BASE2_INCREASE_VAL1:
+        rc = base2_increase_val1(derived1_cast_to_base2(derived1_h));
+        break;
+    case TRACE_OP_E_BASE2_STRING:
+        rc = trace_replay_string(NULL, derived1_cast_to_base2(derived1_h));
+        break;
+    case TRACE_OP_E_BASE2_DELETE:
+        id_map_remove(objs, object_id, NULL);
+        base2_delete(derived1_cast_to_base2(derived1_h));
+        break;
+    case TRACE_OP_E_DERIVED1_INCREASE_VAL4:
+        rc = derived1_increase_val4(derived1_h);
+        break;
+    default:
+        LOG_ERR("Invalid op(%u)", op);
+        return (MY_RC_E_EINVAL);
+    }
+
+    stats->ops++;
+
+    return (rc);
+}
+
+/**
+ * Delete an object which was left undeleted at the end of the trace.
+ *
+ * @param object_id The recorded object ID
+ * @param tagged The object pointer tagged with its class
+ * @param ctx Unused
+ */
+static void
+trace_replay_delete_leaked (uint64_t object_id, uintptr_t tagged, void *ctx)
+{
+    base1_delete(trace_obj_to_base1(tagged));
+}
+
+/**
+ * Replay the records for one shard of a trace.  Objects left undeleted at the
+ * end of the trace are deleted, so repeated replays do not grow the heap.
+ *
+ * @param arg The shard to replay, a trace_shard_st.
+ * @return NULL
+ */
+static void *
+trace_replay_shard (void *arg)
+{
+    trace_shard_st *shard = arg;
+    const uint8_t *cur = shard->records;
+    const uint8_t *end = shard->records + shard->len;
+    uint64_t object_id, args[2];
+    id_map_handle objs;
+    trace_op_e op;
+    size_t n;
+    uint8_t i;
+
+    shard->rc = MY_RC_E_SUCCESS;
+
+    objs = id_map_new(0);
+    if (NULL == objs) {
+        shard->rc = MY_RC_E_ENOMEM;
+        return (NULL);
+    }
+
+    while (cur < end) {
+        op = *cur++;
+        if ((op <= TRACE_OP_E_INVALID) || (op >= TRACE_OP_E_MAX)) {
+            LOG_ERR("Corrupt trace, op(%u)", op);
+            shard->rc = MY_RC_E_EIO;
+            break;
+        }
+
+        n = trace_varint_decode(cur, end - cur, &object_id);
+        cur += n;
+        for (i = 0; (0 != n) && (i < trace_op_info[op].num_args); i++) {
+            n = trace_varint_decode(cur, end - cur, &args[i]);
+            cur += n;
+        }
+        if (0 == n) {
+            LOG_ERR("Truncated trace, op(%s)", trace_op_e_get_string(op));
+            shard->rc = MY_RC_E_EIO;
+            break;
+        }
+
+        if ((object_id % shard->num_shards) != shard->shard) {
+            continue;
+        }
+
+        shard->rc = trace_replay_op(objs, op, object_id, args, &shard->stats);
+        if (my_rc_e_is_notok(shard->rc)) {
+            break;
+        }
+    }
+
+    shard->stats.leaked = id_map_count(objs);
+    id_map_foreach(objs, trace_replay_delete_leaked, NULL);
+    id_map_delete(objs);
+
+    return (NULL);
+}
+
+/**
+ * Get the current time from a monotonic clock.
+ *
+ * @return The time in nanoseconds
+ */
+static uint64_t
+trace_now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (((uint64_t) ts.tv_sec * 1000000000ULL) + ts.tv_nsec);
+}
+
+/**
+ * Read a whole trace file into memory and validate its header.
+ *
+ * @param path The trace file
+ * @param len Outputs the size of the file
+ * @return The contents of the file, to be freed by the caller, or NULL if it
+ * could not be read.
+ */
+static uint8_t *
+trace_read_file (const char *path, size_t *len)
+{
+    uint8_t *buffer = NULL;
+    FILE *file;
+    long size;
+
+    file = fopen(path, "rb");
+    if (NULL == file) {
+        LOG_ERR("Failed to open trace, path(%s)", path);
+        return (NULL);
+    }
+
+    if ((0 != fseek(file, 0, SEEK_END)) || ((size = ftell(file)) < 0) ||
+        (0 != fseek(file, 0, SEEK_SET))) {
+        LOG_ERR("Failed to size trace, path(%s)", path);
+        goto err_exit;
+    }
+
+    buffer = malloc(size + 1);
+    if (NULL == buffer) {
+        goto err_exit;
+    }
+
+    if (fread(buffer, 1, size, file) != (size_t) size) {
+        LOG_ERR("Failed to read trace, path(%s)", path);
+        goto err_exit;
+    }
+
+    if ((size < TRACE_HEADER_SIZE) ||
+        (0 != memcmp(buffer, TRACE_MAGIC, strlen(TRACE_MAGIC))) ||
+        (TRACE_VERSION != (buffer[4] | (buffer[5] << 8) | (buffer[6] << 16) |
+                           ((uint32_t) buffer[7] << 24)))) {
+        LOG_ERR("Not a trace, path(%s)", path);
+        goto err_exit;
+    }
+
+    fclose(file);
+    *len = size;
+
+    return (buffer);
+
+err_exit:
+
+    free(buffer);
+    fclose(file);
+
+    return (NULL);
+}
+
+/**
+ * Replay a trace against the library.  Every recorded call is re-executed, on
+ * objects constructed by the replay in place of those recorded.  Tracing
+ * should be stopped while replaying, or the replay itself will be recorded.
+ *
+ * @param path The trace file
+ * @param num_threads The number of threads to shard the replay across.  Calls
+ * on a given object always run on the same thread in their recorded order.
+ * Zero or one replays on the calling thread.
+ * @param stats Outputs the statistics of the replay, summed over all threads.
+ * May be NULL.
+ * @return Return code
+ */
+my_rc_e
+trace_replay (const char *path, uint32_t num_threads,
+              trace_replay_stats_st *stats)
+{
+    trace_shard_st *shards = NULL;
+    pthread_t *threads = NULL;
+    uint32_t i, num_started = 0;
+    uint64_t start_ns;
+    uint8_t *buffer;
+    size_t len;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if ((NULL == path) || (num_threads > TRACE_MAX_THREADS)) {
+        LOG_ERR("Invalid input, path(%p) num_threads(%u)", path, num_threads);
+        return (MY_RC_E_EINVAL);
+    }
+
+    if (0 == num_threads) {
+        num_threads = 1;
+    }
+
+    buffer = trace_read_file(path, &len);
+    if (NULL == buffer) {
+        return (MY_RC_E_EIO);
+    }
+
+    shards = calloc(num_threads, sizeof(*shards));
+    threads = calloc(num_threads, sizeof(*threads));
+    if ((NULL == shards) || (NULL == threads)) {
+        rc = MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    start_ns = trace_now_ns();
+
+    for (i = 0; i < num_threads; i++) {
+        shards[i].records = buffer + TRACE_HEADER_SIZE;
+        shards[i].len = len - TRACE_HEADER_SIZE;
+        shards[i].shard = i;
+        shards[i].num_shards = num_threads;
+    }
+
+    if (1 == num_threads) {
+        trace_replay_shard(&shards[0]);
+    } else {
+        for (num_started = 0; num_started < num_threads; num_started++) {
+            if (0 != pthread_create(&threads[num_started], NULL,
+                                    trace_replay_shard, &shards[num_started])) {
+                LOG_ERR("Failed to create thread(%u)", num_started);
+                rc = MY_RC_E_ENOMEM;
+                break;
+            }
+        }
+
+        for (i = 0; i < num_started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+
+        if (num_started < num_threads) {
+            goto exit;
+        }
+    }
+
+    for (i = 0; i < num_threads; i++) {
+        if (my_rc_e_is_notok(shards[i].rc)) {
+            rc = shards[i].rc;
+        }
+    }
+
+    if (NULL != stats) {
+        memset(stats, 0, sizeof(*stats));
+        for (i = 0; i < num_threads; i++) {
+            stats->ops += shards[i].stats.ops;
+            stats->skipped += shards[i].stats.skipped;
+            stats->objects += shards[i].stats.objects;
+            stats->leaked += shards[i].stats.leaked;
+        }
+        stats->elapsed_ns = trace_now_ns() - start_ns;
+    }
+
+exit:
+
+    free(threads);
+    free(shards);
+    free(buffer);
+
+    return (rc);
+}
@@ -0,0 +1,132 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for recording the public API calls made on
+ * objects into a compact binary trace and replaying the trace against the
+ * library.  A trace captures the real mix of construction, mutation, string and
+ * delete calls made by an application, so that changes to allocation, dispatch
+ * and formatting can be benchmarked offline against that workload.
+ */
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include "common.h"
+
+/**
+ * The operations recorded in a trace.  Each identifies both the class of the
+ * handle the call was made through and the method called.
+ */
+typedef enum trace_op_e_ {
+    /** Invalid operation, should never be used */
+    TRACE_OP_E_INVALID,
+    /** base1_new1() */
+    TRACE_OP_E_BASE1_NEW1,
+    /** base1_new2(), args are val1 and val2 */
+    TRACE_OP_E_BASE1_NEW2,
+    /** base1_new3(), args are val1 and val3 */
+    TRACE_OP_E_BASE1_NEW3,
+    /** derived1_new1() */
+    TRACE_OP_E_DERIVED1_NEW1,
+    /** derived2_new1() */
+    TRACE_OP_E_DERIVED2_NEW1,
+    /** base1_set_public_data(), args are val1 and val2 */
+    TRACE_OP_E_BASE1_SET_PUBLIC_DATA,
+    /** base1_increase_val3() */
+    TRACE_OP_E_BASE1_INCREASE_VAL3,
+    /** base1_string() */
+    TRACE_OP_E_BASE1_STRING,
+    /** base1_delete() */
+    TRACE_OP_E_BASE1_DELETE,
+    /** base2_increase_val1() */
+    TRACE_OP_E_BASE2_INCREASE_VAL1,
+    /** base2_string() */
+    TRACE_OP_E_BASE2_STRING,
+    /** base2_delete() */
+    TRACE_OP_E_BASE2_DELETE,
+    /** derived1_increase_val4() */
+    TRACE_OP_E_DERIVED1_INCREASE_VAL4,
+    /** base1_reset() */
+    TRACE_OP_E_BASE1_RESET,
+    /** Max operation for bounds testing */
+    TRACE_OP_E_MAX,
+} trace_op_e;
+
+/** Statistics about a replay of a trace */
+typedef struct trace_replay_stats_st_ {
+    /** Number of operations executed */
+    uint64_t ops;
+    /** Number of operations skipped because the object was created before
+     *  the trace started or its construction failed */
+    uint64_t skipped;
+    /** Number of objects constructed */
+    uint64_t objects;
+    /** Number of objects left undeleted at the end of the trace */
+    uint64_t leaked;
+    /** Wall clock time taken by the replay in nanoseconds */
+    uint64_t elapsed_ns;
+} trace_replay_stats_st;
+
+/** Indicates whether a trace is being recorded.  Use trace_is_enabled(). */
+extern bool trace_active;
+
+/**
+ * Indicates whether calls should be recorded.  This is inline since it is
+ * checked on every traced call, and must cost next to nothing when tracing is
+ * off.
+ *
+ * @return true if a trace is being recorded.
+ */
+static inline bool
+trace_is_enabled (void)
+{
+    return (__atomic_load_n(&trace_active, __ATOMIC_RELAXED));
+}
+
+/**
+ * Record an operation if a trace is being recorded.  The arguments are only
+ * evaluated when tracing is enabled.
+ */
+#define TRACE_RECORD(op, object_id, arg1, arg2) \
+do { \
+    if (trace_is_enabled()) { \
+        trace_record(op, object_id, arg1, arg2); \
+    } \
+} while (0)
+
+/* APIs below are documented in their implementation file */
+
+extern const char *
+trace_op_e_get_string(trace_op_e op);
+
+extern my_rc_e
+trace_start(const char *path);
+
+extern my_rc_e
+trace_stop(void);
+
+extern void
+trace_record(trace_op_e op, uint64_t object_id, uint32_t arg1, uint32_t arg2);
+
+extern my_rc_e
+trace_replay(const char *path, uint32_t num_threads,
+             trace_replay_stats_st *stats);
+
+#endif
@@ -0,0 +1,363 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements transactions.
+ *
+ * A read takes the object's version, the field and the version again, and
+ * retries until both versions match and are even, so the value is one no commit
+ * was changing.  A commit may store the field while it is loaded, so the load
+ * is atomic, as are the stores of the mutators run as updates, and the value
+ * is only kept if the versions show that no commit did.
+ *
+ * A commit locks the objects it updates in order of address, so two commits
+ * locking common objects cannot deadlock, and a commit waiting for a lock
+ * yields rather than spinning, since the holder may need the CPU to finish.
+ * Validation then checks each read's object still has the version read, or
+ * holds it locked with that version, which can only be this commit's own
+ * lock.
+ */
+#include <sched.h>
+#include "txn.h"
+#include "base1_friend.h"
+
+/**
+ * Update an object's public data.
+ *
+ * @param base1_h The object
+ * @param arg The public data
+ * @return Return code
+ */
+static my_rc_e
+txn_set_public_data_op (base1_handle base1_h, const void *arg)
+{
+    base1_public_data_st public_data = *(const base1_public_data_st *) arg;
+
+    return (base1_set_public_data(base1_h, &public_data));
+}
+
+/**
+ * Increase an object's val3.
+ *
+ * @param base1_h The object
+ * @param arg Unused
+ * @return Return code
+ */
+static my_rc_e
+txn_increase_val3_op (base1_handle base1_h, const void *arg)
+{
+    return (base1_increase_val3(base1_h));
+}
+
+/**
+ * Increase an object's val4.
+ *
+ * @param base1_h The object, which is a derived1
+ * @param arg The object as a derived1
+ * @return Return code
+ */
+static my_rc_e
+txn_increase_val4_op (base1_handle base1_h, const void *arg)
+{
+    return (derived1_increase_val4((derived1_handle) arg));
+}
+
+/**
+ * Load a field atomically.
+ *
+ * @param ptr The field, which must be aligned to its width
+ * @param width The width of the field
+ * @return The value
+ */
+static uint64_t
+txn_load_field (const uint8_t *ptr, size_t width)
+{
+    switch (width) {
+    case 1:
+        return (__atomic_load_n(ptr, __ATOMIC_RELAXED));
+    case 2:
+        return (__atomic_load_n((const uint16_t *) ptr, __ATOMIC_RELAXED));
+    case 4:
+        return (__atomic_load_n((const uint32_t *) ptr, __ATOMIC_RELAXED));
+    default:
+        return (__atomic_load_n((const uint64_t *) ptr, __ATOMIC_RELAXED));
+    }
+}
+
+/**
+ * Start a transaction, discarding any reads and updates it had.
+ *
+ * @param txn The transaction
+ */
+void
+txn_begin (txn_st *txn)
+{
+    txn->num_reads = 0;
+    txn->num_writes = 0;
+}
+
+/**
+ * Read a field of an object in a transaction.  The commit fails if the
+ * object is updated by another transaction before then.
+ *
+ * @param txn The transaction
+ * @param base1_h The object
+ * @param field The field
+ * @param value Outputs the value
+ * @return Return code, MY_RC_E_EAGAIN if the object was updated since the
+ * transaction last read it, or MY_RC_E_ENOMEM if the transaction has made
+ * TXN_MAX_READS reads of other objects.
+ */
+my_rc_e
+txn_read (txn_st *txn, base1_handle base1_h, my_field_e field,
+          uint64_t *value)
+{
+    uint64_t *word, version;
+    ptrdiff_t offset;
+    size_t i, width;
+    my_rc_e rc;
+
+    if ((NULL == txn) || (NULL == base1_h) || (NULL == value)) {
+        LOG_ERR("Invalid input, txn(%p) base1_h(%p) value(%p)", txn, base1_h,
+                value);
+        return (MY_RC_E_EINVAL);
+    }
+
+    rc = class_registry_base1_field_offset(base1_class_id(base1_h), field,
+                                           &offset, &width);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+
+    word = base1_get_txn_version(base1_h);
+    while (true) {
+        version = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+        if (0 != (version & 1)) {
+            sched_yield();
+            continue;
+        }
+        *value = txn_load_field((const uint8_t *) base1_h + offset, width);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (version == __atomic_load_n(word, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    for (i = 0; i < txn->num_reads; i++) {
+        if (base1_h == txn->reads[i].obj) {
+            return ((version == txn->reads[i].version) ? MY_RC_E_SUCCESS :
+                    MY_RC_E_EAGAIN);
+        }
+    }
+    if (TXN_MAX_READS == txn->num_reads) {
+        return (MY_RC_E_ENOMEM);
+    }
+    txn->reads[txn->num_reads].obj = base1_h;
+    txn->reads[txn->num_reads].version = version;
+    txn->num_reads++;
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Queue an update of an object, run at commit with the object locked.
+ * Updates run in the order they were queued.
+ *
+ * @param txn The transaction
+ * @param base1_h The object
+ * @param fn The update, which should only mutate the object
+ * @param arg Argument of the update, which must remain valid until commit
+ * @return Return code, MY_RC_E_ENOMEM if the transaction has TXN_MAX_WRITES
+ * updates.
+ */
+my_rc_e
+txn_write (txn_st *txn, base1_handle base1_h, txn_op_fn fn, const void *arg)
+{
+    txn_write_st *write;
+
+    if ((NULL == txn) || (NULL == base1_h) || (NULL == fn)) {
+        LOG_ERR("Invalid input, txn(%p) base1_h(%p) fn(%p)", txn, base1_h,
+                fn);
+        return (MY_RC_E_EINVAL);
+    }
+    if (TXN_MAX_WRITES == txn->num_writes) {
+        return (MY_RC_E_ENOMEM);
+    }
+
+    write = &txn->writes[txn->num_writes++];
+    write->obj = base1_h;
+    write->fn = fn;
+    write->arg = arg;
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Queue setting an object's public data.
+ *
+ * @param txn The transaction
+ * @param base1_h The object
+ * @param public_data The public data, which is copied
+ * @return Return code
+ * @see base1_set_public_data()
+ */
+my_rc_e
+txn_set_public_data (txn_st *txn, base1_handle base1_h,
+                     const base1_public_data_st *public_data)
+{
+    txn_write_st *write;
+    my_rc_e rc;
+
+    if (NULL == public_data) {
+        LOG_ERR("Invalid input, public_data(%p)", public_data);
+        return (MY_RC_E_EINVAL);
+    }
+
+    rc = txn_write(txn, base1_h, txn_set_public_data_op, NULL);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+    write = &txn->writes[txn->num_writes - 1];
+    write->public_data = *public_data;
+    write->arg = &write->public_data;
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Queue increasing an object's val3.
+ *
+ * @param txn The transaction
+ * @param base1_h The object
+ * @return Return code
+ * @see base1_increase_val3()
+ */
+my_rc_e
+txn_increase_val3 (txn_st *txn, base1_handle base1_h)
+{
+    return (txn_write(txn, base1_h, txn_increase_val3_op, NULL));
+}
+
+/**
+ * Queue increasing an object's val4.
+ *
+ * @param txn The transaction
+ * @param derived1_h The object
+ * @return Return code
+ * @see derived1_increase_val4()
+ */
+my_rc_e
+txn_increase_val4 (txn_st *txn, derived1_handle derived1_h)
+{
+    return (txn_write(txn, derived1_cast_to_base1(derived1_h),
+                      txn_increase_val4_op, derived1_h));
+}
+
+/**
+ * Commit a transaction.  If every object it read is unchanged, its updates
+ * are run, with every object updated locked against other transactions.
+ * Otherwise nothing is run.  Either way the transaction may then be begun
+ * again.
+ *
+ * @param txn The transaction
+ * @return Return code, MY_RC_E_EAGAIN if an object read was updated by
+ * another transaction, or the first failure of an update.  Updates do not
+ * roll back, so they should not fail for valid objects.
+ */
+my_rc_e
+txn_commit (txn_st *txn)
+{
+    base1_handle locked[TXN_MAX_WRITES];
+    size_t num_locked = 0, i, j;
+    uint64_t *word, version;
+    my_rc_e rc = MY_RC_E_SUCCESS, op_rc;
+    bool valid;
+
+    if (NULL == txn) {
+        LOG_ERR("Invalid input, txn(%p)", txn);
+        return (MY_RC_E_EINVAL);
+    }
+
+    /* The distinct objects updated, in order of address */
+    for (i = 0; i < txn->num_writes; i++) {
+        for (j = num_locked; (j > 0) &&
+             ((uintptr_t) locked[j - 1] > (uintptr_t) txn->writes[i].obj);
+             j--) {
+        }
+        if ((j > 0) && (locked[j - 1] == txn->writes[i].obj)) {
+            continue;
+        }
+        memmove(&locked[j + 1], &locked[j],
+                (num_locked - j) * sizeof(*locked));
+        locked[j] = txn->writes[i].obj;
+        num_locked++;
+    }
+
+    for (i = 0; i < num_locked; i++) {
+        word = base1_get_txn_version(locked[i]);
+        while (true) {
+            version = __atomic_load_n(word, __ATOMIC_RELAXED);
+            if ((0 == (version & 1)) &&
+                __atomic_compare_exchange_n(word, &version, version | 1,
+                                            false, __ATOMIC_ACQUIRE,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+            sched_yield();
+        }
+    }
+    /* Order the updates after the locks for reads checking the versions */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    for (i = 0; i < txn->num_reads; i++) {
+        version = __atomic_load_n(base1_get_txn_version(txn->reads[i].obj),
+                                  __ATOMIC_ACQUIRE);
+        if (version == txn->reads[i].version) {
+            continue;
+        }
+        for (j = 0; (j < num_locked) && (locked[j] != txn->reads[i].obj);
+             j++) {
+        }
+        if ((j == num_locked) || (version != (txn->reads[i].version | 1))) {
+            rc = MY_RC_E_EAGAIN;
+            break;
+        }
+    }
+
+    valid = my_rc_e_is_ok(rc);
+    for (i = 0; valid && (i < txn->num_writes); i++) {
+        op_rc = txn->writes[i].fn(txn->writes[i].obj, txn->writes[i].arg);
+        if (my_rc_e_is_notok(op_rc) && my_rc_e_is_ok(rc)) {
+            rc = op_rc;
+        }
+    }
+
+    /* A failed validation leaves the versions as they were */
+    for (i = 0; i < num_locked; i++) {
+        word = base1_get_txn_version(locked[i]);
+        version = __atomic_load_n(word, __ATOMIC_RELAXED);
+        __atomic_store_n(word, valid ? (version + 1) : (version - 1),
+                         __ATOMIC_RELEASE);
+    }
+
+    txn_begin(txn);
+
+    return (rc);
+}
@@ -0,0 +1,138 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for transactions updating several objects
+ * together.  A transaction reads fields optimistically and queues updates,
+ * which are the objects' own mutators.  At commit the objects updated are
+ * locked, every read is checked to be still current, and the updates are run
+ * before the locks are released, so no other transaction sees some of them
+ * applied and others not.  If a read is out of date, the commit fails with
+ * MY_RC_E_EAGAIN and nothing is applied, and the caller runs the transaction
+ * again:
+ *
+ *     do {
+ *         txn_begin(&txn);
+ *         txn_read(&txn, base1_h, MY_FIELD_E_BASE1_VAL2, &value);
+ *         public_data.val2 = value + 1;
+ *         txn_set_public_data(&txn, base1_h, &public_data);
+ *         txn_increase_val4(&txn, derived1_h);
+ *         rc = txn_commit(&txn);
+ *     } while (MY_RC_E_EAGAIN == rc);
+ *
+ * Every object has a version word, which is even when unlocked and odd while
+ * a commit holds it, and which advances with each commit updating the object.
+ * There is no global clock, so transactions on different objects share no
+ * memory and scale with threads.
+ *
+ * Transactions are isolated from each other only: mutators called outside a
+ * transaction neither take the lock nor advance the version, and the plain
+ * getters (e.g., base1_get_public_data()) do not wait on it, so they may see
+ * a commit partly applied.  Only txn_read() never sees a partly applied
+ * commit.  A transaction does not see its own queued updates, and the values
+ * it reads are only known to be consistent once its commit succeeds.
+ *
+ * txn_read() loads fields while commits may store them, so updates store the
+ * fields they change atomically, as the mutators queued by
+ * txn_set_public_data(), txn_increase_val3() and txn_increase_val4() do.  An
+ * update given to txn_write() must do likewise.
+ */
+#ifndef __TXN_H__
+#define __TXN_H__
+
+#include "common.h"
+#include "base1.h"
+#include "derived1.h"
+#include "class_registry.h"
+
+/** Most reads in a transaction */
+#define TXN_MAX_READS 32
+
+/** Most updates in a transaction */
+#define TXN_MAX_WRITES 16
+
+/**
+ * An update queued by a transaction, run at commit with the object locked.
+ *
+ * @param base1_h The object
+ * @param arg The argument given when the update was queued
+ * @return Return code
+ */
+typedef my_rc_e
+(*txn_op_fn)(base1_handle base1_h, const void *arg);
+
+/** A read made by a transaction */
+typedef struct txn_read_st_ {
+    /** The object */
+    base1_handle obj;
+    /** Its version when read */
+    uint64_t version;
+} txn_read_st;
+
+/** An update queued by a transaction */
+typedef struct txn_write_st_ {
+    /** The object */
+    base1_handle obj;
+    /** The update */
+    txn_op_fn fn;
+    /** Argument of the update */
+    const void *arg;
+    /** Public data set by txn_set_public_data(), which arg points to */
+    base1_public_data_st public_data;
+} txn_write_st;
+
+/** A transaction, normally on the stack of the thread running it */
+typedef struct txn_st_ {
+    /** Number of reads */
+    size_t num_reads;
+    /** The reads */
+    txn_read_st reads[TXN_MAX_READS];
+    /** Number of updates */
+    size_t num_writes;
+    /** The updates, in the order they run */
+    txn_write_st writes[TXN_MAX_WRITES];
+} txn_st;
+
+/* APIs below are documented in their implementation file */
+
+extern void
+txn_begin(txn_st *txn);
+
+extern my_rc_e
+txn_read(txn_st *txn, base1_handle base1_h, my_field_e field,
+         uint64_t *value);
+
+extern my_rc_e
+txn_write(txn_st *txn, base1_handle base1_h, txn_op_fn fn, const void *arg);
+
+extern my_rc_e
+txn_set_public_data(txn_st *txn, base1_handle base1_h,
+                    const base1_public_data_st *public_data);
+
+extern my_rc_e
+txn_increase_val3(txn_st *txn, base1_handle base1_h);
+
+extern my_rc_e
+txn_increase_val4(txn_st *txn, derived1_handle derived1_h);
+
+extern my_rc_e
+txn_commit(txn_st *txn);
+
+#endif
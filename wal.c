@@ -0,0 +1,1238 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This implements the write-ahead log.
+ *
+ * Log files are named wal.<generation> and hold a header followed by framed
+ * records.  Each frame is the payload length and an FNV-1a checksum of the
+ * payload, both 32 bit little-endian, then the payload: the record type, the
+ * object ID as a varint and, depending on the type, the class and a list of
+ * field/value pairs.  Values are logged as absolute new values, so replaying a
+ * record more than once is harmless.  A torn write at the end of a file fails
+ * its checksum, and recovery stops reading that file there.
+ *
+ * Appenders encode their record into a shared buffer under a mutex.  The first
+ * thread needing the buffer on disk becomes the leader: it swaps in the spare
+ * buffer, writes and syncs the full one without the lock, while records from
+ * other threads accumulate behind it, and wakes every thread its sync covered.
+ * Those threads' records are then committed by the next leader in one sync.
+ *
+ * A snapshot first switches to a new log generation, then writes the objects to
+ * snapshot.tmp, syncs it and renames it over snapshot, whose header names the
+ * generation to replay from.  Mutations racing with the snapshot go to the new
+ * generation, and since values are absolute they apply correctly on top.  Older
+ * generations are removed only once the snapshot is durable.
+ */
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "wal.h"
+
+/** Magic at the start of each log file */
+#define WAL_LOG_MAGIC "OOWL"
+
+/** Magic at the start of the snapshot */
+#define WAL_SNAPSHOT_MAGIC "OOSN"
+
+/** Version of the file formats */
+#define WAL_VERSION 1
+
+/** Size of the file headers: magic, version and generation */
+#define WAL_HEADER_SIZE 16
+
+/** Size of a frame header: payload length and checksum */
+#define WAL_FRAME_HEADER_SIZE 8
+
+/** Largest payload: type, object ID, class, field count and fields */
+#define WAL_MAX_PAYLOAD_SIZE (1 + 10 + 1 + 1 + (MY_FIELD_E_MAX * 11))
+
+/** Largest frame */
+#define WAL_MAX_FRAME_SIZE (WAL_FRAME_HEADER_SIZE + WAL_MAX_PAYLOAD_SIZE)
+
+/** Default size of the record buffer */
+#define WAL_DEFAULT_BUFFER_SIZE (256 * 1024)
+
+/** Longest path of a file in the log's directory */
+#define WAL_PATH_SIZE 4096
+
+/** The types of records */
+typedef enum wal_rec_e_ {
+    /** Invalid record, should never be used */
+    WAL_REC_E_INVALID,
+    /** Full state of an object, which is constructed if it does not exist */
+    WAL_REC_E_OBJECT,
+    /** New values of some fields of an object */
+    WAL_REC_E_FIELDS,
+    /** Deletion of an object */
+    WAL_REC_E_DELETE,
+    /** Max record type for bounds testing */
+    WAL_REC_E_MAX,
+} wal_rec_e;
+
+/** State of the open log */
+typedef struct wal_st_ {
+    /** Protects the state below */
+    pthread_mutex_t lock;
+    /** Signalled when a sync completes or the flusher should run */
+    pthread_cond_t cond;
+    /** The configuration */
+    wal_config_st config;
+    /** The log's directory, empty if the log is closed */
+    char dir[WAL_PATH_SIZE];
+    /** The current log file */
+    int fd;
+    /** Generation of the current log file */
+    uint64_t generation;
+    /** Records not yet written */
+    uint8_t *buffer;
+    /** Buffer swapped in while the leader writes the other one */
+    uint8_t *spare;
+    /** Bytes in buffer */
+    size_t len;
+    /** Bytes appended since the log was opened */
+    uint64_t appended;
+    /** Bytes known to be durable */
+    uint64_t durable;
+    /** Whether a leader is writing */
+    bool flushing;
+    /** Result of the last write, sticky once it fails */
+    my_rc_e rc;
+    /** Whether the flusher thread is running */
+    bool flusher_running;
+    /** The flusher thread, in asynchronous mode */
+    pthread_t flusher;
+    /** Statistics */
+    wal_stats_st stats;
+} wal_st;
+
+bool wal_active = false;
+
+/** The open log */
+static wal_st wal = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .fd = -1,
+};
+
+/**
+ * Encode an unsigned value as a varint.
+ *
+ * @param buffer Where to write, with room for 10 bytes
+ * @param value The value
+ * @return Number of bytes written
+ */
+static size_t
+wal_varint_encode (uint8_t *buffer, uint64_t value)
+{
+    size_t len = 0;
+
+    while (value >= 0x80) {
+        buffer[len++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    buffer[len++] = value;
+
+    return (len);
+}
+
+/**
+ * Decode a varint.
+ *
+ * @param buffer Where to read
+ * @param len Bytes available
+ * @param value Outputs the value
+ * @return Number of bytes read or zero if the varint is truncated or too long
+ */
+static size_t
+wal_varint_decode (const uint8_t *buffer, size_t len, uint64_t *value)
+{
+    size_t i;
+
+    *value = 0;
+    for (i = 0; (i < len) && (i < 10); i++) {
+        *value |= (uint64_t) (buffer[i] & 0x7f) << (7 * i);
+        if (0 == (buffer[i] & 0x80)) {
+            return (i + 1);
+        }
+    }
+
+    return (0);
+}
+
+/**
+ * Store a 32 bit value little-endian.
+ *
+ * @param buffer Where to write
+ * @param value The value
+ */
+static void
+wal_put32 (uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = value;
+    buffer[1] = value >> 8;
+    buffer[2] = value >> 16;
+    buffer[3] = value >> 24;
+}
+
+/**
+ * Load a 32 bit little-endian value.
+ *
+ * @param buffer Where to read
+ * @return The value
+ */
+static uint32_t
+wal_get32 (const uint8_t *buffer)
+{
+    return (buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) |
+            ((uint32_t) buffer[3] << 24));
+}
+
+/**
+ * Compute the FNV-1a checksum of a payload.
+ *
+ * @param buffer The payload
+ * @param len Length of the payload
+ * @return The checksum
+ */
+static uint32_t
+wal_checksum (const uint8_t *buffer, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash = (hash ^ buffer[i]) * 16777619u;
+    }
+
+    return (hash);
+}
+
+/**
+ * Encode a record as a frame.
+ *
+ * @param frame Where to write, with room for WAL_MAX_FRAME_SIZE bytes
+ * @param type The record type
+ * @param object_id The object ID
+ * @param class_id The class, for object records
+ * @param count Number of fields, for object and field records
+ * @param fields The fields
+ * @param values The values of the fields
+ * @return Size of the frame
+ */
+static size_t
+wal_encode (uint8_t *frame, wal_rec_e type, uint64_t object_id,
+            my_class_id_e class_id, size_t count, const my_field_e *fields,
+            const uint64_t *values)
+{
+    uint8_t *payload = frame + WAL_FRAME_HEADER_SIZE;
+    size_t len = 0, i;
+
+    payload[len++] = type;
+    len += wal_varint_encode(payload + len, object_id);
+    if (WAL_REC_E_OBJECT == type) {
+        payload[len++] = class_id;
+    }
+    if (WAL_REC_E_DELETE != type) {
+        payload[len++] = count;
+        for (i = 0; i < count; i++) {
+            payload[len++] = fields[i];
+            len += wal_varint_encode(payload + len, values[i]);
+        }
+    }
+
+    wal_put32(frame, len);
+    wal_put32(frame + 4, wal_checksum(payload, len));
+
+    return (WAL_FRAME_HEADER_SIZE + len);
+}
+
+/**
+ * Write a whole buffer to a file.
+ *
+ * @param fd The file
+ * @param buffer The data
+ * @param len Length of the data
+ * @return Return code
+ */
+static my_rc_e
+wal_write_all (int fd, const uint8_t *buffer, size_t len)
+{
+    ssize_t written;
+
+    while (len > 0) {
+        written = write(fd, buffer, len);
+        if (written < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            LOG_ERR("Write failed, errno(%d)", errno);
+            return (MY_RC_E_EIO);
+        }
+        buffer += written;
+        len -= written;
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Build the path of a file in a directory.
+ *
+ * @param path Outputs the path, WAL_PATH_SIZE bytes
+ * @param dir The directory
+ * @param name The file name
+ * @param generation Generation of a log file, used if name has a %
+ * conversion
+ * @return Return code, MY_RC_E_EINVAL if the path does not fit
+ */
+static my_rc_e
+wal_path (char *path, const char *dir, const char *name, uint64_t generation)
+{
+    char file[64];
+    int len;
+
+    len = snprintf(file, sizeof(file), name, generation);
+    if ((len < 0) || ((size_t)len >= sizeof(file))) {
+        LOG_ERR("File name too long, name(%s)", name);
+        return (MY_RC_E_EINVAL);
+    }
+    len = snprintf(path, WAL_PATH_SIZE, "%s/%s", dir, file);
+    if ((len < 0) || (len >= WAL_PATH_SIZE)) {
+        LOG_ERR("Path too long, dir(%s) file(%s)", dir, file);
+        return (MY_RC_E_EINVAL);
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Sync a directory, so that files created or renamed in it are durable.
+ *
+ * @param dir The directory
+ * @return Return code
+ */
+static my_rc_e
+wal_sync_dir (const char *dir)
+{
+    int fd;
+
+    fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        return (MY_RC_E_EIO);
+    }
+    if (0 != fsync(fd)) {
+        close(fd);
+        return (MY_RC_E_EIO);
+    }
+    close(fd);
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Create a file with a header.
+ *
+ * @param path The file
+ * @param magic The magic of the header
+ * @param generation The generation stored in the header
+ * @return The open file or -1 on failure
+ */
+static int
+wal_create_file (const char *path, const char *magic, uint64_t generation)
+{
+    uint8_t header[WAL_HEADER_SIZE];
+    int fd;
+
+    memcpy(header, magic, 4);
+    wal_put32(header + 4, WAL_VERSION);
+    wal_put32(header + 8, generation);
+    wal_put32(header + 12, generation >> 32);
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+        LOG_ERR("Failed to create, path(%s) errno(%d)", path, errno);
+        return (-1);
+    }
+
+    if (my_rc_e_is_notok(wal_write_all(fd, header, sizeof(header))) ||
+        (0 != fdatasync(fd))) {
+        close(fd);
+        return (-1);
+    }
+
+    return (fd);
+}
+
+/**
+ * Make every record appended so far durable, leading the write or waiting for
+ * the current leader as needed.  The lock must be held.
+ *
+ * @param lsn Bytes appended which must be durable
+ * @return Return code
+ */
+static my_rc_e
+wal_commit_locked (uint64_t lsn)
+{
+    uint8_t *buffer;
+    uint64_t end;
+    size_t len;
+    my_rc_e rc;
+
+    while ((wal.durable < lsn) && my_rc_e_is_ok(wal.rc)) {
+        if (wal.flushing) {
+            pthread_cond_wait(&wal.cond, &wal.lock);
+            continue;
+        }
+
+        /* Lead: take the buffer so others can append while it is written */
+        wal.flushing = true;
+        buffer = wal.buffer;
+        len = wal.len;
+        end = wal.appended;
+        wal.buffer = wal.spare;
+        wal.len = 0;
+        pthread_mutex_unlock(&wal.lock);
+
+        rc = wal_write_all(wal.fd, buffer, len);
+        if (my_rc_e_is_ok(rc) && (0 != fdatasync(wal.fd))) {
+            LOG_ERR("Sync failed, errno(%d)", errno);
+            rc = MY_RC_E_EIO;
+        }
+
+        pthread_mutex_lock(&wal.lock);
+        wal.spare = buffer;
+        wal.flushing = false;
+        wal.stats.syncs++;
+        wal.stats.bytes += len;
+        if (my_rc_e_is_ok(rc)) {
+            wal.durable = end;
+        } else {
+            wal.rc = rc;
+        }
+        pthread_cond_broadcast(&wal.cond);
+    }
+
+    return (wal.rc);
+}
+
+/**
+ * Append a frame to the log, waiting until it is durable in synchronous
+ * mode.
+ *
+ * @param frame The frame
+ * @param len Size of the frame
+ * @return Return code, MY_RC_E_EIO once writing the log has failed
+ */
+static my_rc_e
+wal_append (const uint8_t *frame, size_t len)
+{
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    pthread_mutex_lock(&wal.lock);
+
+    if (wal.fd < 0) {
+        /* The log was closed after the caller checked it was enabled */
+        goto exit;
+    }
+
+    while (((wal.len + len) > wal.config.buffer_size) &&
+           my_rc_e_is_ok(wal.rc)) {
+        (void) wal_commit_locked(wal.appended);
+    }
+    rc = wal.rc;
+    if (my_rc_e_is_notok(rc)) {
+        goto exit;
+    }
+
+    memcpy(wal.buffer + wal.len, frame, len);
+    wal.len += len;
+    wal.appended += len;
+    wal.stats.records++;
+
+    if (wal.config.sync) {
+        rc = wal_commit_locked(wal.appended);
+    } else if (wal.len > (wal.config.buffer_size / 2)) {
+        pthread_cond_broadcast(&wal.cond);
+    }
+
+exit:
+
+    pthread_mutex_unlock(&wal.lock);
+
+    return (rc);
+}
+
+/**
+ * Log the full state of an object, as when it is constructed or reset.
+ * Callers should normally use WAL_LOG_OBJECT().
+ *
+ * @param base1_h The object
+ * @return Return code, MY_RC_E_EIO if the log cannot be written or, in
+ * synchronous mode, made durable.
+ */
+my_rc_e
+wal_log_object (base1_handle base1_h)
+{
+    my_field_e fields[MY_FIELD_E_MAX];
+    uint64_t values[MY_FIELD_E_MAX];
+    uint8_t frame[WAL_MAX_FRAME_SIZE];
+    const class_field_st *class_fields;
+    my_class_id_e class_id;
+    size_t count, i;
+
+    class_id = base1_class_id(base1_h);
+    count = class_registry_get_fields(class_id, &class_fields);
+    if (count > MY_FIELD_E_MAX) {
+        return (MY_RC_E_EINVAL);
+    }
+
+    for (i = 0; i < count; i++) {
+        fields[i] = class_fields[i].field;
+        class_registry_get_field(base1_h, fields[i], &values[i]);
+    }
+
+    return (wal_append(frame, wal_encode(frame, WAL_REC_E_OBJECT,
+                                 base1_get_object_id(base1_h), class_id,
+                                 count, fields, values)));
+}
+
+/**
+ * Log new values of fields of an object.  Callers should normally use
+ * WAL_LOG_FIELD() or WAL_LOG_FIELDS().
+ *
+ * @param object_id The object ID
+ * @param count Number of fields
+ * @param fields The fields
+ * @param values The new values
+ * @return Return code, MY_RC_E_EIO if the log cannot be written or, in
+ * synchronous mode, made durable.
+ */
+my_rc_e
+wal_log_fields (uint64_t object_id, size_t count, const my_field_e *fields,
+                const uint64_t *values)
+{
+    uint8_t frame[WAL_MAX_FRAME_SIZE];
+
+    if (count > MY_FIELD_E_MAX) {
+        LOG_ERR("Invalid input, count(%zu)", count);
+        return (MY_RC_E_EINVAL);
+    }
+
+    return (wal_append(frame, wal_encode(frame, WAL_REC_E_FIELDS, object_id,
+                                         MY_CLASS_ID_E_INVALID, count, fields,
+                                         values)));
+}
+
+/**
+ * Log the deletion of an object.  Callers should normally use
+ * WAL_LOG_DELETE().
+ *
+ * @param object_id The object ID
+ * @return Return code, MY_RC_E_EIO if the log cannot be written or, in
+ * synchronous mode, made durable.
+ */
+my_rc_e
+wal_log_delete (uint64_t object_id)
+{
+    uint8_t frame[WAL_MAX_FRAME_SIZE];
+
+    return (wal_append(frame, wal_encode(frame, WAL_REC_E_DELETE, object_id,
+                                         MY_CLASS_ID_E_INVALID, 0, NULL,
+                                         NULL)));
+}
+
+/**
+ * Make records durable periodically in asynchronous mode.
+ *
+ * @param arg Unused
+ * @return NULL
+ */
+static void *
+wal_flusher (void *arg)
+{
+    struct timespec deadline;
+
+    pthread_mutex_lock(&wal.lock);
+    while (wal.fd >= 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += wal.config.flush_interval_ms / 1000;
+        deadline.tv_nsec += (wal.config.flush_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        (void) pthread_cond_timedwait(&wal.cond, &wal.lock, &deadline);
+
+        if (wal.fd >= 0) {
+            (void) wal_commit_locked(wal.appended);
+        }
+    }
+    pthread_mutex_unlock(&wal.lock);
+
+    return (NULL);
+}
+
+/**
+ * Find the highest generation of the log files in a directory.
+ *
+ * @param dir The directory
+ * @return The highest generation or zero if there are none
+ */
+static uint64_t
+wal_max_generation (const char *dir)
+{
+    unsigned long long generation;
+    uint64_t max_generation = 0;
+    struct dirent *entry;
+    DIR *dirp;
+
+    dirp = opendir(dir);
+    if (NULL == dirp) {
+        return (0);
+    }
+
+    while (NULL != (entry = readdir(dirp))) {
+        if ((1 == sscanf(entry->d_name, "wal.%llu", &generation)) &&
+            (generation > max_generation)) {
+            max_generation = generation;
+        }
+    }
+    closedir(dirp);
+
+    return (max_generation);
+}
+
+/**
+ * Open the log in a directory, which must exist.  Each open starts a new log
+ * generation, after any existing log files, so it never appends to a file
+ * which may end in a torn record.  Objects to be recovered from the directory
+ * must be recovered before it is opened.
+ *
+ * @param dir The directory
+ * @param config The configuration or NULL for the defaults (synchronous, with
+ * a 256KB buffer)
+ * @return Return code
+ * @see wal_recover()
+ */
+my_rc_e
+wal_open (const char *dir, const wal_config_st *config)
+{
+    char path[WAL_PATH_SIZE];
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    if ((NULL == dir) || (strlen(dir) >= (WAL_PATH_SIZE - 64))) {
+        LOG_ERR("Invalid input, dir(%p)", dir);
+        return (MY_RC_E_EINVAL);
+    }
+
+    pthread_mutex_lock(&wal.lock);
+
+    if (wal.fd >= 0) {
+        LOG_ERR("Log already open");
+        rc = MY_RC_E_EINVAL;
+        goto exit;
+    }
+
+    memset(&wal.config, 0, sizeof(wal.config));
+    wal.config.sync = true;
+    if (NULL != config) {
+        wal.config = *config;
+    }
+    if (wal.config.buffer_size < (WAL_MAX_FRAME_SIZE * 2)) {
+        wal.config.buffer_size = WAL_DEFAULT_BUFFER_SIZE;
+    }
+    if (0 == wal.config.flush_interval_ms) {
+        wal.config.flush_interval_ms = 10;
+    }
+
+    wal.buffer = malloc(wal.config.buffer_size);
+    wal.spare = malloc(wal.config.buffer_size);
+    if ((NULL == wal.buffer) || (NULL == wal.spare)) {
+        rc = MY_RC_E_ENOMEM;
+        goto err_exit;
+    }
+
+    snprintf(wal.dir, sizeof(wal.dir), "%s", dir);
+    wal.generation = wal_max_generation(dir) + 1;
+    rc = wal_path(path, dir, "wal.%" PRIu64, wal.generation);
+    if (my_rc_e_is_notok(rc)) {
+        goto err_exit;
+    }
+    wal.fd = wal_create_file(path, WAL_LOG_MAGIC, wal.generation);
+    if ((wal.fd < 0) || my_rc_e_is_notok(wal_sync_dir(dir))) {
+        rc = MY_RC_E_EIO;
+        goto err_exit;
+    }
+
+    wal.len = 0;
+    wal.appended = 0;
+    wal.durable = 0;
+    wal.rc = MY_RC_E_SUCCESS;
+    memset(&wal.stats, 0, sizeof(wal.stats));
+    wal.stats.generation = wal.generation;
+
+    if (!wal.config.sync) {
+        if (0 != pthread_create(&wal.flusher, NULL, wal_flusher, NULL)) {
+            rc = MY_RC_E_ENOMEM;
+            goto err_exit;
+        }
+        wal.flusher_running = true;
+    }
+
+    __atomic_store_n(&wal_active, true, __ATOMIC_RELEASE);
+    goto exit;
+
+err_exit:
+
+    if (wal.fd >= 0) {
+        close(wal.fd);
+        wal.fd = -1;
+    }
+    free(wal.buffer);
+    free(wal.spare);
+    wal.buffer = NULL;
+    wal.spare = NULL;
+
+exit:
+
+    pthread_mutex_unlock(&wal.lock);
+
+    return (rc);
+}
+
+/**
+ * Make every record appended so far durable.  In asynchronous mode this is
+ * how a caller ensures its mutations survive a crash.
+ *
+ * @return Return code, MY_RC_E_EIO if writing the log has failed.
+ */
+my_rc_e
+wal_sync (void)
+{
+    my_rc_e rc = MY_RC_E_EINVAL;
+
+    pthread_mutex_lock(&wal.lock);
+    if (wal.fd >= 0) {
+        rc = wal_commit_locked(wal.appended);
+    }
+    pthread_mutex_unlock(&wal.lock);
+
+    return (rc);
+}
+
+/**
+ * Close the log, making every record durable first.
+ *
+ * @return Return code
+ */
+my_rc_e
+wal_close (void)
+{
+    bool flusher_running;
+    my_rc_e rc;
+
+    __atomic_store_n(&wal_active, false, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&wal.lock);
+
+    if (wal.fd < 0) {
+        pthread_mutex_unlock(&wal.lock);
+        LOG_ERR("Log not open");
+        return (MY_RC_E_EINVAL);
+    }
+
+    rc = wal_commit_locked(wal.appended);
+    while (wal.flushing) {
+        pthread_cond_wait(&wal.cond, &wal.lock);
+    }
+
+    close(wal.fd);
+    wal.fd = -1;
+    wal.dir[0] = '\0';
+    flusher_running = wal.flusher_running;
+    wal.flusher_running = false;
+    pthread_cond_broadcast(&wal.cond);
+
+    pthread_mutex_unlock(&wal.lock);
+
+    if (flusher_running) {
+        pthread_join(wal.flusher, NULL);
+    }
+
+    pthread_mutex_lock(&wal.lock);
+    free(wal.buffer);
+    free(wal.spare);
+    wal.buffer = NULL;
+    wal.spare = NULL;
+    pthread_mutex_unlock(&wal.lock);
+
+    return (rc);
+}
+
+/**
+ * Remove the log files of generations before a given one.
+ *
+ * @param dir The directory
+ * @param generation The oldest generation to keep
+ */
+static void
+wal_remove_before (const char *dir, uint64_t generation)
+{
+    unsigned long long file_generation;
+    char path[WAL_PATH_SIZE];
+    struct dirent *entry;
+    DIR *dirp;
+
+    dirp = opendir(dir);
+    if (NULL == dirp) {
+        return;
+    }
+
+    while (NULL != (entry = readdir(dirp))) {
+        if ((1 == sscanf(entry->d_name, "wal.%llu", &file_generation)) &&
+            (file_generation < generation) &&
+            my_rc_e_is_ok(wal_path(path, dir, entry->d_name, 0))) {
+            unlink(path);
+        }
+    }
+    closedir(dirp);
+}
+
+/**
+ * Write a snapshot of objects and remove the log files it supersedes.  The
+ * objects should be every live object whose state must survive; objects
+ * left out survive only if they are in a later log record.  The objects may
+ * be mutated by other threads meanwhile, but not deleted.
+ *
+ * @param objs The objects
+ * @param count Number of objects
+ * @return Return code
+ */
+my_rc_e
+wal_snapshot (const base1_handle *objs, size_t count)
+{
+    my_field_e fields[MY_FIELD_E_MAX];
+    uint64_t values[MY_FIELD_E_MAX];
+    char path[WAL_PATH_SIZE], tmp_path[WAL_PATH_SIZE];
+    char dir[WAL_PATH_SIZE], log_path[WAL_PATH_SIZE];
+    const class_field_st *class_fields;
+    my_class_id_e class_id;
+    uint64_t generation;
+    size_t i, j, num_fields, len;
+    uint8_t *buffer = NULL;
+    int fd = -1, new_fd;
+    my_rc_e rc;
+
+    if ((NULL == objs) && (0 != count)) {
+        LOG_ERR("Invalid input, objs(%p) count(%zu)", objs, count);
+        return (MY_RC_E_EINVAL);
+    }
+
+    /* Switch to a new generation, which the snapshot's records precede */
+    pthread_mutex_lock(&wal.lock);
+    if (wal.fd < 0) {
+        pthread_mutex_unlock(&wal.lock);
+        LOG_ERR("Log not open");
+        return (MY_RC_E_EINVAL);
+    }
+    rc = wal_commit_locked(wal.appended);
+    while (wal.flushing) {
+        pthread_cond_wait(&wal.cond, &wal.lock);
+    }
+    generation = wal.generation + 1;
+    snprintf(dir, sizeof(dir), "%s", wal.dir);
+    if (my_rc_e_is_ok(rc)) {
+        rc = wal_path(log_path, dir, "wal.%" PRIu64, generation);
+    }
+    new_fd = my_rc_e_is_ok(rc) ?
+        wal_create_file(log_path, WAL_LOG_MAGIC, generation) : -1;
+    if (new_fd >= 0) {
+        close(wal.fd);
+        wal.fd = new_fd;
+        wal.generation = generation;
+        wal.stats.generation = generation;
+    }
+    pthread_mutex_unlock(&wal.lock);
+    if ((new_fd < 0) || my_rc_e_is_notok(wal_sync_dir(dir))) {
+        return (MY_RC_E_EIO);
+    }
+
+    rc = wal_path(path, dir, "snapshot", 0);
+    if (my_rc_e_is_ok(rc)) {
+        rc = wal_path(tmp_path, dir, "snapshot.tmp", 0);
+    }
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+    fd = wal_create_file(tmp_path, WAL_SNAPSHOT_MAGIC, generation);
+    buffer = malloc(WAL_DEFAULT_BUFFER_SIZE);
+    if ((fd < 0) || (NULL == buffer)) {
+        rc = (fd < 0) ? MY_RC_E_EIO : MY_RC_E_ENOMEM;
+        goto exit;
+    }
+
+    for (i = 0, len = 0; (i < count) && my_rc_e_is_ok(rc); i++) {
+        class_id = base1_class_id(objs[i]);
+        num_fields = class_registry_get_fields(class_id, &class_fields);
+        for (j = 0; (j < num_fields) && (j < MY_FIELD_E_MAX); j++) {
+            fields[j] = class_fields[j].field;
+            class_registry_get_field(objs[i], fields[j], &values[j]);
+        }
+
+        if ((len + WAL_MAX_FRAME_SIZE) > WAL_DEFAULT_BUFFER_SIZE) {
+            rc = wal_write_all(fd, buffer, len);
+            len = 0;
+        }
+        len += wal_encode(buffer + len, WAL_REC_E_OBJECT,
+                          base1_get_object_id(objs[i]), class_id, j, fields,
+                          values);
+    }
+    if (my_rc_e_is_ok(rc)) {
+        rc = wal_write_all(fd, buffer, len);
+    }
+    if (my_rc_e_is_ok(rc) && (0 != fsync(fd))) {
+        rc = MY_RC_E_EIO;
+    }
+    if (my_rc_e_is_ok(rc) && (0 != rename(tmp_path, path))) {
+        LOG_ERR("Rename failed, errno(%d)", errno);
+        rc = MY_RC_E_EIO;
+    }
+    if (my_rc_e_is_ok(rc)) {
+        rc = wal_sync_dir(dir);
+    }
+    if (my_rc_e_is_ok(rc)) {
+        wal_remove_before(dir, generation);
+    }
+
+exit:
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(buffer);
+
+    return (rc);
+}
+
+/**
+ * Apply one record during recovery.
+ *
+ * @param payload The record
+ * @param len Length of the record
+ * @param objs The objects recovered so far, by object ID
+ * @param stats Updated for the record
+ * @return Return code, MY_RC_E_EIO if the record is malformed
+ */
+static my_rc_e
+wal_apply (const uint8_t *payload, size_t len, id_map_handle objs,
+           wal_recovery_stats_st *stats)
+{
+    uint64_t object_id, field, value;
+    base1_handle base1_h = NULL;
+    my_class_id_e class_id;
+    uintptr_t ptr;
+    size_t pos = 1, used, count, i;
+    wal_rec_e type;
+    my_rc_e rc;
+
+    type = payload[0];
+    used = wal_varint_decode(payload + pos, len - pos, &object_id);
+    if ((0 == used) || (0 == object_id) || (type <= WAL_REC_E_INVALID) ||
+        (type >= WAL_REC_E_MAX)) {
+        return (MY_RC_E_EIO);
+    }
+    pos += used;
+
+    if (id_map_lookup(objs, object_id, &ptr)) {
+        base1_h = (base1_handle) ptr;
+    }
+
+    if (WAL_REC_E_DELETE == type) {
+        if (NULL == base1_h) {
+            stats->skipped++;
+            return (MY_RC_E_SUCCESS);
+        }
+        id_map_remove(objs, object_id, NULL);
+        base1_delete(base1_h);
+        return (MY_RC_E_SUCCESS);
+    }
+
+    if (WAL_REC_E_OBJECT == type) {
+        if (pos >= len) {
+            return (MY_RC_E_EIO);
+        }
+        class_id = payload[pos++];
+        if ((NULL != base1_h) && (base1_class_id(base1_h) != class_id)) {
+            id_map_remove(objs, object_id, NULL);
+            base1_delete(base1_h);
+            base1_h = NULL;
+        }
+        if (NULL == base1_h) {
+            base1_h = class_registry_new(class_id, NULL, object_id);
+            if (NULL == base1_h) {
+                return (MY_RC_E_ENOMEM);
+            }
+            rc = id_map_insert(objs, object_id, (uintptr_t) base1_h);
+            if (my_rc_e_is_notok(rc)) {
+                base1_delete(base1_h);
+                return (rc);
+            }
+            my_object_id_reserve(object_id);
+        }
+    } else if (NULL == base1_h) {
+        stats->skipped++;
+        return (MY_RC_E_SUCCESS);
+    }
+
+    if (pos >= len) {
+        return (MY_RC_E_EIO);
+    }
+    count = payload[pos++];
+    for (i = 0; i < count; i++) {
+        if (pos >= len) {
+            return (MY_RC_E_EIO);
+        }
+        field = payload[pos++];
+        used = wal_varint_decode(payload + pos, len - pos, &value);
+        if (0 == used) {
+            return (MY_RC_E_EIO);
+        }
+        pos += used;
+        (void) class_registry_set_field(base1_h, field, value);
+    }
+
+    return (MY_RC_E_SUCCESS);
+}
+
+/**
+ * Apply every record of a file during recovery.
+ *
+ * @param path The file
+ * @param magic The expected magic
+ * @param objs The objects recovered so far, by object ID
+ * @param stats Updated for the file
+ * @param generation Outputs the generation in the file's header
+ * @param num_records Outputs the number of records applied
+ * @return Return code, MY_RC_E_EIO if the file is missing or its header is
+ * invalid.  A torn or corrupt record ends the file without an error.
+ */
+static my_rc_e
+wal_apply_file (const char *path, const char *magic, id_map_handle objs,
+                wal_recovery_stats_st *stats, uint64_t *generation,
+                uint64_t *num_records)
+{
+    uint8_t header[WAL_HEADER_SIZE], *data = NULL;
+    size_t len = 0, pos, payload_len;
+    FILE *file;
+    long size;
+    my_rc_e rc = MY_RC_E_SUCCESS;
+
+    *num_records = 0;
+
+    file = fopen(path, "rb");
+    if (NULL == file) {
+        return (MY_RC_E_EIO);
+    }
+
+    if ((1 != fread(header, sizeof(header), 1, file)) ||
+        (0 != memcmp(header, magic, 4)) ||
+        (WAL_VERSION != wal_get32(header + 4))) {
+        LOG_ERR("Invalid header, path(%s)", path);
+        fclose(file);
+        return (MY_RC_E_EIO);
+    }
+    *generation = wal_get32(header + 8) |
+        ((uint64_t) wal_get32(header + 12) << 32);
+
+    if ((0 == fseek(file, 0, SEEK_END)) && ((size = ftell(file)) > 0) &&
+        (0 == fseek(file, sizeof(header), SEEK_SET))) {
+        len = size - sizeof(header);
+        data = malloc((0 == len) ? 1 : len);
+        if ((NULL == data) || (len != fread(data, 1, len, file))) {
+            rc = (NULL == data) ? MY_RC_E_ENOMEM : MY_RC_E_EIO;
+        }
+    }
+    fclose(file);
+
+    for (pos = 0; my_rc_e_is_ok(rc) && (pos < len);
+         pos += WAL_FRAME_HEADER_SIZE + payload_len) {
+        if ((len - pos) < WAL_FRAME_HEADER_SIZE) {
+            stats->torn_files++;
+            break;
+        }
+        payload_len = wal_get32(data + pos);
+        if ((0 == payload_len) ||
+            (payload_len > (len - pos - WAL_FRAME_HEADER_SIZE)) ||
+            (wal_checksum(data + pos + WAL_FRAME_HEADER_SIZE, payload_len) !=
+             wal_get32(data + pos + 4))) {
+            stats->torn_files++;
+            break;
+        }
+
+        rc = wal_apply(data + pos + WAL_FRAME_HEADER_SIZE, payload_len, objs,
+                       stats);
+        if (MY_RC_E_EIO == rc) {
+            /* A checksummed but malformed record is treated as corrupt */
+            stats->torn_files++;
+            rc = MY_RC_E_SUCCESS;
+            break;
+        }
+        (*num_records)++;
+    }
+
+    free(data);
+
+    return (rc);
+}
+
+/**
+ * Compare generations, for sorting.
+ *
+ * @param a The first generation
+ * @param b The second generation
+ * @return Negative, zero or positive as a is below, equal to or above b.
+ */
+static int
+wal_generation_cmp (const void *a, const void *b)
+{
+    uint64_t ga = *(const uint64_t *) a, gb = *(const uint64_t *) b;
+
+    return ((ga > gb) - (ga < gb));
+}
+
+/**
+ * Recover objects from a log directory: the latest snapshot is loaded, then
+ * the log files written since are replayed on top of it in order.  Recovered
+ * objects keep their saved object IDs, and IDs allocated afterwards are above
+ * them.  This should be done before the log is opened and before other
+ * threads construct objects.
+ *
+ * @param dir The directory
+ * @param objs Filled in with the recovered objects, by object ID.  The caller
+ * owns the objects.
+ * @param stats Outputs statistics of the recovery, or NULL
+ * @return Return code
+ * @see wal_open()
+ */
+my_rc_e
+wal_recover (const char *dir, id_map_handle objs,
+             wal_recovery_stats_st *stats)
+{
+    unsigned long long file_generation;
+    wal_recovery_stats_st local_stats;
+    char path[WAL_PATH_SIZE];
+    uint64_t *generations = NULL, *grown;
+    uint64_t generation = 0, num_records;
+    size_t num_generations = 0, capacity = 0, i;
+    struct dirent *entry;
+    DIR *dirp;
+    my_rc_e rc;
+
+    if ((NULL == dir) || (NULL == objs) ||
+        (strlen(dir) >= (WAL_PATH_SIZE - 64))) {
+        LOG_ERR("Invalid input, dir(%p) objs(%p)", dir, objs);
+        return (MY_RC_E_EINVAL);
+    }
+    if (NULL == stats) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    if (wal_is_enabled()) {
+        LOG_ERR("Log is open");
+        return (MY_RC_E_EINVAL);
+    }
+
+    rc = wal_path(path, dir, "snapshot", 0);
+    if (my_rc_e_is_notok(rc)) {
+        return (rc);
+    }
+    if (0 == access(path, F_OK)) {
+        rc = wal_apply_file(path, WAL_SNAPSHOT_MAGIC, objs, stats,
+                            &generation, &stats->snapshot_objects);
+        if (my_rc_e_is_notok(rc)) {
+            return (rc);
+        }
+    }
+
+    dirp = opendir(dir);
+    if (NULL == dirp) {
+        LOG_ERR("Failed to open, dir(%s)", dir);
+        return (MY_RC_E_EIO);
+    }
+    while (NULL != (entry = readdir(dirp))) {
+        if ((1 != sscanf(entry->d_name, "wal.%llu", &file_generation)) ||
+            (file_generation < generation)) {
+            continue;
+        }
+        if (num_generations == capacity) {
+            capacity = (0 == capacity) ? 16 : (capacity * 2);
+            grown = realloc(generations, capacity * sizeof(*generations));
+            if (NULL == grown) {
+                closedir(dirp);
+                free(generations);
+                return (MY_RC_E_ENOMEM);
+            }
+            generations = grown;
+        }
+        generations[num_generations++] = file_generation;
+    }
+    closedir(dirp);
+
+    qsort(generations, num_generations, sizeof(*generations),
+          wal_generation_cmp);
+
+    rc = MY_RC_E_SUCCESS;
+    for (i = 0; (i < num_generations) && my_rc_e_is_ok(rc); i++) {
+        rc = wal_path(path, dir, "wal.%" PRIu64, generations[i]);
+        if (my_rc_e_is_notok(rc)) {
+            break;
+        }
+        rc = wal_apply_file(path, WAL_LOG_MAGIC, objs, stats, &generation,
+                            &num_records);
+        if (MY_RC_E_EIO == rc) {
+            /* A file torn before its header was synced holds no records */
+            stats->torn_files++;
+            rc = MY_RC_E_SUCCESS;
+        }
+        stats->records += num_records;
+    }
+    free(generations);
+
+    return (rc);
+}
+
+/**
+ * Get the statistics of the log.
+ *
+ * @param stats Filled in with the statistics
+ */
+void
+wal_get_stats (wal_stats_st *stats)
+{
+    pthread_mutex_lock(&wal.lock);
+    *stats = wal.stats;
+    pthread_mutex_unlock(&wal.lock);
+}
@@ -0,0 +1,168 @@
+/**
+ * @file
+ * @author Matt Miller <matt@matthewjmiller.net>
+ *
+ * @section LICENSE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * @section DESCRIPTION
+ *
+ * This is the public interface for the write-ahead log, which makes object
+ * state durable.  While the log is open, construction, deletion, reset and
+ * every public mutation of an object append a record to an append-only file in
+ * the log's directory.  Records from many threads are written together and made
+ * durable with a single fdatasync() (group commit).  In synchronous mode each
+ * mutation returns only once its record is durable; otherwise records are made
+ * durable by a background thread within a configured interval.  Once writing
+ * the log fails, every mutation fails with MY_RC_E_EIO, though it is applied
+ * in memory; constructors and deletions cannot report the failure, but
+ * wal_sync() and wal_close() do.
+ *
+ * A snapshot of a set of objects can be written at any time, after which older
+ * log files are removed.  After a crash, wal_recover() rebuilds the objects
+ * from the latest snapshot and the log files written since, with their original
+ * object IDs.
+ */
+#ifndef __WAL_H__
+#define __WAL_H__
+
+#include "common.h"
+#include "base1.h"
+#include "class_registry.h"
+#include "id_map.h"
+
+/** Configuration of the log */
+typedef struct wal_config_st_ {
+    /** Whether each mutation waits until its record is durable */
+    bool sync;
+    /** In asynchronous mode, most milliseconds before a record is durable */
+    uint32_t flush_interval_ms;
+    /** Bytes of records buffered before they must be written, or zero for
+     *  a default */
+    size_t buffer_size;
+} wal_config_st;
+
+/** Statistics of the open log */
+typedef struct wal_stats_st_ {
+    /** Records appended */
+    uint64_t records;
+    /** Bytes of records written */
+    uint64_t bytes;
+    /** Number of fdatasync() calls, each committing a group of records */
+    uint64_t syncs;
+    /** Generation of the current log file */
+    uint64_t generation;
+} wal_stats_st;
+
+/** Statistics of a recovery */
+typedef struct wal_recovery_stats_st_ {
+    /** Objects read from the snapshot */
+    uint64_t snapshot_objects;
+    /** Log records applied */
+    uint64_t records;
+    /** Log records for objects not present, which were ignored */
+    uint64_t skipped;
+    /** Log files which ended in a torn or corrupt record */
+    uint64_t torn_files;
+} wal_recovery_stats_st;
+
+/** Indicates whether the log is open.  Use wal_is_enabled(). */
+extern bool wal_active;
+
+/**
+ * Indicates whether mutations should be logged.  This is inline since it is
+ * checked on every mutation, and must cost next to nothing when the log is
+ * closed.
+ *
+ * @return true if the log is open.
+ */
+static inline bool
+wal_is_enabled (void)
+{
+    return (__atomic_load_n(&wal_active, __ATOMIC_RELAXED));
+}
+
+/*
+ * The macros below are expressions giving the return code of logging, which
+ * is MY_RC_E_SUCCESS when the log is closed.  Mutators return it, so that a
+ * mutation whose record is not durable fails.
+ */
+
+/**
+ * Log the full state of an object if the log is open.  The argument is only
+ * evaluated when the log is enabled.
+ */
+#define WAL_LOG_OBJECT(base1_h) \
+    (wal_is_enabled() ? wal_log_object(base1_h) : MY_RC_E_SUCCESS)
+
+/**
+ * Log the new value of a field of an object if the log is open.  The
+ * arguments are only evaluated when the log is enabled.
+ */
+#define WAL_LOG_FIELD(object_id, field, value) \
+    (wal_is_enabled() ? \
+     wal_log_fields((object_id), 1, &(my_field_e) { (field) }, \
+                    &(uint64_t) { (value) }) : \
+     MY_RC_E_SUCCESS)
+
+/**
+ * Log the new values of several fields of an object if the log is open.  The
+ * fields and values are arrays, which may be compound literals in
+ * parentheses.  The arguments are only evaluated when the log is enabled.
+ */
+#define WAL_LOG_FIELDS(object_id, count, fields, values) \
+    (wal_is_enabled() ? \
+     wal_log_fields((object_id), (count), (fields), (values)) : \
+     MY_RC_E_SUCCESS)
+
+/**
+ * Log the deletion of an object if the log is open.  The argument is only
+ * evaluated when the log is enabled.
+ */
+#define WAL_LOG_DELETE(object_id) \
+    (wal_is_enabled() ? wal_log_delete(object_id) : MY_RC_E_SUCCESS)
+
+/* APIs below are documented in their implementation file */
+
+extern my_rc_e
+wal_open(const char *dir, const wal_config_st *config);
+
+extern my_rc_e
+wal_close(void);
+
+extern my_rc_e
+wal_sync(void);
+
+extern my_rc_e
+wal_snapshot(const base1_handle *objs, size_t count);
+
+extern my_rc_e
+wal_recover(const char *dir, id_map_handle objs,
+            wal_recovery_stats_st *stats);
+
+extern void
+wal_get_stats(wal_stats_st *stats);
+
+extern my_rc_e
+wal_log_object(base1_handle base1_h);
+
+extern my_rc_e
+wal_log_fields(uint64_t object_id, size_t count, const my_field_e *fields,
+               const uint64_t *values);
+
+extern my_rc_e
+wal_log_delete(uint64_t object_id);
+
+#endif